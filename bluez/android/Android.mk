@@ -85,6 +85,7 @@ LOCAL_SRC_FILES := \
 	bluez/btio/btio.c \
 	bluez/src/sdp-client.c \
 	bluez/profiles/network/bnep.c \
+	bluez/profiles/network/tap.c \
 	bluez/attrib/gattrib.c \
 	bluez/attrib/gatt.c \
 	bluez/attrib/att.c
@@ -267,6 +268,7 @@ LOCAL_SRC_FILES := \
 	bluez/lib/bluetooth.c \
 	bluez/lib/hci.c \
 	bluez/profiles/network/bnep.c \
+	bluez/profiles/network/tap.c \
 	bluez/tools/bneptest.c \
 
 LOCAL_C_INCLUDES := \
@@ -128,6 +128,10 @@ struct characteristic {
 	uint16_t end_handle;
 
 	struct queue *descriptors;
+
+	/* Descriptors by position, the instance id is position + 1 */
+	void **descr_index;
+	unsigned int descr_index_len;
 };
 
 struct service {
@@ -140,6 +144,10 @@ struct service {
 	struct queue *chars;
 	struct queue *included;	/* Valid only for primary services */
 	bool incl_search_done;
+
+	/* Characteristics by position, the instance id is position + 1 */
+	void **char_index;
+	unsigned int char_index_len;
 };
 
 struct notification_data {
@@ -197,6 +205,11 @@ static struct queue *gatt_apps = NULL;
 static struct queue *gatt_devices = NULL;
 static struct queue *app_connections = NULL;
 
+/* Lookup tables for the queues above, by app id, bdaddr and conn id */
+static GHashTable *app_index = NULL;
+static GHashTable *device_index = NULL;
+static GHashTable *conn_index = NULL;
+
 static struct queue *services_sdp = NULL;
 
 static struct queue *listen_apps = NULL;
@@ -302,6 +315,7 @@ static void destroy_characteristic(void *data)
 		return;
 
 	queue_destroy(chars->descriptors, free);
+	free(chars->descr_index);
 	free(chars);
 }
 
@@ -323,36 +337,69 @@ static void destroy_service(void *data)
 	 */
 	queue_destroy(srvc->included, NULL);
 
+	free(srvc->char_index);
 	free(srvc);
 }
 
-static bool match_app_by_uuid(const void *data, const void *user_data)
+static guint bdaddr_hash(gconstpointer key)
 {
-	const uint8_t *exp_uuid = user_data;
-	const struct gatt_app *client = data;
+	const bdaddr_t *addr = key;
 
-	return !memcmp(exp_uuid, client->uuid, sizeof(client->uuid));
+	return get_le32(addr->b) ^ get_le16(addr->b + 4);
 }
 
-static bool match_app_by_id(const void *data, const void *user_data)
+static gboolean bdaddr_equal(gconstpointer a, gconstpointer b)
 {
-	int32_t exp_id = PTR_TO_INT(user_data);
-	const struct gatt_app *client = data;
-
-	return client->id == exp_id;
+	return !bacmp(a, b);
 }
 
-static struct gatt_app *find_app_by_id(int32_t id)
+/*
+ * Indexes a queue of characteristics or descriptors, both of which start
+ * with their element id. Only the leading entries whose instance id is
+ * their position + 1 are indexed, anything else is found by searching.
+ */
+static void **build_element_index(struct queue *queue, unsigned int *len)
 {
-	return queue_find(gatt_apps, match_app_by_id, INT_TO_PTR(id));
+	const struct queue_entry *entry;
+	unsigned int i = 0, max;
+	void **index;
+
+	*len = 0;
+
+	max = MIN(queue_length(queue), UINT8_MAX);
+	if (!max)
+		return NULL;
+
+	index = new0(void *, max);
+	if (!index)
+		return NULL;
+
+	for (entry = queue_get_entries(queue); entry && i < max;
+							entry = entry->next) {
+		const struct element_id *id = entry->data;
+
+		if (id->instance != i + 1)
+			break;
+
+		index[i++] = entry->data;
+	}
+
+	*len = i;
+
+	return index;
 }
 
-static bool match_device_by_bdaddr(const void *data, const void *user_data)
+static bool match_app_by_uuid(const void *data, const void *user_data)
 {
-	const struct gatt_device *dev = data;
-	const bdaddr_t *addr = user_data;
+	const uint8_t *exp_uuid = user_data;
+	const struct gatt_app *client = data;
 
-	return !bacmp(&dev->bdaddr, addr);
+	return !memcmp(exp_uuid, client->uuid, sizeof(client->uuid));
+}
+
+static struct gatt_app *find_app_by_id(int32_t id)
+{
+	return g_hash_table_lookup(app_index, INT_TO_PTR(id));
 }
 
 static bool match_device_by_state(const void *data, const void *user_data)
@@ -376,14 +423,6 @@ static bool match_pending_device(const void *data, const void *user_data)
 	return false;
 }
 
-static bool match_connection_by_id(const void *data, const void *user_data)
-{
-	const struct app_connection *conn = data;
-	const int32_t id = PTR_TO_INT(user_data);
-
-	return conn->id == id;
-}
-
 static bool match_connection_by_device_and_app(const void *data,
 							const void *user_data)
 {
@@ -397,8 +436,7 @@ static struct app_connection *find_connection_by_id(int32_t conn_id)
 {
 	struct app_connection *conn;
 
-	conn = queue_find(app_connections, match_connection_by_id,
-							INT_TO_PTR(conn_id));
+	conn = g_hash_table_lookup(conn_index, INT_TO_PTR(conn_id));
 	if (conn && conn->device->state == DEVICE_CONNECTED)
 		return conn;
 
@@ -423,7 +461,7 @@ static bool match_connection_by_app(const void *data, const void *user_data)
 
 static struct gatt_device *find_device_by_addr(const bdaddr_t *addr)
 {
-	return queue_find(gatt_devices, match_device_by_bdaddr, addr);
+	return g_hash_table_lookup(device_index, addr);
 }
 
 static struct gatt_device *find_pending_device(void)
@@ -533,6 +571,59 @@ static bool match_char_by_element_id(const void *data, const void *user_data)
 	return false;
 }
 
+/*
+ * Instance ids of characteristics and descriptors follow their discovery
+ * order, so the indexed entry at the matching position is tried before
+ * falling back to a full search.
+ */
+static struct characteristic *find_char(struct service *srvc,
+						const struct element_id *id)
+{
+	struct characteristic *ch;
+
+	if (id->instance && id->instance <= srvc->char_index_len) {
+		ch = srvc->char_index[id->instance - 1];
+		if (!bt_uuid_cmp(&ch->id.uuid, &id->uuid))
+			return ch;
+	}
+
+	return queue_find(srvc->chars, match_char_by_element_id, id);
+}
+
+static struct characteristic *find_next_char(struct service *srvc,
+							uint8_t instance)
+{
+	if (instance < srvc->char_index_len)
+		return srvc->char_index[instance];
+
+	return queue_find(srvc->chars, match_char_by_higher_inst_id,
+							INT_TO_PTR(instance));
+}
+
+static struct descriptor *find_descr(struct characteristic *ch,
+						const struct element_id *id)
+{
+	struct descriptor *descr;
+
+	if (id->instance && id->instance <= ch->descr_index_len) {
+		descr = ch->descr_index[id->instance - 1];
+		if (!bt_uuid_cmp(&descr->id.uuid, &id->uuid))
+			return descr;
+	}
+
+	return queue_find(ch->descriptors, match_descr_by_element_id, id);
+}
+
+static struct descriptor *find_next_descr(struct characteristic *ch,
+							uint8_t instance)
+{
+	if (instance < ch->descr_index_len)
+		return ch->descr_index[instance];
+
+	return queue_find(ch->descriptors, match_descr_by_higher_inst_id,
+							INT_TO_PTR(instance));
+}
+
 static void destroy_notification(void *data)
 {
 	struct notification_data *notification = data;
@@ -674,6 +765,9 @@ static void destroy_gatt_app(void *data)
 
 	queue_destroy(app->notifications, free);
 
+	if (app_index)
+		g_hash_table_remove(app_index, INT_TO_PTR(app->id));
+
 	free(app);
 }
 
@@ -715,6 +809,10 @@ static void destroy_device(void *data)
 
 	bt_auto_connect_remove(&dev->bdaddr);
 
+	if (device_index && g_hash_table_lookup(device_index,
+							&dev->bdaddr) == dev)
+		g_hash_table_remove(device_index, &dev->bdaddr);
+
 	free(dev);
 }
 
@@ -776,6 +874,8 @@ static struct gatt_device *create_device(const bdaddr_t *addr)
 		return NULL;
 	}
 
+	g_hash_table_replace(device_index, &dev->bdaddr, dev);
+
 	return device_ref(dev);
 }
 
@@ -891,6 +991,9 @@ static void destroy_connection(void *data)
 		break;
 	}
 
+	if (conn_index)
+		g_hash_table_remove(conn_index, INT_TO_PTR(conn->id));
+
 	if (!queue_find(app_connections, match_connection_by_device,
 							conn->device))
 		connection_cleanup(conn->device);
@@ -1136,6 +1239,8 @@ static struct app_connection *create_connection(struct gatt_device *device,
 		return NULL;
 	}
 
+	g_hash_table_insert(conn_index, INT_TO_PTR(new_conn->id), new_conn);
+
 	new_conn->device = device_ref(device);
 
 	return new_conn;
@@ -1828,6 +1933,8 @@ static struct gatt_app *register_app(const uint8_t *uuid, gatt_type_t type)
 		return NULL;
 	}
 
+	g_hash_table_insert(app_index, INT_TO_PTR(app->id), app);
+
 	if ((app->type == GATT_SERVER) &&
 			!queue_push_tail(listen_apps, INT_TO_PTR(app->id))) {
 		error("gatt: Cannot push server on the list");
@@ -2019,13 +2126,15 @@ static uint8_t unregister_app(int client_if)
 	queue_foreach(gatt_devices, clear_autoconnect_devices,
 							INT_TO_PTR(client_if));
 
-	cl = queue_remove_if(gatt_apps, match_app_by_id, INT_TO_PTR(client_if));
+	cl = find_app_by_id(client_if);
 	if (!cl) {
 		error("gatt: client_if=%d not found", client_if);
 
 		return HAL_STATUS_FAILED;
 	}
 
+	queue_remove(gatt_apps, cl);
+
 	/* Destroy app connections with proper notifications for this app. */
 	queue_remove_all(app_connections, match_connection_by_app, cl,
 							destroy_connection);
@@ -2194,8 +2303,9 @@ static void handle_client_disconnect(const void *buf, uint16_t len)
 	DBG("");
 
 	/* TODO: should we care to match also bdaddr when conn_id is unique? */
-	conn = queue_remove_if(app_connections, match_connection_by_id,
-						INT_TO_PTR(cmd->conn_id));
+	conn = g_hash_table_lookup(conn_index, INT_TO_PTR(cmd->conn_id));
+	if (conn)
+		queue_remove(app_connections, conn);
 	destroy_connection(conn);
 
 	status = HAL_STATUS_SUCCESS;
@@ -2737,6 +2847,10 @@ static void cache_all_srvc_chars(struct service *srvc, GSList *characteristics)
 			destroy_characteristic(ch);
 		}
 	}
+
+	free(srvc->char_index);
+	srvc->char_index = build_element_index(srvc->chars,
+						&srvc->char_index_len);
 }
 
 struct discover_char_data {
@@ -2822,8 +2936,7 @@ static void handle_client_get_characteristic(const void *buf, uint16_t len)
 	}
 
 	if (cmd->continuation)
-		ch = queue_find(srvc->chars, match_char_by_higher_inst_id,
-					INT_TO_PTR(cmd->char_id[0].inst_id));
+		ch = find_next_char(srvc, cmd->char_id[0].inst_id);
 	else
 		ch = queue_peek_head(srvc->chars);
 
@@ -2904,6 +3017,10 @@ static void gatt_discover_desc_cb(guint8 status, GSList *descs,
 			free(descr);
 	}
 
+	free(ch->descr_index);
+	ch->descr_index = build_element_index(ch->descriptors,
+							&ch->descr_index_len);
+
 reply:
 	descr = queue_peek_head(ch->descriptors);
 
@@ -2982,7 +3099,7 @@ static void handle_client_get_descriptor(const void *buf, uint16_t len)
 		goto failed;
 	}
 
-	ch = queue_find(srvc->chars, match_char_by_element_id, &char_id);
+	ch = find_char(srvc, &char_id);
 	if (!ch) {
 		error("gatt: Get descr. could not find characteristic");
 
@@ -3003,9 +3120,7 @@ static void handle_client_get_descriptor(const void *buf, uint16_t len)
 
 	/* Send from cache */
 	if (cmd->continuation)
-		descr = queue_find(ch->descriptors,
-					match_descr_by_higher_inst_id,
-					INT_TO_PTR(cmd->descr_id[0].inst_id));
+		descr = find_next_descr(ch, cmd->descr_id[0].inst_id);
 	else
 		descr = queue_peek_head(ch->descriptors);
 
@@ -3206,7 +3321,7 @@ static void handle_client_read_characteristic(const void *buf, uint16_t len)
 	}
 
 	/* search characteristics by element id */
-	ch = queue_find(srvc->chars, match_char_by_element_id, &char_id);
+	ch = find_char(srvc, &char_id);
 	if (!ch) {
 		error("gatt: Characteristic with inst_id: %d not found",
 							cmd->char_id.inst_id);
@@ -3342,7 +3457,7 @@ static void handle_client_write_characteristic(const void *buf, uint16_t len)
 	}
 
 	/* search characteristics by instance id */
-	ch = queue_find(srvc->chars, match_char_by_element_id, &char_id);
+	ch = find_char(srvc, &char_id);
 	if (!ch) {
 		error("gatt: Characteristic with inst_id: %d not found",
 							cmd->char_id.inst_id);
@@ -3550,7 +3665,7 @@ static void handle_client_read_descriptor(const void *buf, uint16_t len)
 		goto failed;
 	}
 
-	ch = queue_find(srvc->chars, match_char_by_element_id, &char_id);
+	ch = find_char(srvc, &char_id);
 	if (!ch) {
 		error("gatt: Read descr. could not find characteristic");
 
@@ -3558,8 +3673,7 @@ static void handle_client_read_descriptor(const void *buf, uint16_t len)
 		goto failed;
 	}
 
-	descr = queue_find(ch->descriptors, match_descr_by_element_id,
-								&descr_id);
+	descr = find_descr(ch, &descr_id);
 	if (!descr) {
 		error("gatt: Read descr. could not find descriptor");
 
@@ -3681,7 +3795,7 @@ static void handle_client_write_descriptor(const void *buf, uint16_t len)
 		goto failed;
 	}
 
-	ch = queue_find(srvc->chars, match_char_by_element_id, &char_id);
+	ch = find_char(srvc, &char_id);
 	if (!ch) {
 		error("gatt: Write descr. could not find characteristic");
 
@@ -3689,8 +3803,7 @@ static void handle_client_write_descriptor(const void *buf, uint16_t len)
 		goto failed;
 	}
 
-	descr = queue_find(ch->descriptors, match_descr_by_element_id,
-								&descr_id);
+	descr = find_descr(ch, &descr_id);
 	if (!descr) {
 		error("gatt: Write descr. could not find descriptor");
 
@@ -3834,8 +3947,10 @@ static void handle_notification(const uint8_t *pdu, uint16_t len,
 	ev->len = len - data_offset;
 	memcpy(ev->value, pdu + data_offset, len - data_offset);
 
-	ipc_send_notif(hal_ipc, HAL_SERVICE_ID_GATT, HAL_EV_GATT_CLIENT_NOTIFY,
-						sizeof(*ev) + ev->len, ev);
+	/* Bursts of notifications reach the HAL in one message */
+	ipc_queue_notif(hal_ipc, HAL_SERVICE_ID_GATT, HAL_EV_GATT_CLIENT_NOTIFY,
+					HAL_EV_GATT_CLIENT_NOTIFY_BATCH,
+					sizeof(*ev) + ev->len, ev);
 }
 
 static void send_register_for_notification_ev(int32_t id, int32_t registered,
@@ -3890,7 +4005,7 @@ static void handle_client_register_for_notification(const void *buf,
 	}
 
 	hal_gatt_id_to_element_id(&cmd->char_id, &match_id);
-	c = queue_find(service->chars, match_char_by_element_id, &match_id);
+	c = find_char(service, &match_id);
 	if (!c) {
 		status = HAL_STATUS_FAILED;
 		goto failed;
@@ -4239,8 +4354,7 @@ static void handle_client_test_command(const void *buf, uint16_t len)
 		status = handle_connect(test_client_if, &bdaddr, false);
 		break;
 	case GATT_CLIENT_TEST_CMD_DISCONNECT:
-		app = queue_find(gatt_apps, match_app_by_id,
-						INT_TO_PTR(test_client_if));
+		app = find_app_by_id(test_client_if);
 		queue_remove_all(app_connections, match_connection_by_app, app,
 							destroy_connection);
 
@@ -4335,8 +4449,9 @@ static void handle_server_disconnect(const void *buf, uint16_t len)
 	DBG("");
 
 	/* TODO: should we care to match also bdaddr when conn_id is unique? */
-	conn = queue_remove_if(app_connections, match_connection_by_id,
-						INT_TO_PTR(cmd->conn_id));
+	conn = g_hash_table_lookup(conn_index, INT_TO_PTR(cmd->conn_id));
+	if (conn)
+		queue_remove(app_connections, conn);
 	destroy_connection(conn);
 
 	status = HAL_STATUS_SUCCESS;
@@ -7227,6 +7342,10 @@ bool bt_gatt_register(struct ipc *ipc, const bdaddr_t *addr)
 	services_sdp = queue_new();
 	gatt_db = gatt_db_new();
 
+	app_index = g_hash_table_new(NULL, NULL);
+	device_index = g_hash_table_new(bdaddr_hash, bdaddr_equal);
+	conn_index = g_hash_table_new(NULL, NULL);
+
 	if (!gatt_devices || !gatt_apps || !listen_apps || !app_connections ||
 						!services_sdp || !gatt_db) {
 		error("gatt: Failed to allocate memory for queues");
@@ -7268,6 +7387,21 @@ failed:
 	queue_destroy(app_connections, NULL);
 	app_connections = NULL;
 
+	if (app_index) {
+		g_hash_table_destroy(app_index);
+		app_index = NULL;
+	}
+
+	if (device_index) {
+		g_hash_table_destroy(device_index);
+		device_index = NULL;
+	}
+
+	if (conn_index) {
+		g_hash_table_destroy(conn_index);
+		conn_index = NULL;
+	}
+
 	queue_destroy(listen_apps, NULL);
 	listen_apps = NULL;
 
@@ -7309,6 +7443,15 @@ void bt_gatt_unregister(void)
 	queue_destroy(gatt_devices, destroy_device);
 	gatt_devices = NULL;
 
+	g_hash_table_destroy(app_index);
+	app_index = NULL;
+
+	g_hash_table_destroy(device_index);
+	device_index = NULL;
+
+	g_hash_table_destroy(conn_index);
+	conn_index = NULL;
+
 	queue_destroy(services_sdp, free_service_sdp_record);
 	services_sdp = NULL;
 
@@ -215,6 +215,38 @@ static void handle_notify(void *buf, uint16_t len, int fd)
 		cbs->client->notify_cb(ev->conn_id, &params);
 }
 
+static void handle_notify_batch(void *buf, uint16_t len, int fd)
+{
+	struct hal_ev_gatt_client_notify_batch *ev = buf;
+	uint8_t *ptr = ev->data;
+	uint16_t left = len - sizeof(*ev);
+	uint8_t i;
+
+	for (i = 0; i < ev->num; i++) {
+		struct hal_ev_gatt_client_notify *notify = (void *) ptr;
+		uint16_t size;
+
+		if (left < sizeof(*notify))
+			goto failed;
+
+		size = sizeof(*notify) + notify->len;
+		if (left < size)
+			goto failed;
+
+		handle_notify(notify, size, fd);
+
+		ptr += size;
+		left -= size;
+	}
+
+	if (left == 0)
+		return;
+
+failed:
+	error("gatt: invalid notify batch event, aborting");
+	exit(EXIT_FAILURE);
+}
+
 static void handle_read_characteristic(void *buf, uint16_t len, int fd)
 {
 	struct hal_ev_gatt_client_read_characteristic *ev = buf;
@@ -797,6 +829,9 @@ static const struct hal_ipc_handler ev_handlers[] = {
 	/* HAL_EV_GATT_SERVER_MTU_CHANGED */
 	{ handle_server_mtu_changed, false,
 		sizeof(struct hal_ev_gatt_server_mtu_changed) },
+	/* HAL_EV_GATT_CLIENT_NOTIFY_BATCH */
+	{ handle_notify_batch, true,
+		sizeof(struct hal_ev_gatt_client_notify_batch) },
 	};
 
 /* Client API */
@@ -43,6 +43,35 @@ static pthread_mutex_t cmd_sk_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static pthread_t notif_th = 0;
 
+/*
+ * Commands from several threads may be in flight at the same time. The
+ * daemon responds to commands in the order it received them, so pending
+ * commands are queued in sending order and every response completes the
+ * oldest one. There is no dedicated thread for responses: one of the
+ * waiting callers reads from the socket and wakes up the others.
+ */
+struct cmd_request {
+	uint8_t service_id;
+	uint8_t opcode;
+	size_t *rsp_len;
+	void *rsp;
+	int *fd;
+	int status;
+	bool done;
+	pthread_cond_t cond;
+	struct cmd_request *next;
+};
+
+/* Serializes sending so that the queue matches the order on the socket */
+static pthread_mutex_t cmd_send_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Protects the queue, cmd_sk_mutex only guards cmd_sk itself */
+static pthread_mutex_t cmd_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cmd_queue_cond = PTHREAD_COND_INITIALIZER;
+static struct cmd_request *cmd_head = NULL;
+static struct cmd_request *cmd_tail = NULL;
+static bool cmd_reading = false;
+
 struct service_handler {
 	const struct hal_ipc_handler *handler;
 	uint8_t size;
@@ -202,6 +231,167 @@ failed:
 	exit(EXIT_FAILURE);
 }
 
+static bool handle_rsp(struct cmd_request *req, void *buf, ssize_t len,
+									int fd)
+{
+	struct ipc_hdr *cmd = buf;
+
+	if (len < (ssize_t) sizeof(*cmd)) {
+		error("Too small response received(%zd bytes)", len);
+		return false;
+	}
+
+	if (cmd->service_id != req->service_id) {
+		error("Invalid service id (0x%x vs 0x%x)",
+					cmd->service_id, req->service_id);
+		return false;
+	}
+
+	if (len != (ssize_t) (sizeof(*cmd) + cmd->len)) {
+		error("Malformed response received(%zd bytes)", len);
+		return false;
+	}
+
+	if (cmd->opcode != req->opcode && cmd->opcode != HAL_OP_STATUS) {
+		error("Invalid opcode received (0x%x vs 0x%x)",
+						cmd->opcode, req->opcode);
+		return false;
+	}
+
+	if (cmd->opcode == HAL_OP_STATUS) {
+		struct ipc_status *s = (void *) cmd->payload;
+
+		if (sizeof(*s) != cmd->len) {
+			error("Invalid status length");
+			return false;
+		}
+
+		if (s->code == HAL_STATUS_SUCCESS) {
+			error("Invalid success status response");
+			return false;
+		}
+
+		if (fd >= 0)
+			close(fd);
+
+		req->status = s->code;
+
+		return true;
+	}
+
+	if (cmd->len > *req->rsp_len) {
+		error("Malformed response received(%zd bytes)", len);
+		return false;
+	}
+
+	memcpy(req->rsp, cmd->payload, cmd->len);
+	*req->rsp_len = cmd->len;
+
+	if (req->fd)
+		*req->fd = fd;
+	else if (fd >= 0)
+		close(fd);
+
+	req->status = BT_STATUS_SUCCESS;
+
+	return true;
+}
+
+static void receive_rsp(int sk)
+{
+	struct msghdr msg;
+	struct iovec iv;
+	struct cmsghdr *cmsg;
+	char cmsgbuf[CMSG_SPACE(sizeof(int))];
+	char buf[IPC_MTU];
+	struct cmd_request *req;
+	ssize_t ret;
+	int fd = -1;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(cmsgbuf, 0, sizeof(cmsgbuf));
+
+	iv.iov_base = buf;
+	iv.iov_len = sizeof(buf);
+
+	msg.msg_iov = &iv;
+	msg.msg_iovlen = 1;
+
+	msg.msg_control = cmsgbuf;
+	msg.msg_controllen = sizeof(cmsgbuf);
+
+	ret = recvmsg(sk, &msg, 0);
+	if (ret < 0) {
+		error("Receiving command response failed: %s", strerror(errno));
+		goto failed;
+	}
+
+	/* socket was shutdown */
+	if (ret == 0) {
+		error("Command socket closed");
+		goto failed;
+	}
+
+	/* Receive auxiliary data in msg */
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET
+					&& cmsg->cmsg_type == SCM_RIGHTS) {
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+			break;
+		}
+	}
+
+	pthread_mutex_lock(&cmd_queue_mutex);
+
+	/* The reader is always waiting itself so the queue is not empty */
+	req = cmd_head;
+
+	cmd_head = req->next;
+	if (!cmd_head) {
+		cmd_tail = NULL;
+		pthread_cond_broadcast(&cmd_queue_cond);
+	}
+
+	if (!handle_rsp(req, buf, ret, fd)) {
+		pthread_mutex_unlock(&cmd_queue_mutex);
+		goto failed;
+	}
+
+	req->done = true;
+	pthread_cond_signal(&req->cond);
+
+	pthread_mutex_unlock(&cmd_queue_mutex);
+
+	return;
+
+failed:
+	exit(EXIT_FAILURE);
+}
+
+static void close_cmd_sk(void)
+{
+	int sk;
+
+	/* No new commands are sent once cmd_sk is cleared */
+	pthread_mutex_lock(&cmd_send_mutex);
+	pthread_mutex_lock(&cmd_sk_mutex);
+	sk = cmd_sk;
+	cmd_sk = -1;
+	pthread_mutex_unlock(&cmd_sk_mutex);
+	pthread_mutex_unlock(&cmd_send_mutex);
+
+	if (sk < 0)
+		return;
+
+	/* Let commands already in flight get their responses */
+	pthread_mutex_lock(&cmd_queue_mutex);
+	while (cmd_head)
+		pthread_cond_wait(&cmd_queue_cond, &cmd_queue_mutex);
+	pthread_mutex_unlock(&cmd_queue_mutex);
+
+	close(sk);
+}
+
 static int accept_connection(int sk)
 {
 	int err;
@@ -310,12 +500,7 @@ void hal_ipc_cleanup(void)
 	close(listen_sk);
 	listen_sk = -1;
 
-	pthread_mutex_lock(&cmd_sk_mutex);
-	if (cmd_sk >= 0) {
-		close(cmd_sk);
-		cmd_sk = -1;
-	}
-	pthread_mutex_unlock(&cmd_sk_mutex);
+	close_cmd_sk();
 
 	if (notif_sk < 0)
 		return;
@@ -333,14 +518,10 @@ int hal_ipc_cmd(uint8_t service_id, uint8_t opcode, uint16_t len, void *param,
 	struct msghdr msg;
 	struct iovec iv[2];
 	struct ipc_hdr cmd;
-	char cmsgbuf[CMSG_SPACE(sizeof(int))];
+	struct cmd_request req;
 	struct ipc_status s;
 	size_t s_len = sizeof(s);
-
-	if (cmd_sk < 0) {
-		error("Invalid cmd socket passed to hal_ipc_cmd");
-		goto failed;
-	}
+	int sk;
 
 	if (!rsp || !rsp_len) {
 		memset(&s, 0, s_len);
@@ -348,6 +529,15 @@ int hal_ipc_cmd(uint8_t service_id, uint8_t opcode, uint16_t len, void *param,
 		rsp = &s;
 	}
 
+	memset(&req, 0, sizeof(req));
+
+	req.service_id = service_id;
+	req.opcode = opcode;
+	req.rsp_len = rsp_len;
+	req.rsp = rsp;
+	req.fd = fd;
+	pthread_cond_init(&req.cond, NULL);
+
 	memset(&msg, 0, sizeof(msg));
 	memset(&cmd, 0, sizeof(cmd));
 
@@ -364,107 +554,67 @@ int hal_ipc_cmd(uint8_t service_id, uint8_t opcode, uint16_t len, void *param,
 	msg.msg_iov = iv;
 	msg.msg_iovlen = 2;
 
-	pthread_mutex_lock(&cmd_sk_mutex);
+	pthread_mutex_lock(&cmd_send_mutex);
+
+	if (cmd_sk < 0) {
+		error("Invalid cmd socket passed to hal_ipc_cmd");
+		pthread_mutex_unlock(&cmd_send_mutex);
+		goto failed;
+	}
+
+	/* Queue first, the response may arrive before sendmsg() returns */
+	pthread_mutex_lock(&cmd_queue_mutex);
+	if (cmd_tail)
+		cmd_tail->next = &req;
+	else
+		cmd_head = &req;
+	cmd_tail = &req;
+	pthread_mutex_unlock(&cmd_queue_mutex);
 
 	ret = sendmsg(cmd_sk, &msg, 0);
 	if (ret < 0) {
 		error("Sending command failed:%s", strerror(errno));
-		pthread_mutex_unlock(&cmd_sk_mutex);
+		pthread_mutex_unlock(&cmd_send_mutex);
 		goto failed;
 	}
 
 	/* socket was shutdown */
 	if (ret == 0) {
 		error("Command socket closed");
-		pthread_mutex_unlock(&cmd_sk_mutex);
-		goto failed;
-	}
-
-	memset(&msg, 0, sizeof(msg));
-	memset(&cmd, 0, sizeof(cmd));
-
-	iv[0].iov_base = &cmd;
-	iv[0].iov_len = sizeof(cmd);
-
-	iv[1].iov_base = rsp;
-	iv[1].iov_len = *rsp_len;
-
-	msg.msg_iov = iv;
-	msg.msg_iovlen = 2;
-
-	if (fd) {
-		memset(cmsgbuf, 0, sizeof(cmsgbuf));
-		msg.msg_control = cmsgbuf;
-		msg.msg_controllen = sizeof(cmsgbuf);
-	}
-
-	ret = recvmsg(cmd_sk, &msg, 0);
-
-	pthread_mutex_unlock(&cmd_sk_mutex);
-
-	if (ret < 0) {
-		error("Receiving command response failed: %s", strerror(errno));
+		pthread_mutex_unlock(&cmd_send_mutex);
 		goto failed;
 	}
 
+	sk = cmd_sk;
 
-	if (ret < (ssize_t) sizeof(cmd)) {
-		error("Too small response received(%zd bytes)", ret);
-		goto failed;
-	}
+	pthread_mutex_unlock(&cmd_send_mutex);
 
-	if (cmd.service_id != service_id) {
-		error("Invalid service id (0x%x vs 0x%x)",
-						cmd.service_id, service_id);
-		goto failed;
-	}
+	pthread_mutex_lock(&cmd_queue_mutex);
 
-	if (ret != (ssize_t) (sizeof(cmd) + cmd.len)) {
-		error("Malformed response received(%zd bytes)", ret);
-		goto failed;
-	}
-
-	if (cmd.opcode != opcode && cmd.opcode != HAL_OP_STATUS) {
-		error("Invalid opcode received (0x%x vs 0x%x)",
-						cmd.opcode, opcode);
-		goto failed;
-	}
-
-	if (cmd.opcode == HAL_OP_STATUS) {
-		struct ipc_status *s = rsp;
-
-		if (sizeof(*s) != cmd.len) {
-			error("Invalid status length");
-			goto failed;
+	while (!req.done) {
+		if (cmd_reading) {
+			pthread_cond_wait(&req.cond, &cmd_queue_mutex);
+			continue;
 		}
 
-		if (s->code == HAL_STATUS_SUCCESS) {
-			error("Invalid success status response");
-			goto failed;
-		}
+		cmd_reading = true;
+		pthread_mutex_unlock(&cmd_queue_mutex);
 
-		return s->code;
-	}
+		receive_rsp(sk);
 
-	/* Receive auxiliary data in msg */
-	if (fd) {
-		struct cmsghdr *cmsg;
+		pthread_mutex_lock(&cmd_queue_mutex);
+		cmd_reading = false;
+	}
 
-		*fd = -1;
+	/* Hand reading over to the oldest command still waiting */
+	if (cmd_head && !cmd_reading)
+		pthread_cond_signal(&cmd_head->cond);
 
-		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
-					cmsg = CMSG_NXTHDR(&msg, cmsg)) {
-			if (cmsg->cmsg_level == SOL_SOCKET
-					&& cmsg->cmsg_type == SCM_RIGHTS) {
-				memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
-				break;
-			}
-		}
-	}
+	pthread_mutex_unlock(&cmd_queue_mutex);
 
-	*rsp_len = cmd.len;
+	pthread_cond_destroy(&req.cond);
 
-	return BT_STATUS_SUCCESS;
+	return req.status;
 
 failed:
 	exit(EXIT_FAILURE);
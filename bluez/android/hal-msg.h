@@ -2098,6 +2098,13 @@ struct hal_ev_gatt_server_mtu_changed {
 	int32_t mtu;
 } __attribute__((packed));
 
+/* data holds num struct hal_ev_gatt_client_notify records back to back */
+#define HAL_EV_GATT_CLIENT_NOTIFY_BATCH		0xb1
+struct hal_ev_gatt_client_notify_batch {
+	uint8_t num;
+	uint8_t data[0];
+} __attribute__((packed));
+
 #define HAL_GATT_PERMISSION_READ			0x0001
 #define HAL_GATT_PERMISSION_READ_ENCRYPTED		0x0002
 #define HAL_GATT_PERMISSION_READ_ENCRYPTED_MITM		0x0004
@@ -59,12 +59,29 @@ struct ipc {
 	GIOChannel *notif_io;
 	guint notif_watch;
 
+	/* Notifications queued by ipc_queue_notif() */
+	uint8_t batch_service_id;
+	uint8_t batch_opcode;
+	uint8_t batch_multi_opcode;
+	uint8_t batch_num;
+	uint16_t batch_len;
+	uint8_t batch_buf[IPC_MTU - sizeof(struct ipc_hdr)];
+	guint batch_id;
+
 	ipc_disconnect_cb disconnect_cb;
 	void *disconnect_cb_data;
 };
 
 static void ipc_disconnect(struct ipc *ipc, bool in_cleanup)
 {
+	if (ipc->batch_id) {
+		g_source_remove(ipc->batch_id);
+		ipc->batch_id = 0;
+	}
+
+	ipc->batch_num = 0;
+	ipc->batch_len = 0;
+
 	if (ipc->cmd_watch) {
 		g_source_remove(ipc->cmd_watch);
 		ipc->cmd_watch = 0;
@@ -401,6 +418,43 @@ void ipc_send_rsp_full(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
 								param, fd);
 }
 
+static void batch_flush(struct ipc *ipc)
+{
+	int sk;
+
+	if (ipc->batch_id) {
+		g_source_remove(ipc->batch_id);
+		ipc->batch_id = 0;
+	}
+
+	if (!ipc->batch_num)
+		return;
+
+	sk = g_io_channel_unix_get_fd(ipc->notif_io);
+
+	/* A single notification goes out as it would without batching */
+	if (ipc->batch_num == 1)
+		ipc_send(sk, ipc->batch_service_id, ipc->batch_opcode,
+				ipc->batch_len - 1, ipc->batch_buf + 1, -1);
+	else
+		ipc_send(sk, ipc->batch_service_id, ipc->batch_multi_opcode,
+					ipc->batch_len, ipc->batch_buf, -1);
+
+	ipc->batch_num = 0;
+	ipc->batch_len = 0;
+}
+
+static gboolean batch_flush_cb(gpointer user_data)
+{
+	struct ipc *ipc = user_data;
+
+	ipc->batch_id = 0;
+
+	batch_flush(ipc);
+
+	return FALSE;
+}
+
 void ipc_send_notif(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
 						uint16_t len, void *param)
 {
@@ -413,10 +467,52 @@ void ipc_send_notif_with_fd(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
 	if (!ipc || !ipc->notif_io)
 		return;
 
+	/* Keep notifications in the order they were sent or queued */
+	batch_flush(ipc);
+
 	ipc_send(g_io_channel_unix_get_fd(ipc->notif_io), service_id, opcode,
 								len, param, fd);
 }
 
+/*
+ * Notifications queued within one main loop iteration are sent together
+ * as a single multi_opcode notification: the number of notifications
+ * (1 octet) followed by their parameters back to back. The parameters
+ * must carry their own length so that the receiver can split them.
+ */
+void ipc_queue_notif(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
+				uint8_t multi_opcode, uint16_t len, void *param)
+{
+	if (!ipc || !ipc->notif_io)
+		return;
+
+	if (len >= sizeof(ipc->batch_buf)) {
+		ipc_send_notif(ipc, service_id, opcode, len, param);
+		return;
+	}
+
+	if (ipc->batch_num && (ipc->batch_service_id != service_id ||
+				ipc->batch_opcode != opcode ||
+				ipc->batch_num == UINT8_MAX ||
+				ipc->batch_len + len > sizeof(ipc->batch_buf)))
+		batch_flush(ipc);
+
+	if (!ipc->batch_num) {
+		ipc->batch_service_id = service_id;
+		ipc->batch_opcode = opcode;
+		ipc->batch_multi_opcode = multi_opcode;
+		ipc->batch_len = 1;
+	}
+
+	memcpy(ipc->batch_buf + ipc->batch_len, param, len);
+	ipc->batch_len += len;
+	ipc->batch_buf[0] = ++ipc->batch_num;
+
+	if (!ipc->batch_id)
+		ipc->batch_id = g_idle_add_full(G_PRIORITY_DEFAULT,
+						batch_flush_cb, ipc, NULL);
+}
+
 void ipc_register(struct ipc *ipc, uint8_t service,
 			const struct ipc_handler *handlers, uint8_t size)
 {
@@ -44,6 +44,8 @@ void ipc_send_notif(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
 						uint16_t len, void *param);
 void ipc_send_notif_with_fd(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
 					uint16_t len, void *param, int fd);
+void ipc_queue_notif(struct ipc *ipc, uint8_t service_id, uint8_t opcode,
+			uint8_t multi_opcode, uint16_t len, void *param);
 
 void ipc_register(struct ipc *ipc, uint8_t service,
 			const struct ipc_handler *handlers, uint8_t size);
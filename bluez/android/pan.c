@@ -855,7 +855,7 @@ bool bt_pan_register(struct ipc *ipc, const bdaddr_t *addr, uint8_t mode)
 		return false;
 	}
 
-	err = bnep_init();
+	err = bnep_init(false);
 	if (err < 0) {
 		error("Failed to init BNEP");
 		bt_adapter_remove_record(nap_rec->handle);
@@ -29,6 +29,8 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 
 #include "lib/bluetooth.h"
 #include "btio/btio.h"
@@ -63,13 +65,34 @@
 #define DEFAULT_MAS_MSG_TYPE	(MAP_MSG_TYPE_SMS_GSM | MAP_MSG_TYPE_SMS_CDMA)
 
 static struct ipc *hal_ipc = NULL;
+
+struct rfcomm_sock;
+
+/*
+ * One direction of the proxy. Data is moved with splice() through a pipe
+ * so it never gets copied into userspace; if the kernel can't splice
+ * from the source, a plain buffer is used instead. While data is pending
+ * the source isn't read and the destination is polled for writing.
+ */
+struct rfsock_stream {
+	struct rfcomm_sock *rfsock;
+	int src;
+	int dst;
+	guint src_watch;
+	guint dst_watch;
+	int pipe[2];
+	uint8_t *buf;
+	size_t buf_off;
+	size_t pending;
+	uint64_t bytes;
+};
+
 struct rfcomm_sock {
 	int channel;	/* RFCOMM channel */
 	BtIOSecLevel sec_level;
 
 	/* for socket to BT */
 	int bt_sock;
-	guint bt_watch;
 
 	/* for socket to HAL */
 	int jv_sock;
@@ -78,8 +101,11 @@ struct rfcomm_sock {
 	bdaddr_t dst;
 	uint32_t service_handle;
 
-	uint8_t *buf;
 	int buf_size;
+
+	struct rfsock_stream to_bt;	/* HAL to RFCOMM */
+	struct rfsock_stream to_hal;	/* RFCOMM to HAL */
+	gint64 start_time;
 };
 
 struct rfcomm_channel {
@@ -125,12 +151,28 @@ static int rfsock_set_buffer(struct rfcomm_sock *rfsock)
 
 	DBG("Set buffer size %d", size);
 
-	rfsock->buf = g_malloc(size);
 	rfsock->buf_size = size;
 
 	return 0;
 }
 
+static void stream_cleanup(struct rfsock_stream *stream)
+{
+	if (stream->src_watch > 0)
+		g_source_remove(stream->src_watch);
+
+	if (stream->dst_watch > 0)
+		g_source_remove(stream->dst_watch);
+
+	if (stream->pipe[0] >= 0)
+		close(stream->pipe[0]);
+
+	if (stream->pipe[1] >= 0)
+		close(stream->pipe[1]);
+
+	g_free(stream->buf);
+}
+
 static void cleanup_rfsock(gpointer data)
 {
 	struct rfcomm_sock *rfsock = data;
@@ -148,20 +190,23 @@ static void cleanup_rfsock(gpointer data)
 			error("close() fd %d: failed: %s", rfsock->bt_sock,
 							strerror(errno));
 
-	if (rfsock->bt_watch > 0)
-		if (!g_source_remove(rfsock->bt_watch))
-			error("bt_watch source was not found");
-
 	if (rfsock->jv_watch > 0)
 		if (!g_source_remove(rfsock->jv_watch))
 			error("stack_watch source was not found");
 
+	if (rfsock->start_time > 0)
+		DBG("rfsock %p %" PRIu64 " bytes sent %" PRIu64 " received "
+				"in %" G_GINT64_FORMAT " ms", rfsock,
+				rfsock->to_bt.bytes, rfsock->to_hal.bytes,
+				(g_get_monotonic_time() - rfsock->start_time) /
+									1000);
+
+	stream_cleanup(&rfsock->to_bt);
+	stream_cleanup(&rfsock->to_hal);
+
 	if (rfsock->service_handle)
 		bt_adapter_remove_record(rfsock->service_handle);
 
-	if (rfsock->buf)
-		g_free(rfsock->buf);
-
 	g_free(rfsock);
 }
 
@@ -176,10 +221,25 @@ static struct rfcomm_sock *create_rfsock(int bt_sock, int *hal_sock)
 		return NULL;
 	}
 
+	/*
+	 * Our end must not block so a slow HAL reader throttles the stream
+	 * through G_IO_OUT instead of stalling the main loop. The HAL end is
+	 * handed to applications and stays blocking.
+	 */
+	if (fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK) < 0) {
+		error("fcntl(): %s", strerror(errno));
+		close(fds[0]);
+		close(fds[1]);
+		*hal_sock = -1;
+		return NULL;
+	}
+
 	rfsock = g_new0(struct rfcomm_sock, 1);
 	rfsock->jv_sock = fds[0];
 	*hal_sock = fds[1];
 	rfsock->bt_sock = bt_sock;
+	rfsock->to_bt.pipe[0] = rfsock->to_bt.pipe[1] = -1;
+	rfsock->to_hal.pipe[0] = rfsock->to_hal.pipe[1] = -1;
 
 	DBG("rfsock %p", rfsock);
 
@@ -540,34 +600,109 @@ static const struct profile_info *get_profile_by_uuid(const uint8_t *uuid)
 	return NULL;
 }
 
-static int try_write_all(int fd, unsigned char *buf, int len)
+static void rfsock_close(struct rfcomm_sock *rfsock)
+{
+	DBG("rfsock %p bt_sock %d jv_sock %d", rfsock, rfsock->bt_sock,
+							rfsock->jv_sock);
+
+	connections = g_list_remove(connections, rfsock);
+	cleanup_rfsock(rfsock);
+}
+
+static void stream_use_buffer(struct rfsock_stream *stream)
+{
+	DBG("rfsock %p fd %d can't splice, using a buffer", stream->rfsock,
+								stream->src);
+
+	close(stream->pipe[0]);
+	close(stream->pipe[1]);
+	stream->pipe[0] = stream->pipe[1] = -1;
+
+	stream->buf = g_malloc(stream->rfsock->buf_size);
+}
+
+/* Only called once everything read before went out */
+static ssize_t stream_fill(struct rfsock_stream *stream)
 {
-	int sent = 0;
+	ssize_t len;
+
+	if (stream->pipe[1] >= 0) {
+		len = splice(stream->src, NULL, stream->pipe[1], NULL,
+					stream->rfsock->buf_size,
+					SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (len >= 0 || (errno != EINVAL && errno != ENOSYS))
+			goto done;
+
+		stream_use_buffer(stream);
+	}
 
-	while (len > 0) {
-		int written;
+	len = read(stream->src, stream->buf, stream->rfsock->buf_size);
+	stream->buf_off = 0;
 
-		written = write(fd, buf, len);
-		if (written < 0) {
-			if (errno == EINTR || errno == EAGAIN)
+done:
+	if (len > 0)
+		stream->pending = len;
+
+	return len;
+}
+
+/* Returns 0 once all pending data is written, -EAGAIN if it would block */
+static int stream_flush(struct rfsock_stream *stream)
+{
+	while (stream->pending > 0) {
+		ssize_t len;
+
+		if (stream->pipe[0] >= 0)
+			len = splice(stream->pipe[0], NULL, stream->dst, NULL,
+					stream->pending,
+					SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		else
+			len = write(stream->dst, stream->buf + stream->buf_off,
+							stream->pending);
+
+		if (len < 0) {
+			if (errno == EINTR)
 				continue;
-			return -1;
+
+			return -errno;
 		}
 
-		if (!written)
-			return 0;
+		if (!len)
+			return -EPIPE;
 
-		len -= written; buf += written; sent += written;
+		stream->pending -= len;
+		stream->buf_off += len;
+		stream->bytes += len;
 	}
 
-	return sent;
+	return 0;
 }
 
-static gboolean jv_sock_client_event_cb(GIOChannel *io, GIOCondition cond,
+static gboolean stream_src_cb(GIOChannel *io, GIOCondition cond,
+							gpointer data);
+static gboolean stream_dst_cb(GIOChannel *io, GIOCondition cond,
+							gpointer data);
+
+static guint stream_add_watch(int fd, GIOCondition cond, GIOFunc func,
+					struct rfsock_stream *stream)
+{
+	GIOChannel *io;
+	guint id;
+
+	io = g_io_channel_unix_new(fd);
+	id = g_io_add_watch(io, cond | G_IO_HUP | G_IO_ERR | G_IO_NVAL, func,
+								stream);
+	g_io_channel_unref(io);
+
+	return id;
+}
+
+static gboolean stream_src_cb(GIOChannel *io, GIOCondition cond,
 								gpointer data)
 {
-	struct rfcomm_sock *rfsock = data;
-	int len, sent;
+	struct rfsock_stream *stream = data;
+	ssize_t len;
+	int err;
 
 	if (cond & G_IO_HUP) {
 		DBG("Socket %d hang up", g_io_channel_unix_get_fd(io));
@@ -579,68 +714,109 @@ static gboolean jv_sock_client_event_cb(GIOChannel *io, GIOCondition cond,
 		goto fail;
 	}
 
-	len = read(rfsock->jv_sock, rfsock->buf, rfsock->buf_size);
-	if (len <= 0) {
+	len = stream_fill(stream);
+	if (len < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return TRUE;
+
 		error("read(): %s", strerror(errno));
-		/* Read again */
-		return TRUE;
+		goto fail;
 	}
 
-	sent = try_write_all(rfsock->bt_sock, rfsock->buf, len);
-	if (sent < 0) {
-		error("write(): %s", strerror(errno));
+	if (!len) {
+		DBG("Socket %d closed", g_io_channel_unix_get_fd(io));
 		goto fail;
 	}
 
-	return TRUE;
-fail:
-	DBG("rfsock %p jv_sock %d cond %d", rfsock, rfsock->jv_sock, cond);
+	err = stream_flush(stream);
+	if (!err)
+		return TRUE;
 
-	connections = g_list_remove(connections, rfsock);
-	cleanup_rfsock(rfsock);
+	if (err != -EAGAIN) {
+		error("write(): %s", strerror(-err));
+		goto fail;
+	}
+
+	/* Stop reading until the other side took what is pending */
+	stream->src_watch = 0;
+	stream->dst_watch = stream_add_watch(stream->dst, G_IO_OUT,
+							stream_dst_cb, stream);
+
+	return FALSE;
+
+fail:
+	rfsock_close(stream->rfsock);
 
 	return FALSE;
 }
 
-static gboolean bt_sock_event_cb(GIOChannel *io, GIOCondition cond,
+static gboolean stream_dst_cb(GIOChannel *io, GIOCondition cond,
 								gpointer data)
 {
-	struct rfcomm_sock *rfsock = data;
-	int len, sent;
+	struct rfsock_stream *stream = data;
+	int err;
 
-	if (cond & G_IO_HUP) {
-		DBG("Socket %d hang up", g_io_channel_unix_get_fd(io));
-		goto fail;
-	}
-
-	if (cond & (G_IO_ERR | G_IO_NVAL)) {
+	if (cond & (G_IO_HUP | G_IO_ERR | G_IO_NVAL)) {
 		error("Socket %d error", g_io_channel_unix_get_fd(io));
 		goto fail;
 	}
 
-	len = read(rfsock->bt_sock, rfsock->buf, rfsock->buf_size);
-	if (len <= 0) {
-		error("read(): %s", strerror(errno));
-		/* Read again */
+	err = stream_flush(stream);
+	if (err == -EAGAIN)
 		return TRUE;
-	}
 
-	sent = try_write_all(rfsock->jv_sock, rfsock->buf, len);
-	if (sent < 0) {
-		error("write(): %s", strerror(errno));
+	if (err < 0) {
+		error("write(): %s", strerror(-err));
 		goto fail;
 	}
 
-	return TRUE;
-fail:
-	DBG("rfsock %p bt_sock %d cond %d", rfsock, rfsock->bt_sock, cond);
+	stream->dst_watch = 0;
+	stream->src_watch = stream_add_watch(stream->src, G_IO_IN,
+							stream_src_cb, stream);
 
-	connections = g_list_remove(connections, rfsock);
-	cleanup_rfsock(rfsock);
+	return FALSE;
+
+fail:
+	rfsock_close(stream->rfsock);
 
 	return FALSE;
 }
 
+static void stream_start(struct rfcomm_sock *rfsock,
+				struct rfsock_stream *stream, int src, int dst)
+{
+	stream->rfsock = rfsock;
+	stream->src = src;
+	stream->dst = dst;
+
+	if (pipe2(stream->pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+		error("pipe2(): %s", strerror(errno));
+		stream->pipe[0] = stream->pipe[1] = -1;
+		stream->buf = g_malloc(rfsock->buf_size);
+	}
+
+#ifdef F_SETPIPE_SZ
+	/* Let a whole socket buffer fit, the default may be smaller */
+	if (stream->pipe[1] >= 0)
+		fcntl(stream->pipe[1], F_SETPIPE_SZ, rfsock->buf_size);
+#endif
+
+	stream->src_watch = stream_add_watch(src, G_IO_IN, stream_src_cb,
+								stream);
+}
+
+static void rfsock_start_proxy(struct rfcomm_sock *rfsock)
+{
+	rfsock->start_time = g_get_monotonic_time();
+
+	/* Handle events from Android */
+	stream_start(rfsock, &rfsock->to_bt, rfsock->jv_sock, rfsock->bt_sock);
+
+	/* Handle rfcomm events */
+	stream_start(rfsock, &rfsock->to_hal, rfsock->bt_sock,
+							rfsock->jv_sock);
+}
+
 static bool sock_send_accept(struct rfcomm_sock *rfsock, bdaddr_t *bdaddr,
 							int fd_accepted)
 {
@@ -654,6 +830,10 @@ static bool sock_send_accept(struct rfcomm_sock *rfsock, bdaddr_t *bdaddr,
 	cmd.channel = rfsock->channel;
 	cmd.status = 0;
 
+	/*
+	 * jv_sock is non-blocking, if the HAL stopped reading accept signals
+	 * the connection is dropped rather than blocking the daemon.
+	 */
 	len = bt_sock_send_fd(rfsock->jv_sock, &cmd, sizeof(cmd), fd_accepted);
 	if (len != sizeof(cmd)) {
 		error("Error sending accept signal");
@@ -685,14 +865,11 @@ static void accept_cb(GIOChannel *io, GError *err, gpointer user_data)
 {
 	struct rfcomm_sock *rfsock = user_data;
 	struct rfcomm_sock *new_rfsock;
-	GIOChannel *jv_io;
 	GError *gerr = NULL;
 	bdaddr_t dst;
 	char address[18];
 	int new_sock;
 	int hal_sock;
-	guint id;
-	GIOCondition cond;
 
 	if (err) {
 		error("%s", err->message);
@@ -730,20 +907,9 @@ static void accept_cb(GIOChannel *io, GError *err, gpointer user_data)
 
 	connections = g_list_append(connections, new_rfsock);
 
-	/* Handle events from Android */
-	cond = G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL;
-	jv_io = g_io_channel_unix_new(new_rfsock->jv_sock);
-	id = g_io_add_watch(jv_io, cond, jv_sock_client_event_cb, new_rfsock);
-	g_io_channel_unref(jv_io);
-
-	new_rfsock->jv_watch = id;
-
-	/* Handle rfcomm events */
-	cond = G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL;
-	id = g_io_add_watch(io, cond, bt_sock_event_cb, new_rfsock);
 	g_io_channel_set_close_on_unref(io, FALSE);
 
-	new_rfsock->bt_watch = id;
+	rfsock_start_proxy(new_rfsock);
 }
 
 static int find_free_channel(void)
@@ -1056,10 +1222,7 @@ static void connect_cb(GIOChannel *io, GError *err, gpointer user_data)
 {
 	struct rfcomm_sock *rfsock = user_data;
 	bdaddr_t *dst = &rfsock->dst;
-	GIOChannel *jv_io;
 	char address[18];
-	guint id;
-	GIOCondition cond;
 
 	if (err) {
 		error("%s", err->message);
@@ -1073,20 +1236,9 @@ static void connect_cb(GIOChannel *io, GError *err, gpointer user_data)
 	if (!sock_send_connect(rfsock, dst))
 		goto fail;
 
-	/* Handle events from Android */
-	cond = G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL;
-	jv_io = g_io_channel_unix_new(rfsock->jv_sock);
-	id = g_io_add_watch(jv_io, cond, jv_sock_client_event_cb, rfsock);
-	g_io_channel_unref(jv_io);
-
-	rfsock->jv_watch = id;
-
-	/* Handle rfcomm events */
-	cond = G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL;
-	id = g_io_add_watch(io, cond, bt_sock_event_cb, rfsock);
 	g_io_channel_set_close_on_unref(io, FALSE);
 
-	rfsock->bt_watch = id;
+	rfsock_start_proxy(rfsock);
 
 	return;
 fail:
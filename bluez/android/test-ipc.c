@@ -53,6 +53,8 @@ struct test_data {
 	uint8_t service;
 	const struct ipc_handler *handlers;
 	uint8_t handlers_size;
+	const struct iovec *notifs;
+	int notifs_count;
 };
 
 struct context {
@@ -67,6 +69,8 @@ struct context {
 	GIOChannel *cmd_io;
 	GIOChannel *notif_io;
 
+	int notifs_received;
+
 	const struct test_data *data;
 };
 
@@ -115,6 +119,9 @@ static gboolean notif_watch(GIOChannel *io, GIOCondition cond,
 {
 	struct context *context = user_data;
 	const struct test_data *test_data = context->data;
+	const struct iovec *notif;
+	uint8_t buf[IPC_MTU];
+	ssize_t len;
 
 	if (cond & (G_IO_HUP | G_IO_ERR | G_IO_NVAL)) {
 		g_assert(test_data->disconnect);
@@ -123,9 +130,36 @@ static gboolean notif_watch(GIOChannel *io, GIOCondition cond,
 
 	g_assert(!test_data->disconnect);
 
+	g_assert(context->notifs_received < test_data->notifs_count);
+	notif = &test_data->notifs[context->notifs_received++];
+
+	len = read(g_io_channel_unix_get_fd(io), buf, sizeof(buf));
+	g_assert(len == (ssize_t) notif->iov_len);
+	g_assert(!memcmp(buf, notif->iov_base, len));
+
+	if (context->notifs_received == test_data->notifs_count)
+		context_quit(context);
+
 	return TRUE;
 }
 
+static gboolean send_notifs(gpointer user_data)
+{
+	uint8_t notif_1[] = { 0x01, 0x02 };
+	uint8_t notif_2[] = { 0x03 };
+	uint8_t notif_3[] = { 0x04, 0x05, 0x06 };
+
+	/* Queued notifications must not be overtaken by a regular one */
+	ipc_queue_notif(ipc, 1, 0x81, 0x82, sizeof(notif_1), notif_1);
+	ipc_queue_notif(ipc, 1, 0x81, 0x82, sizeof(notif_2), notif_2);
+	ipc_send_notif(ipc, 1, 0x83, sizeof(notif_3), notif_3);
+
+	/* A notification queued alone is sent as is */
+	ipc_queue_notif(ipc, 1, 0x81, 0x82, sizeof(notif_3), notif_3);
+
+	return FALSE;
+}
+
 static gboolean connect_handler(GIOChannel *io, GIOCondition cond,
 						gpointer user_data)
 {
@@ -162,7 +196,10 @@ static gboolean connect_handler(GIOChannel *io, GIOCondition cond,
 		context->cmd_io = new_io;
 	}
 
-	if (context->cmd_source && context->notif_source && !test_data->cmd)
+	if (context->cmd_source && context->notif_source && test_data->notifs)
+		g_idle_add(send_notifs, context);
+	else if (context->cmd_source && context->notif_source &&
+							!test_data->cmd)
 		context_quit(context);
 
 	return TRUE;
@@ -538,6 +575,24 @@ static const struct test_data test_cmd_msg_invalid_2 = {
 	.disconnect = true,
 };
 
+static const uint8_t notif_batch[] = { 0x01, 0x82, 0x04, 0x00,
+						0x02, 0x01, 0x02, 0x03 };
+static const uint8_t notif_plain[] = { 0x01, 0x83, 0x03, 0x00,
+						0x04, 0x05, 0x06 };
+static const uint8_t notif_single[] = { 0x01, 0x81, 0x03, 0x00,
+						0x04, 0x05, 0x06 };
+
+static const struct iovec notifs_batch[] = {
+	{ (void *) notif_batch, sizeof(notif_batch) },
+	{ (void *) notif_plain, sizeof(notif_plain) },
+	{ (void *) notif_single, sizeof(notif_single) },
+};
+
+static const struct test_data test_notif_batch = {
+	.notifs = notifs_batch,
+	.notifs_count = G_N_ELEMENTS(notifs_batch),
+};
+
 int main(int argc, char *argv[])
 {
 	g_test_init(&argc, &argv, NULL);
@@ -572,6 +627,8 @@ int main(int argc, char *argv[])
 				&test_cmd_msg_invalid_1, test_cmd_reg);
 	g_test_add_data_func("/android_ipc/msg_invalid_2",
 				&test_cmd_msg_invalid_2, test_cmd_reg);
+	g_test_add_data_func("/android_ipc/notif_batch",
+				&test_notif_batch, test_init);
 
 	return g_test_run();
 }
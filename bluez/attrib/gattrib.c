@@ -52,8 +52,16 @@ struct _GAttrib {
 	uint8_t *buf;
 	int buflen;
 	struct queue *track_ids;
+
+	/* Callbacks for a single handle, by opcode and handle */
+	GHashTable *notify_index;
+	unsigned int notify_id;
+	unsigned int ind_id;
+	guint next_reg_id;
 };
 
+#define INDEX_KEY(opcode, handle) GUINT_TO_POINTER((opcode) << 16 | (handle))
+
 struct id_pair {
 	unsigned int org_id;
 	unsigned int pend_id;
@@ -66,7 +74,10 @@ struct attrib_callbacks {
 	GDestroyNotify destroy_func;
 	gpointer user_data;
 	GAttrib *parent;
+	uint8_t notify_opcode;
 	uint16_t notify_handle;
+	guint reg_id;
+	unsigned int att_id;
 };
 
 static bool find_with_org_id(const void *data, const void *user_data)
@@ -95,6 +106,11 @@ static struct id_pair *store_id(GAttrib *attrib, unsigned int org_id,
 	return NULL;
 }
 
+static void index_queue_free(void *data)
+{
+	queue_destroy(data, NULL);
+}
+
 GAttrib *g_attrib_new(GIOChannel *io, guint16 mtu, bool ext_signed)
 {
 	gint fd;
@@ -134,6 +150,10 @@ GAttrib *g_attrib_new(GIOChannel *io, guint16 mtu, bool ext_signed)
 	if (!attr->track_ids)
 		goto fail;
 
+	attr->notify_index = g_hash_table_new_full(g_direct_hash,
+							g_direct_equal, NULL,
+							index_queue_free);
+
 	return g_attrib_ref(attr);
 
 fail:
@@ -192,10 +212,15 @@ void g_attrib_unref(GAttrib *attrib)
 	if (attrib->destroy)
 		attrib->destroy(attrib->destroy_user_data);
 
+	/* Others might still hold a reference to the bt_att */
+	bt_att_unregister(attrib->att, attrib->notify_id);
+	bt_att_unregister(attrib->att, attrib->ind_id);
+
 	bt_att_unref(attrib->att);
 
 	queue_destroy(attrib->callbacks, attrib_callbacks_destroy);
 	queue_destroy(attrib->track_ids, free);
+	g_hash_table_destroy(attrib->notify_index);
 
 	free(attrib->buf);
 
@@ -233,33 +258,34 @@ gboolean g_attrib_set_destroy_function(GAttrib *attrib, GDestroyNotify destroy,
 }
 
 
-static uint8_t *construct_full_pdu(uint8_t opcode, const void *pdu,
-								uint16_t length)
+/*
+ * bt_att passes received PDUs in place, right behind their opcode, so the
+ * full PDU GAttrib users expect is available without a copy. Only PDUs
+ * without parameters, or made up by bt_att, need the opcode put somewhere.
+ */
+static const uint8_t *full_pdu(uint8_t opcode, const void *pdu,
+					uint16_t length, uint8_t *opcode_buf)
 {
-	uint8_t *buf = malloc0(length + 1);
+	if (pdu && length)
+		return (const uint8_t *) pdu - 1;
 
-	if (!buf)
-		return NULL;
-
-	buf[0] = opcode;
-	memcpy(buf + 1, pdu, length);
+	*opcode_buf = opcode;
 
-	return buf;
+	return opcode_buf;
 }
 
 static void attrib_callback_result(uint8_t opcode, const void *pdu,
 					uint16_t length, void *user_data)
 {
-	uint8_t *buf;
+	const uint8_t *buf;
+	uint8_t opcode_buf;
 	struct attrib_callbacks *cb = user_data;
 	guint8 status = 0;
 
 	if (!cb)
 		return;
 
-	buf = construct_full_pdu(opcode, pdu, length);
-	if (!buf)
-		return;
+	buf = full_pdu(opcode, pdu, length, &opcode_buf);
 
 	if (opcode == BT_ATT_OP_ERROR_RSP) {
 		/* Error code is the third byte of the PDU data */
@@ -271,14 +297,13 @@ static void attrib_callback_result(uint8_t opcode, const void *pdu,
 
 	if (cb->result_func)
 		cb->result_func(status, buf, length + 1, cb->user_data);
-
-	free(buf);
 }
 
 static void attrib_callback_notify(uint8_t opcode, const void *pdu,
 					uint16_t length, void *user_data)
 {
-	uint8_t *buf;
+	const uint8_t *buf;
+	uint8_t opcode_buf;
 	struct attrib_callbacks *cb = user_data;
 
 	if (!cb || !cb->notify_func)
@@ -291,13 +316,119 @@ static void attrib_callback_notify(uint8_t opcode, const void *pdu,
 					cb->notify_handle != get_le16(pdu))
 		return;
 
-	buf = construct_full_pdu(opcode, pdu, length);
-	if (!buf)
-		return;
+	buf = full_pdu(opcode, pdu, length, &opcode_buf);
 
 	cb->notify_func(buf, length + 1, cb->user_data);
+}
+
+struct index_notify {
+	const uint8_t *pdu;
+	uint16_t length;
+};
+
+static void index_notify(void *data, void *user_data)
+{
+	struct attrib_callbacks *cb = data;
+	struct index_notify *notify = user_data;
+
+	if (cb->notify_func)
+		cb->notify_func(notify->pdu, notify->length, cb->user_data);
+}
+
+/*
+ * Notifications and indications for a single handle are looked up by their
+ * handle instead of offering every PDU to every registered callback.
+ */
+static void attrib_index_notify(uint8_t opcode, const void *pdu,
+					uint16_t length, void *user_data)
+{
+	GAttrib *attrib = user_data;
+	struct index_notify notify;
+	struct queue *callbacks;
+
+	if (length < 2)
+		return;
+
+	callbacks = g_hash_table_lookup(attrib->notify_index,
+					INDEX_KEY(opcode, get_le16(pdu)));
+	if (!callbacks)
+		return;
+
+	notify.pdu = (const uint8_t *) pdu - 1;
+	notify.length = length + 1;
+
+	queue_foreach(callbacks, index_notify, &notify);
+}
+
+static bool is_indexed(uint8_t opcode, uint16_t handle)
+{
+	if (handle == GATTRIB_ALL_HANDLES)
+		return false;
+
+	return opcode == BT_ATT_OP_HANDLE_VAL_NOT ||
+					opcode == BT_ATT_OP_HANDLE_VAL_IND;
+}
+
+static bool index_add(GAttrib *attrib, struct attrib_callbacks *cb)
+{
+	unsigned int *id;
+	struct queue *callbacks;
+	gpointer key;
+
+	if (cb->notify_opcode == BT_ATT_OP_HANDLE_VAL_NOT)
+		id = &attrib->notify_id;
+	else
+		id = &attrib->ind_id;
+
+	if (!*id) {
+		*id = bt_att_register(attrib->att, cb->notify_opcode,
+						attrib_index_notify, attrib,
+						NULL);
+		if (!*id)
+			return false;
+	}
+
+	key = INDEX_KEY(cb->notify_opcode, cb->notify_handle);
+
+	callbacks = g_hash_table_lookup(attrib->notify_index, key);
+	if (!callbacks) {
+		callbacks = queue_new();
+		g_hash_table_insert(attrib->notify_index, key, callbacks);
+	}
+
+	return queue_push_tail(callbacks, cb);
+}
+
+static void index_remove(GAttrib *attrib, struct attrib_callbacks *cb)
+{
+	struct queue *callbacks;
+	gpointer key;
+
+	key = INDEX_KEY(cb->notify_opcode, cb->notify_handle);
+
+	callbacks = g_hash_table_lookup(attrib->notify_index, key);
+	if (!callbacks)
+		return;
+
+	queue_remove(callbacks, cb);
+
+	if (queue_isempty(callbacks))
+		g_hash_table_remove(attrib->notify_index, key);
+}
+
+static gboolean index_remove_all(gpointer key, gpointer value,
+							gpointer user_data)
+{
+	queue_remove_all(value, NULL, NULL, attrib_callbacks_remove);
+
+	return TRUE;
+}
+
+static bool match_reg_id(const void *data, const void *user_data)
+{
+	const struct attrib_callbacks *cb = data;
 
-	free(buf);
+	return cb->reg_id == PTR_TO_UINT(user_data);
 }
 
 guint g_attrib_send(GAttrib *attrib, guint id, const guint8 *pdu, guint16 len,
@@ -403,28 +534,47 @@ guint g_attrib_register(GAttrib *attrib, guint8 opcode, guint16 handle,
 				GAttribNotifyFunc func, gpointer user_data,
 				GDestroyNotify notify)
 {
-	struct attrib_callbacks *cb = NULL;
+	struct attrib_callbacks *cb;
 
 	if (!attrib)
 		return 0;
 
-	if (func || notify) {
-		cb = new0(struct attrib_callbacks, 1);
-		if (!cb)
+	cb = new0(struct attrib_callbacks, 1);
+	if (!cb)
+		return 0;
+
+	cb->notify_func = func;
+	cb->notify_opcode = opcode;
+	cb->notify_handle = handle;
+	cb->user_data = user_data;
+	cb->destroy_func = notify;
+	cb->parent = attrib;
+
+	if (is_indexed(opcode, handle)) {
+		if (!index_add(attrib, cb)) {
+			free(cb);
 			return 0;
-		cb->notify_func = func;
-		cb->notify_handle = handle;
-		cb->user_data = user_data;
-		cb->destroy_func = notify;
-		cb->parent = attrib;
-		queue_push_head(attrib->callbacks, cb);
+		}
+	} else {
+		if (opcode == GATTRIB_ALL_REQS)
+			opcode = BT_ATT_ALL_REQUESTS;
+
+		cb->att_id = bt_att_register(attrib->att, opcode,
+						attrib_callback_notify, cb,
+						attrib_callbacks_remove);
+		if (!cb->att_id) {
+			free(cb);
+			return 0;
+		}
 	}
 
-	if (opcode == GATTRIB_ALL_REQS)
-		opcode = BT_ATT_ALL_REQUESTS;
+	if (++attrib->next_reg_id == 0)
+		attrib->next_reg_id = 1;
+
+	cb->reg_id = attrib->next_reg_id;
+	queue_push_head(attrib->callbacks, cb);
 
-	return bt_att_register(attrib->att, opcode, attrib_callback_notify,
-						cb, attrib_callbacks_remove);
+	return cb->reg_id;
 }
 
 uint8_t *g_attrib_get_buffer(GAttrib *attrib, size_t *len)
@@ -473,10 +623,22 @@ gboolean g_attrib_set_mtu(GAttrib *attrib, int mtu)
 
 gboolean g_attrib_unregister(GAttrib *attrib, guint id)
 {
-	if (!attrib)
+	struct attrib_callbacks *cb;
+
+	if (!attrib || !id)
 		return FALSE;
 
-	return bt_att_unregister(attrib->att, id);
+	cb = queue_find(attrib->callbacks, match_reg_id, UINT_TO_PTR(id));
+	if (!cb)
+		return FALSE;
+
+	if (cb->att_id)
+		return bt_att_unregister(attrib->att, cb->att_id);
+
+	index_remove(attrib, cb);
+	attrib_callbacks_remove(cb);
+
+	return TRUE;
 }
 
 gboolean g_attrib_unregister_all(GAttrib *attrib)
@@ -484,5 +646,10 @@ gboolean g_attrib_unregister_all(GAttrib *attrib)
 	if (!attrib)
 		return false;
 
+	g_hash_table_foreach_remove(attrib->notify_index, index_remove_all,
+									NULL);
+	attrib->notify_id = 0;
+	attrib->ind_id = 0;
+
 	return bt_att_unregister_all(attrib->att);
 }
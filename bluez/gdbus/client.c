@@ -26,6 +26,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <glib.h>
 #include <dbus/dbus.h>
 
@@ -63,6 +64,7 @@ struct GDBusClient {
 	GDBusPropertyFunction property_changed;
 	void *user_data;
 	GList *proxy_list;
+	GHashTable *proxy_index;
 };
 
 struct GDBusProxy {
@@ -81,6 +83,7 @@ struct GDBusProxy {
 struct prop_entry {
 	char *name;
 	int type;
+	DBusBasicValue value;
 	DBusMessage *msg;
 };
 
@@ -166,23 +169,59 @@ static void iter_append_iter(DBusMessageIter *base, DBusMessageIter *iter)
 	}
 }
 
-static void prop_entry_update(struct prop_entry *prop, DBusMessageIter *iter)
+static gboolean prop_type_is_fixed(int type)
+{
+	return dbus_type_is_fixed(type) && type != DBUS_TYPE_UNIX_FD;
+}
+
+/*
+ * Values of fixed size basic types, like RSSI, are kept in the entry itself
+ * so that frequent updates don't allocate anything. The message holding
+ * them is only built once somebody asks for the value.
+ */
+static DBusMessage *prop_entry_get_msg(struct prop_entry *prop)
 {
-	DBusMessage *msg;
 	DBusMessageIter base;
 
-	msg = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
-	if (msg == NULL)
-		return;
+	if (prop->msg != NULL || !prop_type_is_fixed(prop->type))
+		return prop->msg;
 
-	dbus_message_iter_init_append(msg, &base);
-	iter_append_iter(&base, iter);
+	prop->msg = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+	if (prop->msg == NULL)
+		return NULL;
 
-	if (prop->msg != NULL)
+	dbus_message_iter_init_append(prop->msg, &base);
+	dbus_message_iter_append_basic(&base, prop->type, &prop->value);
+
+	return prop->msg;
+}
+
+static void prop_entry_update(struct prop_entry *prop, DBusMessageIter *iter)
+{
+	DBusMessageIter base;
+	int type;
+
+	type = dbus_message_iter_get_arg_type(iter);
+
+	if (prop->msg != NULL) {
 		dbus_message_unref(prop->msg);
+		prop->msg = NULL;
+	}
 
-	prop->msg = dbus_message_copy(msg);
-	dbus_message_unref(msg);
+	prop->type = type;
+
+	if (prop_type_is_fixed(type)) {
+		memset(&prop->value, 0, sizeof(prop->value));
+		dbus_message_iter_get_basic(iter, &prop->value);
+		return;
+	}
+
+	prop->msg = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+	if (prop->msg == NULL)
+		return;
+
+	dbus_message_iter_init_append(prop->msg, &base);
+	iter_append_iter(&base, iter);
 }
 
 static struct prop_entry *prop_entry_new(const char *name,
@@ -195,7 +234,6 @@ static struct prop_entry *prop_entry_new(const char *name,
 		return NULL;
 
 	prop->name = g_strdup(name);
-	prop->type = dbus_message_iter_get_arg_type(iter);
 
 	prop_entry_update(prop, iter);
 
@@ -278,6 +316,66 @@ static void update_properties(GDBusProxy *proxy, DBusMessageIter *iter,
 	}
 }
 
+static guint proxy_hash(gconstpointer key)
+{
+	const GDBusProxy *proxy = key;
+
+	return g_str_hash(proxy->obj_path) * 31 + g_str_hash(proxy->interface);
+}
+
+static gboolean proxy_equal(gconstpointer a, gconstpointer b)
+{
+	const GDBusProxy *proxy_a = a;
+	const GDBusProxy *proxy_b = b;
+
+	return g_str_equal(proxy_a->interface, proxy_b->interface) &&
+			g_str_equal(proxy_a->obj_path, proxy_b->obj_path);
+}
+
+static GDBusProxy *proxy_lookup(GDBusClient *client, const char *path,
+						const char *interface)
+{
+	GDBusProxy key;
+
+	key.obj_path = (char *) path;
+	key.interface = (char *) interface;
+
+	return g_hash_table_lookup(client->proxy_index, &key);
+}
+
+/*
+ * The index only points to the first proxy of the list for a given path
+ * and interface, just like a linear search of the list would find it.
+ */
+static void proxy_list_add(GDBusClient *client, GDBusProxy *proxy)
+{
+	client->proxy_list = g_list_append(client->proxy_list, proxy);
+
+	if (g_hash_table_lookup(client->proxy_index, proxy) == NULL)
+		g_hash_table_insert(client->proxy_index, proxy, proxy);
+}
+
+static void proxy_list_remove(GDBusClient *client, GDBusProxy *proxy)
+{
+	GList *list;
+
+	client->proxy_list = g_list_remove(client->proxy_list, proxy);
+
+	if (g_hash_table_lookup(client->proxy_index, proxy) != proxy)
+		return;
+
+	g_hash_table_remove(client->proxy_index, proxy);
+
+	for (list = g_list_first(client->proxy_list); list;
+						list = g_list_next(list)) {
+		if (proxy_equal(list->data, proxy)) {
+			g_hash_table_insert(client->proxy_index, list->data,
+								list->data);
+			break;
+		}
+	}
+}
+
 static void get_all_properties_reply(DBusPendingCall *call, void *user_data)
 {
 	GDBusProxy *proxy = user_data;
@@ -298,11 +396,12 @@ static void get_all_properties_reply(DBusPendingCall *call, void *user_data)
 	update_properties(proxy, &iter, FALSE);
 
 done:
-	if (g_list_find(client->proxy_list, proxy) == NULL) {
+	if (proxy_lookup(client, proxy->obj_path, proxy->interface) != proxy &&
+			g_list_find(client->proxy_list, proxy) == NULL) {
 		if (client->proxy_added)
 			client->proxy_added(proxy, client->user_data);
 
-		client->proxy_list = g_list_append(client->proxy_list, proxy);
+		proxy_list_add(client, proxy);
 	}
 
 	dbus_message_unref(reply);
@@ -340,23 +439,6 @@ static void get_all_properties(GDBusProxy *proxy)
 	dbus_message_unref(msg);
 }
 
-static GDBusProxy *proxy_lookup(GDBusClient *client, const char *path,
-						const char *interface)
-{
-	GList *list;
-
-	for (list = g_list_first(client->proxy_list); list;
-						list = g_list_next(list)) {
-		GDBusProxy *proxy = list->data;
-
-		if (g_str_equal(proxy->interface, interface) == TRUE &&
-				g_str_equal(proxy->obj_path, path) == TRUE)
-			return proxy;
-        }
-
-	return NULL;
-}
-
 static gboolean properties_changed(DBusConnection *conn, DBusMessage *msg,
 							void *user_data)
 {
@@ -451,23 +533,25 @@ static void proxy_free(gpointer data)
 	g_dbus_proxy_unref(proxy);
 }
 
+static void proxy_list_free(GDBusClient *client)
+{
+	g_hash_table_remove_all(client->proxy_index);
+
+	g_list_free_full(client->proxy_list, proxy_free);
+	client->proxy_list = NULL;
+}
+
 static void proxy_remove(GDBusClient *client, const char *path,
 						const char *interface)
 {
-	GList *list;
+	GDBusProxy *proxy;
 
-	for (list = g_list_first(client->proxy_list); list;
-						list = g_list_next(list)) {
-		GDBusProxy *proxy = list->data;
+	proxy = proxy_lookup(client, path, interface);
+	if (proxy == NULL)
+		return;
 
-		if (g_str_equal(proxy->interface, interface) == TRUE &&
-				g_str_equal(proxy->obj_path, path) == TRUE) {
-			client->proxy_list =
-				g_list_delete_link(client->proxy_list, list);
-			proxy_free(proxy);
-			break;
-		}
-	}
+	proxy_list_remove(client, proxy);
+	proxy_free(proxy);
 }
 
 GDBusProxy *g_dbus_proxy_new(GDBusClient *client, const char *path,
@@ -545,7 +629,7 @@ gboolean g_dbus_proxy_get_property(GDBusProxy *proxy, const char *name,
 	if (prop == NULL)
 		return FALSE;
 
-	if (prop->msg == NULL)
+	if (prop_entry_get_msg(prop) == NULL)
 		return FALSE;
 
 	if (dbus_message_iter_init(prop->msg, iter) == FALSE)
@@ -952,7 +1036,7 @@ static void parse_properties(GDBusClient *client, const char *path,
 	if (client->proxy_added)
 		client->proxy_added(proxy, client->user_data);
 
-	client->proxy_list = g_list_append(client->proxy_list, proxy);
+	proxy_list_add(client, proxy);
 }
 
 static void parse_interfaces(GDBusClient *client, const char *path,
@@ -1164,8 +1248,7 @@ static void service_disconnect(DBusConnection *conn, void *user_data)
 
 	client->connected = FALSE;
 
-	g_list_free_full(client->proxy_list, proxy_free);
-	client->proxy_list = NULL;
+	proxy_list_free(client);
 
 	if (client->disconn_func)
 		client->disconn_func(conn, client->disconn_data);
@@ -1231,6 +1314,7 @@ GDBusClient *g_dbus_client_new_full(DBusConnection *connection,
 	client->base_path = g_strdup(path);
 	client->root_path = g_strdup(root_path);
 	client->connected = FALSE;
+	client->proxy_index = g_hash_table_new(proxy_hash, proxy_equal);
 
 	client->match_rules = g_ptr_array_sized_new(1);
 	g_ptr_array_set_free_func(client->match_rules, g_free);
@@ -1307,7 +1391,8 @@ void g_dbus_client_unref(GDBusClient *client)
 	dbus_connection_remove_filter(client->dbus_conn,
 						message_filter, client);
 
-	g_list_free_full(client->proxy_list, proxy_free);
+	proxy_list_free(client);
+	g_hash_table_destroy(client->proxy_index);
 
 	/*
 	 * Don't call disconn_func twice if disconnection
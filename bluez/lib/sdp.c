@@ -2658,22 +2658,53 @@ uuid_t *sdp_uuid128_create(uuid_t *u, const void *val)
 	return u;
 }
 
+static void uuid_to_uuid128(uuid_t *uuid128, const uuid_t *uuid)
+{
+	switch (uuid->type) {
+	case SDP_UUID128:
+		*uuid128 = *uuid;
+		break;
+	case SDP_UUID32:
+		sdp_uuid32_to_uuid128(uuid128, uuid);
+		break;
+	case SDP_UUID16:
+		sdp_uuid16_to_uuid128(uuid128, uuid);
+		break;
+	default:
+		memset(uuid128, 0, sizeof(uuid_t));
+		break;
+	}
+}
+
 /*
  * UUID comparison function
- * returns 0 if uuidValue1 == uuidValue2 else -1
+ * returns 0 if uuidValue1 == uuidValue2, a negative value if it sorts
+ * before uuidValue2 and a positive value otherwise
  */
 int sdp_uuid_cmp(const void *p1, const void *p2)
 {
-	uuid_t *u1 = sdp_uuid_to_uuid128(p1);
-	uuid_t *u2 = sdp_uuid_to_uuid128(p2);
-	int ret;
+	const uuid_t *u1 = p1;
+	const uuid_t *u2 = p2;
+	uuid_t u1_128, u2_128;
 
-	ret = sdp_uuid128_cmp(u1, u2);
+	/* Same sized short UUIDs need no conversion to be compared */
+	if (u1->type == u2->type) {
+		switch (u1->type) {
+		case SDP_UUID16:
+			return (u1->value.uuid16 > u2->value.uuid16) -
+					(u1->value.uuid16 < u2->value.uuid16);
+		case SDP_UUID32:
+			return (u1->value.uuid32 > u2->value.uuid32) -
+					(u1->value.uuid32 < u2->value.uuid32);
+		case SDP_UUID128:
+			return sdp_uuid128_cmp(u1, u2);
+		}
+	}
 
-	bt_free(u1);
-	bt_free(u2);
+	uuid_to_uuid128(&u1_128, u1);
+	uuid_to_uuid128(&u2_128, u2);
 
-	return ret;
+	return sdp_uuid128_cmp(&u1_128, &u2_128);
 }
 
 /*
@@ -2755,17 +2786,8 @@ uuid_t *sdp_uuid_to_uuid128(const uuid_t *uuid)
 		return NULL;
 
 	memset(uuid128, 0, sizeof(uuid_t));
-	switch (uuid->type) {
-	case SDP_UUID128:
-		*uuid128 = *uuid;
-		break;
-	case SDP_UUID32:
-		sdp_uuid32_to_uuid128(uuid128, uuid);
-		break;
-	case SDP_UUID16:
-		sdp_uuid16_to_uuid128(uuid128, uuid);
-		break;
-	}
+	uuid_to_uuid128(uuid128, uuid);
+
 	return uuid128;
 }
 
@@ -28,6 +28,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <errno.h>
 
 #include "lib/bluetooth.h"
@@ -87,13 +88,31 @@ void bt_uuid_to_uuid128(const bt_uuid_t *src, bt_uuid_t *dst)
 		break;
 	case BT_UUID_UNSPEC:
 	default:
+		memset(dst, 0, sizeof(*dst));
 		break;
 	}
 }
 
+/*
+ * 128-bit UUIDs are stored big-endian, so comparing the two 64-bit halves
+ * as integers gives the same ordering as memcmp() without a byte loop.
+ */
+static inline int uint64_cmp(uint64_t a, uint64_t b)
+{
+	return (a > b) - (a < b);
+}
+
 static int bt_uuid128_cmp(const bt_uuid_t *u1, const bt_uuid_t *u2)
 {
-	return memcmp(&u1->value.u128, &u2->value.u128, sizeof(uint128_t));
+	const uint8_t *d1 = u1->value.u128.data;
+	const uint8_t *d2 = u2->value.u128.data;
+	int ret;
+
+	ret = uint64_cmp(bt_get_be64(d1), bt_get_be64(d2));
+	if (ret)
+		return ret;
+
+	return uint64_cmp(bt_get_be64(d1 + 8), bt_get_be64(d2 + 8));
 }
 
 int bt_uuid16_create(bt_uuid_t *btuuid, uint16_t value)
@@ -127,17 +146,122 @@ int bt_uuid_cmp(const bt_uuid_t *uuid1, const bt_uuid_t *uuid2)
 {
 	bt_uuid_t u1, u2;
 
+	/*
+	 * Short UUIDs of the same type only differ in the bytes they replace
+	 * in the base UUID, so their numeric order matches the 128-bit order
+	 * and no conversion is needed.
+	 */
+	if (uuid1->type == uuid2->type) {
+		switch (uuid1->type) {
+		case BT_UUID16:
+			return (uuid1->value.u16 > uuid2->value.u16) -
+					(uuid1->value.u16 < uuid2->value.u16);
+		case BT_UUID32:
+			return (uuid1->value.u32 > uuid2->value.u32) -
+					(uuid1->value.u32 < uuid2->value.u32);
+		case BT_UUID128:
+			return bt_uuid128_cmp(uuid1, uuid2);
+		case BT_UUID_UNSPEC:
+		default:
+			break;
+		}
+	}
+
 	bt_uuid_to_uuid128(uuid1, &u1);
 	bt_uuid_to_uuid128(uuid2, &u2);
 
 	return bt_uuid128_cmp(&u1, &u2);
 }
 
+static const char hex_digits[] = "0123456789abcdef";
+
+/*
+ * Value of each hex digit plus one, so that zero marks characters which
+ * are not hex digits.
+ */
+static const uint8_t hex_values[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+static char *hex_format(char *str, const uint8_t *data, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		*str++ = hex_digits[data[i] >> 4];
+		*str++ = hex_digits[data[i] & 0x0f];
+	}
+
+	return str;
+}
+
+static bool hex_parse(const char *str, uint8_t *data, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		uint8_t hi = hex_values[(uint8_t) str[i * 2]];
+		uint8_t lo = hex_values[(uint8_t) str[i * 2 + 1]];
+
+		if (!hi || !lo)
+			return false;
+
+		data[i] = ((hi - 1) << 4) | (lo - 1);
+	}
+
+	return true;
+}
+
+/* Layout of the 128-bit string form: bytes per dash separated group */
+static const uint8_t uuid128_groups[] = { 4, 2, 2, 2, 6 };
+
+static void uuid128_format(const uint128_t *u128, char *str)
+{
+	const uint8_t *data = u128->data;
+	size_t i;
+
+	for (i = 0; i < sizeof(uuid128_groups); i++) {
+		if (i)
+			*str++ = '-';
+
+		str = hex_format(str, data, uuid128_groups[i]);
+		data += uuid128_groups[i];
+	}
+
+	*str = '\0';
+}
+
+static bool uuid128_parse(const char *str, uint128_t *u128)
+{
+	uint8_t *data = u128->data;
+	size_t i;
+
+	for (i = 0; i < sizeof(uuid128_groups); i++) {
+		if (i && *str++ != '-')
+			return false;
+
+		if (!hex_parse(str, data, uuid128_groups[i]))
+			return false;
+
+		str += uuid128_groups[i] * 2;
+		data += uuid128_groups[i];
+	}
+
+	return *str == '\0';
+}
+
 /*
  * convert the UUID to string, copying a maximum of n characters.
  */
 int bt_uuid_to_string(const bt_uuid_t *uuid, char *str, size_t n)
 {
+	char buf[MAX_LEN_UUID_STR];
+	uint8_t data[4];
+	size_t len;
+
 	if (!uuid) {
 		snprintf(str, n, "NULL");
 		return -EINVAL;
@@ -145,33 +269,15 @@ int bt_uuid_to_string(const bt_uuid_t *uuid, char *str, size_t n)
 
 	switch (uuid->type) {
 	case BT_UUID16:
-		snprintf(str, n, "%.4x", uuid->value.u16);
+		bt_put_be16(uuid->value.u16, data);
+		*hex_format(buf, data, 2) = '\0';
 		break;
 	case BT_UUID32:
-		snprintf(str, n, "%.8x", uuid->value.u32);
+		bt_put_be32(uuid->value.u32, data);
+		*hex_format(buf, data, 4) = '\0';
 		break;
-	case BT_UUID128: {
-		unsigned int   data0;
-		unsigned short data1;
-		unsigned short data2;
-		unsigned short data3;
-		unsigned int   data4;
-		unsigned short data5;
-
-		const uint8_t *data = (uint8_t *) &uuid->value.u128;
-
-		memcpy(&data0, &data[0], 4);
-		memcpy(&data1, &data[4], 2);
-		memcpy(&data2, &data[6], 2);
-		memcpy(&data3, &data[8], 2);
-		memcpy(&data4, &data[10], 4);
-		memcpy(&data5, &data[14], 2);
-
-		snprintf(str, n, "%.8x-%.4x-%.4x-%.4x-%.8x%.4x",
-				ntohl(data0), ntohs(data1),
-				ntohs(data2), ntohs(data3),
-				ntohl(data4), ntohs(data5));
-		}
+	case BT_UUID128:
+		uuid128_format(&uuid->value.u128, buf);
 		break;
 	case BT_UUID_UNSPEC:
 	default:
@@ -179,6 +285,16 @@ int bt_uuid_to_string(const bt_uuid_t *uuid, char *str, size_t n)
 		return -EINVAL;	/* Enum type of UUID not set */
 	}
 
+	if (!n)
+		return 0;
+
+	len = strlen(buf);
+	if (len >= n)
+		len = n - 1;
+
+	memcpy(str, buf, len);
+	str[len] = '\0';
+
 	return 0;
 }
 
@@ -191,17 +307,13 @@ static inline int is_uuid128(const char *string)
 			string[23] == '-');
 }
 
-static inline int is_base_uuid128(const char *string)
+static inline int is_base_uuid128(const uint128_t *u128)
 {
-	uint16_t uuid;
-	char dummy;
+	const uint8_t *base = bluetooth_base_uuid.data;
 
-	if (!is_uuid128(string))
-		return 0;
-
-	return sscanf(string,
-		"0000%04hx-0000-1000-8000-00805%1[fF]9%1[bB]34%1[fF]%1[bB]",
-		&uuid, &dummy, &dummy, &dummy, &dummy) == 5;
+	/* Everything but the 16-bit value at bytes 2-3 has to match */
+	return !memcmp(u128->data, base, BASE_UUID16_OFFSET) &&
+			!memcmp(&u128->data[4], &base[4], sizeof(uint128_t) - 4);
 }
 
 static inline int is_uuid32(const char *string)
@@ -244,40 +356,25 @@ static int bt_string_to_uuid32(bt_uuid_t *uuid, const char *string)
 
 static int bt_string_to_uuid128(bt_uuid_t *uuid, const char *string)
 {
-	uint32_t data0, data4;
-	uint16_t data1, data2, data3, data5;
 	uint128_t u128;
-	uint8_t *val = (uint8_t *) &u128;
+	uint16_t u16;
 
-	if (sscanf(string, "%08x-%04hx-%04hx-%04hx-%08x%04hx",
-				&data0, &data1, &data2,
-				&data3, &data4, &data5) != 6)
+	if (!uuid128_parse(string, &u128))
 		return -EINVAL;
 
-	data0 = htonl(data0);
-	data1 = htons(data1);
-	data2 = htons(data2);
-	data3 = htons(data3);
-	data4 = htonl(data4);
-	data5 = htons(data5);
-
-	memcpy(&val[0], &data0, 4);
-	memcpy(&val[4], &data1, 2);
-	memcpy(&val[6], &data2, 2);
-	memcpy(&val[8], &data3, 2);
-	memcpy(&val[10], &data4, 4);
-	memcpy(&val[14], &data5, 2);
-
-	bt_uuid128_create(uuid, u128);
+	if (is_base_uuid128(&u128)) {
+		u16 = bt_get_be16(&u128.data[BASE_UUID16_OFFSET]);
+		bt_uuid16_create(uuid, u16);
+	} else {
+		bt_uuid128_create(uuid, u128);
+	}
 
 	return 0;
 }
 
 int bt_string_to_uuid(bt_uuid_t *uuid, const char *string)
 {
-	if (is_base_uuid128(string))
-		return bt_string_to_uuid16(uuid, string + 4);
-	else if (is_uuid128(string))
+	if (is_uuid128(string))
 		return bt_string_to_uuid128(uuid, string);
 	else if (is_uuid32(string))
 		return bt_string_to_uuid32(uuid, string);
@@ -41,6 +41,7 @@
 #include "src/profile.h"
 #include "src/service.h"
 #include "src/dbus-common.h"
+#include "src/batch.h"
 #include "src/shared/util.h"
 #include "src/error.h"
 #include "attrib/gattrib.h"
@@ -124,6 +125,7 @@ struct watcher {
 	guint			id;
 	char			*srv;
 	char			*path;
+	struct batch_watcher	*batch;
 };
 
 struct measurement {
@@ -221,6 +223,7 @@ static void destroy_watcher(gpointer user_data)
 {
 	struct watcher *watcher = user_data;
 
+	batch_watcher_free(watcher->batch);
 	g_free(watcher->path);
 	g_free(watcher->srv);
 	g_free(watcher);
@@ -494,6 +497,25 @@ static void discover_desc(struct csc *csc, struct gatt_char *c,
 									ch);
 }
 
+static void append_measurement(DBusMessageIter *dict, void *user_data)
+{
+	struct measurement *m = user_data;
+
+	if (m->has_wheel_rev) {
+		dict_append_entry(dict, "WheelRevolutions",
+					DBUS_TYPE_UINT32, &m->wheel_rev);
+		dict_append_entry(dict, "LastWheelEventTime",
+					DBUS_TYPE_UINT16, &m->last_wheel_time);
+	}
+
+	if (m->has_crank_rev) {
+		dict_append_entry(dict, "CrankRevolutions",
+					DBUS_TYPE_UINT16, &m->crank_rev);
+		dict_append_entry(dict, "LastCrankEventTime",
+					DBUS_TYPE_UINT16, &m->last_crank_time);
+	}
+}
+
 static void update_watcher(gpointer data, gpointer user_data)
 {
 	struct watcher *w = data;
@@ -504,6 +526,11 @@ static void update_watcher(gpointer data, gpointer user_data)
 	DBusMessageIter dict;
 	DBusMessage *msg;
 
+	if (w->batch != NULL) {
+		batch_watcher_queue(w->batch, path, append_measurement, m);
+		return;
+	}
+
 	msg = dbus_message_new_method_call(w->srv, w->path,
 			CYCLINGSPEED_WATCHER_INTERFACE, "MeasurementReceived");
 	if (msg == NULL)
@@ -518,19 +545,7 @@ static void update_watcher(gpointer data, gpointer user_data)
 			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
 			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
 
-	if (m->has_wheel_rev) {
-		dict_append_entry(&dict, "WheelRevolutions",
-					DBUS_TYPE_UINT32, &m->wheel_rev);
-		dict_append_entry(&dict, "LastWheelEventTime",
-					DBUS_TYPE_UINT16, &m->last_wheel_time);
-	}
-
-	if (m->has_crank_rev) {
-		dict_append_entry(&dict, "CrankRevolutions",
-					DBUS_TYPE_UINT16, &m->crank_rev);
-		dict_append_entry(&dict, "LastCrankEventTime",
-					DBUS_TYPE_UINT16, &m->last_crank_time);
-	}
+	append_measurement(&dict, m);
 
 	dbus_message_iter_close_container(&iter, &dict);
 
@@ -872,17 +887,12 @@ static void watcher_exit_cb(DBusConnection *conn, void *user_data)
 		g_slist_foreach(cadapter->devices, disable_measurement, 0);
 }
 
-static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
-								void *data)
+static DBusMessage *add_watcher(DBusConnection *conn, DBusMessage *msg,
+					struct csc_adapter *cadapter,
+					const char *path, uint16_t interval)
 {
-	struct csc_adapter *cadapter = data;
 	struct watcher *watcher;
 	const char *sender = dbus_message_get_sender(msg);
-	char *path;
-
-	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
-							DBUS_TYPE_INVALID))
-		return btd_error_invalid_args(msg);
 
 	watcher = find_watcher(cadapter->watchers, sender, path);
 	if (watcher != NULL)
@@ -895,6 +905,11 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	watcher->srv = g_strdup(sender);
 	watcher->path = g_strdup(path);
 
+	if (interval > 0)
+		watcher->batch = batch_watcher_new(sender, path,
+						CYCLINGSPEED_WATCHER_INTERFACE,
+						interval);
+
 	if (g_slist_length(cadapter->watchers) == 0)
 		g_slist_foreach(cadapter->devices, enable_measurement, 0);
 
@@ -905,6 +920,37 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	return dbus_message_new_method_return(msg);
 }
 
+static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
+								void *data)
+{
+	struct csc_adapter *cadapter = data;
+	char *path;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
+							DBUS_TYPE_INVALID))
+		return btd_error_invalid_args(msg);
+
+	return add_watcher(conn, msg, cadapter, path, 0);
+}
+
+static DBusMessage *register_batch_watcher(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	struct csc_adapter *cadapter = data;
+	uint16_t interval;
+	char *path;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
+						DBUS_TYPE_UINT16, &interval,
+						DBUS_TYPE_INVALID))
+		return btd_error_invalid_args(msg);
+
+	if (interval == 0)
+		return btd_error_invalid_args(msg);
+
+	return add_watcher(conn, msg, cadapter, path, interval);
+}
+
 static DBusMessage *unregister_watcher(DBusConnection *conn, DBusMessage *msg,
 								void *data)
 {
@@ -939,6 +985,9 @@ static const GDBusMethodTable cyclingspeed_manager_methods[] = {
 	{ GDBUS_METHOD("UnregisterWatcher",
 			GDBUS_ARGS({ "agent", "o" }), NULL,
 			unregister_watcher) },
+	{ GDBUS_EXPERIMENTAL_METHOD("RegisterBatchWatcher",
+			GDBUS_ARGS({ "agent", "o" }, { "interval", "q" }),
+			NULL, register_batch_watcher) },
 	{ }
 };
 
@@ -47,6 +47,7 @@
 
 #include "hdp_types.h"
 #include "hdp_util.h"
+#include "hdp_stream.h"
 #include "hdp.h"
 #include "mcap.h"
 
@@ -78,6 +79,7 @@ struct hdp_tmp_dc_data {
 	struct hdp_channel		*hdp_chann;
 	guint				ref;
 	mcap_mdl_operation_cb		cb;
+	gboolean			stream;
 };
 
 struct hdp_echo_data {
@@ -104,6 +106,7 @@ static void free_health_channel(struct hdp_channel *chan)
 		chan->edata = NULL;
 	}
 
+	hdp_stream_free(chan->stream);
 	mcap_mdl_unref(chan->mdl);
 	hdp_application_unref(chan->app);
 	health_device_unref(chan->dev);
@@ -477,6 +480,38 @@ static void abort_mdl_cb(GError *err, gpointer data)
 		error("Aborting error: %s", err->message);
 }
 
+static DBusMessage *channel_acquire_reply(struct hdp_tmp_dc_data *data,
+									int fd)
+{
+	struct hdp_channel *chan = data->hdp_chann;
+	GError *gerr = NULL;
+	DBusMessage *reply;
+	int ring, notify;
+
+	if (!data->stream)
+		return g_dbus_create_reply(data->msg, DBUS_TYPE_UNIX_FD, &fd,
+							DBUS_TYPE_INVALID);
+
+	if (chan->stream == NULL) {
+		chan->stream = hdp_stream_new(fd, chan->imtu, &gerr);
+		if (chan->stream == NULL) {
+			reply = g_dbus_create_error(data->msg,
+						ERROR_INTERFACE ".HealthError",
+						"%s", gerr->message);
+			g_error_free(gerr);
+			return reply;
+		}
+	}
+
+	ring = hdp_stream_get_ring_fd(chan->stream);
+	notify = hdp_stream_get_notify_fd(chan->stream);
+
+	return g_dbus_create_reply(data->msg, DBUS_TYPE_UNIX_FD, &fd,
+						DBUS_TYPE_UNIX_FD, &ring,
+						DBUS_TYPE_UNIX_FD, &notify,
+						DBUS_TYPE_INVALID);
+}
+
 static void hdp_mdl_reconn_cb(struct mcap_mdl *mdl, GError *err, gpointer data)
 {
 	DBusConnection *conn = btd_get_dbus_connection();
@@ -513,8 +548,7 @@ static void hdp_mdl_reconn_cb(struct mcap_mdl *mdl, GError *err, gpointer data)
 		return;
 	}
 
-	reply = g_dbus_create_reply(dc_data->msg, DBUS_TYPE_UNIX_FD,
-							&fd, DBUS_TYPE_INVALID);
+	reply = channel_acquire_reply(dc_data, fd);
 	g_dbus_send_message(conn, reply);
 
 	g_dbus_emit_signal(conn, device_get_path(dc_data->hdp_chann->dev->dev),
@@ -604,8 +638,7 @@ static DBusMessage *channel_acquire_continue(struct hdp_tmp_dc_data *data,
 
 	fd = mcap_mdl_get_fd(data->hdp_chann->mdl);
 	if (fd >= 0)
-		return g_dbus_create_reply(data->msg, DBUS_TYPE_UNIX_FD, &fd,
-							DBUS_TYPE_INVALID);
+		return channel_acquire_reply(data, fd);
 
 	hdp_tmp_dc_data_ref(data);
 	if (mcap_reconnect_mdl(data->hdp_chann->mdl, device_reconnect_mdl_cb,
@@ -630,10 +663,9 @@ static void channel_acquire_cb(gpointer data, GError *err)
 		g_dbus_send_message(btd_get_dbus_connection(), reply);
 }
 
-static DBusMessage *channel_acquire(DBusConnection *conn,
-					DBusMessage *msg, void *user_data)
+static DBusMessage *acquire(DBusMessage *msg, struct hdp_channel *chan,
+							gboolean stream)
 {
-	struct hdp_channel *chan = user_data;
 	struct hdp_tmp_dc_data *dc_data;
 	GError *gerr = NULL;
 	DBusMessage *reply;
@@ -641,6 +673,7 @@ static DBusMessage *channel_acquire(DBusConnection *conn,
 	dc_data = g_new0(struct hdp_tmp_dc_data, 1);
 	dc_data->msg = dbus_message_ref(msg);
 	dc_data->hdp_chann = hdp_channel_ref(chan);
+	dc_data->stream = stream;
 
 	if (chan->dev->mcl_conn) {
 		reply = channel_acquire_continue(hdp_tmp_dc_data_ref(dc_data),
@@ -662,10 +695,31 @@ static DBusMessage *channel_acquire(DBusConnection *conn,
 	return reply;
 }
 
+static DBusMessage *channel_acquire(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	return acquire(msg, user_data, FALSE);
+}
+
+static DBusMessage *channel_acquire_stream(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	struct hdp_channel *chan = user_data;
+
+	/* Echo channels are served by the daemon itself */
+	if (chan->mdep == HDP_MDEP_ECHO)
+		return btd_error_not_supported(msg);
+
+	return acquire(msg, chan, TRUE);
+}
+
 static void close_mdl(struct hdp_channel *hdp_chann)
 {
 	int fd;
 
+	hdp_stream_free(hdp_chann->stream);
+	hdp_chann->stream = NULL;
+
 	fd = mcap_mdl_get_fd(hdp_chann->mdl);
 	if (fd < 0)
 		return;
@@ -729,6 +783,10 @@ static const GDBusMethodTable health_channels_methods[] = {
 	{ GDBUS_ASYNC_METHOD("Acquire",
 			NULL, GDBUS_ARGS({ "fd", "h" }),
 			channel_acquire) },
+	{ GDBUS_EXPERIMENTAL_ASYNC_METHOD("AcquireStream",
+			NULL, GDBUS_ARGS({ "fd", "h" }, { "ring", "h" },
+							{ "notify", "h" }),
+			channel_acquire_stream) },
 	{ GDBUS_METHOD("Release", NULL, NULL, channel_release) },
 	{ }
 };
@@ -993,11 +1051,21 @@ end:
 
 static void hdp_mcap_mdl_closed_cb(struct mcap_mdl *mdl, void *data)
 {
-	/* struct hdp_device *dev = data; */
+	struct hdp_device *dev = data;
+	struct hdp_channel *chan;
+	GSList *l;
 
 	DBG("");
 
-	/* Nothing to do */
+	l = g_slist_find_custom(dev->channels, mdl, cmp_chan_mdl);
+	if (l == NULL)
+		return;
+
+	chan = l->data;
+
+	/* A reconnected data channel needs a new stream reading from it */
+	hdp_stream_free(chan->stream);
+	chan->stream = NULL;
 }
 
 static void hdp_mcap_mdl_deleted_cb(struct mcap_mdl *mdl, void *data)
@@ -1351,7 +1419,7 @@ static gboolean update_adapter(struct hdp_adapter *hdp_adapter)
 				BT_IO_SEC_MEDIUM, 0, 0,
 				mcl_connected, mcl_reconnected,
 				mcl_disconnected, mcl_uncached,
-				NULL, /* CSP is not used by now */
+				NULL, /* Only the CSP-Slave role is used */
 				hdp_adapter, &err);
 	if (hdp_adapter->mi == NULL) {
 		error("Error creating the MCAP instance: %s", err->message);
@@ -1359,6 +1427,8 @@ static gboolean update_adapter(struct hdp_adapter *hdp_adapter)
 		return FALSE;
 	}
 
+	mcap_enable_csp(hdp_adapter->mi);
+
 	hdp_adapter->ccpsm = mcap_get_ctrl_psm(hdp_adapter->mi, &err);
 	if (err != NULL) {
 		error("Error getting MCAP control PSM: %s", err->message);
@@ -2066,6 +2136,43 @@ fail:
 	return reply;
 }
 
+static DBusMessage *device_get_sync_info(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	struct hdp_device *device = user_data;
+	struct mcap_sync_stats stats;
+	DBusMessageIter iter, dict;
+	DBusMessage *reply;
+	uint32_t samples, bound;
+
+	if (!device->mcl_conn || device->mcl == NULL)
+		return btd_error_not_connected(msg);
+
+	if (!mcap_sync_get_stats(device->mcl, &stats))
+		return btd_error_not_available(msg);
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &dict);
+
+	samples = stats.samples;
+	dict_append_entry(&dict, "Samples", DBUS_TYPE_UINT32, &samples);
+
+	if (stats.error >= 0) {
+		bound = stats.error;
+		dict_append_entry(&dict, "Error", DBUS_TYPE_UINT32, &bound);
+		dict_append_entry(&dict, "Drift", DBUS_TYPE_INT32,
+								&stats.drift);
+	}
+
+	dbus_message_iter_close_container(&iter, &dict);
+
+	return reply;
+}
+
 static gboolean dev_property_exists_main_channel(
 				const GDBusPropertyTable *property, void *data)
 {
@@ -2116,6 +2223,9 @@ static const GDBusMethodTable health_device_methods[] = {
 	{ GDBUS_ASYNC_METHOD("DestroyChannel",
 			GDBUS_ARGS({ "channel", "o" }), NULL,
 			device_destroy_channel) },
+	{ GDBUS_EXPERIMENTAL_METHOD("GetSyncInfo",
+			NULL, GDBUS_ARGS({ "info", "a{sv}" }),
+			device_get_sync_info) },
 	{ }
 };
 
@@ -0,0 +1,347 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2015  PDi Communication Systems, Inc.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+#include <glib.h>
+
+#include "src/log.h"
+
+#include "hdp_types.h"
+#include "hdp_stream.h"
+
+#define STREAM_SHM_TEMPLATE	"/dev/shm/bluez-hdp-XXXXXX"
+#define STREAM_DATA_OFFSET	64
+#define STREAM_DATA_SIZE	(256 * 1024)
+#define STREAM_MAP_SIZE		(STREAM_DATA_OFFSET + STREAM_DATA_SIZE)
+
+/* Packets moved out of the socket per recvmmsg() call */
+#define STREAM_BATCH		8
+
+#define RECORD_ALIGN(len)	(((len) + 7) & ~7)
+
+#define NSEC_PER_SEC		1000000000ULL
+
+struct hdp_stream {
+	int fd;
+	int ring_fd;
+	int notify_fd;
+	guint watch;
+	struct hdp_stream_ring *ring;
+	uint8_t *data;
+	uint16_t imtu;
+	uint8_t *buf;
+	struct mmsghdr msg[STREAM_BATCH];
+	struct iovec iov[STREAM_BATCH];
+	uint8_t cmsg[STREAM_BATCH][CMSG_SPACE(sizeof(struct timespec))];
+};
+
+static uint64_t timespec_to_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+/*
+ * The kernel stamps packets with CLOCK_REALTIME while MCAP works with
+ * CLOCK_MONOTONIC, so compute the offset between both once per batch.
+ */
+static int64_t realtime_offset(void)
+{
+	struct timespec mono, real;
+
+	clock_gettime(CLOCK_REALTIME, &real);
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+
+	return timespec_to_ns(&real) - timespec_to_ns(&mono);
+}
+
+static uint64_t msg_timestamp(struct msghdr *msg, int64_t offset)
+{
+	struct cmsghdr *cmsg;
+	struct timespec now;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		struct timespec ts;
+
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+					cmsg->cmsg_type != SCM_TIMESTAMPNS)
+			continue;
+
+		memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+
+		return timespec_to_ns(&ts) - offset;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return timespec_to_ns(&now);
+}
+
+static bool ring_push(struct hdp_stream *stream, const uint8_t *data,
+					uint32_t len, uint64_t timestamp)
+{
+	struct hdp_stream_ring *ring = stream->ring;
+	struct hdp_stream_record *rec;
+	uint32_t size = RECORD_ALIGN(sizeof(*rec) + len);
+	uint32_t pos = ring->head % STREAM_DATA_SIZE;
+	uint32_t skip = 0;
+	uint64_t used;
+
+	/* Records never wrap, the rest of the area is skipped instead */
+	if (pos + size > STREAM_DATA_SIZE)
+		skip = STREAM_DATA_SIZE - pos;
+
+	__sync_synchronize();
+	used = ring->head - ring->tail;
+
+	if (used + skip + size > STREAM_DATA_SIZE) {
+		ring->dropped++;
+		return false;
+	}
+
+	if (skip) {
+		/* Less than a header left means an implicit wrap */
+		if (skip >= sizeof(*rec)) {
+			rec = (void *) (stream->data + pos);
+			rec->len = 0;
+			rec->flags = HDP_STREAM_RECORD_WRAP;
+			rec->timestamp = 0;
+		}
+
+		pos = 0;
+	}
+
+	rec = (void *) (stream->data + pos);
+	rec->len = len;
+	rec->flags = 0;
+	rec->timestamp = timestamp;
+	memcpy(rec->data, data, len);
+
+	/* Make the record visible before moving the head */
+	__sync_synchronize();
+	ring->head += skip + size;
+
+	return true;
+}
+
+static void stream_notify(struct hdp_stream *stream)
+{
+	uint64_t val = 1;
+
+	if (write(stream->notify_fd, &val, sizeof(val)) < 0 &&
+							errno != EAGAIN)
+		error("hdp: stream notification failed: %s (%d)",
+							strerror(errno), errno);
+}
+
+static gboolean stream_read_cb(GIOChannel *chan, GIOCondition cond,
+							gpointer user_data)
+{
+	struct hdp_stream *stream = user_data;
+	bool pushed = false;
+	int64_t offset;
+	int i, n;
+
+	if (cond & (G_IO_HUP | G_IO_ERR | G_IO_NVAL))
+		goto done;
+
+	n = recvmmsg(stream->fd, stream->msg, STREAM_BATCH, MSG_DONTWAIT,
+									NULL);
+	if (n < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return TRUE;
+
+		error("hdp: stream read failed: %s (%d)", strerror(errno),
+									errno);
+		goto done;
+	}
+
+	if (n == 0)
+		goto done;
+
+	offset = realtime_offset();
+
+	for (i = 0; i < n; i++) {
+		struct msghdr *hdr = &stream->msg[i].msg_hdr;
+		uint64_t ts = msg_timestamp(hdr, offset);
+
+		if (ring_push(stream, stream->iov[i].iov_base,
+						stream->msg[i].msg_len, ts))
+			pushed = true;
+
+		/* recvmmsg() updates the control length of every message */
+		hdr->msg_controllen = sizeof(stream->cmsg[i]);
+	}
+
+	if (pushed)
+		stream_notify(stream);
+
+	return TRUE;
+
+done:
+	DBG("hdp: stream on fd %d stopped", stream->fd);
+	stream->watch = 0;
+
+	/* Wake up the reader so it can notice the hang up */
+	stream_notify(stream);
+
+	return FALSE;
+}
+
+static int ring_create(struct hdp_stream *stream)
+{
+	char path[] = STREAM_SHM_TEMPLATE;
+	void *map;
+	int fd, err;
+
+	fd = mkostemp(path, O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	unlink(path);
+
+	if (ftruncate(fd, STREAM_MAP_SIZE) < 0)
+		goto failed;
+
+	map = mmap(NULL, STREAM_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+								fd, 0);
+	if (map == MAP_FAILED)
+		goto failed;
+
+	stream->ring_fd = fd;
+	stream->ring = map;
+	stream->data = (uint8_t *) map + STREAM_DATA_OFFSET;
+
+	stream->ring->magic = HDP_STREAM_MAGIC;
+	stream->ring->version = HDP_STREAM_VERSION;
+	stream->ring->data_offset = STREAM_DATA_OFFSET;
+	stream->ring->data_size = STREAM_DATA_SIZE;
+
+	return 0;
+
+failed:
+	err = -errno;
+	close(fd);
+	return err;
+}
+
+struct hdp_stream *hdp_stream_new(int fd, uint16_t imtu, GError **err)
+{
+	struct hdp_stream *stream;
+	GIOChannel *io;
+	int opt = 1;
+	int i, ret;
+
+	stream = g_new0(struct hdp_stream, 1);
+	stream->fd = fd;
+	stream->ring_fd = -1;
+	stream->imtu = imtu ? imtu : UINT16_MAX;
+
+	ret = ring_create(stream);
+	if (ret < 0) {
+		g_set_error(err, HDP_ERROR, HDP_UNSPECIFIED_ERROR,
+				"Can't create stream ring: %s", strerror(-ret));
+		g_free(stream);
+		return NULL;
+	}
+
+	stream->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (stream->notify_fd < 0) {
+		g_set_error(err, HDP_ERROR, HDP_UNSPECIFIED_ERROR,
+				"Can't create stream notifier: %s",
+				strerror(errno));
+		hdp_stream_free(stream);
+		return NULL;
+	}
+
+	if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &opt, sizeof(opt)) < 0)
+		DBG("hdp: no receive timestamps: %s", strerror(errno));
+
+	stream->buf = g_malloc(STREAM_BATCH * stream->imtu);
+
+	for (i = 0; i < STREAM_BATCH; i++) {
+		struct msghdr *hdr = &stream->msg[i].msg_hdr;
+
+		stream->iov[i].iov_base = stream->buf + i * stream->imtu;
+		stream->iov[i].iov_len = stream->imtu;
+		hdr->msg_iov = &stream->iov[i];
+		hdr->msg_iovlen = 1;
+		hdr->msg_control = stream->cmsg[i];
+		hdr->msg_controllen = sizeof(stream->cmsg[i]);
+	}
+
+	/* Measurements are drained ahead of regular main loop work */
+	io = g_io_channel_unix_new(fd);
+	stream->watch = g_io_add_watch_full(io, G_PRIORITY_HIGH,
+				G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+				stream_read_cb, stream, NULL);
+	g_io_channel_unref(io);
+
+	return stream;
+}
+
+void hdp_stream_free(struct hdp_stream *stream)
+{
+	if (stream == NULL)
+		return;
+
+	if (stream->watch > 0)
+		g_source_remove(stream->watch);
+
+	if (stream->ring != NULL)
+		munmap(stream->ring, STREAM_MAP_SIZE);
+
+	if (stream->ring_fd >= 0)
+		close(stream->ring_fd);
+
+	if (stream->notify_fd >= 0)
+		close(stream->notify_fd);
+
+	g_free(stream->buf);
+	g_free(stream);
+}
+
+int hdp_stream_get_ring_fd(struct hdp_stream *stream)
+{
+	return stream->ring_fd;
+}
+
+int hdp_stream_get_notify_fd(struct hdp_stream *stream)
+{
+	return stream->notify_fd;
+}
@@ -0,0 +1,58 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2015  PDi Communication Systems, Inc.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __HDP_STREAM_H__
+#define __HDP_STREAM_H__
+
+#define HDP_STREAM_MAGIC	0x53504448	/* "HDPS" */
+#define HDP_STREAM_VERSION	1
+
+/* Shared memory layout, see doc/health-api.txt */
+struct hdp_stream_ring {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t data_offset;		/* Start of the record area */
+	uint32_t data_size;		/* Size of the record area */
+	uint64_t head;			/* Bytes written by bluetoothd */
+	uint64_t tail;			/* Bytes consumed by the application */
+	uint64_t dropped;		/* Records lost to a full ring */
+} __attribute__ ((packed));
+
+#define HDP_STREAM_RECORD_WRAP	0x01	/* Continue at the area start */
+
+struct hdp_stream_record {
+	uint32_t len;			/* Payload length */
+	uint32_t flags;
+	uint64_t timestamp;		/* CLOCK_MONOTONIC receive time, ns */
+	uint8_t data[0];
+} __attribute__ ((packed));
+
+struct hdp_stream;
+
+struct hdp_stream *hdp_stream_new(int fd, uint16_t imtu, GError **err);
+void hdp_stream_free(struct hdp_stream *stream);
+
+int hdp_stream_get_ring_fd(struct hdp_stream *stream);
+int hdp_stream_get_notify_fd(struct hdp_stream *stream);
+
+#endif /* __HDP_STREAM_H__ */
@@ -102,6 +102,7 @@ struct hdp_device {
 };
 
 struct hdp_echo_data;
+struct hdp_stream;
 
 struct hdp_channel {
 	struct hdp_device	*dev;		/* Device where this channel belongs */
@@ -114,6 +115,7 @@ struct hdp_channel {
 	uint16_t		imtu;		/* Channel incoming MTU */
 	uint16_t		omtu;		/* Channel outgoing MTU */
 	struct hdp_echo_data	*edata;		/* private data used by echo channels */
+	struct hdp_stream	*stream;	/* In-daemon reader, if acquired */
 	int			ref;		/* Reference counter */
 };
 
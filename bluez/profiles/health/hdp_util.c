@@ -670,7 +670,7 @@ static gboolean register_data_exchange_spec(sdp_record_t *record)
 static gboolean register_mcap_features(sdp_record_t *sdp_record)
 {
 	sdp_data_t *mcap_proc;
-	uint8_t mcap_sup_proc = MCAP_SUP_PROC;
+	uint8_t mcap_sup_proc = MCAP_SUP_PROC | MCAP_SUP_CSP;
 
 	mcap_proc = sdp_data_alloc(SDP_UINT8, &mcap_sup_proc);
 	if (mcap_proc == NULL)
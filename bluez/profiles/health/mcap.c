@@ -28,13 +28,18 @@
 
 #include <netinet/in.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
 
 #include <glib.h>
 
 #include "lib/bluetooth.h"
 #include "bluetooth/l2cap.h"
+#include "lib/hci.h"
+#include "lib/hci_lib.h"
 #include "btio/btio.h"
 #include "src/log.h"
 
@@ -47,6 +52,16 @@
 #define MAX_RETRIES	10
 #define SAMPLE_COUNT	20
 
+#define BTCLOCK_PICONET		0x01	/* HCI Read Clock: piconet clock */
+#define BTCLOCK_TIMEOUT		100	/* ms */
+
+/* Clock model filter, see sync_sample() */
+#define SYNC_ALPHA		0.25
+#define SYNC_BETA		0.05
+#define SYNC_MAX_DRIFT		0.0005	/* 500 ppm */
+#define SYNC_MIN_SAMPLES	4
+#define SYNC_MAX_AGE		10000000	/* us */
+
 #define RESPONSE_TIMER	6	/* seconds */
 #define MAX_CACHED	10	/* 10 devices */
 
@@ -59,6 +74,17 @@
 	}					\
 } while(0)
 
+struct sync_filter {
+	unsigned int	samples;	/* BT clock samples taken */
+	uint32_t	btclock;	/* Last BT clock read */
+	int64_t		raw_us;		/* Last BT clock read, unwrapped */
+	uint64_t	local_us;	/* Local time of the last sample */
+	double		bt_us;		/* Filtered BT clock at local_us */
+	double		drift;		/* Local clock rate error vs BT clock */
+	double		jitter;		/* Smoothed absolute residual, us */
+	int		latency;	/* Latency of the last sample, us */
+};
+
 struct mcap_csp {
 	uint64_t	base_tmstamp;	/* CSP base timestamp */
 	struct timespec	base_time;	/* CSP base time when timestamp set */
@@ -71,6 +97,14 @@ struct mcap_csp {
 	guint		set_timer;	/* CSP-Slave: delayed set timer */
 	void		*set_data;	/* CSP-Slave: delayed set data */
 	void		*csp_priv_data;	/* CSP-Master: In-flight request data */
+	int		hci_dd;		/* HCI socket used to read BT clock */
+	int		clock_dd;	/* Non-blocking HCI socket, same use */
+	guint		clock_watch;	/* Read Clock completion watch */
+	gboolean	clock_pending;	/* Read Clock sent on clock_dd */
+	struct timespec	clock_req;	/* When the pending one was sent */
+	uint16_t	hci_handle;	/* ACL handle of the control channel */
+	struct timespec	rx_time;	/* Arrival time of the last command */
+	struct sync_filter filter;	/* Local clock vs BT clock model */
 };
 
 struct mcap_sync_cap_cbdata {
@@ -1761,22 +1795,72 @@ gboolean mcap_connect_mdl(struct mcap_mdl *mdl, uint8_t mode,
 	return TRUE;
 }
 
+/*
+ * Receive timestamps are taken by the kernel with CLOCK_REALTIME, turn
+ * them into CLK so they can be compared with the CSP base time.
+ */
+static void get_rx_time(struct msghdr *msg, struct timespec *rx_time)
+{
+	struct timespec real, now;
+	struct cmsghdr *cmsg;
+	int64_t delta;
+
+	clock_gettime(CLK, &now);
+	*rx_time = now;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		struct timespec ts;
+
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+					cmsg->cmsg_type != SCM_TIMESTAMPNS)
+			continue;
+
+		memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+		clock_gettime(CLOCK_REALTIME, &real);
+
+		delta = (real.tv_sec - ts.tv_sec) * 1000000000LL +
+						real.tv_nsec - ts.tv_nsec;
+		if (delta < 0)
+			break;
+
+		delta = (now.tv_sec * 1000000000LL + now.tv_nsec) - delta;
+		rx_time->tv_sec = delta / 1000000000LL;
+		rx_time->tv_nsec = delta % 1000000000LL;
+		break;
+	}
+}
+
 static gboolean mcl_control_cb(GIOChannel *chan, GIOCondition cond,
 								gpointer data)
 {
 	GError *gerr = NULL;
 	struct mcap_mcl *mcl = data;
-	int sk, len;
+	uint8_t control[CMSG_SPACE(sizeof(struct timespec))];
 	uint8_t buf[MCAP_CC_MTU];
+	struct msghdr msg;
+	struct iovec iov;
+	int sk, len;
 
 	if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL))
 		goto fail;
 
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
 	sk = g_io_channel_unix_get_fd(chan);
-	len = read(sk, buf, sizeof(buf));
+	len = recvmsg(sk, &msg, 0);
 	if (len < 0)
 		goto fail;
 
+	if (mcl->csp)
+		get_rx_time(&msg, &mcl->csp->rx_time);
+
 	proc_cmd(mcl, buf, (uint32_t) len);
 	return TRUE;
 
@@ -2308,6 +2392,8 @@ static void reset_tmstamp(struct mcap_csp *csp, struct timespec *base_time,
 
 void mcap_sync_init(struct mcap_mcl *mcl)
 {
+	int opt = 1;
+
 	if (!mcl->mi->csp_enabled) {
 		mcl->csp = NULL;
 		return;
@@ -2318,8 +2404,17 @@ void mcap_sync_init(struct mcap_mcl *mcl)
 	mcl->csp->rem_req_acc = 10000; /* safe divisor */
 	mcl->csp->set_data = NULL;
 	mcl->csp->csp_priv_data = NULL;
+	mcl->csp->hci_dd = -1;
+	mcl->csp->clock_dd = -1;
 
 	reset_tmstamp(mcl->csp, NULL, 0);
+	mcl->csp->rx_time = mcl->csp->base_time;
+
+	/* Sync commands are timed from their arrival, not their dispatch */
+	if (mcl->cc && setsockopt(g_io_channel_unix_get_fd(mcl->cc),
+					SOL_SOCKET, SO_TIMESTAMPNS, &opt,
+					sizeof(opt)) < 0)
+		DBG("CSP: no receive timestamps: %s", strerror(errno));
 }
 
 void mcap_sync_stop(struct mcap_mcl *mcl)
@@ -2339,6 +2434,15 @@ void mcap_sync_stop(struct mcap_mcl *mcl)
 	if (mcl->csp->csp_priv_data)
 		g_free(mcl->csp->csp_priv_data);
 
+	if (mcl->csp->hci_dd >= 0)
+		hci_close_dev(mcl->csp->hci_dd);
+
+	if (mcl->csp->clock_watch)
+		g_source_remove(mcl->csp->clock_watch);
+
+	if (mcl->csp->clock_dd >= 0)
+		hci_close_dev(mcl->csp->clock_dd);
+
 	mcl->csp->ind_timer = 0;
 	mcl->csp->set_timer = 0;
 	mcl->csp->set_data = NULL;
@@ -2385,17 +2489,209 @@ static gboolean valid_btclock(uint32_t btclk)
 	return btclk <= MCAP_BTCLOCK_MAX;
 }
 
+/*
+ * Tracks the BT clock as seen from the local clock with an alpha-beta
+ * filter: each sample corrects the predicted BT clock by a fraction of
+ * the residual and nudges the rate error (drift) so the model converges
+ * well below the 312.5us resolution of a single BT clock read.
+ */
+static void sync_sample(struct mcap_csp *csp, uint32_t btclock,
+				struct timespec *local, int latency)
+{
+	struct sync_filter *f = &csp->filter;
+	uint64_t local_us = time_us(local);
+	double dt, predicted, residual;
+
+	if (f->samples == 0) {
+		f->btclock = btclock;
+		f->raw_us = 0;
+		f->local_us = local_us;
+		f->bt_us = 0;
+		f->drift = 0;
+		f->jitter = bt2us(1);
+		f->latency = latency;
+		f->samples = 1;
+		return;
+	}
+
+	if (local_us <= f->local_us)
+		return;
+
+	f->raw_us += bt2us(btoffset(f->btclock, btclock));
+	f->btclock = btclock;
+
+	dt = local_us - f->local_us;
+	predicted = f->bt_us + dt * (1.0 + f->drift);
+	residual = f->raw_us - predicted;
+
+	f->bt_us = predicted + residual * SYNC_ALPHA;
+	f->drift += residual * SYNC_BETA / dt;
+
+	if (f->drift > SYNC_MAX_DRIFT)
+		f->drift = SYNC_MAX_DRIFT;
+	else if (f->drift < -SYNC_MAX_DRIFT)
+		f->drift = -SYNC_MAX_DRIFT;
+
+	if (residual < 0)
+		residual = -residual;
+
+	f->jitter += (residual - f->jitter) / 8;
+	f->latency = latency;
+	f->local_us = local_us;
+	f->samples++;
+}
+
+static gboolean btclock_event_cb(GIOChannel *io, GIOCondition cond,
+							gpointer user_data)
+{
+	struct mcap_mcl *mcl = user_data;
+	struct mcap_csp *csp = mcl->csp;
+	unsigned char buf[HCI_MAX_EVENT_SIZE], *ptr;
+	evt_cmd_complete *cc;
+	read_clock_rp *rp;
+	struct timespec now;
+	ssize_t len;
+
+	if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+		csp->clock_watch = 0;
+		csp->clock_pending = FALSE;
+		return FALSE;
+	}
+
+	len = read(g_io_channel_unix_get_fd(io), buf, sizeof(buf));
+	if (len < 0)
+		return TRUE;
+
+	clock_gettime(CLK, &now);
+
+	if (len < 1 + HCI_EVENT_HDR_SIZE + EVT_CMD_COMPLETE_SIZE +
+							READ_CLOCK_RP_SIZE)
+		return TRUE;
+
+	ptr = buf + 1 + HCI_EVENT_HDR_SIZE;
+	cc = (evt_cmd_complete *) ptr;
+	rp = (read_clock_rp *) (ptr + EVT_CMD_COMPLETE_SIZE);
+
+	if (buf[0] != HCI_EVENT_PKT || cc->opcode !=
+			htobs(cmd_opcode_pack(OGF_STATUS_PARAM, OCF_READ_CLOCK)))
+		return TRUE;
+
+	/* Raw sockets see the completions of every Read Clock */
+	if (!csp->clock_pending || rp->status ||
+					btohs(rp->handle) != csp->hci_handle)
+		return TRUE;
+
+	csp->clock_pending = FALSE;
+
+	sync_sample(csp, btohl(rp->clock) & MCAP_BTCLOCK_MAX, &now,
+				time_us(&now) - time_us(&csp->clock_req));
+
+	return TRUE;
+}
+
+/*
+ * Second HCI socket for reading the clock without waiting for the
+ * controller, the completion is picked up from the main loop.
+ */
+static void open_btclock_async(struct mcap_mcl *mcl, int dev_id)
+{
+	struct mcap_csp *csp = mcl->csp;
+	struct hci_filter nf;
+	GIOChannel *io;
+	int dd;
+
+	dd = hci_open_dev(dev_id);
+	if (dd < 0)
+		return;
+
+	hci_filter_clear(&nf);
+	hci_filter_set_ptype(HCI_EVENT_PKT, &nf);
+	hci_filter_set_event(EVT_CMD_COMPLETE, &nf);
+	hci_filter_set_opcode(htobs(cmd_opcode_pack(OGF_STATUS_PARAM,
+							OCF_READ_CLOCK)), &nf);
+
+	if (setsockopt(dd, SOL_HCI, HCI_FILTER, &nf, sizeof(nf)) < 0 ||
+				fcntl(dd, F_SETFL, O_NONBLOCK) < 0) {
+		DBG("CSP: could not set up hci%d: %s", dev_id,
+							strerror(errno));
+		hci_close_dev(dd);
+		return;
+	}
+
+	io = g_io_channel_unix_new(dd);
+	csp->clock_watch = g_io_add_watch(io,
+				G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+				btclock_event_cb, mcl);
+	g_io_channel_unref(io);
+
+	csp->clock_dd = dd;
+}
+
+/*
+ * The piconet clock is read straight from the controller through a raw
+ * HCI socket so there is no dependency on struct btd_adapter.
+ */
+static gboolean open_btclock(struct mcap_mcl *mcl)
+{
+	struct l2cap_conninfo info;
+	socklen_t len = sizeof(info);
+	char addr[18];
+	int sk, dev_id;
+
+	if (!mcl->cc)
+		return FALSE;
+
+	sk = g_io_channel_unix_get_fd(mcl->cc);
+	if (getsockopt(sk, SOL_L2CAP, L2CAP_CONNINFO, &info, &len) < 0) {
+		DBG("CSP: could not get connection handle: %s",
+							strerror(errno));
+		return FALSE;
+	}
+
+	if (bacmp(&mcl->mi->src, BDADDR_ANY) == 0)
+		dev_id = hci_get_route(NULL);
+	else {
+		ba2str(&mcl->mi->src, addr);
+		dev_id = hci_devid(addr);
+	}
+
+	if (dev_id < 0) {
+		DBG("CSP: no controller available");
+		return FALSE;
+	}
+
+	mcl->csp->hci_dd = hci_open_dev(dev_id);
+	if (mcl->csp->hci_dd < 0) {
+		DBG("CSP: could not open hci%d: %s", dev_id, strerror(errno));
+		return FALSE;
+	}
+
+	mcl->csp->hci_handle = info.hci_handle;
+
+	open_btclock_async(mcl, dev_id);
+
+	return TRUE;
+}
+
 /* This call may fail; either deal with retry or use read_btclock_retry */
 static gboolean read_btclock(struct mcap_mcl *mcl, uint32_t *btclock,
 							uint16_t *btaccuracy)
 {
-	/*
-	 * FIXME: btd_adapter_read_clock(...) always return FALSE, current
-	 * code doesn't support CSP (Clock Synchronization Protocol). To avoid
-	 * build dependancy on struct 'btd_adapter', removing this code.
-	 */
+	uint32_t clock;
+	uint16_t accuracy;
 
-	return FALSE;
+	if (mcl->csp->hci_dd < 0 && !open_btclock(mcl))
+		return FALSE;
+
+	if (hci_read_clock(mcl->csp->hci_dd, mcl->csp->hci_handle,
+				BTCLOCK_PICONET, &clock, &accuracy,
+				BTCLOCK_TIMEOUT) < 0)
+		return FALSE;
+
+	*btclock = btohl(clock) & MCAP_BTCLOCK_MAX;
+	*btaccuracy = btohs(accuracy);
+
+	return TRUE;
 }
 
 static gboolean read_btclock_retry(struct mcap_mcl *mcl, uint32_t *btclock,
@@ -2412,6 +2708,33 @@ static gboolean read_btclock_retry(struct mcap_mcl *mcl, uint32_t *btclock,
 	return FALSE;
 }
 
+/* Feeds the clock model once the controller answers, never blocks */
+static void request_btclock(struct mcap_mcl *mcl)
+{
+	struct mcap_csp *csp = mcl->csp;
+	read_clock_cp cp;
+	struct timespec now;
+
+	if (csp->clock_dd < 0 || !csp->clock_watch)
+		return;
+
+	if (clock_gettime(CLK, &now) < 0)
+		return;
+
+	/* Give up on an answer that did not come in time */
+	if (csp->clock_pending && time_us(&now) - time_us(&csp->clock_req) <
+						BTCLOCK_TIMEOUT * 1000)
+		return;
+
+	cp.handle = htobs(csp->hci_handle);
+	cp.which_clock = BTCLOCK_PICONET;
+
+	csp->clock_req = now;
+	csp->clock_pending = hci_send_cmd(csp->clock_dd, OGF_STATUS_PARAM,
+					OCF_READ_CLOCK, READ_CLOCK_CP_SIZE,
+					&cp) == 0;
+}
+
 static gboolean get_btrole(struct mcap_mcl *mcl)
 {
 	int sock, flags;
@@ -2429,6 +2752,47 @@ static gboolean get_btrole(struct mcap_mcl *mcl)
 	return flags & L2CAP_LM_MASTER;
 }
 
+/* BT clock at the given local time according to the model */
+static gboolean sync_predict(struct mcap_csp *csp, struct timespec *local,
+							uint32_t *btclock)
+{
+	struct sync_filter *f = &csp->filter;
+	double dt, ticks;
+	int64_t clock;
+
+	if (f->samples < SYNC_MIN_SAMPLES)
+		return FALSE;
+
+	dt = (double) time_us(local) - f->local_us;
+	if (dt < 0 || dt > SYNC_MAX_AGE)
+		return FALSE;
+
+	ticks = (f->bt_us + dt * (1.0 + f->drift) - f->raw_us) / 312.5;
+	ticks += ticks < 0 ? -0.5 : 0.5;
+	clock = (int64_t) f->btclock + (int64_t) ticks;
+
+	*btclock = ((clock % MCAP_BTCLOCK_FIELD) + MCAP_BTCLOCK_FIELD) %
+							MCAP_BTCLOCK_FIELD;
+
+	return TRUE;
+}
+
+/* Error bound of the model in us, negative while it is not usable */
+static int sync_error(struct mcap_csp *csp)
+{
+	struct sync_filter *f = &csp->filter;
+	double err;
+
+	if (f->samples < SYNC_MIN_SAMPLES)
+		return -1;
+
+	err = 2 * f->jitter + f->latency / 2.0 + 1;
+	if (err > UINT16_MAX)
+		return UINT16_MAX;
+
+	return err;
+}
+
 uint64_t mcap_get_timestamp(struct mcap_mcl *mcl,
 				struct timespec *given_time)
 {
@@ -2667,6 +3031,8 @@ static gboolean get_all_clocks(struct mcap_mcl *mcl, uint32_t *btclock,
 	if (retry < 0)
 		return FALSE;
 
+	sync_sample(mcl->csp, *btclock, base_time, latency);
+
 	*timestamp = mcap_get_timestamp(mcl, base_time);
 
 	return TRUE;
@@ -2675,10 +3041,12 @@ static gboolean get_all_clocks(struct mcap_mcl *mcl, uint32_t *btclock,
 static gboolean sync_send_indication(gpointer user_data)
 {
 	struct mcap_mcl *mcl;
-	mcap_md_sync_info_ind *cmd;
+	mcap_md_sync_info_ind cmd;
 	uint32_t btclock;
 	uint64_t tmstamp;
 	struct timespec base_time;
+	gboolean predicted;
+	int accuracy;
 	int sent;
 
 	if (!user_data)
@@ -2690,18 +3058,34 @@ static gboolean sync_send_indication(gpointer user_data)
 	if (!caps(mcl))
 		return FALSE;
 
-	if (!get_all_clocks(mcl, &btclock, &base_time, &tmstamp))
-		return FALSE;
+	/*
+	 * Once the clock model is settled the indication is built from it
+	 * without waiting for the controller, a BT clock read is requested
+	 * after sending and feeds the model when the controller answers.
+	 */
+	clock_gettime(CLK, &base_time);
+	predicted = sync_predict(mcl->csp, &base_time, &btclock);
+
+	if (predicted) {
+		tmstamp = mcap_get_timestamp(mcl, &base_time);
+		accuracy = sync_error(mcl->csp);
+	} else {
+		if (!get_all_clocks(mcl, &btclock, &base_time, &tmstamp))
+			return FALSE;
 
-	cmd = g_new0(mcap_md_sync_info_ind, 1);
+		accuracy = caps(mcl)->latency;
+	}
 
-	cmd->op = MCAP_MD_SYNC_INFO_IND;
-	cmd->btclock = htonl(btclock);
-	cmd->timestst = hton64(tmstamp);
-	cmd->timestsa = htons(caps(mcl)->latency);
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.op = MCAP_MD_SYNC_INFO_IND;
+	cmd.btclock = htonl(btclock);
+	cmd.timestst = hton64(tmstamp);
+	cmd.timestsa = htons(accuracy);
 
-	sent = send_sync_cmd(mcl, cmd, sizeof(*cmd));
-	g_free(cmd);
+	sent = send_sync_cmd(mcl, &cmd, sizeof(cmd));
+
+	if (predicted)
+		request_btclock(mcl);
 
 	return !sent;
 }
@@ -2767,11 +3151,21 @@ static gboolean proc_sync_set_req_phase2(gpointer user_data)
 									delay);
 		}
 
-		reset_tmstamp(mcl->csp, &base_time, new_tmstamp);
-		tmstamp = new_tmstamp;
+		if (sched_btclock != MCAP_BTCLOCK_IMMEDIATE) {
+			reset_tmstamp(mcl->csp, &base_time, new_tmstamp);
+			tmstamp = new_tmstamp;
+		} else {
+			/* Immediate resets apply when the request arrived */
+			reset_tmstamp(mcl->csp, &mcl->csp->rx_time,
+								new_tmstamp);
+			tmstamp = mcap_get_timestamp(mcl, &base_time);
+		}
 	}
 
-	tmstampacc = caps(mcl)->latency + caps(mcl)->ts_acc;
+	if (sync_error(mcl->csp) >= 0)
+		tmstampacc = sync_error(mcl->csp) + caps(mcl)->ts_acc;
+	else
+		tmstampacc = caps(mcl)->latency + caps(mcl)->ts_acc;
 
 	if (mcl->csp->ind_timer) {
 		g_source_remove(mcl->csp->ind_timer);
@@ -2780,9 +3174,9 @@ static gboolean proc_sync_set_req_phase2(gpointer user_data)
 
 	if (update) {
 		int when = ind_freq + caps(mcl)->syncleadtime_ms;
-		mcl->csp->ind_timer = g_timeout_add(when,
-						sync_send_indication,
-						mcl);
+		mcl->csp->ind_timer = g_timeout_add_full(G_PRIORITY_HIGH,
+						when, sync_send_indication,
+						mcl, NULL);
 	}
 
 	send_sync_set_rsp(mcl, MCAP_SUCCESS, btclock, tmstamp, tmstampacc);
@@ -3171,6 +3565,23 @@ void mcap_sync_set_req(struct mcap_mcl *mcl, uint8_t update, uint32_t btclock,
 	g_free(cmd);
 }
 
+gboolean mcap_sync_get_stats(struct mcap_mcl *mcl,
+					struct mcap_sync_stats *stats)
+{
+	struct sync_filter *f;
+
+	if (!mcl->csp)
+		return FALSE;
+
+	f = &mcl->csp->filter;
+
+	stats->samples = f->samples;
+	stats->drift = f->samples < SYNC_MIN_SAMPLES ? 0 : f->drift * 1e9;
+	stats->error = sync_error(mcl->csp);
+
+	return TRUE;
+}
+
 void mcap_enable_csp(struct mcap_instance *mi)
 {
 	mi->csp_enabled = TRUE;
@@ -26,6 +26,7 @@
 
 /* bytes to get MCAP Supported Procedures */
 #define MCAP_SUP_PROC	0x06
+#define MCAP_SUP_CSP	0x08	/* Clock Synchronization Protocol */
 
 /* maximum transmission unit for channels */
 #define MCAP_CC_MTU	48
@@ -325,6 +326,12 @@ struct sync_info_ind_data {
 	uint16_t	accuracy;
 };
 
+struct mcap_sync_stats {
+	unsigned int	samples;	/* BT clock samples taken */
+	int32_t		drift;		/* Local clock vs BT clock, ppb */
+	int		error;		/* Timestamp error bound in us or -1 */
+};
+
 /************ Operations ************/
 
 /* MDL operations */
@@ -392,6 +399,8 @@ void mcap_disable_csp(struct mcap_instance *mi);
 uint64_t mcap_get_timestamp(struct mcap_mcl *mcl,
 				struct timespec *given_time);
 uint32_t mcap_get_btclock(struct mcap_mcl *mcl);
+gboolean mcap_sync_get_stats(struct mcap_mcl *mcl,
+					struct mcap_sync_stats *stats);
 
 void mcap_sync_cap_req(struct mcap_mcl *mcl,
 			uint16_t reqacc,
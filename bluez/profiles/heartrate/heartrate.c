@@ -37,6 +37,7 @@
 #include "src/plugin.h"
 #include "src/adapter.h"
 #include "src/dbus-common.h"
+#include "src/batch.h"
 #include "src/device.h"
 #include "src/profile.h"
 #include "src/shared/util.h"
@@ -85,6 +86,7 @@ struct watcher {
 	guint				id;
 	char				*srv;
 	char				*path;
+	struct batch_watcher		*batch;
 };
 
 struct measurement {
@@ -170,6 +172,7 @@ static void destroy_watcher(gpointer user_data)
 {
 	struct watcher *watcher = user_data;
 
+	batch_watcher_free(watcher->batch);
 	g_free(watcher->path);
 	g_free(watcher->srv);
 	g_free(watcher);
@@ -266,6 +269,25 @@ static void char_write_cb(guint8 status, const guint8 *pdu, guint16 len,
 	g_free(msg);
 }
 
+static void append_measurement(DBusMessageIter *dict, void *user_data)
+{
+	struct measurement *m = user_data;
+
+	dict_append_entry(dict, "Value", DBUS_TYPE_UINT16, &m->value);
+
+	if (m->has_energy)
+		dict_append_entry(dict, "Energy", DBUS_TYPE_UINT16,
+								&m->energy);
+
+	if (m->has_contact)
+		dict_append_entry(dict, "Contact", DBUS_TYPE_BOOLEAN,
+								&m->contact);
+
+	if (m->num_interval > 0)
+		dict_append_array(dict, "Interval", DBUS_TYPE_UINT16,
+						&m->interval, m->num_interval);
+}
+
 static void update_watcher(gpointer data, gpointer user_data)
 {
 	struct watcher *w = data;
@@ -276,6 +298,11 @@ static void update_watcher(gpointer data, gpointer user_data)
 	DBusMessageIter dict;
 	DBusMessage *msg;
 
+	if (w->batch != NULL) {
+		batch_watcher_queue(w->batch, path, append_measurement, m);
+		return;
+	}
+
 	msg = dbus_message_new_method_call(w->srv, w->path,
 			HEART_RATE_WATCHER_INTERFACE, "MeasurementReceived");
 	if (msg == NULL)
@@ -290,19 +317,7 @@ static void update_watcher(gpointer data, gpointer user_data)
 			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
 			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
 
-	dict_append_entry(&dict, "Value", DBUS_TYPE_UINT16, &m->value);
-
-	if (m->has_energy)
-		dict_append_entry(&dict, "Energy", DBUS_TYPE_UINT16,
-								&m->energy);
-
-	if (m->has_contact)
-		dict_append_entry(&dict, "Contact", DBUS_TYPE_BOOLEAN,
-								&m->contact);
-
-	if (m->num_interval > 0)
-		dict_append_array(&dict, "Interval", DBUS_TYPE_UINT16,
-						&m->interval, m->num_interval);
+	append_measurement(&dict, m);
 
 	dbus_message_iter_close_container(&iter, &dict);
 
@@ -559,17 +574,12 @@ static void watcher_exit_cb(DBusConnection *conn, void *user_data)
 		g_slist_foreach(hradapter->devices, disable_measurement, 0);
 }
 
-static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
-								void *data)
+static DBusMessage *add_watcher(DBusConnection *conn, DBusMessage *msg,
+					struct heartrate_adapter *hradapter,
+					const char *path, uint16_t interval)
 {
-	struct heartrate_adapter *hradapter = data;
 	struct watcher *watcher;
 	const char *sender = dbus_message_get_sender(msg);
-	char *path;
-
-	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
-							DBUS_TYPE_INVALID))
-		return btd_error_invalid_args(msg);
 
 	watcher = find_watcher(hradapter->watchers, sender, path);
 	if (watcher != NULL)
@@ -582,6 +592,11 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	watcher->srv = g_strdup(sender);
 	watcher->path = g_strdup(path);
 
+	if (interval > 0)
+		watcher->batch = batch_watcher_new(sender, path,
+						HEART_RATE_WATCHER_INTERFACE,
+						interval);
+
 	if (g_slist_length(hradapter->watchers) == 0)
 		g_slist_foreach(hradapter->devices, enable_measurement, 0);
 
@@ -592,6 +607,37 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	return dbus_message_new_method_return(msg);
 }
 
+static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
+								void *data)
+{
+	struct heartrate_adapter *hradapter = data;
+	char *path;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
+							DBUS_TYPE_INVALID))
+		return btd_error_invalid_args(msg);
+
+	return add_watcher(conn, msg, hradapter, path, 0);
+}
+
+static DBusMessage *register_batch_watcher(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	struct heartrate_adapter *hradapter = data;
+	uint16_t interval;
+	char *path;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
+						DBUS_TYPE_UINT16, &interval,
+						DBUS_TYPE_INVALID))
+		return btd_error_invalid_args(msg);
+
+	if (interval == 0)
+		return btd_error_invalid_args(msg);
+
+	return add_watcher(conn, msg, hradapter, path, interval);
+}
+
 static DBusMessage *unregister_watcher(DBusConnection *conn, DBusMessage *msg,
 								void *data)
 {
@@ -626,6 +672,9 @@ static const GDBusMethodTable heartrate_manager_methods[] = {
 	{ GDBUS_METHOD("UnregisterWatcher",
 			GDBUS_ARGS({ "agent", "o" }), NULL,
 			unregister_watcher) },
+	{ GDBUS_EXPERIMENTAL_METHOD("RegisterBatchWatcher",
+			GDBUS_ARGS({ "agent", "o" }, { "interval", "q" }),
+			NULL, register_batch_watcher) },
 	{ }
 };
 
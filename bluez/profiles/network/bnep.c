@@ -26,6 +26,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdbool.h>
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -48,11 +49,14 @@
 #include "btio/btio.h"
 
 #include "bnep.h"
+#include "tap.h"
 
 #define CON_SETUP_RETRIES      3
 #define CON_SETUP_TO           9
 
-static int ctl;
+static int ctl = -1;
+static bool userspace;
+static GSList *taps;
 
 struct __service_16 {
 	uint16_t dst;
@@ -74,12 +78,29 @@ struct bnep {
 	void	*disconn_data;
 };
 
-int bnep_init(void)
+int bnep_init(bool use_tap)
 {
+	if (use_tap) {
+		if (!bnep_tap_supported()) {
+			error("bnep: userspace data path needs TUN/TAP support");
+			return -ENOSYS;
+		}
+
+		userspace = true;
+		return 0;
+	}
+
 	ctl = socket(PF_BLUETOOTH, SOCK_RAW, BTPROTO_BNEP);
 	if (ctl < 0) {
 		int err = -errno;
 
+		if (err == -EPROTONOSUPPORT && bnep_tap_supported()) {
+			info("bnep: kernel lacks bnep-protocol support, "
+						"using userspace data path");
+			userspace = true;
+			return 0;
+		}
+
 		if (err == -EPROTONOSUPPORT)
 			warn("kernel lacks bnep-protocol support");
 		else
@@ -94,14 +115,64 @@ int bnep_init(void)
 
 int bnep_cleanup(void)
 {
-	close(ctl);
+	g_slist_free_full(taps, (GDestroyNotify) bnep_tap_free);
+	taps = NULL;
+
+	if (ctl >= 0)
+		close(ctl);
+
+	ctl = -1;
+
+	return 0;
+}
+
+static int tap_cmp(gconstpointer a, gconstpointer b)
+{
+	struct bnep_tap *tap = (struct bnep_tap *) a;
+	const char *iface = b;
+
+	return strcmp(bnep_tap_get_iface(tap), iface);
+}
+
+static void tap_disconnected(struct bnep_tap *tap, void *data)
+{
+	taps = g_slist_remove(taps, tap);
+	bnep_tap_free(tap);
+}
+
+static int bnep_tap_add(int sk, char *dev)
+{
+	struct bnep_tap *tap;
+
+	tap = bnep_tap_new(sk, dev, tap_disconnected, NULL);
+	if (!tap)
+		return -EIO;
+
+	taps = g_slist_prepend(taps, tap);
+
 	return 0;
 }
 
-static int bnep_conndel(const bdaddr_t *dst)
+static void bnep_tap_del(const char *dev)
+{
+	GSList *l;
+
+	l = g_slist_find_custom(taps, dev, tap_cmp);
+	if (!l)
+		return;
+
+	tap_disconnected(l->data, NULL);
+}
+
+static int bnep_conndel(const char *dev, const bdaddr_t *dst)
 {
 	struct bnep_conndel_req req;
 
+	if (userspace) {
+		bnep_tap_del(dev);
+		return 0;
+	}
+
 	memset(&req, 0, sizeof(req));
 	baswap((bdaddr_t *)&req.dst, dst);
 	req.flags = 0;
@@ -118,6 +189,9 @@ static int bnep_connadd(int sk, uint16_t role, char *dev)
 {
 	struct bnep_connadd_req req;
 
+	if (userspace)
+		return bnep_tap_add(sk, dev);
+
 	memset(&req, 0, sizeof(req));
 	strncpy(req.device, dev, 16);
 	req.device[15] = '\0';
@@ -274,7 +348,7 @@ static gboolean bnep_setup_cb(GIOChannel *chan, GIOCondition cond,
 		goto failed;
 
 	if (bnep_if_up(session->iface) < 0) {
-		bnep_conndel(&session->dst_addr);
+		bnep_conndel(session->iface, &session->dst_addr);
 		goto failed;
 	}
 
@@ -431,7 +505,7 @@ void bnep_disconnect(struct bnep *session)
 	}
 
 	bnep_if_down(session->iface);
-	bnep_conndel(&session->dst_addr);
+	bnep_conndel(session->iface, &session->dst_addr);
 }
 
 static int bnep_add_to_bridge(const char *devname, const char *bridge)
@@ -624,7 +698,7 @@ static int bnep_server_add_legacy(int sk, uint16_t dst, char *bridge,
 
 	err = bnep_add_to_bridge(iface, bridge);
 	if (err < 0) {
-		bnep_conndel(addr);
+		bnep_conndel(iface, addr);
 		rsp = BNEP_CONN_NOT_ALLOWED;
 		goto reply;
 	}
@@ -632,7 +706,7 @@ static int bnep_server_add_legacy(int sk, uint16_t dst, char *bridge,
 	err = bnep_if_up(iface);
 	if (err < 0) {
 		bnep_del_from_bridge(iface, bridge);
-		bnep_conndel(addr);
+		bnep_conndel(iface, addr);
 		rsp = BNEP_CONN_NOT_ALLOWED;
 		goto reply;
 	}
@@ -680,7 +754,8 @@ int bnep_server_add(int sk, char *bridge, char *iface, const bdaddr_t *addr,
 		goto failed;
 	}
 
-	feat = bnep_getsuppfeat();
+	/* The userspace data path answers the setup request like old kernels */
+	feat = userspace ? 0 : bnep_getsuppfeat();
 
 	/*
 	 * Take out setup data if kernel doesn't support handling it, especially
@@ -711,7 +786,7 @@ failed_bridge:
 	bnep_del_from_bridge(iface, bridge);
 
 failed_conn:
-	bnep_conndel(addr);
+	bnep_conndel(iface, addr);
 
 	return err;
 
@@ -732,5 +807,5 @@ void bnep_server_delete(char *bridge, char *iface, const bdaddr_t *addr)
 
 	bnep_del_from_bridge(iface, bridge);
 	bnep_if_down(iface);
-	bnep_conndel(addr);
+	bnep_conndel(iface, addr);
 }
@@ -23,7 +23,7 @@
 
 struct bnep;
 
-int bnep_init(void);
+int bnep_init(bool use_tap);
 int bnep_cleanup(void);
 
 struct bnep *bnep_new(int sk, uint16_t local_role, uint16_t remote_role,
@@ -0,0 +1,762 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2015  PDi Communication Systems, Inc.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <linux/if_tun.h>
+
+#include <glib.h>
+
+#include "lib/bluetooth.h"
+#include "lib/l2cap.h"
+#include "lib/bnep.h"
+
+#include "src/log.h"
+#include "src/shared/util.h"
+
+#include "tap.h"
+
+#define TUN_DEVICE		"/dev/net/tun"
+
+#define ETH_HDR_LEN		14
+
+/* Frames moved per recvmmsg()/sendmmsg() call */
+#define TAP_BATCH		16
+
+/*
+ * Received BNEP packets are stored after ETH_HDR_LEN bytes of headroom so
+ * the Ethernet header can be rebuilt in front of the payload in place.
+ * Frames read from the TAP device get one byte of headroom, which is
+ * what the uncompressed BNEP header needs on top of the Ethernet header.
+ */
+#define TAP_RX_HEADROOM		ETH_HDR_LEN
+#define TAP_TX_HEADROOM		1
+#define TAP_BUF_SIZE		(TAP_RX_HEADROOM + BNEP_MTU)
+
+/* Same limits as the kernel BNEP implementation */
+#define TAP_MAX_PROTO_FILTERS	5
+#define TAP_MAX_MCAST_FILTERS	20
+
+#define BNEP_EXT_CONTROL	0x00
+
+struct proto_filter {
+	uint16_t start;
+	uint16_t end;
+};
+
+struct mcast_filter {
+	uint8_t start[ETH_ALEN];
+	uint8_t end[ETH_ALEN];
+};
+
+struct bnep_tap {
+	char iface[16];
+	int sk;
+	int fd;
+	uint8_t local[ETH_ALEN];
+	uint8_t remote[ETH_ALEN];
+	guint sk_watch;
+	guint tap_watch;
+	guint out_watch;
+	bnep_tap_disconnect_cb disconn_cb;
+	void *disconn_data;
+	struct proto_filter proto[TAP_MAX_PROTO_FILTERS];
+	unsigned int proto_count;
+	struct mcast_filter mcast[TAP_MAX_MCAST_FILTERS];
+	unsigned int mcast_count;
+	struct mmsghdr rx_msg[TAP_BATCH];
+	struct iovec rx_iov[TAP_BATCH];
+	uint8_t rx_buf[TAP_BATCH][TAP_BUF_SIZE];
+	struct mmsghdr tx_msg[TAP_BATCH];
+	struct iovec tx_iov[TAP_BATCH];
+	uint8_t tx_buf[TAP_BATCH][TAP_BUF_SIZE];
+	unsigned int tx_head;
+	unsigned int tx_count;
+	struct bnep_tap_stats stats;
+};
+
+static gboolean tap_read_cb(GIOChannel *chan, GIOCondition cond,
+							gpointer user_data);
+
+bool bnep_tap_supported(void)
+{
+	return access(TUN_DEVICE, R_OK | W_OK) == 0;
+}
+
+static guint add_watch(int fd, GIOCondition cond, GIOFunc func,
+							gpointer user_data)
+{
+	GIOChannel *io;
+	guint id;
+
+	io = g_io_channel_unix_new(fd);
+	id = g_io_add_watch(io, cond, func, user_data);
+	g_io_channel_unref(io);
+
+	return id;
+}
+
+static void tap_disconnect(struct bnep_tap *tap)
+{
+	if (tap->disconn_cb)
+		tap->disconn_cb(tap, tap->disconn_data);
+}
+
+static void tap_send_rsp(struct bnep_tap *tap, uint8_t ctrl, uint16_t resp)
+{
+	struct bnep_control_rsp rsp;
+	struct bnep_ctrl_cmd_not_understood_cmd nu;
+	ssize_t ret;
+
+	if (ctrl == BNEP_CMD_NOT_UNDERSTOOD) {
+		nu.type = BNEP_CONTROL;
+		nu.ctrl = ctrl;
+		nu.unkn_ctrl = resp;
+		ret = send(tap->sk, &nu, sizeof(nu), MSG_DONTWAIT);
+	} else {
+		rsp.type = BNEP_CONTROL;
+		rsp.ctrl = ctrl;
+		rsp.resp = htons(resp);
+		ret = send(tap->sk, &rsp, sizeof(rsp), MSG_DONTWAIT);
+	}
+
+	if (ret < 0)
+		error("bnep: %s: control response failed: %s (%d)",
+					tap->iface, strerror(errno), errno);
+}
+
+static uint16_t set_proto_filter(struct bnep_tap *tap, const uint8_t *list,
+								uint16_t len)
+{
+	unsigned int i, count = len / 4;
+
+	if (len % 4)
+		return BNEP_FILTER_INVALID_RANGE;
+
+	if (count > TAP_MAX_PROTO_FILTERS)
+		return BNEP_FILTER_LIMIT_REACHED;
+
+	for (i = 0; i < count; i++) {
+		uint16_t start = get_be16(list + i * 4);
+		uint16_t end = get_be16(list + i * 4 + 2);
+
+		if (start > end)
+			return BNEP_FILTER_INVALID_RANGE;
+
+		tap->proto[i].start = start;
+		tap->proto[i].end = end;
+	}
+
+	tap->proto_count = count;
+
+	DBG("%s: %u protocol filters", tap->iface, count);
+
+	return BNEP_SUCCESS;
+}
+
+static uint16_t set_mcast_filter(struct bnep_tap *tap, const uint8_t *list,
+								uint16_t len)
+{
+	unsigned int i, count = len / (ETH_ALEN * 2);
+
+	if (len % (ETH_ALEN * 2))
+		return BNEP_FILTER_INVALID_MCADDR;
+
+	if (count > TAP_MAX_MCAST_FILTERS)
+		return BNEP_FILTER_LIMIT_REACHED;
+
+	for (i = 0; i < count; i++) {
+		const uint8_t *start = list + i * ETH_ALEN * 2;
+		const uint8_t *end = start + ETH_ALEN;
+
+		if (memcmp(start, end, ETH_ALEN) > 0)
+			return BNEP_FILTER_INVALID_MCADDR;
+
+		memcpy(tap->mcast[i].start, start, ETH_ALEN);
+		memcpy(tap->mcast[i].end, end, ETH_ALEN);
+	}
+
+	tap->mcast_count = count;
+
+	DBG("%s: %u multicast filters", tap->iface, count);
+
+	return BNEP_SUCCESS;
+}
+
+/* Returns the number of bytes consumed, or -1 if the packet is malformed */
+static ssize_t tap_rx_control(struct bnep_tap *tap, const uint8_t *data,
+								size_t len)
+{
+	uint16_t list_len, resp;
+
+	if (len < 1)
+		return -1;
+
+	switch (data[0]) {
+	case BNEP_CMD_NOT_UNDERSTOOD:
+		return len < 2 ? -1 : 2;
+	case BNEP_SETUP_CONN_RSP:
+	case BNEP_FILTER_NET_TYPE_RSP:
+	case BNEP_FILTER_MULT_ADDR_RSP:
+		return len < 3 ? -1 : 3;
+	case BNEP_SETUP_CONN_REQ:
+		/* Setup was completed before the data path started */
+		if (len < 2 || len < 2 + (size_t) data[1] * 2)
+			return -1;
+
+		tap_send_rsp(tap, BNEP_SETUP_CONN_RSP, BNEP_CONN_NOT_ALLOWED);
+		return 2 + data[1] * 2;
+	case BNEP_FILTER_NET_TYPE_SET:
+	case BNEP_FILTER_MULT_ADDR_SET:
+		if (len < 3)
+			return -1;
+
+		list_len = get_be16(data + 1);
+		if (len < 3 + (size_t) list_len)
+			return -1;
+
+		if (data[0] == BNEP_FILTER_NET_TYPE_SET) {
+			resp = set_proto_filter(tap, data + 3, list_len);
+			tap_send_rsp(tap, BNEP_FILTER_NET_TYPE_RSP, resp);
+		} else {
+			resp = set_mcast_filter(tap, data + 3, list_len);
+			tap_send_rsp(tap, BNEP_FILTER_MULT_ADDR_RSP, resp);
+		}
+
+		return 3 + list_len;
+	default:
+		tap_send_rsp(tap, BNEP_CMD_NOT_UNDERSTOOD, data[0]);
+		return len;
+	}
+}
+
+/* Skips extension headers, returns the start of the payload or NULL */
+static uint8_t *tap_rx_extensions(struct bnep_tap *tap, uint8_t *data,
+							const uint8_t *end)
+{
+	uint8_t type;
+
+	do {
+		if (end - data < 2 || end - data < 2 + data[1])
+			return NULL;
+
+		type = data[0];
+
+		if ((type & BNEP_TYPE_MASK) == BNEP_EXT_CONTROL)
+			tap_rx_control(tap, data + 2, data[1]);
+
+		data += 2 + data[1];
+	} while (type & BNEP_EXT_HEADER);
+
+	return data;
+}
+
+static bool tap_rx_frame(struct bnep_tap *tap, uint8_t *buf, size_t len)
+{
+	uint8_t *data = buf + TAP_RX_HEADROOM;
+	uint8_t *end = data + len;
+	uint8_t dst[ETH_ALEN], src[ETH_ALEN];
+	uint8_t *payload, *eth;
+	size_t hlen;
+	ssize_t ret;
+
+	if (len < 1)
+		return false;
+
+	switch (data[0] & BNEP_TYPE_MASK) {
+	case BNEP_CONTROL:
+		ret = tap_rx_control(tap, data + 1, len - 1);
+		if (ret < 0)
+			return false;
+
+		if (data[0] & BNEP_EXT_HEADER)
+			tap_rx_extensions(tap, data + 1 + ret, end);
+
+		return true;
+	case BNEP_GENERAL:
+		hlen = 1 + ETH_ALEN * 2 + 2;
+		if (len < hlen)
+			return false;
+
+		memcpy(dst, data + 1, ETH_ALEN);
+		memcpy(src, data + 1 + ETH_ALEN, ETH_ALEN);
+		break;
+	case BNEP_COMPRESSED:
+		hlen = 1 + 2;
+		if (len < hlen)
+			return false;
+
+		memcpy(dst, tap->local, ETH_ALEN);
+		memcpy(src, tap->remote, ETH_ALEN);
+		break;
+	case BNEP_COMPRESSED_SRC_ONLY:
+		hlen = 1 + ETH_ALEN + 2;
+		if (len < hlen)
+			return false;
+
+		memcpy(dst, tap->local, ETH_ALEN);
+		memcpy(src, data + 1, ETH_ALEN);
+		break;
+	case BNEP_COMPRESSED_DST_ONLY:
+		hlen = 1 + ETH_ALEN + 2;
+		if (len < hlen)
+			return false;
+
+		memcpy(dst, data + 1, ETH_ALEN);
+		memcpy(src, tap->remote, ETH_ALEN);
+		break;
+	default:
+		return false;
+	}
+
+	payload = data + hlen;
+
+	if (data[0] & BNEP_EXT_HEADER) {
+		payload = tap_rx_extensions(tap, payload, end);
+		if (!payload)
+			return false;
+	}
+
+	/*
+	 * The protocol type is the last field of every header variant, copy
+	 * it first since the Ethernet header may overlap the BNEP header.
+	 */
+	eth = payload - ETH_HDR_LEN;
+	memmove(eth + ETH_ALEN * 2, data + hlen - 2, 2);
+	memcpy(eth, dst, ETH_ALEN);
+	memcpy(eth + ETH_ALEN, src, ETH_ALEN);
+
+	ret = write(tap->fd, eth, end - eth);
+	if (ret < 0)
+		return false;
+
+	tap->stats.rx_packets++;
+	tap->stats.rx_bytes += ret;
+
+	return true;
+}
+
+static gboolean tap_sk_cb(GIOChannel *chan, GIOCondition cond,
+							gpointer user_data)
+{
+	struct bnep_tap *tap = user_data;
+	int i, n;
+
+	if (cond & (G_IO_HUP | G_IO_ERR | G_IO_NVAL))
+		goto disconnect;
+
+	n = recvmmsg(tap->sk, tap->rx_msg, TAP_BATCH, MSG_DONTWAIT, NULL);
+	if (n < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return TRUE;
+
+		error("bnep: %s: recvmmsg: %s (%d)", tap->iface,
+							strerror(errno), errno);
+		goto disconnect;
+	}
+
+	if (n == 0)
+		goto disconnect;
+
+	tap->stats.rx_batches++;
+
+	for (i = 0; i < n; i++) {
+		if (!tap_rx_frame(tap, tap->rx_buf[i], tap->rx_msg[i].msg_len))
+			tap->stats.rx_dropped++;
+	}
+
+	return TRUE;
+
+disconnect:
+	tap->sk_watch = 0;
+	tap_disconnect(tap);
+
+	return FALSE;
+}
+
+static bool tap_tx_allowed(struct bnep_tap *tap, const uint8_t *eth)
+{
+	uint16_t proto = get_be16(eth + ETH_ALEN * 2);
+	unsigned int i;
+
+	if (tap->proto_count) {
+		for (i = 0; i < tap->proto_count; i++) {
+			if (proto >= tap->proto[i].start &&
+						proto <= tap->proto[i].end)
+				break;
+		}
+
+		if (i == tap->proto_count)
+			return false;
+	}
+
+	/* Multicast filters only apply to group addresses */
+	if (!tap->mcast_count || !(eth[0] & 0x01))
+		return true;
+
+	for (i = 0; i < tap->mcast_count; i++) {
+		if (memcmp(eth, tap->mcast[i].start, ETH_ALEN) >= 0 &&
+				memcmp(eth, tap->mcast[i].end, ETH_ALEN) <= 0)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Turns the Ethernet header in front of the payload into the smallest BNEP
+ * header that describes it and returns where the packet now starts.
+ */
+static uint8_t *tap_tx_compress(struct bnep_tap *tap, uint8_t *eth)
+{
+	bool dst_remote = !memcmp(eth, tap->remote, ETH_ALEN);
+	bool src_local = !memcmp(eth + ETH_ALEN, tap->local, ETH_ALEN);
+	uint8_t *hdr;
+
+	if (dst_remote && src_local) {
+		hdr = eth + ETH_ALEN * 2 - 1;
+		hdr[0] = BNEP_COMPRESSED;
+	} else if (src_local) {
+		memmove(eth + ETH_ALEN, eth, ETH_ALEN);
+		hdr = eth + ETH_ALEN - 1;
+		hdr[0] = BNEP_COMPRESSED_DST_ONLY;
+	} else if (dst_remote) {
+		hdr = eth + ETH_ALEN - 1;
+		hdr[0] = BNEP_COMPRESSED_SRC_ONLY;
+	} else {
+		hdr = eth - 1;
+		hdr[0] = BNEP_GENERAL;
+		return hdr;
+	}
+
+	tap->stats.tx_compressed++;
+
+	return hdr;
+}
+
+/* Returns false if the socket can't take more data right now */
+static bool tap_flush(struct bnep_tap *tap)
+{
+	unsigned int i;
+	int n;
+
+	while (tap->tx_head < tap->tx_count) {
+		n = sendmmsg(tap->sk, tap->tx_msg + tap->tx_head,
+					tap->tx_count - tap->tx_head,
+					MSG_DONTWAIT);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return false;
+
+			if (errno == EINTR)
+				continue;
+
+			error("bnep: %s: sendmmsg: %s (%d)", tap->iface,
+							strerror(errno), errno);
+			tap->stats.tx_dropped += tap->tx_count - tap->tx_head;
+			break;
+		}
+
+		tap->stats.tx_batches++;
+
+		for (i = tap->tx_head; i < tap->tx_head + n; i++) {
+			tap->stats.tx_packets++;
+			tap->stats.tx_bytes += tap->tx_msg[i].msg_len;
+		}
+
+		tap->tx_head += n;
+	}
+
+	tap->tx_head = 0;
+	tap->tx_count = 0;
+
+	return true;
+}
+
+static gboolean tap_write_cb(GIOChannel *chan, GIOCondition cond,
+							gpointer user_data)
+{
+	struct bnep_tap *tap = user_data;
+
+	if (cond & (G_IO_HUP | G_IO_ERR | G_IO_NVAL)) {
+		tap->out_watch = 0;
+		return FALSE;
+	}
+
+	if (!tap_flush(tap))
+		return TRUE;
+
+	tap->out_watch = 0;
+	tap->tap_watch = add_watch(tap->fd, G_IO_IN, tap_read_cb, tap);
+
+	return FALSE;
+}
+
+static gboolean tap_read_cb(GIOChannel *chan, GIOCondition cond,
+							gpointer user_data)
+{
+	struct bnep_tap *tap = user_data;
+
+	if (cond & (G_IO_HUP | G_IO_ERR | G_IO_NVAL)) {
+		tap->tap_watch = 0;
+		return FALSE;
+	}
+
+	while (tap->tx_count < TAP_BATCH) {
+		uint8_t *buf = tap->tx_buf[tap->tx_count];
+		uint8_t *eth = buf + TAP_TX_HEADROOM;
+		uint8_t *hdr;
+		ssize_t len;
+
+		len = read(tap->fd, eth, TAP_BUF_SIZE - TAP_TX_HEADROOM);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		if (len < ETH_HDR_LEN) {
+			tap->stats.tx_dropped++;
+			continue;
+		}
+
+		if (!tap_tx_allowed(tap, eth)) {
+			tap->stats.tx_filtered++;
+			continue;
+		}
+
+		hdr = tap_tx_compress(tap, eth);
+
+		tap->tx_iov[tap->tx_count].iov_base = hdr;
+		tap->tx_iov[tap->tx_count].iov_len = eth + len - hdr;
+		tap->tx_count++;
+	}
+
+	if (tap_flush(tap))
+		return TRUE;
+
+	/* Stop reading from the interface until the socket drains */
+	tap->tap_watch = 0;
+	tap->out_watch = add_watch(tap->sk, G_IO_OUT | G_IO_ERR | G_IO_HUP,
+							tap_write_cb, tap);
+
+	return FALSE;
+}
+
+static int tap_open(char *iface)
+{
+	struct ifreq ifr;
+	int fd, err;
+
+	fd = open(TUN_DEVICE, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		err = -errno;
+		error("bnep: Failed to open %s: %s (%d)", TUN_DEVICE,
+							strerror(-err), -err);
+		return err;
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	strncpy(ifr.ifr_name, iface, IFNAMSIZ - 1);
+
+	if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+		err = -errno;
+		error("bnep: Failed to create TAP device %s: %s (%d)",
+						iface, strerror(-err), -err);
+		close(fd);
+		return err;
+	}
+
+	strncpy(iface, ifr.ifr_name, 16);
+	iface[15] = '\0';
+
+	return fd;
+}
+
+static int tap_set_hwaddr(const char *iface, const uint8_t *addr)
+{
+	struct ifreq ifr;
+	int sk, err = 0;
+
+	sk = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (sk < 0)
+		return -errno;
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, iface, IFNAMSIZ - 1);
+	ifr.ifr_hwaddr.sa_family = ARPHRD_ETHER;
+	memcpy(ifr.ifr_hwaddr.sa_data, addr, ETH_ALEN);
+
+	if (ioctl(sk, SIOCSIFHWADDR, &ifr) < 0) {
+		err = -errno;
+		error("bnep: Failed to set address of %s: %s (%d)",
+						iface, strerror(-err), -err);
+	}
+
+	close(sk);
+
+	return err;
+}
+
+static int tap_get_addrs(struct bnep_tap *tap, int sk)
+{
+	struct sockaddr_l2 addr;
+	socklen_t len;
+
+	/* Ethernet addresses are the byte-swapped Bluetooth addresses */
+	len = sizeof(addr);
+	if (getsockname(sk, (struct sockaddr *) &addr, &len) < 0)
+		return -errno;
+
+	baswap((bdaddr_t *) tap->local, &addr.l2_bdaddr);
+
+	len = sizeof(addr);
+	if (getpeername(sk, (struct sockaddr *) &addr, &len) < 0)
+		return -errno;
+
+	baswap((bdaddr_t *) tap->remote, &addr.l2_bdaddr);
+
+	return 0;
+}
+
+static void tap_init_msgs(struct bnep_tap *tap)
+{
+	unsigned int i;
+
+	for (i = 0; i < TAP_BATCH; i++) {
+		tap->rx_iov[i].iov_base = tap->rx_buf[i] + TAP_RX_HEADROOM;
+		tap->rx_iov[i].iov_len = BNEP_MTU;
+		tap->rx_msg[i].msg_hdr.msg_iov = &tap->rx_iov[i];
+		tap->rx_msg[i].msg_hdr.msg_iovlen = 1;
+
+		tap->tx_msg[i].msg_hdr.msg_iov = &tap->tx_iov[i];
+		tap->tx_msg[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+struct bnep_tap *bnep_tap_new(int sk, char *iface,
+				bnep_tap_disconnect_cb disconn_cb, void *data)
+{
+	struct bnep_tap *tap;
+	int err;
+
+	tap = g_new0(struct bnep_tap, 1);
+	tap->fd = -1;
+	tap->disconn_cb = disconn_cb;
+	tap->disconn_data = data;
+
+	err = tap_get_addrs(tap, sk);
+	if (err < 0) {
+		error("bnep: Failed to get L2CAP addresses: %s (%d)",
+							strerror(-err), -err);
+		g_free(tap);
+		return NULL;
+	}
+
+	tap->sk = dup(sk);
+	if (tap->sk < 0) {
+		g_free(tap);
+		return NULL;
+	}
+
+	tap->fd = tap_open(iface);
+	if (tap->fd < 0)
+		goto failed;
+
+	strncpy(tap->iface, iface, sizeof(tap->iface));
+
+	if (tap_set_hwaddr(tap->iface, tap->local) < 0)
+		goto failed;
+
+	tap_init_msgs(tap);
+
+	tap->sk_watch = add_watch(tap->sk, G_IO_IN | G_IO_HUP | G_IO_ERR |
+						G_IO_NVAL, tap_sk_cb, tap);
+	tap->tap_watch = add_watch(tap->fd, G_IO_IN, tap_read_cb, tap);
+
+	DBG("%s: userspace data path started", tap->iface);
+
+	return tap;
+
+failed:
+	bnep_tap_free(tap);
+	return NULL;
+}
+
+void bnep_tap_free(struct bnep_tap *tap)
+{
+	const struct bnep_tap_stats *s;
+
+	if (!tap)
+		return;
+
+	if (tap->sk_watch > 0)
+		g_source_remove(tap->sk_watch);
+
+	if (tap->tap_watch > 0)
+		g_source_remove(tap->tap_watch);
+
+	if (tap->out_watch > 0)
+		g_source_remove(tap->out_watch);
+
+	s = &tap->stats;
+
+	DBG("%s: rx %" PRIu64 " packets %" PRIu64 " bytes %" PRIu64
+		" dropped %" PRIu64 " batches, tx %" PRIu64 " packets %"
+		PRIu64 " bytes %" PRIu64 " dropped %" PRIu64 " filtered %"
+		PRIu64 " compressed %" PRIu64 " batches", tap->iface,
+		s->rx_packets, s->rx_bytes, s->rx_dropped, s->rx_batches,
+		s->tx_packets, s->tx_bytes, s->tx_dropped, s->tx_filtered,
+		s->tx_compressed, s->tx_batches);
+
+	if (tap->fd >= 0)
+		close(tap->fd);
+
+	close(tap->sk);
+
+	g_free(tap);
+}
+
+const char *bnep_tap_get_iface(struct bnep_tap *tap)
+{
+	return tap->iface;
+}
+
+const struct bnep_tap_stats *bnep_tap_get_stats(struct bnep_tap *tap)
+{
+	return &tap->stats;
+}
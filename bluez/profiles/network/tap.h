@@ -0,0 +1,48 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2015  PDi Communication Systems, Inc.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+struct bnep_tap;
+
+struct bnep_tap_stats {
+	uint64_t rx_packets;
+	uint64_t rx_bytes;
+	uint64_t rx_dropped;
+	uint64_t rx_batches;
+	uint64_t tx_packets;
+	uint64_t tx_bytes;
+	uint64_t tx_dropped;
+	uint64_t tx_filtered;
+	uint64_t tx_compressed;
+	uint64_t tx_batches;
+};
+
+typedef void (*bnep_tap_disconnect_cb) (struct bnep_tap *tap, void *data);
+
+bool bnep_tap_supported(void);
+
+struct bnep_tap *bnep_tap_new(int sk, char *iface,
+				bnep_tap_disconnect_cb disconn_cb, void *data);
+void bnep_tap_free(struct bnep_tap *tap);
+
+const char *bnep_tap_get_iface(struct bnep_tap *tap);
+const struct bnep_tap_stats *bnep_tap_get_stats(struct bnep_tap *tap);
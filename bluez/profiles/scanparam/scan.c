@@ -48,8 +48,6 @@
 #define SCAN_INTERVAL_WIN_UUID		0x2A4F
 #define SCAN_REFRESH_UUID		0x2A31
 
-#define SCAN_INTERVAL		0x0060
-#define SCAN_WINDOW		0x0030
 #define SERVER_REQUIRES_REFRESH	0x00
 
 struct scan {
@@ -64,14 +62,19 @@ struct scan {
 	guint refresh_cb_id;
 };
 
-static void write_scan_params(GAttrib *attrib, uint16_t handle)
+static void write_scan_params(struct scan *scan)
 {
+	struct btd_adapter *adapter = device_get_adapter(scan->device);
 	uint8_t value[4];
 
-	put_le16(SCAN_INTERVAL, &value[0]);
-	put_le16(SCAN_WINDOW, &value[2]);
+	/* Report the parameters the adapter really uses to reconnect */
+	btd_adapter_get_scan_params(adapter, &scan->interval, &scan->window);
 
-	gatt_write_cmd(attrib, handle, value, sizeof(value), NULL, NULL);
+	put_le16(scan->interval, &value[0]);
+	put_le16(scan->window, &value[2]);
+
+	gatt_write_cmd(scan->attrib, scan->iwhandle, value, sizeof(value),
+								NULL, NULL);
 }
 
 static void refresh_value_cb(const uint8_t *pdu, uint16_t len,
@@ -82,7 +85,7 @@ static void refresh_value_cb(const uint8_t *pdu, uint16_t len,
 	DBG("Server requires refresh: %d", pdu[3]);
 
 	if (pdu[3] == SERVER_REQUIRES_REFRESH)
-		write_scan_params(scan->attrib, scan->iwhandle);
+		write_scan_params(scan);
 }
 
 static void ccc_written_cb(guint8 status, const guint8 *pdu,
@@ -175,7 +178,7 @@ static void iwin_discovered_cb(uint8_t status, GSList *chars, void *user_data)
 
 	DBG("Scan Interval Window handle: 0x%04x", scan->iwhandle);
 
-	write_scan_params(scan->attrib, scan->iwhandle);
+	write_scan_params(scan);
 }
 
 static void attio_connected_cb(GAttrib *attrib, gpointer user_data)
@@ -186,7 +189,7 @@ static void attio_connected_cb(GAttrib *attrib, gpointer user_data)
 	scan->attrib = g_attrib_ref(attrib);
 
 	if (scan->iwhandle) {
-		write_scan_params(scan->attrib, scan->iwhandle);
+		write_scan_params(scan);
 		return;
 	}
 
@@ -35,6 +35,7 @@
 
 #include "src/plugin.h"
 #include "src/dbus-common.h"
+#include "src/batch.h"
 #include "src/adapter.h"
 #include "src/device.h"
 #include "src/profile.h"
@@ -104,6 +105,7 @@ struct watcher {
 	guint				id;
 	char				*srv;
 	char				*path;
+	struct batch_watcher		*batch;
 };
 
 struct measurement {
@@ -150,6 +152,7 @@ static void destroy_watcher(gpointer user_data)
 {
 	struct watcher *watcher = user_data;
 
+	batch_watcher_free(watcher->batch);
 	g_free(watcher->path);
 	g_free(watcher->srv);
 	g_free(watcher);
@@ -277,6 +280,21 @@ static void change_property(struct thermometer *t, const char *name,
 						THERMOMETER_INTERFACE, name);
 }
 
+static void append_measurement(DBusMessageIter *dict, void *user_data)
+{
+	struct measurement *m = user_data;
+
+	dict_append_entry(dict, "Exponent", DBUS_TYPE_INT16, &m->exp);
+	dict_append_entry(dict, "Mantissa", DBUS_TYPE_INT32, &m->mant);
+	dict_append_entry(dict, "Unit", DBUS_TYPE_STRING, &m->unit);
+
+	if (m->suptime)
+		dict_append_entry(dict, "Time", DBUS_TYPE_UINT64, &m->time);
+
+	dict_append_entry(dict, "Type", DBUS_TYPE_STRING, &m->type);
+	dict_append_entry(dict, "Measurement", DBUS_TYPE_STRING, &m->value);
+}
+
 static void update_watcher(gpointer data, gpointer user_data)
 {
 	struct watcher *w = data;
@@ -286,6 +304,11 @@ static void update_watcher(gpointer data, gpointer user_data)
 	DBusMessageIter dict;
 	DBusMessage *msg;
 
+	if (w->batch != NULL) {
+		batch_watcher_queue(w->batch, path, append_measurement, m);
+		return;
+	}
+
 	msg = dbus_message_new_method_call(w->srv, w->path,
 				THERMOMETER_WATCHER_INTERFACE,
 				"MeasurementReceived");
@@ -301,15 +324,7 @@ static void update_watcher(gpointer data, gpointer user_data)
 			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
 			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
 
-	dict_append_entry(&dict, "Exponent", DBUS_TYPE_INT16, &m->exp);
-	dict_append_entry(&dict, "Mantissa", DBUS_TYPE_INT32, &m->mant);
-	dict_append_entry(&dict, "Unit", DBUS_TYPE_STRING, &m->unit);
-
-	if (m->suptime)
-		dict_append_entry(&dict, "Time", DBUS_TYPE_UINT64, &m->time);
-
-	dict_append_entry(&dict, "Type", DBUS_TYPE_STRING, &m->type);
-	dict_append_entry(&dict, "Measurement", DBUS_TYPE_STRING, &m->value);
+	append_measurement(&dict, m);
 
 	dbus_message_iter_close_container(&iter, &dict);
 
@@ -882,17 +897,12 @@ static struct watcher *find_watcher(GSList *list, const char *sender,
 	return NULL;
 }
 
-static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
-								void *data)
+static DBusMessage *add_watcher(DBusConnection *conn, DBusMessage *msg,
+					struct thermometer_adapter *tadapter,
+					const char *path, uint16_t interval)
 {
 	const char *sender = dbus_message_get_sender(msg);
-	struct thermometer_adapter *tadapter = data;
 	struct watcher *watcher;
-	char *path;
-
-	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
-							DBUS_TYPE_INVALID))
-		return btd_error_invalid_args(msg);
 
 	watcher = find_watcher(tadapter->fwatchers, sender, path);
 	if (watcher != NULL)
@@ -904,6 +914,12 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	watcher->srv = g_strdup(sender);
 	watcher->path = g_strdup(path);
 	watcher->tadapter = tadapter;
+
+	if (interval > 0)
+		watcher->batch = batch_watcher_new(sender, path,
+						THERMOMETER_WATCHER_INTERFACE,
+						interval);
+
 	watcher->id = g_dbus_add_disconnect_watch(conn, sender, watcher_exit,
 						watcher, destroy_watcher);
 
@@ -915,6 +931,37 @@ static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
 	return dbus_message_new_method_return(msg);
 }
 
+static DBusMessage *register_watcher(DBusConnection *conn, DBusMessage *msg,
+								void *data)
+{
+	struct thermometer_adapter *tadapter = data;
+	char *path;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
+							DBUS_TYPE_INVALID))
+		return btd_error_invalid_args(msg);
+
+	return add_watcher(conn, msg, tadapter, path, 0);
+}
+
+static DBusMessage *register_batch_watcher(DBusConnection *conn,
+						DBusMessage *msg, void *data)
+{
+	struct thermometer_adapter *tadapter = data;
+	uint16_t interval;
+	char *path;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
+						DBUS_TYPE_UINT16, &interval,
+						DBUS_TYPE_INVALID))
+		return btd_error_invalid_args(msg);
+
+	if (interval == 0)
+		return btd_error_invalid_args(msg);
+
+	return add_watcher(conn, msg, tadapter, path, interval);
+}
+
 static DBusMessage *unregister_watcher(DBusConnection *conn, DBusMessage *msg,
 								void *data)
 {
@@ -1225,6 +1272,9 @@ static const GDBusMethodTable thermometer_manager_methods[] = {
 	{ GDBUS_METHOD("DisableIntermediateMeasurement",
 			GDBUS_ARGS({ "agent", "o" }), NULL,
 			disable_intermediate) },
+	{ GDBUS_EXPERIMENTAL_METHOD("RegisterBatchWatcher",
+			GDBUS_ARGS({ "agent", "o" }, { "interval", "q" }),
+			NULL, register_batch_watcher) },
 	{ }
 };
 
@@ -148,8 +148,61 @@ struct conn_param {
 	uint16_t max_interval;
 	uint16_t latency;
 	uint16_t timeout;
+	uint8_t  link_losses;	/* Recent supervision timeouts */
 };
 
+/*
+ * Limits used when tuning connection parameters. Intervals are in units
+ * of 1.25 ms, timeouts in units of 10 ms and the scan parameters in
+ * units of 0.625 ms.
+ */
+struct tuning_policy {
+	uint16_t min_interval;
+	uint16_t max_interval;
+	uint16_t max_latency;
+	uint16_t min_timeout;
+	uint16_t max_timeout;
+	unsigned int target_rtt;	/* ms */
+	uint16_t scan_interval;
+	uint16_t scan_window;
+};
+
+static const struct tuning_policy tuning_policies[] = {
+	[BT_TUNING_POWER] = {
+		.min_interval = 0x0050, .max_interval = 0x0190,
+		.max_latency = 10,
+		.min_timeout = 0x0190, .max_timeout = 0x0c80,
+		.target_rtt = 500,
+		.scan_interval = 0x0800, .scan_window = 0x0012,
+	},
+	[BT_TUNING_BALANCED] = {
+		.min_interval = 0x0018, .max_interval = 0x0050,
+		.max_latency = 4,
+		.min_timeout = 0x00c8, .max_timeout = 0x0258,
+		.target_rtt = 150,
+		.scan_interval = 0x0060, .scan_window = 0x0030,
+	},
+	[BT_TUNING_LATENCY] = {
+		.min_interval = 0x0006, .max_interval = 0x0018,
+		.max_latency = 0,
+		.min_timeout = 0x0064, .max_timeout = 0x0258,
+		.target_rtt = 50,
+		.scan_interval = 0x0040, .scan_window = 0x0030,
+	},
+};
+
+/* Kernel defaults for devices without stored parameters */
+#define DEFAULT_CONN_MIN_INTERVAL	0x0018
+#define DEFAULT_CONN_MAX_INTERVAL	0x0028
+#define DEFAULT_CONN_LATENCY		0x0000
+#define DEFAULT_CONN_TIMEOUT		0x002a
+#define DEFAULT_SCAN_INTERVAL		0x0060
+#define DEFAULT_SCAN_WINDOW		0x0030
+
+#define TUNING_MIN_DURATION	30	/* seconds before judging a link idle */
+#define TUNING_IDLE_RATE	64	/* bytes per second */
+#define TUNING_BUSY_RATE	2048	/* bytes per second */
+
 struct discovery_filter {
 	uint8_t type;
 	uint16_t pathloss;
@@ -259,6 +312,9 @@ struct btd_adapter {
 
 	unsigned int db_id;		/* Service event handler for GATT db */
 
+	GSList *conn_params;		/* Connection parameters in kernel */
+	guint conn_params_id;		/* Pending conn params reload */
+
 	bool is_default;		/* true if adapter is default one */
 };
 
@@ -1129,6 +1185,37 @@ static void service_auth_cancel(struct service_auth *auth)
 	g_free(auth);
 }
 
+static struct conn_param *find_conn_param(struct btd_adapter *adapter,
+						const bdaddr_t *bdaddr,
+						uint8_t bdaddr_type)
+{
+	GSList *l;
+
+	for (l = adapter->conn_params; l; l = g_slist_next(l)) {
+		struct conn_param *param = l->data;
+
+		if (param->bdaddr_type == bdaddr_type &&
+				!bacmp(&param->bdaddr, bdaddr))
+			return param;
+	}
+
+	return NULL;
+}
+
+static void remove_conn_param(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	struct conn_param *param;
+
+	param = find_conn_param(adapter, device_get_address(device),
+					btd_device_get_bdaddr_type(device));
+	if (!param)
+		return;
+
+	adapter->conn_params = g_slist_remove(adapter->conn_params, param);
+	g_free(param);
+}
+
 void btd_adapter_remove_device(struct btd_adapter *adapter,
 				struct btd_device *dev)
 {
@@ -1146,6 +1233,8 @@ void btd_adapter_remove_device(struct btd_adapter *adapter,
 	if (adapter->connect_le == dev)
 		adapter->connect_le = NULL;
 
+	remove_conn_param(adapter, dev);
+
 	l = adapter->auths->head;
 	while (l != NULL) {
 		struct service_auth *auth = l->data;
@@ -3436,6 +3525,103 @@ static void load_conn_params(struct btd_adapter *adapter, GSList *params)
 		error("Load connection parameters failed");
 }
 
+static gboolean reload_conn_params(gpointer user_data)
+{
+	struct btd_adapter *adapter = user_data;
+
+	adapter->conn_params_id = 0;
+
+	/*
+	 * Loading parameters replaces every entry not used for automatic
+	 * connections in the kernel, so the whole list is always sent.
+	 */
+	load_conn_params(adapter, adapter->conn_params);
+
+	return FALSE;
+}
+
+static struct conn_param *update_conn_param(struct btd_adapter *adapter,
+					const bdaddr_t *bdaddr,
+					uint8_t bdaddr_type,
+					uint16_t min_interval,
+					uint16_t max_interval,
+					uint16_t latency, uint16_t timeout)
+{
+	struct conn_param *param;
+
+	param = find_conn_param(adapter, bdaddr, bdaddr_type);
+	if (!param) {
+		param = g_new0(struct conn_param, 1);
+		bacpy(&param->bdaddr, bdaddr);
+		param->bdaddr_type = bdaddr_type;
+		adapter->conn_params = g_slist_append(adapter->conn_params,
+									param);
+	}
+
+	param->min_interval = min_interval;
+	param->max_interval = max_interval;
+	param->latency = latency;
+	param->timeout = timeout;
+
+	return param;
+}
+
+static void set_scan_params_complete(uint8_t status, uint16_t length,
+					const void *param, void *user_data)
+{
+	struct btd_adapter *adapter = user_data;
+
+	if (status != MGMT_STATUS_SUCCESS) {
+		error("hci%u Set Scan Parameters failed: %s (0x%02x)",
+				adapter->dev_id, mgmt_errstr(status), status);
+		return;
+	}
+
+	DBG("Scan Parameters set for hci%u", adapter->dev_id);
+}
+
+static void set_scan_params(struct btd_adapter *adapter)
+{
+	struct mgmt_cp_set_scan_params cp;
+	uint16_t interval, window;
+
+	if (main_opts.conn_tuning == BT_TUNING_OFF)
+		return;
+
+	if (!(adapter->supported_settings & MGMT_SETTING_LE))
+		return;
+
+	btd_adapter_get_scan_params(adapter, &interval, &window);
+
+	DBG("hci%u interval 0x%04x window 0x%04x", adapter->dev_id,
+							interval, window);
+
+	cp.interval = htobs(interval);
+	cp.window = htobs(window);
+
+	if (mgmt_send(adapter->mgmt, MGMT_OP_SET_SCAN_PARAMS, adapter->dev_id,
+					sizeof(cp), &cp, set_scan_params_complete,
+					adapter, NULL) == 0)
+		error("Set scan parameters failed");
+}
+
+void btd_adapter_get_scan_params(struct btd_adapter *adapter,
+					uint16_t *interval, uint16_t *window)
+{
+	const struct tuning_policy *policy;
+
+	if (main_opts.conn_tuning == BT_TUNING_OFF) {
+		*interval = DEFAULT_SCAN_INTERVAL;
+		*window = DEFAULT_SCAN_WINDOW;
+		return;
+	}
+
+	policy = &tuning_policies[main_opts.conn_tuning];
+
+	*interval = policy->scan_interval;
+	*window = policy->scan_window;
+}
+
 static uint8_t get_le_addr_type(GKeyFile *keyfile)
 {
 	uint8_t addr_type;
@@ -3563,7 +3749,8 @@ free:
 	load_irks(adapter, irks);
 	g_slist_free_full(irks, g_free);
 	load_conn_params(adapter, params);
-	g_slist_free_full(params, g_free);
+	g_slist_free_full(adapter->conn_params, g_free);
+	adapter->conn_params = params;
 }
 
 int btd_adapter_block_address(struct btd_adapter *adapter,
@@ -4177,6 +4364,11 @@ static void adapter_free(gpointer user_data)
 	if (adapter->auth_idle_id)
 		g_source_remove(adapter->auth_idle_id);
 
+	if (adapter->conn_params_id)
+		g_source_remove(adapter->conn_params_id);
+
+	g_slist_free_full(adapter->conn_params, g_free);
+
 	g_queue_foreach(adapter->auths, free_service_auth, NULL);
 	g_queue_free(adapter->auths);
 
@@ -7103,11 +7295,115 @@ static void new_conn_param(uint16_t index, uint16_t length,
 	if (!ev->store_hint)
 		return;
 
+	update_conn_param(adapter, &ev->addr.bdaddr, ev->addr.type, min, max,
+							latency, timeout);
+
 	store_conn_param(adapter, &ev->addr.bdaddr, ev->addr.type,
 					ev->min_interval, ev->max_interval,
 					ev->latency, ev->timeout);
 }
 
+/*
+ * Called at the end of every LE connection with what was observed on it.
+ * Parameters only apply to the next connection, so they are moved one
+ * step at a time: faster when requests are slow or the link is busy,
+ * more relaxed when it is idle, and more tolerant after a link loss.
+ */
+void adapter_tune_conn_param(struct btd_adapter *adapter,
+					const bdaddr_t *bdaddr,
+					uint8_t bdaddr_type,
+					const struct btd_conn_stats *stats)
+{
+	const struct tuning_policy *policy;
+	struct conn_param *param;
+	unsigned int interval, max, latency, timeout, rate;
+	uint8_t losses;
+	char addr[18];
+
+	if (main_opts.conn_tuning == BT_TUNING_OFF)
+		return;
+
+	if (!(adapter->supported_settings & MGMT_SETTING_LE))
+		return;
+
+	policy = &tuning_policies[main_opts.conn_tuning];
+
+	param = find_conn_param(adapter, bdaddr, bdaddr_type);
+	if (param) {
+		interval = param->min_interval;
+		latency = param->latency;
+		timeout = param->timeout;
+		losses = param->link_losses;
+	} else {
+		interval = DEFAULT_CONN_MIN_INTERVAL;
+		latency = DEFAULT_CONN_LATENCY;
+		timeout = DEFAULT_CONN_TIMEOUT;
+		losses = 0;
+	}
+
+	rate = stats->duration ? stats->bytes / stats->duration : stats->bytes;
+
+	if (stats->link_loss) {
+		if (losses < UINT8_MAX)
+			losses++;
+
+		timeout = timeout * 3 / 2;
+		latency /= 2;
+	} else {
+		if (losses > 0)
+			losses--;
+
+		if (stats->rtt > policy->target_rtt ||
+						rate >= TUNING_BUSY_RATE) {
+			interval = interval * 3 / 4;
+			latency = 0;
+		} else if (stats->duration >= TUNING_MIN_DURATION &&
+					rate < TUNING_IDLE_RATE && !losses) {
+			interval = interval * 5 / 4 + 1;
+			latency++;
+		}
+	}
+
+	interval = MAX(interval, policy->min_interval);
+	interval = MIN(interval, policy->max_interval);
+	max = MIN(interval + interval / 4, 0x0c80);
+	latency = MIN(latency, policy->max_latency);
+	timeout = MAX(timeout, policy->min_timeout);
+	timeout = MIN(timeout, policy->max_timeout);
+
+	/* Supervision timeout must exceed (1 + latency) * max interval * 2 */
+	while (latency > 0 && (1 + latency) * max / 4 >= timeout)
+		latency--;
+
+	if (max / 4 >= timeout)
+		timeout = max / 4 + 1;
+
+	if (param && param->min_interval == interval &&
+			param->max_interval == max &&
+			param->latency == latency && param->timeout == timeout) {
+		param->link_losses = losses;
+		return;
+	}
+
+	ba2str(bdaddr, addr);
+
+	DBG("hci%u %s (%u) rate %u rtt %u loss %u: min 0x%04x max 0x%04x "
+			"latency 0x%04x timeout 0x%04x", adapter->dev_id,
+			addr, bdaddr_type, rate, stats->rtt, stats->link_loss,
+			interval, max, latency, timeout);
+
+	param = update_conn_param(adapter, bdaddr, bdaddr_type, interval, max,
+							latency, timeout);
+	param->link_losses = losses;
+
+	store_conn_param(adapter, bdaddr, bdaddr_type, interval, max, latency,
+								timeout);
+
+	if (!adapter->conn_params_id)
+		adapter->conn_params_id = g_idle_add(reload_conn_params,
+								adapter);
+}
+
 int adapter_set_io_capability(struct btd_adapter *adapter, uint8_t io_cap)
 {
 	struct mgmt_cp_set_io_capability cp;
@@ -7373,6 +7669,7 @@ static int adapter_register(struct btd_adapter *adapter)
 	btd_profile_foreach(probe_profile, adapter);
 	clear_blocked(adapter);
 	load_devices(adapter);
+	set_scan_params(adapter);
 
 	/* retrieve the active connections: address the scenario where
 	 * the are active connections before the daemon've started */
@@ -225,3 +225,18 @@ void btd_adapter_for_each_device(struct btd_adapter *adapter,
 			void *data);
 
 bool btd_le_connect_before_pairing(void);
+
+struct btd_conn_stats {
+	unsigned int duration;		/* Connection length in seconds */
+	uint64_t bytes;			/* ATT bytes in both directions */
+	unsigned int requests;		/* ATT requests answered */
+	unsigned int rtt;		/* Smoothed request round trip, ms */
+	bool link_loss;			/* Ended by supervision timeout */
+};
+
+void adapter_tune_conn_param(struct btd_adapter *adapter,
+					const bdaddr_t *bdaddr,
+					uint8_t bdaddr_type,
+					const struct btd_conn_stats *stats);
+void btd_adapter_get_scan_params(struct btd_adapter *adapter,
+					uint16_t *interval, uint16_t *window);
@@ -0,0 +1,200 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2015  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+
+#include "dbus-common.h"
+#include "batch.h"
+
+/* Upper bound of measurements delivered in a single batch */
+#define BATCH_MAX_MEASUREMENTS	64
+
+struct batch_watcher {
+	char			*srv;
+	char			*path;
+	char			*interface;
+	uint16_t		interval;	/* batch window (ms) */
+	GSList			*batches;
+};
+
+/* Measurements of one device pending delivery to the watcher */
+struct batch {
+	struct batch_watcher	*watcher;
+	char			*device;
+	DBusMessage		*msg;
+	DBusMessageIter		iter;
+	DBusMessageIter		array;
+	unsigned int		count;
+	guint			timeout;
+};
+
+static void destroy_batch(gpointer user_data)
+{
+	struct batch *batch = user_data;
+
+	if (batch->timeout > 0)
+		g_source_remove(batch->timeout);
+
+	if (batch->msg != NULL) {
+		dbus_message_iter_abandon_container(&batch->iter,
+							&batch->array);
+		dbus_message_unref(batch->msg);
+	}
+
+	g_free(batch->device);
+	g_free(batch);
+}
+
+static void flush_batch(struct batch *batch)
+{
+	struct batch_watcher *w = batch->watcher;
+
+	dbus_message_iter_close_container(&batch->iter, &batch->array);
+
+	dbus_message_set_no_reply(batch->msg, TRUE);
+	g_dbus_send_message(btd_get_dbus_connection(), batch->msg);
+	batch->msg = NULL;
+
+	w->batches = g_slist_remove(w->batches, batch);
+	destroy_batch(batch);
+}
+
+static gboolean batch_timeout(gpointer user_data)
+{
+	struct batch *batch = user_data;
+
+	batch->timeout = 0;
+	flush_batch(batch);
+
+	return FALSE;
+}
+
+static struct batch *get_batch(struct batch_watcher *w, const char *device)
+{
+	struct batch *batch;
+	GSList *l;
+
+	for (l = w->batches; l; l = l->next) {
+		batch = l->data;
+
+		if (g_str_equal(batch->device, device))
+			return batch;
+	}
+
+	batch = g_new0(struct batch, 1);
+	batch->msg = dbus_message_new_method_call(w->srv, w->path,
+					w->interface, "MeasurementsReceived");
+	if (batch->msg == NULL) {
+		g_free(batch);
+		return NULL;
+	}
+
+	batch->watcher = w;
+	batch->device = g_strdup(device);
+
+	dbus_message_iter_init_append(batch->msg, &batch->iter);
+
+	dbus_message_iter_append_basic(&batch->iter, DBUS_TYPE_OBJECT_PATH,
+								&device);
+
+	dbus_message_iter_open_container(&batch->iter, DBUS_TYPE_ARRAY,
+			DBUS_TYPE_ARRAY_AS_STRING
+			DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
+			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &batch->array);
+
+	batch->timeout = g_timeout_add(w->interval, batch_timeout, batch);
+
+	w->batches = g_slist_prepend(w->batches, batch);
+
+	return batch;
+}
+
+struct batch_watcher *batch_watcher_new(const char *srv, const char *path,
+					const char *interface,
+					uint16_t interval)
+{
+	struct batch_watcher *watcher;
+
+	watcher = g_new0(struct batch_watcher, 1);
+	watcher->srv = g_strdup(srv);
+	watcher->path = g_strdup(path);
+	watcher->interface = g_strdup(interface);
+	watcher->interval = interval;
+
+	return watcher;
+}
+
+void batch_watcher_free(struct batch_watcher *watcher)
+{
+	if (watcher == NULL)
+		return;
+
+	g_slist_free_full(watcher->batches, destroy_batch);
+	g_free(watcher->interface);
+	g_free(watcher->path);
+	g_free(watcher->srv);
+	g_free(watcher);
+}
+
+/*
+ * Appends one measurement of the given device to its pending
+ * MeasurementsReceived call, stamped with the monotonic reception time.
+ * The append callback adds the profile specific entries to the dictionary.
+ */
+void batch_watcher_queue(struct batch_watcher *watcher, const char *device,
+				batch_append_func_t append, void *user_data)
+{
+	struct batch *batch;
+	DBusMessageIter dict;
+	uint64_t timestamp;
+
+	batch = get_batch(watcher, device);
+	if (batch == NULL)
+		return;
+
+	timestamp = g_get_monotonic_time();
+
+	dbus_message_iter_open_container(&batch->array, DBUS_TYPE_ARRAY,
+			DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
+			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
+
+	dict_append_entry(&dict, "Timestamp", DBUS_TYPE_UINT64, &timestamp);
+
+	append(&dict, user_data);
+
+	dbus_message_iter_close_container(&batch->array, &dict);
+
+	if (++batch->count >= BATCH_MAX_MEASUREMENTS)
+		flush_batch(batch);
+}
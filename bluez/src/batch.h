@@ -0,0 +1,34 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2015  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+typedef void (*batch_append_func_t) (DBusMessageIter *dict, void *user_data);
+
+struct batch_watcher;
+
+struct batch_watcher *batch_watcher_new(const char *srv, const char *path,
+					const char *interface,
+					uint16_t interval);
+void batch_watcher_free(struct batch_watcher *watcher);
+
+void batch_watcher_queue(struct batch_watcher *watcher, const char *device,
+				batch_append_func_t append, void *user_data);
@@ -130,6 +130,7 @@ struct authentication_req {
 struct browse_req {
 	DBusMessage *msg;
 	struct btd_device *device;
+	uint8_t bdaddr_type;
 	GSList *match_uuids;
 	GSList *profiles_added;
 	sdp_list_t *records;
@@ -175,6 +176,7 @@ struct bearer_state {
 	bool bonded;
 	bool connected;
 	bool svc_resolved;
+	struct browse_req *browse;	/* service discover request */
 };
 
 struct csrk_info {
@@ -213,7 +215,6 @@ struct btd_device {
 	bool		temporary;
 	guint		disconn_timer;
 	guint		discov_timer;
-	struct browse_req *browse;		/* service discover request */
 	struct bonding_req *bonding;
 	struct authentication_req *authr;	/* authentication request */
 	GSList		*disconnects;		/* disconnects message */
@@ -226,6 +227,7 @@ struct btd_device {
 	struct bt_att *att;			/* The new ATT transport */
 	uint16_t att_mtu;			/* The ATT MTU */
 	unsigned int att_disconn_id;
+	struct timespec att_start;		/* When ATT got connected */
 
 	/*
 	 * TODO: For now, device creates and owns the client-role gatt_db, but
@@ -585,17 +587,29 @@ static void browse_request_cancel(struct browse_req *req)
 {
 	struct btd_device *device = req->device;
 	struct btd_adapter *adapter = device->adapter;
+	struct bearer_state *state = get_state(device, req->bdaddr_type);
 
 	DBG("");
 
-	bt_cancel_discovery(btd_adapter_get_address(adapter), &device->bdaddr);
-
-	attio_cleanup(device);
+	if (req->bdaddr_type == BDADDR_BREDR)
+		bt_cancel_discovery(btd_adapter_get_address(adapter),
+							&device->bdaddr);
+	else
+		attio_cleanup(device);
 
-	device->browse = NULL;
+	state->browse = NULL;
 	browse_request_free(req);
 }
 
+static void device_cancel_browse(struct btd_device *device)
+{
+	if (device->bredr_state.browse)
+		browse_request_cancel(device->bredr_state.browse);
+
+	if (device->le_state.browse)
+		browse_request_cancel(device->le_state.browse);
+}
+
 static void svc_dev_remove(gpointer user_data)
 {
 	struct svc_callback *cb = user_data;
@@ -1347,8 +1361,7 @@ void device_request_disconnect(struct btd_device *device, DBusMessage *msg)
 	if (device->bonding)
 		bonding_request_cancel(device->bonding);
 
-	if (device->browse)
-		browse_request_cancel(device->browse);
+	device_cancel_browse(device);
 
 	if (device->connect) {
 		DBusMessage *reply = btd_error_failed(device->connect,
@@ -1666,7 +1679,7 @@ int btd_device_connect_services(struct btd_device *dev, GSList *services)
 {
 	GSList *l;
 
-	if (dev->pending || dev->connect || dev->browse)
+	if (dev->pending || dev->connect || dev->bredr_state.browse)
 		return -EBUSY;
 
 	if (!btd_adapter_get_powered(dev->adapter))
@@ -1693,7 +1706,7 @@ static DBusMessage *connect_profiles(struct btd_device *dev, uint8_t bdaddr_type
 	DBG("%s %s, client %s", dev->path, uuid ? uuid : "(all)",
 						dbus_message_get_sender(msg));
 
-	if (dev->pending || dev->connect || dev->browse)
+	if (dev->pending || dev->connect || state->browse)
 		return btd_error_in_progress(msg);
 
 	if (!btd_adapter_get_powered(dev->adapter))
@@ -2012,7 +2025,7 @@ static void device_svc_resolved(struct btd_device *dev, uint8_t bdaddr_type,
 								int err)
 {
 	struct bearer_state *state = get_state(dev, bdaddr_type);
-	struct browse_req *req = dev->browse;
+	struct browse_req *req = state->browse;
 
 	DBG("%s err %d", dev->path, err);
 
@@ -2056,7 +2069,7 @@ static void device_svc_resolved(struct btd_device *dev, uint8_t bdaddr_type,
 	if (!req)
 		return;
 
-	dev->browse = NULL;
+	state->browse = NULL;
 	browse_request_complete(req, bdaddr_type, err);
 }
 
@@ -3512,8 +3525,7 @@ void device_remove(struct btd_device *device, gboolean remove_stored)
 		device_cancel_bonding(device, status);
 	}
 
-	if (device->browse)
-		browse_request_cancel(device->browse);
+	device_cancel_browse(device);
 
 	while (device->services != NULL) {
 		struct btd_service *service = device->services->data;
@@ -4005,11 +4017,95 @@ static GSList *device_services_from_record(struct btd_device *device,
 	return prim_list;
 }
 
+static void probe_bredr_services(struct browse_req *req)
+{
+	struct btd_device *device = req->device;
+	GSList *primaries;
+
+	primaries = device_services_from_record(device, req->profiles_added);
+	if (primaries)
+		device_register_primaries(device, primaries, ATT_PSM);
+
+	/*
+	 * TODO: The btd_service instances for GATT services need to be
+	 * initialized with the service handles. Eventually this code should
+	 * perform ATT protocol service discovery over the ATT PSM to obtain
+	 * the full list of services and populate a client-role gatt_db over
+	 * BR/EDR.
+	 */
+	device_probe_profiles(device, req->profiles_added);
+
+	/* Propagate services changes */
+	g_dbus_emit_property_changed(dbus_conn, device->path,
+						DEVICE_INTERFACE, "UUIDs");
+
+	g_slist_free_full(req->profiles_added, g_free);
+	req->profiles_added = NULL;
+}
+
+static sdp_list_t *copy_records(sdp_list_t *recs)
+{
+	sdp_list_t *copy = NULL;
+
+	for (; recs; recs = recs->next)
+		copy = sdp_list_append(copy, sdp_copy_record(recs->data));
+
+	return copy;
+}
+
+/* Drop cached records which a complete browse didn't return anymore */
+static void remove_stale_records(struct btd_device *device, sdp_list_t *recs)
+{
+	char filename[PATH_MAX];
+	char srcaddr[18], dstaddr[18];
+	GKeyFile *key_file;
+	char **handles;
+	bool changed = false;
+	char *data;
+	gsize length = 0;
+	int i;
+
+	ba2str(btd_adapter_get_address(device->adapter), srcaddr);
+	ba2str(&device->bdaddr, dstaddr);
+
+	snprintf(filename, PATH_MAX, STORAGEDIR "/%s/cache/%s", srcaddr,
+								dstaddr);
+
+	key_file = g_key_file_new();
+	g_key_file_load_from_file(key_file, filename, 0, NULL);
+
+	handles = g_key_file_get_keys(key_file, "ServiceRecords", NULL, NULL);
+
+	for (i = 0; handles && handles[i]; i++) {
+		sdp_record_t rec;
+
+		rec.handle = strtoul(handles[i], NULL, 16);
+
+		if (sdp_list_find(recs, &rec, rec_cmp))
+			continue;
+
+		DBG("Removing stale record %s", handles[i]);
+
+		g_key_file_remove_key(key_file, "ServiceRecords", handles[i],
+									NULL);
+		changed = true;
+	}
+
+	g_strfreev(handles);
+
+	if (changed) {
+		data = g_key_file_to_data(key_file, &length, NULL);
+		g_file_set_contents(filename, data, length, NULL);
+		g_free(data);
+	}
+
+	g_key_file_free(key_file);
+}
+
 static void search_cb(sdp_list_t *recs, int err, gpointer user_data)
 {
 	struct browse_req *req = user_data;
 	struct btd_device *device = req->device;
-	GSList *primaries;
 	char addr[18];
 
 	ba2str(&device->bdaddr, addr);
@@ -4022,6 +4118,8 @@ static void search_cb(sdp_list_t *recs, int err, gpointer user_data)
 
 	update_bredr_services(req, recs);
 
+	remove_stale_records(device, req->records);
+
 	if (device->tmp_records)
 		sdp_list_free(device->tmp_records,
 					(sdp_free_func_t) sdp_record_free);
@@ -4034,22 +4132,7 @@ static void search_cb(sdp_list_t *recs, int err, gpointer user_data)
 		goto send_reply;
 	}
 
-	primaries = device_services_from_record(device, req->profiles_added);
-	if (primaries)
-		device_register_primaries(device, primaries, ATT_PSM);
-
-	/*
-	 * TODO: The btd_service instances for GATT services need to be
-	 * initialized with the service handles. Eventually this code should
-	 * perform ATT protocol service discovery over the ATT PSM to obtain
-	 * the full list of services and populate a client-role gatt_db over
-	 * BR/EDR.
-	 */
-	device_probe_profiles(device, req->profiles_added);
-
-	/* Propagate services changes */
-	g_dbus_emit_property_changed(dbus_conn, req->device->path,
-						DEVICE_INTERFACE, "UUIDs");
+	probe_bredr_services(req);
 
 send_reply:
 	device_svc_resolved(device, BDADDR_BREDR, err);
@@ -4074,6 +4157,20 @@ static void browse_cb(sdp_list_t *recs, int err, gpointer user_data)
 
 	update_bredr_services(req, recs);
 
+	/*
+	 * Probe the services found so far instead of waiting for the
+	 * remaining searches, each of them takes a new SDP connection.
+	 */
+	if (req->profiles_added) {
+		if (device->tmp_records)
+			sdp_list_free(device->tmp_records,
+					(sdp_free_func_t) sdp_record_free);
+
+		device->tmp_records = copy_records(req->records);
+
+		probe_bredr_services(req);
+	}
+
 	/* Search for mandatory uuids */
 	if (uuid_list[req->search_uuid]) {
 		sdp_uuid16_create(&uuid, uuid_list[req->search_uuid++]);
@@ -4117,13 +4214,40 @@ static void attio_disconnected(gpointer data, gpointer user_data)
 		attio->dcfunc(attio->user_data);
 }
 
+static void tune_conn_param(struct btd_device *device, int err)
+{
+	struct btd_conn_stats stats;
+	struct bt_att_stats att_stats;
+	struct timespec now;
+
+	if (device->bdaddr_type == BDADDR_BREDR)
+		return;
+
+	if (!bt_att_get_stats(device->att, &att_stats))
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	memset(&stats, 0, sizeof(stats));
+	stats.duration = now.tv_sec - device->att_start.tv_sec;
+	stats.bytes = att_stats.tx_bytes + att_stats.rx_bytes;
+	stats.requests = att_stats.requests;
+	stats.rtt = att_stats.rtt;
+	stats.link_loss = (err == ETIMEDOUT);
+
+	adapter_tune_conn_param(device->adapter, &device->bdaddr,
+						device->bdaddr_type, &stats);
+}
+
 static void att_disconnected_cb(int err, void *user_data)
 {
 	struct btd_device *device = user_data;
 
 	DBG("");
 
-	if (device->browse)
+	tune_conn_param(device, err);
+
+	if (device->le_state.browse)
 		goto done;
 
 	DBG("%s (%d)", strerror(err), err);
@@ -4151,7 +4275,7 @@ done:
 
 static void register_gatt_services(struct btd_device *device)
 {
-	struct browse_req *req = device->browse;
+	struct bearer_state *state = get_state(device, device->bdaddr_type);
 	GSList *services = NULL;
 
 	if (!bt_gatt_client_is_ready(device->client))
@@ -4165,8 +4289,8 @@ static void register_gatt_services(struct btd_device *device)
 
 	btd_device_set_temporary(device, false);
 
-	if (req)
-		update_gatt_uuids(req, device->primaries, services);
+	if (state->browse)
+		update_gatt_uuids(state->browse, device->primaries, services);
 
 	g_slist_free_full(device->primaries, g_free);
 	device->primaries = NULL;
@@ -4352,6 +4476,8 @@ bool device_attach_att(struct btd_device *dev, GIOChannel *io)
 						att_disconnected_cb, dev, NULL);
 	bt_att_set_close_on_unref(dev->att, true);
 
+	clock_gettime(CLOCK_MONOTONIC, &dev->att_start);
+
 	if (dev->local_csrk)
 		bt_att_set_local_key(dev->att, dev->local_csrk->key,
 							local_counter, dev);
@@ -4518,9 +4644,10 @@ static void att_browse_error_cb(const GError *gerr, gpointer user_data)
 {
 	struct att_callbacks *attcb = user_data;
 	struct btd_device *device = attcb->user_data;
-	struct browse_req *req = device->browse;
+	struct bearer_state *state = get_state(device, device->bdaddr_type);
+	struct browse_req *req = state->browse;
 
-	device->browse = NULL;
+	state->browse = NULL;
 	browse_request_complete(req, device->bdaddr_type, -ECONNABORTED);
 }
 
@@ -4530,17 +4657,21 @@ static void att_browse_cb(gpointer user_data)
 }
 
 static struct browse_req *browse_request_new(struct btd_device *device,
+							uint8_t bdaddr_type,
 							DBusMessage *msg)
 {
+	struct bearer_state *state = get_state(device, bdaddr_type);
 	struct browse_req *req;
 
-	if (device->browse)
+	/* SDP and GATT resolution of dual-mode devices run independently */
+	if (state->browse)
 		return NULL;
 
 	req = g_new0(struct browse_req, 1);
 	req->device = device;
+	req->bdaddr_type = bdaddr_type;
 
-	device->browse = req;
+	state->browse = req;
 
 	if (!msg)
 		return req;
@@ -4565,7 +4696,7 @@ static int device_browse_gatt(struct btd_device *device, DBusMessage *msg)
 	struct att_callbacks *attcb;
 	struct browse_req *req;
 
-	req = browse_request_new(device, msg);
+	req = browse_request_new(device, device->bdaddr_type, msg);
 	if (!req)
 		return -EBUSY;
 
@@ -4602,7 +4733,7 @@ static int device_browse_gatt(struct btd_device *device, DBusMessage *msg)
 				BT_IO_OPT_INVALID);
 
 	if (device->att_io == NULL) {
-		device->browse = NULL;
+		get_state(device, device->bdaddr_type)->browse = NULL;
 		browse_request_free(req);
 		g_free(attcb);
 		return -EIO;
@@ -4643,7 +4774,7 @@ static int device_browse_sdp(struct btd_device *device, DBusMessage *msg)
 	uuid_t uuid;
 	int err;
 
-	req = browse_request_new(device, msg);
+	req = browse_request_new(device, BDADDR_BREDR, msg);
 	if (!req)
 		return -EBUSY;
 
@@ -4655,6 +4786,7 @@ static int device_browse_sdp(struct btd_device *device, DBusMessage *msg)
 				&device->bdaddr, &uuid, browse_cb, req, NULL,
 				req->sdp_flags);
 	if (err < 0) {
+		device->bredr_state.browse = NULL;
 		browse_request_free(req);
 		return err;
 	}
@@ -4982,7 +5114,7 @@ void device_bonding_complete(struct btd_device *device, uint8_t bdaddr_type,
 
 		bonding_request_free(bonding);
 	} else if (!state->svc_resolved) {
-		if (!device->browse && !device->discov_timer &&
+		if (!state->browse && !device->discov_timer &&
 				main_opts.reverse_sdp) {
 			/* If we are not initiators and there is no currently
 			 * active discovery or discovery timer, set discovery
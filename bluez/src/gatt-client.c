@@ -23,6 +23,9 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
 
 #include <dbus/dbus.h>
 
@@ -37,6 +40,7 @@
 #include "adapter.h"
 #include "device.h"
 #include "src/shared/queue.h"
+#include "src/shared/io.h"
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
 #include "src/shared/gatt-client.h"
@@ -90,6 +94,9 @@ struct characteristic {
 	unsigned int read_id;
 	unsigned int write_id;
 
+	/* Socket acquired for writes without response */
+	struct io *write_io;
+
 	struct queue *descs;
 
 	bool notifying;
@@ -721,6 +728,28 @@ static gboolean characteristic_get_notifying(const GDBusPropertyTable *property,
 	return TRUE;
 }
 
+static gboolean characteristic_get_write_acquired(
+					const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct characteristic *chrc = data;
+	dbus_bool_t locked = chrc->write_io ? TRUE : FALSE;
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_BOOLEAN, &locked);
+
+	return TRUE;
+}
+
+static gboolean characteristic_write_acquired_exists(
+					const GDBusPropertyTable *property,
+					void *data)
+{
+	struct characteristic *chrc = data;
+
+	return (chrc->props & BT_GATT_CHRC_PROP_WRITE_WITHOUT_RESP) ?
+								TRUE : FALSE;
+}
+
 struct chrc_prop_data {
 	uint8_t prop;
 	char *str;
@@ -960,12 +989,158 @@ fail:
 	return btd_error_not_supported(msg);
 }
 
+/*
+ * The acquired sockets carry one value per packet, so the application end is
+ * handed out together with the MTU to size its buffers and bluetoothd never
+ * has to marshal the values into D-Bus messages.
+ */
+static struct io *sock_io_new(int *app_fd)
+{
+	struct io *io;
+	int fds[2];
+
+	if (socketpair(AF_LOCAL, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC,
+								0, fds) < 0) {
+		error("Failed to create socket pair: %s (%d)", strerror(errno),
+									errno);
+		return NULL;
+	}
+
+	io = io_new(fds[0]);
+	if (!io) {
+		close(fds[0]);
+		close(fds[1]);
+		return NULL;
+	}
+
+	io_set_close_on_destroy(io, true);
+
+	*app_fd = fds[1];
+
+	return io;
+}
+
+static DBusMessage *create_acquire_reply(DBusMessage *msg, int fd,
+							uint16_t mtu)
+{
+	DBusMessage *reply;
+
+	/* The descriptor is duplicated into the message */
+	reply = g_dbus_create_reply(msg, DBUS_TYPE_UNIX_FD, &fd,
+							DBUS_TYPE_UINT16, &mtu,
+							DBUS_TYPE_INVALID);
+	close(fd);
+
+	return reply;
+}
+
+static void release_write_io(struct characteristic *chrc)
+{
+	if (!chrc->write_io)
+		return;
+
+	DBG("%s", chrc->path);
+
+	io_destroy(chrc->write_io);
+	chrc->write_io = NULL;
+
+	g_dbus_emit_property_changed(btd_get_dbus_connection(), chrc->path,
+						GATT_CHARACTERISTIC_IFACE,
+						"WriteAcquired");
+}
+
+static bool write_io_read(struct io *io, void *user_data)
+{
+	struct characteristic *chrc = user_data;
+	struct bt_gatt_client *gatt = chrc->service->client->gatt;
+	uint8_t value[BT_ATT_MAX_VALUE_LEN];
+	ssize_t len;
+
+	len = recv(io_get_fd(io), value, sizeof(value), MSG_TRUNC);
+	if (len < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return true;
+
+		error("Failed to read value to write: %s (%d)",
+							strerror(errno), errno);
+		release_write_io(chrc);
+		return false;
+	}
+
+	if (!len) {
+		release_write_io(chrc);
+		return false;
+	}
+
+	if (!gatt)
+		return true;
+
+	if ((size_t) len > sizeof(value) ||
+				len > bt_gatt_client_get_mtu(gatt) - 3) {
+		error("Value of %zd bytes doesn't fit the MTU, dropped", len);
+		return true;
+	}
+
+	if (!bt_gatt_client_write_without_response(gatt, chrc->value_handle,
+					chrc->props & BT_GATT_CHRC_PROP_AUTH,
+					value, len))
+		error("Failed to write value from socket");
+
+	return true;
+}
+
+static bool write_io_hup(struct io *io, void *user_data)
+{
+	struct characteristic *chrc = user_data;
+
+	release_write_io(chrc);
+
+	return false;
+}
+
+static DBusMessage *characteristic_acquire_write(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	struct characteristic *chrc = user_data;
+	struct bt_gatt_client *gatt = chrc->service->client->gatt;
+	int fd;
+
+	if (!gatt)
+		return btd_error_failed(msg, "Not connected");
+
+	if (!(chrc->props & BT_GATT_CHRC_PROP_WRITE_WITHOUT_RESP))
+		return btd_error_not_supported(msg);
+
+	if (chrc->write_io)
+		return btd_error_not_permitted(msg, "Write acquired");
+
+	chrc->write_io = sock_io_new(&fd);
+	if (!chrc->write_io)
+		return btd_error_failed(msg, "Failed to create socket");
+
+	io_set_read_handler(chrc->write_io, write_io_read, chrc, NULL);
+	io_set_disconnect_handler(chrc->write_io, write_io_hup, chrc, NULL);
+
+	DBG("%s acquired by %s", chrc->path, dbus_message_get_sender(msg));
+
+	g_dbus_emit_property_changed(btd_get_dbus_connection(), chrc->path,
+						GATT_CHARACTERISTIC_IFACE,
+						"WriteAcquired");
+
+	return create_acquire_reply(msg, fd, bt_gatt_client_get_mtu(gatt));
+}
+
 struct notify_client {
 	struct characteristic *chrc;
 	int ref_count;
 	char *owner;
 	guint watch;
 	unsigned int notify_id;
+
+	/* Notifications go to this socket instead of the Value property */
+	struct io *io;
+	/* Application end of io until AcquireNotify is replied */
+	int acquire_fd;
 };
 
 static void notify_client_free(struct notify_client *client)
@@ -975,6 +1150,11 @@ static void notify_client_free(struct notify_client *client)
 	g_dbus_remove_watch(btd_get_dbus_connection(), client->watch);
 	bt_gatt_client_unregister_notify(client->chrc->service->client->gatt,
 							client->notify_id);
+
+	if (client->acquire_fd >= 0)
+		close(client->acquire_fd);
+
+	io_destroy(client->io);
 	free(client->owner);
 	free(client);
 }
@@ -1047,6 +1227,7 @@ static struct notify_client *notify_client_create(struct characteristic *chrc,
 		return NULL;
 
 	client->chrc = chrc;
+	client->acquire_fd = -1;
 	client->owner = strdup(owner);
 	if (!client->owner) {
 		free(client);
@@ -1080,6 +1261,15 @@ static void notify_cb(uint16_t value_handle, const uint8_t *value,
 	struct notify_client *client = op->data;
 	struct characteristic *chrc = client->chrc;
 
+	if (client->io) {
+		/* Slow readers lose values rather than stalling bluetoothd */
+		if (send(io_get_fd(client->io), value, length,
+					MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+			DBG("Failed to forward notification: %s",
+							strerror(errno));
+		return;
+	}
+
 	/*
 	 * Even if the value didn't change, we want to send a PropertiesChanged
 	 * signal so that we propagate the notification/indication to
@@ -1093,12 +1283,18 @@ static void notify_cb(uint16_t value_handle, const uint8_t *value,
 static DBusMessage *create_notify_reply(struct async_dbus_op *op,
 						bool success, uint8_t att_ecode)
 {
+	struct notify_client *client = op->data;
 	DBusMessage *reply = NULL;
+	uint16_t mtu;
 
 	if (!op->msg)
 		return NULL;
 
-	if (success)
+	if (success && client->acquire_fd >= 0) {
+		mtu = bt_gatt_client_get_mtu(client->chrc->service->client->gatt);
+		reply = create_acquire_reply(op->msg, client->acquire_fd, mtu);
+		client->acquire_fd = -1;
+	} else if (success)
 		reply = g_dbus_create_reply(op->msg, DBUS_TYPE_INVALID);
 	else if (att_ecode)
 		reply = create_gatt_dbus_error(op->msg, att_ecode);
@@ -1143,10 +1339,28 @@ done:
 		g_dbus_send_message(btd_get_dbus_connection(), reply);
 }
 
-static DBusMessage *characteristic_start_notify(DBusConnection *conn,
-					DBusMessage *msg, void *user_data)
+static bool notify_io_hup(struct io *io, void *user_data)
+{
+	struct notify_client *client = user_data;
+	struct characteristic *chrc = client->chrc;
+
+	DBG("owner %s", client->owner);
+
+	queue_remove(chrc->notify_clients, client);
+	queue_remove(chrc->service->client->all_notify_clients, client);
+	bt_gatt_client_unregister_notify(chrc->service->client->gatt,
+							client->notify_id);
+	client->notify_id = 0;
+	update_notifying(chrc);
+
+	notify_client_unref(client);
+
+	return false;
+}
+
+static DBusMessage *start_notify(DBusMessage *msg, struct characteristic *chrc,
+								bool acquire)
 {
-	struct characteristic *chrc = user_data;
 	struct bt_gatt_client *gatt = chrc->service->client->gatt;
 	const char *sender = dbus_message_get_sender(msg);
 	struct async_dbus_op *op;
@@ -1156,6 +1370,10 @@ static DBusMessage *characteristic_start_notify(DBusConnection *conn,
 				chrc->props & BT_GATT_CHRC_PROP_INDICATE))
 		return btd_error_not_supported(msg);
 
+	/* The socket is only handed out once notifications are enabled */
+	if (acquire && !gatt)
+		return btd_error_failed(msg, "Not connected");
+
 	/* Each client can only have one active notify session. */
 	client = queue_find(chrc->notify_clients, match_notify_sender, sender);
 	if (client)
@@ -1167,6 +1385,17 @@ static DBusMessage *characteristic_start_notify(DBusConnection *conn,
 	if (!client)
 		return btd_error_failed(msg, "Failed allocate notify session");
 
+	if (acquire) {
+		client->io = sock_io_new(&client->acquire_fd);
+		if (!client->io) {
+			notify_client_free(client);
+			return btd_error_failed(msg, "Failed to create socket");
+		}
+
+		io_set_disconnect_handler(client->io, notify_io_hup, client,
+									NULL);
+	}
+
 	queue_push_tail(chrc->notify_clients, client);
 	queue_push_tail(chrc->service->client->all_notify_clients, client);
 
@@ -1216,6 +1445,18 @@ fail:
 	return btd_error_failed(msg, "Failed to register notify session");
 }
 
+static DBusMessage *characteristic_start_notify(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	return start_notify(msg, user_data, false);
+}
+
+static DBusMessage *characteristic_acquire_notify(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	return start_notify(msg, user_data, true);
+}
+
 static DBusMessage *characteristic_stop_notify(DBusConnection *conn,
 					DBusMessage *msg, void *user_data)
 {
@@ -1280,6 +1521,9 @@ static const GDBusPropertyTable characteristic_properties[] = {
 					G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
 	{ "Descriptors", "ao", characteristic_get_descriptors, NULL, NULL,
 					G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
+	{ "WriteAcquired", "b", characteristic_get_write_acquired, NULL,
+					characteristic_write_acquired_exists,
+					G_DBUS_PROPERTY_FLAG_EXPERIMENTAL },
 	{ }
 };
 
@@ -1295,6 +1539,14 @@ static const GDBusMethodTable characteristic_methods[] = {
 						characteristic_start_notify) },
 	{ GDBUS_EXPERIMENTAL_METHOD("StopNotify", NULL, NULL,
 						characteristic_stop_notify) },
+	{ GDBUS_EXPERIMENTAL_METHOD("AcquireWrite", NULL,
+						GDBUS_ARGS({ "fd", "h" },
+							{ "mtu", "q" }),
+						characteristic_acquire_write) },
+	{ GDBUS_EXPERIMENTAL_ASYNC_METHOD("AcquireNotify", NULL,
+						GDBUS_ARGS({ "fd", "h" },
+							{ "mtu", "q" }),
+						characteristic_acquire_notify) },
 	{ }
 };
 
@@ -1393,6 +1645,9 @@ static void unregister_characteristic(void *data)
 	if (chrc->write_id)
 		bt_gatt_client_cancel(gatt, chrc->write_id);
 
+	io_destroy(chrc->write_io);
+	chrc->write_io = NULL;
+
 	queue_remove_all(chrc->notify_clients, NULL, NULL, remove_client);
 	queue_remove_all(chrc->descs, NULL, NULL, unregister_descriptor);
 
@@ -1926,6 +2181,9 @@ static void cancel_chrc_ops(void *data, void *user_data)
 		chrc->write_id = 0;
 	}
 
+	/* Let the application know its writes have nowhere to go */
+	release_write_io(chrc);
+
 	queue_foreach(chrc->descs, cancel_desc_ops, user_data);
 }
 
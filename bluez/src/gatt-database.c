@@ -24,6 +24,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
 
 #include "lib/bluetooth.h"
 #include "lib/sdp.h"
@@ -33,6 +35,7 @@
 #include "gdbus/gdbus.h"
 #include "src/shared/util.h"
 #include "src/shared/queue.h"
+#include "src/shared/io.h"
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
 #include "src/shared/gatt-server.h"
@@ -113,6 +116,11 @@ struct external_chrc {
 	struct queue *pending_reads;
 	struct queue *pending_writes;
 	unsigned int ntfy_cnt;
+	struct io *write_io;
+	struct io *notify_io;
+	struct acquire_op *write_acquire;
+	struct acquire_op *notify_acquire;
+	bool write_released;	/* AcquireWrite failed or socket closed */
 };
 
 struct external_desc {
@@ -126,6 +134,10 @@ struct external_desc {
 	struct queue *pending_writes;
 };
 
+struct acquire_op {
+	struct external_chrc *chrc;
+};
+
 struct pending_op {
 	unsigned int id;
 	struct gatt_db_attribute *attrib;
@@ -328,6 +340,15 @@ static void chrc_free(void *data)
 	queue_destroy(chrc->pending_reads, cancel_pending_read);
 	queue_destroy(chrc->pending_writes, cancel_pending_write);
 
+	io_destroy(chrc->write_io);
+	io_destroy(chrc->notify_io);
+
+	if (chrc->write_acquire)
+		chrc->write_acquire->chrc = NULL;
+
+	if (chrc->notify_acquire)
+		chrc->notify_acquire->chrc = NULL;
+
 	g_free(chrc->path);
 
 	g_dbus_proxy_set_property_watch(chrc->proxy, NULL, NULL);
@@ -1609,6 +1630,67 @@ static struct pending_op *pending_read_new(struct queue *owner_queue,
 	return op;
 }
 
+static bool parse_value_cached(GDBusProxy *proxy)
+{
+	DBusMessageIter iter;
+	dbus_bool_t val;
+
+	if (!g_dbus_proxy_get_property(proxy, "ValueCached", &iter))
+		return false;
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_BOOLEAN)
+		return false;
+
+	dbus_message_iter_get_basic(&iter, &val);
+
+	return val;
+}
+
+/*
+ * Objects setting ValueCached are read from the copy of their Value property
+ * GDBusProxy keeps up to date from PropertiesChanged, without a ReadValue
+ * round trip.
+ */
+static bool send_cached_read(struct gatt_db_attribute *attrib,
+					GDBusProxy *proxy, unsigned int id,
+					uint16_t offset)
+{
+	DBusMessageIter iter, array;
+	uint8_t *value = NULL;
+	int len = 0;
+
+	if (!parse_value_cached(proxy))
+		return false;
+
+	if (!g_dbus_proxy_get_property(proxy, "Value", &iter))
+		return false;
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY)
+		return false;
+
+	dbus_message_iter_recurse(&iter, &array);
+	dbus_message_iter_get_fixed_array(&array, &value, &len);
+
+	if (len < 0)
+		return false;
+
+	/* Truncate the value if it's too large */
+	len = MIN(BT_ATT_MAX_VALUE_LEN, len);
+
+	if (offset > len) {
+		gatt_db_attribute_read_result(attrib, id,
+						BT_ATT_ERROR_INVALID_OFFSET,
+						NULL, 0);
+		return true;
+	}
+
+	gatt_db_attribute_read_result(attrib, id, 0,
+					offset < len ? value + offset : NULL,
+					len - offset);
+
+	return true;
+}
+
 static void send_read(struct gatt_db_attribute *attrib, GDBusProxy *proxy,
 						struct queue *owner_queue,
 						unsigned int id)
@@ -1760,6 +1842,232 @@ static uint32_t permissions_from_props(uint8_t props, uint8_t ext_props)
 	return perm;
 }
 
+/*
+ * Applications announcing WriteAcquired or NotifyAcquired hand out one end of
+ * a SOCK_SEQPACKET socket, after which values travel one per packet without
+ * any D-Bus involvement.
+ */
+static struct acquire_op *acquire_op_send(struct external_chrc *chrc,
+					const char *property, const char *method,
+					struct acquire_op *pending,
+					GDBusReturnFunction reply_cb)
+{
+	struct acquire_op *op;
+	DBusMessageIter iter;
+
+	if (pending)
+		return pending;
+
+	if (!g_dbus_proxy_get_property(chrc->proxy, property, &iter))
+		return NULL;
+
+	op = new0(struct acquire_op, 1);
+	if (!op)
+		return NULL;
+
+	op->chrc = chrc;
+
+	if (g_dbus_proxy_method_call(chrc->proxy, method, NULL, reply_cb, op,
+							free) == TRUE)
+		return op;
+
+	error("Failed to call %s on %s", method, chrc->path);
+	free(op);
+
+	return NULL;
+}
+
+static int acquire_reply_fd(DBusMessage *message, const char *method)
+{
+	DBusMessageIter iter;
+	DBusError err;
+	int fd;
+
+	dbus_error_init(&err);
+
+	if (dbus_set_error_from_message(&err, message) == TRUE) {
+		DBG("Failed to %s: %s: %s", method, err.name, err.message);
+		dbus_error_free(&err);
+		return -1;
+	}
+
+	/* The MTU following the descriptor isn't needed on this side */
+	dbus_message_iter_init(message, &iter);
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UNIX_FD) {
+		error("Invalid return value received for \"%s\"", method);
+		return -1;
+	}
+
+	/* The descriptor is duplicated and owned by the caller */
+	dbus_message_iter_get_basic(&iter, &fd);
+
+	return fd;
+}
+
+static bool write_io_hup(struct io *io, void *user_data)
+{
+	struct external_chrc *chrc = user_data;
+
+	DBG("%s released write socket", chrc->path);
+
+	io_destroy(chrc->write_io);
+	chrc->write_io = NULL;
+	chrc->write_released = true;
+
+	return false;
+}
+
+static void acquire_write_reply(DBusMessage *message, void *user_data)
+{
+	struct acquire_op *op = user_data;
+	struct external_chrc *chrc = op->chrc;
+	int fd;
+
+	if (!chrc) {
+		DBG("Pending acquire was canceled when object got removed");
+		return;
+	}
+
+	chrc->write_acquire = NULL;
+
+	fd = acquire_reply_fd(message, "AcquireWrite");
+	if (fd < 0) {
+		chrc->write_released = true;
+		return;
+	}
+
+	chrc->write_io = io_new(fd);
+	if (!chrc->write_io) {
+		close(fd);
+		chrc->write_released = true;
+		return;
+	}
+
+	io_set_close_on_destroy(chrc->write_io, true);
+	io_set_disconnect_handler(chrc->write_io, write_io_hup, chrc, NULL);
+}
+
+static bool sock_write_value(struct external_chrc *chrc, const uint8_t *value,
+								size_t len)
+{
+	/*
+	 * Values go through WriteValue until the socket is there, and for
+	 * good once acquiring failed or the application closed it.
+	 */
+	if (chrc->write_released)
+		return false;
+
+	if (!chrc->write_io) {
+		chrc->write_acquire = acquire_op_send(chrc, "WriteAcquired",
+							"AcquireWrite",
+							chrc->write_acquire,
+							acquire_write_reply);
+		return false;
+	}
+
+	/* Writes without response are lost anyway if nobody can take them */
+	if (send(io_get_fd(chrc->write_io), value, len,
+					MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+		DBG("Failed to write value to socket: %s", strerror(errno));
+
+	return true;
+}
+
+static void release_notify_io(struct external_chrc *chrc)
+{
+	DBG("%s", chrc->path);
+
+	io_destroy(chrc->notify_io);
+	chrc->notify_io = NULL;
+}
+
+static bool notify_io_read(struct io *io, void *user_data)
+{
+	struct external_chrc *chrc = user_data;
+	uint8_t value[BT_ATT_MAX_VALUE_LEN];
+	ssize_t len;
+
+	/* Larger values are truncated like the Value property */
+	len = recv(io_get_fd(io), value, sizeof(value), 0);
+	if (len < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return true;
+
+		error("Failed to read notification: %s (%d)", strerror(errno),
+									errno);
+		release_notify_io(chrc);
+		return false;
+	}
+
+	if (!len) {
+		release_notify_io(chrc);
+		return false;
+	}
+
+	send_notification_to_devices(chrc->service->database,
+				gatt_db_attribute_get_handle(chrc->attrib),
+				value, len,
+				gatt_db_attribute_get_handle(chrc->ccc),
+				chrc->props & BT_GATT_CHRC_PROP_INDICATE);
+
+	return true;
+}
+
+static bool notify_io_hup(struct io *io, void *user_data)
+{
+	release_notify_io(user_data);
+
+	return false;
+}
+
+static void acquire_notify_reply(DBusMessage *message, void *user_data)
+{
+	struct acquire_op *op = user_data;
+	struct external_chrc *chrc = op->chrc;
+	int fd;
+
+	if (!chrc) {
+		DBG("Pending acquire was canceled when object got removed");
+		return;
+	}
+
+	chrc->notify_acquire = NULL;
+
+	fd = acquire_reply_fd(message, "AcquireNotify");
+	if (fd < 0)
+		return;
+
+	/* All devices might have unsubscribed in the meantime */
+	if (!chrc->ntfy_cnt) {
+		close(fd);
+		return;
+	}
+
+	chrc->notify_io = io_new(fd);
+	if (!chrc->notify_io) {
+		close(fd);
+		return;
+	}
+
+	io_set_close_on_destroy(chrc->notify_io, true);
+	io_set_read_handler(chrc->notify_io, notify_io_read, chrc, NULL);
+	io_set_disconnect_handler(chrc->notify_io, notify_io_hup, chrc, NULL);
+}
+
+static bool acquire_notify(struct external_chrc *chrc)
+{
+	if (chrc->notify_io)
+		return true;
+
+	chrc->notify_acquire = acquire_op_send(chrc, "NotifyAcquired",
+							"AcquireNotify",
+							chrc->notify_acquire,
+							acquire_notify_reply);
+
+	return chrc->notify_acquire != NULL;
+}
+
 static uint8_t ccc_write_cb(uint16_t value, void *user_data)
 {
 	struct external_chrc *chrc = user_data;
@@ -1774,6 +2082,12 @@ static uint8_t ccc_write_cb(uint16_t value, void *user_data)
 		if (__sync_sub_and_fetch(&chrc->ntfy_cnt, 1))
 			return 0;
 
+		/* Closing the socket tells the application to stop */
+		if (chrc->notify_io || chrc->notify_acquire) {
+			release_notify_io(chrc);
+			return 0;
+		}
+
 		/*
 		 * Send request to stop notifying. This is best-effort
 		 * operation, so simply ignore the return the value.
@@ -1802,9 +2116,9 @@ static uint8_t ccc_write_cb(uint16_t value, void *user_data)
 
 	/*
 	 * Always call StartNotify for an incoming enable and ignore the return
-	 * value for now.
+	 * value for now, unless the application takes values from a socket.
 	 */
-	if (g_dbus_proxy_method_call(chrc->proxy,
+	if (!acquire_notify(chrc) && g_dbus_proxy_method_call(chrc->proxy,
 						"StartNotify", NULL, NULL,
 						NULL, NULL) == FALSE)
 		return BT_ATT_ERROR_REQUEST_NOT_SUPPORTED;
@@ -1928,6 +2242,9 @@ static void desc_read_cb(struct gatt_db_attribute *attrib,
 		return;
 	}
 
+	if (send_cached_read(attrib, desc->proxy, id, offset))
+		return;
+
 	send_read(attrib, desc->proxy, desc->pending_reads, id);
 }
 
@@ -1983,6 +2300,9 @@ static void chrc_read_cb(struct gatt_db_attribute *attrib,
 		return;
 	}
 
+	if (send_cached_read(attrib, chrc->proxy, id, offset))
+		return;
+
 	send_read(attrib, chrc->proxy, chrc->pending_reads, id);
 }
 
@@ -1999,6 +2319,13 @@ static void chrc_write_cb(struct gatt_db_attribute *attrib,
 		return;
 	}
 
+	if ((opcode == BT_ATT_OP_WRITE_CMD ||
+				opcode == BT_ATT_OP_SIGNED_WRITE_CMD) &&
+				sock_write_value(chrc, value, len)) {
+		gatt_db_attribute_write_result(attrib, id, 0);
+		return;
+	}
+
 	send_write(attrib, chrc->proxy, chrc->pending_writes, id, value, len);
 }
 
@@ -29,6 +29,13 @@ typedef enum {
 	BT_MODE_LE,
 } bt_mode_t;
 
+typedef enum {
+	BT_TUNING_OFF,
+	BT_TUNING_POWER,
+	BT_TUNING_BALANCED,
+	BT_TUNING_LATENCY,
+} bt_tuning_t;
+
 struct main_opts {
 	char		*name;
 	uint32_t	class;
@@ -46,6 +53,7 @@ struct main_opts {
 	uint16_t	did_version;
 
 	bt_mode_t	mode;
+	bt_tuning_t	conn_tuning;
 };
 
 extern struct main_opts main_opts;
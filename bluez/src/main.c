@@ -88,6 +88,7 @@ static const char * const supported_options[] = {
 	"DebugKeys",
 	"ControllerMode",
 	"MultiProfile",
+	"ConnectionTuning",
 };
 
 GKeyFile *btd_get_main_conf(void)
@@ -210,6 +211,22 @@ static int get_mode(const char *str)
 	return BT_MODE_DUAL;
 }
 
+static bt_tuning_t get_tuning(const char *str)
+{
+	if (strcmp(str, "off") == 0)
+		return BT_TUNING_OFF;
+	else if (strcmp(str, "power") == 0)
+		return BT_TUNING_POWER;
+	else if (strcmp(str, "balanced") == 0)
+		return BT_TUNING_BALANCED;
+	else if (strcmp(str, "latency") == 0)
+		return BT_TUNING_LATENCY;
+
+	error("Unknown connection tuning policy \"%s\"", str);
+
+	return BT_TUNING_OFF;
+}
+
 static void parse_config(GKeyFile *config)
 {
 	GError *err = NULL;
@@ -329,6 +346,16 @@ static void parse_config(GKeyFile *config)
 		g_free(str);
 	}
 
+	str = g_key_file_get_string(config, "General", "ConnectionTuning",
+									&err);
+	if (err) {
+		g_clear_error(&err);
+	} else {
+		DBG("ConnectionTuning=%s", str);
+		main_opts.conn_tuning = get_tuning(str);
+		g_free(str);
+	}
+
 	boolean = g_key_file_get_boolean(config, "General",
 						"FastConnectable", &err);
 	if (err)
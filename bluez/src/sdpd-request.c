@@ -338,16 +338,26 @@ static int sdp_match_uuid(sdp_list_t *search, sdp_list_t *pattern)
 	if (patlen < sdp_list_len(search))
 		return -1;
 	for (; search; search = search->next) {
-		uuid_t *uuid128;
-		void *data = search->data;
+		uuid_t *uuid = search->data;
+		uuid_t uuid128;
 		sdp_list_t *list;
-		if (data == NULL)
+		if (uuid == NULL)
 			return -1;
 
 		/* create 128-bit form of the search UUID */
-		uuid128 = sdp_uuid_to_uuid128((uuid_t *)data);
-		list = sdp_list_find(pattern, uuid128, sdp_uuid128_cmp);
-		bt_free(uuid128);
+		switch (uuid->type) {
+		case SDP_UUID16:
+			sdp_uuid16_to_uuid128(&uuid128, uuid);
+			break;
+		case SDP_UUID32:
+			sdp_uuid32_to_uuid128(&uuid128, uuid);
+			break;
+		default:
+			uuid128 = *uuid;
+			break;
+		}
+
+		list = sdp_list_find(pattern, &uuid128, sdp_uuid128_cmp);
 		if (!list)
 			return 0;
 	}
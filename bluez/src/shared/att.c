@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 
 #include "src/shared/io.h"
 #include "src/shared/queue.h"
@@ -86,6 +87,8 @@ struct bt_att {
 
 	struct sign_info *local_sign;
 	struct sign_info *remote_sign;
+
+	struct bt_att_stats stats;
 };
 
 struct sign_info {
@@ -188,11 +191,21 @@ struct att_send_op {
 	uint16_t opcode;
 	void *pdu;
 	uint16_t len;
+	uint64_t sent;			/* Time the request left, in us */
 	bt_att_response_func_t callback;
 	bt_att_destroy_func_t destroy;
 	void *user_data;
 };
 
+static uint64_t get_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
 static void destroy_att_send_op(void *data)
 {
 	struct att_send_op *op = data;
@@ -471,6 +484,8 @@ static bool can_write_data(struct io *io, void *user_data)
 
 	util_hexdump('<', op->pdu, ret, att->debug_callback, att->debug_data);
 
+	att->stats.tx_bytes += ret;
+
 	/* Based on the operation type, set either the pending request or the
 	 * pending indication. If it came from the write queue, then there is
 	 * no need to keep it around.
@@ -478,6 +493,7 @@ static bool can_write_data(struct io *io, void *user_data)
 	switch (op->type) {
 	case ATT_OP_TYPE_REQ:
 		att->pending_req = op;
+		op->sent = get_time_us();
 		break;
 	case ATT_OP_TYPE_IND:
 		att->pending_ind = op;
@@ -624,6 +640,19 @@ static bool handle_error_rsp(struct bt_att *att, uint8_t *pdu,
 	return queue_push_head(att->req_queue, op);
 }
 
+static void update_rtt(struct bt_att *att, struct att_send_op *op)
+{
+	unsigned int rtt = (get_time_us() - op->sent) / 1000;
+
+	att->stats.requests++;
+
+	/* Same smoothing as TCP: 7/8 of the old value, 1/8 of the sample */
+	if (att->stats.requests == 1)
+		att->stats.rtt = rtt;
+	else
+		att->stats.rtt = (att->stats.rtt * 7 + rtt) / 8;
+}
+
 static void handle_rsp(struct bt_att *att, uint8_t opcode, uint8_t *pdu,
 								ssize_t pdu_len)
 {
@@ -667,6 +696,8 @@ static void handle_rsp(struct bt_att *att, uint8_t opcode, uint8_t *pdu,
 		rsp_pdu_len = pdu_len;
 	}
 
+	update_rtt(att, op);
+
 	goto done;
 
 fail:
@@ -836,6 +867,8 @@ static bool can_read_data(struct io *io, void *user_data)
 	util_hexdump('>', att->buf, bytes_read,
 					att->debug_callback, att->debug_data);
 
+	att->stats.rx_bytes += bytes_read;
+
 	if (bytes_read < ATT_MIN_PDU_LEN)
 		return true;
 
@@ -1078,6 +1111,16 @@ uint16_t bt_att_get_mtu(struct bt_att *att)
 	return att->mtu;
 }
 
+bool bt_att_get_stats(struct bt_att *att, struct bt_att_stats *stats)
+{
+	if (!att || !stats)
+		return false;
+
+	*stats = att->stats;
+
+	return true;
+}
+
 bool bt_att_set_mtu(struct bt_att *att, uint16_t mtu)
 {
 	void *buf;
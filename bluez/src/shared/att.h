@@ -28,6 +28,13 @@
 
 struct bt_att;
 
+struct bt_att_stats {
+	uint64_t tx_bytes;		/* PDU bytes written */
+	uint64_t rx_bytes;		/* PDU bytes read */
+	unsigned int requests;		/* Requests that got a response */
+	unsigned int rtt;		/* Smoothed request round trip, ms */
+};
+
 struct bt_att *bt_att_new(int fd, bool ext_signed);
 
 struct bt_att *bt_att_ref(struct bt_att *att);
@@ -37,6 +44,11 @@ bool bt_att_set_close_on_unref(struct bt_att *att, bool do_close);
 
 int bt_att_get_fd(struct bt_att *att);
 
+/*
+ * For PDUs received from the remote, pdu points into the receive buffer
+ * right after the opcode, so ((const uint8_t *) pdu)[-1] is always valid
+ * when pdu is not NULL. Responses generated locally pass NULL instead.
+ */
 typedef void (*bt_att_response_func_t)(uint8_t opcode, const void *pdu,
 					uint16_t length, void *user_data);
 typedef void (*bt_att_notify_func_t)(uint8_t opcode, const void *pdu,
@@ -54,6 +66,8 @@ bool bt_att_set_debug(struct bt_att *att, bt_att_debug_func_t callback,
 uint16_t bt_att_get_mtu(struct bt_att *att);
 bool bt_att_set_mtu(struct bt_att *att, uint16_t mtu);
 
+bool bt_att_get_stats(struct bt_att *att, struct bt_att_stats *stats);
+
 bool bt_att_set_timeout_cb(struct bt_att *att, bt_att_timeout_func_t callback,
 						void *user_data,
 						bt_att_destroy_func_t destroy);
@@ -670,7 +670,7 @@ int main(int argc, char *argv[])
 
 	switch (mode) {
 	case MODE_CONNECT:
-		err = bnep_init();
+		err = bnep_init(false);
 		if (err < 0) {
 			printf("cannot initialize bnep\n");
 			exit(1);
@@ -681,7 +681,7 @@ int main(int argc, char *argv[])
 
 		break;
 	case MODE_LISTEN:
-		err = bnep_init();
+		err = bnep_init(false);
 		if (err < 0) {
 			printf("cannot initialize bnep\n");
 			exit(1);
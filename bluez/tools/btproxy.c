@@ -37,11 +37,15 @@
 #include <getopt.h>
 #include <stdbool.h>
 #include <termios.h>
+#include <time.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 
 #include "src/shared/util.h"
@@ -60,34 +64,134 @@ struct sockaddr_hci {
 };
 #define HCI_CHANNEL_USER	1
 
+/*
+ * Stream sockets deliver several packets per read, so the buffers are big
+ * enough to hold a good number of them. Packet sockets are only drained
+ * while a packet of the largest size seen on HCI still fits.
+ */
+#define PROXY_BUF_SIZE		(64 * 1024)
+#define PROXY_PACKET_MAX	4096
+
+/* Packets written to a stream socket with a single writev() */
+#define PROXY_BATCH_MAX		64
+
+#define STATS_INTERVAL		1000
+
 static uint16_t hci_index = 0;
 static bool client_active = false;
 static bool debug_enabled = false;
 static bool emulate_ecc = false;
+static bool stats_enabled = false;
 
 static void hexdump_print(const char *str, void *user_data)
 {
 	printf("%s%s\n", (char *) user_data, str);
 }
 
+struct proxy_stats {
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t batches;
+	uint64_t latency_sum;
+	uint64_t latency_max;
+};
+
 struct proxy {
 	/* Receive commands, ACL and SCO data */
 	int host_fd;
-	uint8_t host_buf[4096];
-	uint16_t host_len;
+	uint8_t host_buf[PROXY_BUF_SIZE];
+	uint32_t host_len;
 	bool host_shutdown;
+	int host_type;
+	struct proxy_stats host_stats;
 
 	/* Receive events, ACL and SCO data */
 	int dev_fd;
-	uint8_t dev_buf[4096];
-	uint16_t dev_len;
+	uint8_t dev_buf[PROXY_BUF_SIZE];
+	uint32_t dev_len;
 	bool dev_shutdown;
+	int dev_type;
+	struct proxy_stats dev_stats;
+
+	int stats_id;
 
 	/* ECC emulation */
 	uint8_t event_mask[8];
 	uint8_t local_sk256[32];
 };
 
+/* Socket type of a descriptor or 0 if it is a character device */
+static int fd_type(int fd)
+{
+	socklen_t len = sizeof(int);
+	int type;
+
+	if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0)
+		return 0;
+
+	return type;
+}
+
+static uint64_t time_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void stats_update(struct proxy_stats *stats, unsigned int packets,
+					size_t bytes, uint64_t start)
+{
+	uint64_t latency = time_usec() - start;
+
+	stats->packets += packets;
+	stats->bytes += bytes;
+	stats->batches++;
+	stats->latency_sum += latency;
+
+	if (latency > stats->latency_max)
+		stats->latency_max = latency;
+}
+
+static void stats_print(const char *dir, struct proxy_stats *stats)
+{
+	if (!stats->batches)
+		return;
+
+	printf("%s: %llu packets, %llu bytes/s, %llu packets per batch, "
+			"latency %llu us (max %llu us)\n", dir,
+			(unsigned long long) stats->packets,
+			(unsigned long long) stats->bytes * 1000 /
+							STATS_INTERVAL,
+			(unsigned long long) (stats->packets / stats->batches),
+			(unsigned long long) (stats->latency_sum /
+							stats->batches),
+			(unsigned long long) stats->latency_max);
+
+	memset(stats, 0, sizeof(*stats));
+}
+
+static void stats_callback(int id, void *user_data)
+{
+	struct proxy *proxy = user_data;
+
+	stats_print("H->D", &proxy->host_stats);
+	stats_print("D->H", &proxy->dev_stats);
+
+	mainloop_modify_timeout(id, STATS_INTERVAL);
+}
+
+static void free_proxy(struct proxy *proxy)
+{
+	if (proxy->stats_id > 0)
+		mainloop_remove_timeout(proxy->stats_id);
+
+	client_active = false;
+	free(proxy);
+}
+
 static bool write_packet(int fd, const void *data, size_t size,
 							void *user_data)
 {
@@ -112,6 +216,125 @@ static bool write_packet(int fd, const void *data, size_t size,
 	return true;
 }
 
+/*
+ * Complete packets read in one go are written together to stream sockets.
+ * Anything else, like /dev/vhci or the HCI user channel, expects exactly
+ * one packet per write.
+ */
+static bool write_batch(int fd, int type, struct iovec *iov, int iovcnt,
+							void *user_data)
+{
+	int i;
+
+	if (type != SOCK_STREAM || iovcnt == 1) {
+		for (i = 0; i < iovcnt; i++) {
+			if (!write_packet(fd, iov[i].iov_base, iov[i].iov_len,
+								user_data))
+				return false;
+		}
+
+		return true;
+	}
+
+	if (debug_enabled)
+		for (i = 0; i < iovcnt; i++)
+			util_hexdump('<', iov[i].iov_base, iov[i].iov_len,
+						hexdump_print, user_data);
+
+	while (iovcnt > 0) {
+		ssize_t written;
+
+		written = writev(fd, iov, iovcnt);
+		if (written < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			return false;
+		}
+
+		while (iovcnt > 0 && (size_t) written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+
+		if (iovcnt > 0) {
+			iov->iov_base = (uint8_t *) iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+
+	return true;
+}
+
+/* Read as much as is available, packet sockets return one per call */
+static ssize_t read_data(int fd, int type, uint8_t *buf, size_t size)
+{
+	ssize_t len, total;
+
+	total = read(fd, buf, size);
+	if (total <= 0 || !type || type == SOCK_STREAM)
+		return total;
+
+	while (size - total >= PROXY_PACKET_MAX) {
+		len = recv(fd, buf + total, size - total, MSG_DONTWAIT);
+		if (len <= 0)
+			break;
+
+		total += len;
+	}
+
+	return total;
+}
+
+/* Length of the packet at buf, 0 if incomplete or -1 if malformed */
+static int packet_length(const uint8_t *buf, uint32_t len, uint8_t ctrl_type)
+{
+	const struct bt_hci_cmd_hdr *cmd_hdr;
+	const struct bt_hci_evt_hdr *evt_hdr;
+	const struct bt_hci_acl_hdr *acl_hdr;
+	const struct bt_hci_sco_hdr *sco_hdr;
+	uint32_t pktlen;
+
+	if (len < 1)
+		return 0;
+
+	if (buf[0] == BT_H4_CMD_PKT && ctrl_type == BT_H4_CMD_PKT) {
+		if (len < 1 + sizeof(*cmd_hdr))
+			return 0;
+
+		cmd_hdr = (const void *) (buf + 1);
+		pktlen = 1 + sizeof(*cmd_hdr) + cmd_hdr->plen;
+	} else if (buf[0] == BT_H4_EVT_PKT && ctrl_type == BT_H4_EVT_PKT) {
+		if (len < 1 + sizeof(*evt_hdr))
+			return 0;
+
+		evt_hdr = (const void *) (buf + 1);
+		pktlen = 1 + sizeof(*evt_hdr) + evt_hdr->plen;
+	} else if (buf[0] == BT_H4_ACL_PKT) {
+		if (len < 1 + sizeof(*acl_hdr))
+			return 0;
+
+		acl_hdr = (const void *) (buf + 1);
+		pktlen = 1 + sizeof(*acl_hdr) + le16_to_cpu(acl_hdr->dlen);
+	} else if (buf[0] == BT_H4_SCO_PKT) {
+		if (len < 1 + sizeof(*sco_hdr))
+			return 0;
+
+		sco_hdr = (const void *) (buf + 1);
+		pktlen = 1 + sizeof(*sco_hdr) + sco_hdr->dlen;
+	} else
+		return -1;
+
+	/* Has to fit the buffer and the uint16_t length of the writers */
+	if (pktlen > UINT16_MAX)
+		return -1;
+
+	if (len < pktlen)
+		return 0;
+
+	return pktlen;
+}
+
 static void host_write_packet(struct proxy *proxy, void *buf, uint16_t len)
 {
 	if (!write_packet(proxy->dev_fd, buf, len, "D: ")) {
@@ -128,6 +351,37 @@ static void dev_write_packet(struct proxy *proxy, void *buf, uint16_t len)
 	}
 }
 
+static bool host_write_batch(struct proxy *proxy, struct iovec *iov,
+					int iovcnt, size_t bytes, uint64_t start)
+{
+	if (!write_batch(proxy->dev_fd, proxy->dev_type, iov, iovcnt, "D: ")) {
+		fprintf(stderr, "Write to device descriptor failed\n");
+		mainloop_remove_fd(proxy->dev_fd);
+		return false;
+	}
+
+	if (stats_enabled)
+		stats_update(&proxy->host_stats, iovcnt, bytes, start);
+
+	return true;
+}
+
+static bool dev_write_batch(struct proxy *proxy, struct iovec *iov,
+					int iovcnt, size_t bytes, uint64_t start)
+{
+	if (!write_batch(proxy->host_fd, proxy->host_type, iov, iovcnt,
+								"H: ")) {
+		fprintf(stderr, "Write to host descriptor failed\n");
+		mainloop_remove_fd(proxy->host_fd);
+		return false;
+	}
+
+	if (stats_enabled)
+		stats_update(&proxy->dev_stats, iovcnt, bytes, start);
+
+	return true;
+}
+
 static void cmd_status(struct proxy *proxy, uint8_t status, uint16_t opcode)
 {
 	size_t buf_size = 1 + sizeof(struct bt_hci_evt_hdr) +
@@ -280,21 +534,21 @@ static void host_read_destroy(void *user_data)
 	close(proxy->host_fd);
 	proxy->host_fd = -1;
 
-	if (proxy->dev_fd < 0) {
-		client_active = false;
-		free(proxy);
-	} else
+	if (proxy->dev_fd < 0)
+		free_proxy(proxy);
+	else
 		mainloop_remove_fd(proxy->dev_fd);
 }
 
 static void host_read_callback(int fd, uint32_t events, void *user_data)
 {
 	struct proxy *proxy = user_data;
-	struct bt_hci_cmd_hdr *cmd_hdr;
-	struct bt_hci_acl_hdr *acl_hdr;
-	struct bt_hci_sco_hdr *sco_hdr;
+	struct iovec iov[PROXY_BATCH_MAX];
+	int iovcnt = 0, pktlen;
+	uint32_t offset = 0;
+	uint64_t start = 0;
+	size_t bytes = 0;
 	ssize_t len;
-	uint16_t pktlen;
 
 	if (events & (EPOLLERR | EPOLLHUP)) {
 		fprintf(stderr, "Error from host descriptor\n");
@@ -308,7 +562,8 @@ static void host_read_callback(int fd, uint32_t events, void *user_data)
 		return;
 	}
 
-	len = read(proxy->host_fd, proxy->host_buf + proxy->host_len,
+	len = read_data(proxy->host_fd, proxy->host_type,
+				proxy->host_buf + proxy->host_len,
 				sizeof(proxy->host_buf) - proxy->host_len);
 	if (len < 0) {
 		if (errno == EAGAIN || errno == EINTR)
@@ -319,65 +574,66 @@ static void host_read_callback(int fd, uint32_t events, void *user_data)
 		return;
 	}
 
+	if (stats_enabled)
+		start = time_usec();
+
 	if (debug_enabled)
 		util_hexdump('>', proxy->host_buf + proxy->host_len, len,
 						hexdump_print, "H: ");
 
 	proxy->host_len += len;
 
-process_packet:
-	if (proxy->host_len < 1)
-		return;
+	while (offset < proxy->host_len) {
+		uint8_t *pkt = proxy->host_buf + offset;
 
-	switch (proxy->host_buf[0]) {
-	case BT_H4_CMD_PKT:
-		if (proxy->host_len < 1 + sizeof(*cmd_hdr))
-			return;
+		if (pkt[0] == 0xff) {
+			/* Notification packet from /dev/vhci - ignore */
+			offset = proxy->host_len;
+			break;
+		}
 
-		cmd_hdr = (void *) (proxy->host_buf + 1);
-		pktlen = 1 + sizeof(*cmd_hdr) + cmd_hdr->plen;
-		break;
-	case BT_H4_ACL_PKT:
-		if (proxy->host_len < 1 + sizeof(*acl_hdr))
+		pktlen = packet_length(pkt, proxy->host_len - offset,
+								BT_H4_CMD_PKT);
+		if (pktlen < 0) {
+			fprintf(stderr, "Received unknown host packet type "
+							"0x%02x\n", pkt[0]);
+			mainloop_remove_fd(proxy->host_fd);
 			return;
+		}
 
-		acl_hdr = (void *) (proxy->host_buf + 1);
-		pktlen = 1 + sizeof(*acl_hdr) + cpu_to_le16(acl_hdr->dlen);
-		break;
-	case BT_H4_SCO_PKT:
-		if (proxy->host_len < 1 + sizeof(*sco_hdr))
+		if (!pktlen)
+			break;
+
+		offset += pktlen;
+
+		if (emulate_ecc) {
+			host_emulate_ecc(proxy, pkt, pktlen);
+			continue;
+		}
+
+		iov[iovcnt].iov_base = pkt;
+		iov[iovcnt].iov_len = pktlen;
+		bytes += pktlen;
+
+		if (++iovcnt < PROXY_BATCH_MAX)
+			continue;
+
+		if (!host_write_batch(proxy, iov, iovcnt, bytes, start))
 			return;
 
-		sco_hdr = (void *) (proxy->host_buf + 1);
-		pktlen = 1 + sizeof(*sco_hdr) + sco_hdr->dlen;
-		break;
-	case 0xff:
-		/* Notification packet from /dev/vhci - ignore */
-		proxy->host_len = 0;
-		return;
-	default:
-		fprintf(stderr, "Received unknown host packet type 0x%02x\n",
-							proxy->host_buf[0]);
-		mainloop_remove_fd(proxy->host_fd);
-		return;
+		iovcnt = 0;
+		bytes = 0;
 	}
 
-	if (proxy->host_len < pktlen)
+	if (iovcnt && !host_write_batch(proxy, iov, iovcnt, bytes, start))
 		return;
 
-	if (emulate_ecc)
-		host_emulate_ecc(proxy, proxy->host_buf, pktlen);
-	else
-		host_write_packet(proxy, proxy->host_buf, pktlen);
+	/* Keep the start of an incomplete packet for the next read */
+	if (offset < proxy->host_len)
+		memmove(proxy->host_buf, proxy->host_buf + offset,
+						proxy->host_len - offset);
 
-	if (proxy->host_len > pktlen) {
-		memmove(proxy->host_buf, proxy->host_buf + pktlen,
-						proxy->host_len - pktlen);
-		proxy->host_len -= pktlen;
-		goto process_packet;
-	}
-
-	proxy->host_len = 0;
+	proxy->host_len -= offset;
 }
 
 static void dev_read_destroy(void *user_data)
@@ -392,21 +648,21 @@ static void dev_read_destroy(void *user_data)
 	close(proxy->dev_fd);
 	proxy->dev_fd = -1;
 
-	if (proxy->host_fd < 0) {
-		client_active = false;
-		free(proxy);
-	} else
+	if (proxy->host_fd < 0)
+		free_proxy(proxy);
+	else
 		mainloop_remove_fd(proxy->host_fd);
 }
 
 static void dev_read_callback(int fd, uint32_t events, void *user_data)
 {
 	struct proxy *proxy = user_data;
-	struct bt_hci_evt_hdr *evt_hdr;
-	struct bt_hci_acl_hdr *acl_hdr;
-	struct bt_hci_sco_hdr *sco_hdr;
+	struct iovec iov[PROXY_BATCH_MAX];
+	int iovcnt = 0, pktlen;
+	uint32_t offset = 0;
+	uint64_t start = 0;
+	size_t bytes = 0;
 	ssize_t len;
-	uint16_t pktlen;
 
 	if (events & (EPOLLERR | EPOLLHUP)) {
 		fprintf(stderr, "Error from device descriptor\n");
@@ -420,7 +676,8 @@ static void dev_read_callback(int fd, uint32_t events, void *user_data)
 		return;
 	}
 
-	len = read(proxy->dev_fd, proxy->dev_buf + proxy->dev_len,
+	len = read_data(proxy->dev_fd, proxy->dev_type,
+				proxy->dev_buf + proxy->dev_len,
 				sizeof(proxy->dev_buf) - proxy->dev_len);
 	if (len < 0) {
 		if (errno == EAGAIN || errno == EINTR)
@@ -431,61 +688,60 @@ static void dev_read_callback(int fd, uint32_t events, void *user_data)
 		return;
 	}
 
+	if (stats_enabled)
+		start = time_usec();
+
 	if (debug_enabled)
 		util_hexdump('>', proxy->dev_buf + proxy->dev_len, len,
 						hexdump_print, "D: ");
 
 	proxy->dev_len += len;
 
-process_packet:
-	if (proxy->dev_len < 1)
-		return;
+	while (offset < proxy->dev_len) {
+		uint8_t *pkt = proxy->dev_buf + offset;
 
-	switch (proxy->dev_buf[0]) {
-	case BT_H4_EVT_PKT:
-		if (proxy->dev_len < 1 + sizeof(*evt_hdr))
+		pktlen = packet_length(pkt, proxy->dev_len - offset,
+								BT_H4_EVT_PKT);
+		if (pktlen < 0) {
+			fprintf(stderr, "Received unknown device packet type "
+							"0x%02x\n", pkt[0]);
+			mainloop_remove_fd(proxy->dev_fd);
 			return;
+		}
 
-		evt_hdr = (void *) (proxy->dev_buf + 1);
-		pktlen = 1 + sizeof(*evt_hdr) + evt_hdr->plen;
-		break;
-	case BT_H4_ACL_PKT:
-		if (proxy->dev_len < 1 + sizeof(*acl_hdr))
-			return;
+		if (!pktlen)
+			break;
 
-		acl_hdr = (void *) (proxy->dev_buf + 1);
-		pktlen = 1 + sizeof(*acl_hdr) + cpu_to_le16(acl_hdr->dlen);
-		break;
-	case BT_H4_SCO_PKT:
-		if (proxy->dev_len < 1 + sizeof(*sco_hdr))
+		offset += pktlen;
+
+		if (emulate_ecc) {
+			dev_emulate_ecc(proxy, pkt, pktlen);
+			continue;
+		}
+
+		iov[iovcnt].iov_base = pkt;
+		iov[iovcnt].iov_len = pktlen;
+		bytes += pktlen;
+
+		if (++iovcnt < PROXY_BATCH_MAX)
+			continue;
+
+		if (!dev_write_batch(proxy, iov, iovcnt, bytes, start))
 			return;
 
-		sco_hdr = (void *) (proxy->dev_buf + 1);
-		pktlen = 1 + sizeof(*sco_hdr) + sco_hdr->dlen;
-		break;
-	default:
-		fprintf(stderr, "Received unknown device packet type 0x%02x\n",
-							proxy->dev_buf[0]);
-		mainloop_remove_fd(proxy->dev_fd);
-		return;
+		iovcnt = 0;
+		bytes = 0;
 	}
 
-	if (proxy->dev_len < pktlen)
+	if (iovcnt && !dev_write_batch(proxy, iov, iovcnt, bytes, start))
 		return;
 
-	if (emulate_ecc)
-		dev_emulate_ecc(proxy, proxy->dev_buf, pktlen);
-	else
-		dev_write_packet(proxy, proxy->dev_buf, pktlen);
+	/* Keep the start of an incomplete packet for the next read */
+	if (offset < proxy->dev_len)
+		memmove(proxy->dev_buf, proxy->dev_buf + offset,
+						proxy->dev_len - offset);
 
-	if (proxy->dev_len > pktlen) {
-		memmove(proxy->dev_buf, proxy->dev_buf + pktlen,
-						proxy->dev_len - pktlen);
-		proxy->dev_len -= pktlen;
-		goto process_packet;
-	}
-
-	proxy->dev_len = 0;
+	proxy->dev_len -= offset;
 }
 
 static bool setup_proxy(int host_fd, bool host_shutdown,
@@ -506,6 +762,13 @@ static bool setup_proxy(int host_fd, bool host_shutdown,
 	proxy->dev_fd = dev_fd;
 	proxy->dev_shutdown = dev_shutdown;
 
+	proxy->host_type = fd_type(host_fd);
+	proxy->dev_type = fd_type(dev_fd);
+
+	if (stats_enabled)
+		proxy->stats_id = mainloop_add_timeout(STATS_INTERVAL,
+						stats_callback, proxy, NULL);
+
 	mainloop_add_fd(proxy->host_fd, EPOLLIN | EPOLLRDHUP,
 				host_read_callback, proxy, host_read_destroy);
 
@@ -515,6 +778,15 @@ static bool setup_proxy(int host_fd, bool host_shutdown,
 	return true;
 }
 
+static void set_nodelay(int fd)
+{
+	int opt = 1;
+
+	/* Packets are written as soon as they are complete */
+	if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)) < 0)
+		perror("Failed to disable Nagle algorithm");
+}
+
 static int open_channel(uint16_t index)
 {
 	struct sockaddr_hci addr;
@@ -571,6 +843,9 @@ static void server_callback(int fd, uint32_t events, void *user_data)
 		return;
 	}
 
+	if (addr.common.sa_family == AF_INET)
+		set_nodelay(host_fd);
+
 	if (client_active) {
 		fprintf(stderr, "Active client already present\n");
 		close(host_fd);
@@ -684,6 +959,8 @@ static int connect_tcp(const char *address, unsigned int port)
 		return -1;
 	}
 
+	set_nodelay(fd);
+
 	return fd;
 }
 
@@ -732,6 +1009,7 @@ static void usage(void)
 		"\t-i, --index <num>           Use specified controller\n"
 		"\t-a, --amp                   Create AMP controller\n"
 		"\t-e, --ecc                   Emulate ECC support\n"
+		"\t-s, --stats                 Print forwarding statistics\n"
 		"\t-d, --debug                 Enable debugging output\n"
 		"\t-h, --help                  Show help options\n");
 }
@@ -745,6 +1023,7 @@ static const struct option main_options[] = {
 	{ "index",    required_argument, NULL, 'i' },
 	{ "amp",      no_argument,       NULL, 'a' },
 	{ "ecc",      no_argument,       NULL, 'e' },
+	{ "stats",    no_argument,       NULL, 's' },
 	{ "debug",    no_argument,       NULL, 'd' },
 	{ "version",  no_argument,       NULL, 'v' },
 	{ "help",     no_argument,       NULL, 'h' },
@@ -765,7 +1044,7 @@ int main(int argc, char *argv[])
 	for (;;) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "rc:l::u::p:i:aedvh",
+		opt = getopt_long(argc, argv, "rc:l::u::p:i:aesdvh",
 						main_options, NULL);
 		if (opt < 0)
 			break;
@@ -809,6 +1088,9 @@ int main(int argc, char *argv[])
 		case 'e':
 			emulate_ecc = true;
 			break;
+		case 's':
+			stats_enabled = true;
+			break;
 		case 'd':
 			debug_enabled = true;
 			break;
@@ -378,6 +378,8 @@ static void send_test_pdus(gpointer context, struct test_pdu *pdus)
 #define PDU_IND_NODATA pdu(ATT_OP_HANDLE_IND, 0x01, 0x00)
 #define PDU_INVALID_IND pdu(ATT_OP_HANDLE_IND, 0x14)
 #define PDU_IND_DATA pdu(ATT_OP_HANDLE_IND, 0x14, 0x00, 0x01)
+#define PDU_NOTIFY_DATA pdu(ATT_OP_HANDLE_NOTIFY, 0x14, 0x00, 0x02)
+#define PDU_NOTIFY_OTHER pdu(ATT_OP_HANDLE_NOTIFY, 0x15, 0x00, 0x03, 0x04)
 
 struct expect_test_data {
 	struct test_pdu *expected;
@@ -517,6 +519,73 @@ static void test_register(struct context *cxt, gconstpointer user_data)
 	g_assert(!canceled);
 }
 
+static void test_register_handles(struct context *cxt, gconstpointer user_data)
+{
+	guint ind_id, notify_id, other_id;
+	gboolean canceled;
+	struct test_pdu pdus[] = {
+		PDU_IND_DATA,
+		PDU_NOTIFY_DATA,
+		PDU_NOTIFY_OTHER,
+		PDU_NOTIFY_DATA,
+		{ },
+	};
+	struct test_pdu notify_only_pdus[] = { PDU_NOTIFY_DATA, { } };
+	struct test_pdu ind_pdus[] = { PDU_IND_DATA, { } };
+	struct test_pdu notify_pdus[] = {
+		PDU_NOTIFY_DATA,
+		PDU_NOTIFY_DATA,
+		{ },
+	};
+	struct test_pdu other_pdus[] = { PDU_NOTIFY_OTHER, { } };
+	struct test_pdu *current_pdu;
+	struct expect_test_data ind, notify, other;
+
+	ind.att = notify.att = other.att = cxt->att;
+	ind.expected = ind_pdus;
+	notify.expected = notify_pdus;
+	other.expected = other_pdus;
+
+	/* Same handle with different opcodes, and two handles */
+	ind_id = g_attrib_register(cxt->att, ATT_OP_HANDLE_IND, 0x0014,
+					notify_canary_expect, &ind, NULL);
+	g_assert(ind_id != 0);
+
+	notify_id = g_attrib_register(cxt->att, ATT_OP_HANDLE_NOTIFY, 0x0014,
+					notify_canary_expect, &notify, NULL);
+	g_assert(notify_id != 0);
+
+	other_id = g_attrib_register(cxt->att, ATT_OP_HANDLE_NOTIFY, 0x0015,
+					notify_canary_expect, &other, NULL);
+	g_assert(other_id != 0);
+
+	send_test_pdus(cxt, pdus);
+
+	for (current_pdu = ind_pdus; current_pdu->valid; current_pdu++)
+		g_assert(current_pdu->received);
+
+	for (current_pdu = notify_pdus; current_pdu->valid; current_pdu++)
+		g_assert(current_pdu->received);
+
+	for (current_pdu = other_pdus; current_pdu->valid; current_pdu++)
+		g_assert(current_pdu->received);
+
+	/* Nothing is expected anymore for 0x0014 once unregistered */
+	canceled = g_attrib_unregister(cxt->att, notify_id);
+	g_assert(canceled);
+
+	send_test_pdus(cxt, notify_only_pdus);
+
+	canceled = g_attrib_unregister(cxt->att, notify_id);
+	g_assert(!canceled);
+
+	canceled = g_attrib_unregister(cxt->att, ind_id);
+	g_assert(canceled);
+
+	canceled = g_attrib_unregister(cxt->att, other_id);
+	g_assert(canceled);
+}
+
 static void test_buffers(struct context *cxt, gconstpointer unused)
 {
 	size_t buflen;
@@ -558,6 +627,9 @@ int main(int argc, char *argv[])
 						 test_cancel, teardown_context);
 	g_test_add("/gattrib/register", struct context, NULL, setup_context,
 					       test_register, teardown_context);
+	g_test_add("/gattrib/register_handles", struct context, NULL,
+					setup_context, test_register_handles,
+					teardown_context);
 	g_test_add("/gattrib/buffers", struct context, NULL, setup_context,
 						test_buffers, teardown_context);
 
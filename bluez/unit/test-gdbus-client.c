@@ -707,6 +707,107 @@ static void client_string_changed(const void *data)
 						context);
 }
 
+static gboolean get_rssi(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct context *context = data;
+	dbus_int16_t value = GPOINTER_TO_INT(context->data);
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_INT16, &value);
+
+	return TRUE;
+}
+
+static gboolean emit_rssi_change(void *user_data)
+{
+	struct context *context = user_data;
+
+	context->data = GINT_TO_POINTER(GPOINTER_TO_INT(context->data) - 1);
+
+	g_dbus_emit_property_changed(context->dbus_conn, SERVICE_PATH,
+						SERVICE_NAME, "RSSI");
+
+	return FALSE;
+}
+
+static void proxy_rssi_changed(GDBusProxy *proxy, void *user_data)
+{
+	struct context *context = user_data;
+	DBusMessageIter iter;
+	dbus_int16_t value;
+
+	tester_debug("proxy %s found", g_dbus_proxy_get_interface(proxy));
+
+	g_assert(g_dbus_proxy_get_property(proxy, "RSSI", &iter));
+	g_assert(dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_INT16);
+
+	dbus_message_iter_get_basic(&iter, &value);
+	g_assert(value == -40);
+
+	context->timeout_source = g_timeout_add_seconds(2, timeout_test,
+								context);
+
+	g_idle_add(emit_rssi_change, context);
+}
+
+static void property_rssi_changed(GDBusProxy *proxy, const char *name,
+					DBusMessageIter *iter, void *user_data)
+{
+	struct context *context = user_data;
+	DBusMessageIter value_iter;
+	dbus_int16_t value, cached;
+
+	tester_debug("property %s changed", name);
+
+	g_assert(g_strcmp0(name, "RSSI") == 0);
+	g_assert(dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_INT16);
+
+	dbus_message_iter_get_basic(iter, &value);
+	g_assert(value == GPOINTER_TO_INT(context->data));
+
+	g_assert(g_dbus_proxy_get_property(proxy, "RSSI", &value_iter));
+	dbus_message_iter_get_basic(&value_iter, &cached);
+	g_assert(cached == value);
+
+	if (value > -50) {
+		g_idle_add(emit_rssi_change, context);
+		return;
+	}
+
+	/* Not an allocated string, don't let destroy_context() free it */
+	context->data = NULL;
+
+	g_dbus_client_unref(context->dbus_client);
+}
+
+static void client_rssi_changed(const void *data)
+{
+	struct context *context = create_context();
+	static const GDBusPropertyTable rssi_properties[] = {
+		{ "RSSI", "n", get_rssi },
+		{ },
+	};
+
+	if (context == NULL)
+		return;
+
+	context->data = GINT_TO_POINTER(-40);
+	g_dbus_register_interface(context->dbus_conn,
+				SERVICE_PATH, SERVICE_NAME,
+				methods, signals, rssi_properties,
+				context, NULL);
+
+	context->dbus_client = g_dbus_client_new(context->dbus_conn,
+						SERVICE_NAME, SERVICE_PATH);
+
+	g_dbus_client_set_disconnect_watch(context->dbus_client,
+						disconnect_handler, context);
+	g_dbus_client_set_proxy_handlers(context->dbus_client,
+						proxy_rssi_changed, NULL,
+						property_rssi_changed,
+						context);
+}
+
 static void property_check_order(const DBusError *err, void *user_data)
 {
 	struct context *context = user_data;
@@ -975,6 +1076,9 @@ int main(int argc, char *argv[])
 	tester_add("/gdbus/client_string_changed", NULL, NULL,
 					client_string_changed, NULL);
 
+	tester_add("/gdbus/client_rssi_changed", NULL, NULL,
+					client_rssi_changed, NULL);
+
 	tester_add("/gdbus/client_check_order", NULL, NULL, client_check_order,
 					NULL);
 
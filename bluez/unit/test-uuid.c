@@ -25,6 +25,9 @@
 #include <config.h>
 #endif
 
+#include <stdbool.h>
+#include <string.h>
+
 #include <glib.h>
 
 #include "lib/bluetooth.h"
@@ -230,10 +233,135 @@ static void test_malformed(gconstpointer data)
 	tester_test_passed();
 }
 
+static void test_order(gconstpointer data)
+{
+	bt_uuid_t u16a, u16b, u32, u128a, u128b;
+
+	bt_uuid16_create(&u16a, 0x1800);
+	bt_uuid16_create(&u16b, 0x2a00);
+	bt_uuid32_create(&u32, 0x12345678);
+	g_assert(bt_string_to_uuid(&u128a, uuid_128.str) == 0);
+	g_assert(bt_string_to_uuid(&u128b,
+				"F0000000-0000-1000-8000-00805f9b34fc") == 0);
+
+	g_assert(bt_uuid_cmp(&u16a, &u16b) < 0);
+	g_assert(bt_uuid_cmp(&u16b, &u16a) > 0);
+	g_assert(bt_uuid_cmp(&u16a, &u32) < 0);
+	g_assert(bt_uuid_cmp(&u32, &u16b) > 0);
+	g_assert(bt_uuid_cmp(&u32, &u128a) < 0);
+	g_assert(bt_uuid_cmp(&u128a, &u128b) < 0);
+	g_assert(bt_uuid_cmp(&u128b, &u128a) > 0);
+	g_assert(bt_uuid_cmp(&u128b, &u128b) == 0);
+
+	tester_test_passed();
+}
+
+static void test_truncate(gconstpointer data)
+{
+	bt_uuid_t uuid;
+	char buf[9];
+
+	g_assert(bt_string_to_uuid(&uuid, uuid_128.str) == 0);
+
+	memset(buf, 'x', sizeof(buf));
+	g_assert(bt_uuid_to_string(&uuid, buf, 5) == 0);
+	g_assert(strcmp(buf, "f000") == 0);
+	g_assert(buf[5] == 'x');
+
+	memset(buf, 'x', sizeof(buf));
+	g_assert(bt_uuid_to_string(&uuid, buf, 0) == 0);
+	g_assert(buf[0] == 'x');
+
+	tester_test_passed();
+}
+
+#define BENCHMARK_ITERATIONS 1000000
+
+static double benchmark_elapsed(GTimer *timer)
+{
+	return g_timer_elapsed(timer, NULL) * 1e9 / BENCHMARK_ITERATIONS;
+}
+
+static void test_benchmark(gconstpointer data)
+{
+	bt_uuid_t u16, u128, tmp;
+	char buf[MAX_LEN_UUID_STR];
+	GTimer *timer;
+	int i, matches = 0;
+
+	bt_uuid16_create(&u16, 0x2a37);
+	g_assert(bt_string_to_uuid(&u128, uuid_128.str) == 0);
+
+	timer = g_timer_new();
+
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		u16.value.u16 = i;
+		matches += !bt_uuid_cmp(&u16, &u128);
+	}
+
+	tester_debug("cmp 16/128: %.1f ns", benchmark_elapsed(timer));
+
+	g_timer_start(timer);
+
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		tmp = u128;
+		tmp.value.u128.data[15] = i;
+		matches += !bt_uuid_cmp(&tmp, &u128);
+	}
+
+	tester_debug("cmp 128/128: %.1f ns", benchmark_elapsed(timer));
+
+	g_timer_start(timer);
+
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		u128.value.u128.data[15] = i;
+		bt_uuid_to_string(&u128, buf, sizeof(buf));
+	}
+
+	tester_debug("to_string 128: %.1f ns", benchmark_elapsed(timer));
+
+	g_timer_start(timer);
+
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+		matches += !bt_string_to_uuid(&tmp, buf);
+
+	tester_debug("from_string 128: %.1f ns", benchmark_elapsed(timer));
+
+	g_timer_destroy(timer);
+
+	g_assert(matches >= BENCHMARK_ITERATIONS);
+
+	tester_test_passed();
+}
+
+/*
+ * The benchmark takes too long for every test run, it only runs when
+ * --benchmark is passed and reports its timings with -d.
+ */
+static bool benchmark_requested(int *argc, char *argv[])
+{
+	int i;
+
+	for (i = 1; i < *argc; i++) {
+		if (strcmp(argv[i], "--benchmark"))
+			continue;
+
+		memmove(argv + i, argv + i + 1, (*argc - i) * sizeof(*argv));
+		(*argc)--;
+
+		return true;
+	}
+
+	return false;
+}
+
 int main(int argc, char *argv[])
 {
+	bool benchmark;
 	size_t i;
 
+	benchmark = benchmark_requested(&argc, argv);
+
 	tester_init(&argc, &argv);
 
 	tester_add("/uuid/base", &uuid_base, NULL, test_uuid, NULL);
@@ -260,6 +388,9 @@ int main(int argc, char *argv[])
 	tester_add("/uuid/onetwentyeight/str", &uuid_128, NULL, test_str, NULL);
 	tester_add("/uuid/onetwentyeight/cmp", &uuid_128, NULL, test_cmp, NULL);
 
+	tester_add("/uuid/order", NULL, NULL, test_order, NULL);
+	tester_add("/uuid/truncate", NULL, NULL, test_truncate, NULL);
+
 	for (i = 0; malformed[i]; i++) {
 		char *testpath;
 
@@ -277,5 +408,9 @@ int main(int argc, char *argv[])
 		g_free(testpath);
 	}
 
+	if (benchmark)
+		tester_add("/uuid/benchmark", NULL, NULL, test_benchmark,
+									NULL);
+
 	return tester_run();
 }
@@ -139,6 +139,9 @@
 /* Define to 1 if you have the `endservent' function. */
 #define HAVE_ENDSERVENT 1
 
+/* Define to 1 if you have the `epoll_create1' function. */
+#define HAVE_EPOLL_CREATE1 1
+
 /* we have the eventfd(2) system call */
 #define HAVE_EVENTFD 1
 
@@ -344,6 +347,9 @@
 /* Define to 1 if you have the `readlink' function. */
 #define HAVE_READLINK 1
 
+/* Define to 1 if you have the `recvmmsg' function. */
+#define HAVE_RECVMMSG 1
+
 /* Define to 1 if you have the <sched.h> header file. */
 #define HAVE_SCHED_H 1
 
@@ -87,6 +87,35 @@
  * internally.
  */
 
+/* Bounded queues keep their items in a lock-free ring instead of
+ * queue->queue, after Dmitry Vyukov's bounded MPMC queue. Every cell
+ * carries a sequence number telling for which position it may be written
+ * (sequence == pos) or read (sequence == pos + 1), so producers and
+ * consumers each only contend on their own position counter. The mutex
+ * and condition variables are only used to sleep on an empty or full
+ * ring; waiting_threads and waiting_pushers are updated atomically so
+ * that the other side knows whether it has to wake anybody up.
+ */
+#define RING_CACHE_LINE 64
+
+typedef struct
+{
+  gsize    sequence;
+  gpointer data;
+} GAsyncQueueCell;
+
+typedef struct
+{
+  gsize            enqueue_pos;
+  gchar            pad1[RING_CACHE_LINE - sizeof (gsize)];
+  gsize            dequeue_pos;
+  gchar            pad2[RING_CACHE_LINE - sizeof (gsize)];
+  GAsyncQueueCell *cells;
+  gsize            mask;
+  GCond            space_cond;
+  gint             waiting_pushers;
+} GAsyncQueueRing;
+
 /**
  * GAsyncQueue:
  *
@@ -102,6 +131,7 @@ struct _GAsyncQueue
   GDestroyNotify item_free_func;
   guint waiting_threads;
   gint ref_count;
+  GAsyncQueueRing *ring;
 };
 
 typedef struct
@@ -110,6 +140,149 @@ typedef struct
   gpointer         user_data;
 } SortData;
 
+#define RING_LOAD(pos) ((gsize) g_atomic_pointer_get (pos))
+
+static gboolean
+ring_try_push (GAsyncQueueRing *ring,
+               gpointer         data)
+{
+  GAsyncQueueCell *cell;
+  gsize pos = RING_LOAD (&ring->enqueue_pos);
+
+  for (;;)
+    {
+      gssize diff;
+
+      cell = &ring->cells[pos & ring->mask];
+      diff = (gssize) (RING_LOAD (&cell->sequence) - pos);
+
+      if (diff == 0)
+        {
+          if (g_atomic_pointer_compare_and_exchange (&ring->enqueue_pos,
+                                                     pos, pos + 1))
+            break;
+        }
+      else if (diff < 0)
+        return FALSE;           /* full */
+
+      pos = RING_LOAD (&ring->enqueue_pos);
+    }
+
+  cell->data = data;
+  g_atomic_pointer_set (&cell->sequence, pos + 1);
+
+  return TRUE;
+}
+
+static gpointer
+ring_try_pop (GAsyncQueueRing *ring)
+{
+  GAsyncQueueCell *cell;
+  gsize pos = RING_LOAD (&ring->dequeue_pos);
+  gpointer data;
+
+  for (;;)
+    {
+      gssize diff;
+
+      cell = &ring->cells[pos & ring->mask];
+      diff = (gssize) (RING_LOAD (&cell->sequence) - (pos + 1));
+
+      if (diff == 0)
+        {
+          if (g_atomic_pointer_compare_and_exchange (&ring->dequeue_pos,
+                                                     pos, pos + 1))
+            break;
+        }
+      else if (diff < 0)
+        return NULL;            /* empty */
+
+      pos = RING_LOAD (&ring->dequeue_pos);
+    }
+
+  data = cell->data;
+  g_atomic_pointer_set (&cell->sequence, pos + ring->mask + 1);
+
+  return data;
+}
+
+/* @locked tells whether the caller already holds queue->mutex */
+static void
+g_async_queue_push_ring (GAsyncQueue *queue,
+                         gpointer     data,
+                         gboolean     locked)
+{
+  GAsyncQueueRing *ring = queue->ring;
+
+  if (G_UNLIKELY (!ring_try_push (ring, data)))
+    {
+      if (!locked)
+        g_mutex_lock (&queue->mutex);
+
+      g_atomic_int_inc (&ring->waiting_pushers);
+      while (!ring_try_push (ring, data))
+        g_cond_wait (&ring->space_cond, &queue->mutex);
+      g_atomic_int_add (&ring->waiting_pushers, -1);
+
+      if (!locked)
+        g_mutex_unlock (&queue->mutex);
+    }
+
+  if (g_atomic_int_get (&queue->waiting_threads) > 0)
+    {
+      if (!locked)
+        g_mutex_lock (&queue->mutex);
+      g_cond_signal (&queue->cond);
+      if (!locked)
+        g_mutex_unlock (&queue->mutex);
+    }
+}
+
+static gpointer
+g_async_queue_pop_ring (GAsyncQueue *queue,
+                        gboolean     wait,
+                        gint64       end_time,
+                        gboolean     locked)
+{
+  GAsyncQueueRing *ring = queue->ring;
+  gpointer retval;
+
+  retval = ring_try_pop (ring);
+
+  if (!retval && wait)
+    {
+      if (!locked)
+        g_mutex_lock (&queue->mutex);
+
+      g_atomic_int_inc (&queue->waiting_threads);
+      while (!(retval = ring_try_pop (ring)))
+        {
+          if (end_time == -1)
+            g_cond_wait (&queue->cond, &queue->mutex);
+          else if (!g_cond_wait_until (&queue->cond, &queue->mutex, end_time))
+            {
+              retval = ring_try_pop (ring);
+              break;
+            }
+        }
+      g_atomic_int_add (&queue->waiting_threads, -1);
+
+      if (!locked)
+        g_mutex_unlock (&queue->mutex);
+    }
+
+  if (retval && g_atomic_int_get (&ring->waiting_pushers) > 0)
+    {
+      if (!locked)
+        g_mutex_lock (&queue->mutex);
+      g_cond_signal (&ring->space_cond);
+      if (!locked)
+        g_mutex_unlock (&queue->mutex);
+    }
+
+  return retval;
+}
+
 /**
  * g_async_queue_new:
  *
@@ -147,6 +320,58 @@ g_async_queue_new_full (GDestroyNotify item_free_func)
   queue->waiting_threads = 0;
   queue->ref_count = 1;
   queue->item_free_func = item_free_func;
+  queue->ring = NULL;
+
+  return queue;
+}
+
+/**
+ * g_async_queue_new_bounded:
+ * @capacity: the maximum number of items in the queue
+ * @item_free_func: (allow-none): function to free queue elements
+ *
+ * Creates a new asynchronous queue that holds at most @capacity items,
+ * rounded up to the next power of two.
+ *
+ * Pushing to and popping from a bounded queue doesn't take the queue's
+ * lock as long as the queue is neither empty nor full, which avoids
+ * contention between threads that produce and consume items at a high
+ * rate. The lock is only taken to sleep in g_async_queue_pop() and
+ * friends on an empty queue, and in g_async_queue_push() on a full
+ * queue, which blocks until another thread popped an item.
+ *
+ * Since the queue's lock does not protect the items of a bounded queue,
+ * holding it doesn't prevent other threads from pushing and popping,
+ * and bounded queues can't be sorted with g_async_queue_sort() or
+ * g_async_queue_push_sorted().
+ *
+ * Return value: a new #GAsyncQueue. Free with g_async_queue_unref()
+ *
+ * Since: 2.32
+ */
+GAsyncQueue *
+g_async_queue_new_bounded (guint          capacity,
+                           GDestroyNotify item_free_func)
+{
+  GAsyncQueue *queue;
+  GAsyncQueueRing *ring;
+  gsize size = 2, i;
+
+  g_return_val_if_fail (capacity > 0, NULL);
+
+  while (size < capacity)
+    size <<= 1;
+
+  queue = g_async_queue_new_full (item_free_func);
+
+  ring = g_new0 (GAsyncQueueRing, 1);
+  ring->cells = g_new (GAsyncQueueCell, size);
+  ring->mask = size - 1;
+  for (i = 0; i < size; i++)
+    ring->cells[i].sequence = i;
+  g_cond_init (&ring->space_cond);
+
+  queue->ring = ring;
 
   return queue;
 }
@@ -234,6 +459,17 @@ g_async_queue_unref (GAsyncQueue *queue)
       if (queue->item_free_func)
         g_queue_foreach (&queue->queue, (GFunc) queue->item_free_func, NULL);
       g_queue_clear (&queue->queue);
+      if (queue->ring)
+        {
+          gpointer data;
+
+          while ((data = ring_try_pop (queue->ring)))
+            if (queue->item_free_func)
+              queue->item_free_func (data);
+          g_cond_clear (&queue->ring->space_cond);
+          g_free (queue->ring->cells);
+          g_free (queue->ring);
+        }
       g_free (queue);
     }
 }
@@ -292,6 +528,12 @@ g_async_queue_push (GAsyncQueue *queue,
   g_return_if_fail (queue);
   g_return_if_fail (data);
 
+  if (queue->ring)
+    {
+      g_async_queue_push_ring (queue, data, FALSE);
+      return;
+    }
+
   g_mutex_lock (&queue->mutex);
   g_async_queue_push_unlocked (queue, data);
   g_mutex_unlock (&queue->mutex);
@@ -313,6 +555,12 @@ g_async_queue_push_unlocked (GAsyncQueue *queue,
   g_return_if_fail (queue);
   g_return_if_fail (data);
 
+  if (queue->ring)
+    {
+      g_async_queue_push_ring (queue, data, TRUE);
+      return;
+    }
+
   g_queue_push_head (&queue->queue, data);
   if (queue->waiting_threads > 0)
     g_cond_signal (&queue->cond);
@@ -393,6 +641,7 @@ g_async_queue_push_sorted_unlocked (GAsyncQueue      *queue,
   SortData sd;
 
   g_return_if_fail (queue != NULL);
+  g_return_if_fail (queue->ring == NULL);
 
   sd.func = func;
   sd.user_data = user_data;
@@ -412,6 +661,9 @@ g_async_queue_pop_intern_unlocked (GAsyncQueue *queue,
 {
   gpointer retval;
 
+  if (queue->ring)
+    return g_async_queue_pop_ring (queue, wait, end_time, TRUE);
+
   if (!g_queue_peek_tail_link (&queue->queue) && wait)
     {
       queue->waiting_threads++;
@@ -451,6 +703,9 @@ g_async_queue_pop (GAsyncQueue *queue)
 
   g_return_val_if_fail (queue, NULL);
 
+  if (queue->ring)
+    return g_async_queue_pop_ring (queue, TRUE, -1, FALSE);
+
   g_mutex_lock (&queue->mutex);
   retval = g_async_queue_pop_intern_unlocked (queue, TRUE, -1);
   g_mutex_unlock (&queue->mutex);
@@ -494,6 +749,9 @@ g_async_queue_try_pop (GAsyncQueue *queue)
 
   g_return_val_if_fail (queue, NULL);
 
+  if (queue->ring)
+    return g_async_queue_pop_ring (queue, FALSE, -1, FALSE);
+
   g_mutex_lock (&queue->mutex);
   retval = g_async_queue_pop_intern_unlocked (queue, FALSE, -1);
   g_mutex_unlock (&queue->mutex);
@@ -541,6 +799,9 @@ g_async_queue_timeout_pop (GAsyncQueue *queue,
   gint64 end_time = g_get_monotonic_time () + timeout;
   gpointer retval;
 
+  if (queue->ring)
+    return g_async_queue_pop_ring (queue, TRUE, end_time, FALSE);
+
   g_mutex_lock (&queue->mutex);
   retval = g_async_queue_pop_intern_unlocked (queue, TRUE, end_time);
   g_mutex_unlock (&queue->mutex);
@@ -608,6 +869,9 @@ g_async_queue_timed_pop (GAsyncQueue *queue,
   else
     m_end_time = -1;
 
+  if (queue->ring)
+    return g_async_queue_pop_ring (queue, TRUE, m_end_time, FALSE);
+
   g_mutex_lock (&queue->mutex);
   retval = g_async_queue_pop_intern_unlocked (queue, TRUE, m_end_time);
   g_mutex_unlock (&queue->mutex);
@@ -677,6 +941,9 @@ g_async_queue_length (GAsyncQueue *queue)
 
   g_return_val_if_fail (queue, 0);
 
+  if (queue->ring)
+    return g_async_queue_length_unlocked (queue);
+
   g_mutex_lock (&queue->mutex);
   retval = queue->queue.length - queue->waiting_threads;
   g_mutex_unlock (&queue->mutex);
@@ -706,6 +973,11 @@ g_async_queue_length_unlocked (GAsyncQueue *queue)
 {
   g_return_val_if_fail (queue, 0);
 
+  if (queue->ring)
+    return (gint) (RING_LOAD (&queue->ring->enqueue_pos) -
+                   RING_LOAD (&queue->ring->dequeue_pos)) -
+           (gint) g_atomic_int_get (&queue->waiting_threads);
+
   return queue->queue.length - queue->waiting_threads;
 }
 
@@ -780,6 +1052,7 @@ g_async_queue_sort_unlocked (GAsyncQueue      *queue,
 
   g_return_if_fail (queue != NULL);
   g_return_if_fail (func != NULL);
+  g_return_if_fail (queue->ring == NULL);
 
   sd.func = func;
   sd.user_data = user_data;
@@ -39,6 +39,8 @@ typedef struct _GAsyncQueue GAsyncQueue;
 
 GAsyncQueue *g_async_queue_new                  (void);
 GAsyncQueue *g_async_queue_new_full             (GDestroyNotify item_free_func);
+GAsyncQueue *g_async_queue_new_bounded          (guint          capacity,
+                                                 GDestroyNotify item_free_func);
 void         g_async_queue_lock                 (GAsyncQueue      *queue);
 void         g_async_queue_unlock               (GAsyncQueue      *queue);
 GAsyncQueue *g_async_queue_ref                  (GAsyncQueue      *queue);
@@ -51,6 +51,7 @@
 #include "gtestutils.h"
 #include "gthread.h"
 #include "gunicode.h"
+#include "gunicodeprivate.h"
 #include "gfileutils.h"
 
 #ifdef NEED_ICONV_CACHE
@@ -875,6 +876,99 @@ g_convert_with_iconv (const gchar *str,
  *               nul-terminated string, which must be freed with
  *               g_free(). Otherwise %NULL and @error will be set.
  **/
+static gboolean
+is_utf8_codeset (const gchar *codeset)
+{
+  return g_ascii_strcasecmp (codeset, "UTF-8") == 0 ||
+         g_ascii_strcasecmp (codeset, "UTF8") == 0;
+}
+
+/* Returns G_BIG_ENDIAN or G_LITTLE_ENDIAN for UTF-16 with an explicit
+ * byte order, 0 for anything else
+ */
+static gint
+utf16_codeset_byte_order (const gchar *codeset)
+{
+  if (g_ascii_strcasecmp (codeset, "UTF-16BE") == 0)
+    return G_BIG_ENDIAN;
+  if (g_ascii_strcasecmp (codeset, "UTF-16LE") == 0)
+    return G_LITTLE_ENDIAN;
+
+  return 0;
+}
+
+/*
+ * convert_ascii:
+ *
+ * Converts ASCII-only text between UTF-8 and UTF-16BE/LE without going
+ * through iconv. Returns %NULL if the codesets aren't handled here or
+ * @str isn't pure ASCII, leaving the conversion to iconv; the result
+ * is the same as iconv would produce otherwise.
+ */
+static gchar *
+convert_ascii (const gchar *str,
+               gssize       len,
+               const gchar *to_codeset,
+               const gchar *from_codeset,
+               gsize       *bytes_read,
+               gsize       *bytes_written)
+{
+  gchar *dest;
+  gint order;
+
+  if ((order = utf16_codeset_byte_order (from_codeset)) &&
+      is_utf8_codeset (to_codeset))
+    {
+      gsize n_units;
+
+      /* partial characters need the error handling of the slow path */
+      if (len < 0 || len % 2)
+        return NULL;
+
+      n_units = len / 2;
+      dest = g_malloc (n_units + NUL_TERMINATOR_LENGTH);
+
+      if (_g_utf16_ascii_to_utf8 (dest, (const guchar *) str, n_units,
+                                  order == G_BIG_ENDIAN) != n_units)
+        {
+          g_free (dest);
+          return NULL;
+        }
+
+      memset (dest + n_units, 0, NUL_TERMINATOR_LENGTH);
+
+      if (bytes_read)
+        *bytes_read = len;
+      if (bytes_written)
+        *bytes_written = n_units;
+
+      return dest;
+    }
+
+  if ((order = utf16_codeset_byte_order (to_codeset)) &&
+      is_utf8_codeset (from_codeset))
+    {
+      if (len < 0)
+        len = strlen (str);
+
+      if (_g_utf8_ascii_prefix (str, len) != (gsize) len)
+        return NULL;
+
+      dest = g_malloc (len * 2 + NUL_TERMINATOR_LENGTH);
+      _g_ascii_to_utf16 ((guchar *) dest, str, len, order == G_BIG_ENDIAN);
+      memset (dest + len * 2, 0, NUL_TERMINATOR_LENGTH);
+
+      if (bytes_read)
+        *bytes_read = len;
+      if (bytes_written)
+        *bytes_written = len * 2;
+
+      return dest;
+    }
+
+  return NULL;
+}
+
 gchar*
 g_convert (const gchar *str,
            gssize       len,  
@@ -890,6 +984,12 @@ g_convert (const gchar *str,
   g_return_val_if_fail (str != NULL, NULL);
   g_return_val_if_fail (to_codeset != NULL, NULL);
   g_return_val_if_fail (from_codeset != NULL, NULL);
+
+  /* names in OBEX headers, Bluetooth device names: mostly ASCII */
+  res = convert_ascii (str, len, to_codeset, from_codeset,
+                       bytes_read, bytes_written);
+  if (res)
+    return res;
   
   cd = open_converter (to_codeset, from_codeset, error);
 
@@ -34,6 +34,7 @@
 
 #include "ghash.h"
 
+#include "gquark.h"
 #include "gstrfuncs.h"
 #include "gatomic.h"
 #include "gtestutils.h"
@@ -245,6 +246,168 @@
 #define HASH_IS_TOMBSTONE(h_) ((h_) == TOMBSTONE_HASH_VALUE)
 #define HASH_IS_REAL(h_) ((h_) >= 2)
 
+/* Besides the cached hash value every bucket has a control byte,
+ * holding 7 bits of the (remixed) hash for used buckets. Lookups scan
+ * a whole group of control bytes at once and only look at the hashes
+ * and keys of the buckets whose bits match.
+ *
+ * The first group is mirrored behind the end of the table so that a
+ * group can be loaded at any bucket without wrapping around.
+ */
+#define CTRL_EMPTY ((guint8) 0x80)
+#define CTRL_DELETED ((guint8) 0xfe)
+#define CTRL_H2(h_) ((guint8) (((h_) * 0x9e3779b1U) >> 25))
+
+#if defined (__SSE2__)
+
+#include <emmintrin.h>
+
+/* one bit per bucket */
+#define CTRL_GROUP_WIDTH 16
+#define CTRL_MASK_SHIFT 0
+
+static inline guint64
+ctrl_group_match (const guint8 *group,
+                  guint8        h2)
+{
+  __m128i ctrl = _mm_loadu_si128 ((const __m128i *) group);
+
+  return _mm_movemask_epi8 (_mm_cmpeq_epi8 (ctrl, _mm_set1_epi8 ((gchar) h2)));
+}
+
+static inline guint64
+ctrl_group_match_empty (const guint8 *group)
+{
+  return ctrl_group_match (group, CTRL_EMPTY);
+}
+
+static inline guint64
+ctrl_group_match_free (const guint8 *group)
+{
+  /* empty and deleted buckets have the top bit set */
+  return _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i *) group));
+}
+
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__)
+
+#include <arm_neon.h>
+
+/* one nibble per bucket, only its top bit is kept */
+#define CTRL_GROUP_WIDTH 16
+#define CTRL_MASK_SHIFT 2
+
+static inline guint64
+ctrl_neon_mask (uint8x16_t bytes)
+{
+  uint8x8_t nibbles = vshrn_n_u16 (vreinterpretq_u16_u8 (bytes), 4);
+
+  return vget_lane_u64 (vreinterpret_u64_u8 (nibbles), 0) &
+    G_GUINT64_CONSTANT (0x8888888888888888);
+}
+
+static inline guint64
+ctrl_group_match (const guint8 *group,
+                  guint8        h2)
+{
+  return ctrl_neon_mask (vceqq_u8 (vld1q_u8 (group), vdupq_n_u8 (h2)));
+}
+
+static inline guint64
+ctrl_group_match_empty (const guint8 *group)
+{
+  return ctrl_group_match (group, CTRL_EMPTY);
+}
+
+static inline guint64
+ctrl_group_match_free (const guint8 *group)
+{
+  return ctrl_neon_mask (vcltq_s8 (vld1q_s8 ((const int8_t *) group),
+                                   vdupq_n_s8 (0)));
+}
+
+#else
+
+/* Portable version working on 8 buckets in a 64 bit word, with the top
+ * bit of every byte standing for its bucket.
+ */
+#define CTRL_GROUP_WIDTH 8
+#define CTRL_MASK_SHIFT 3
+
+#define CTRL_LSB G_GUINT64_CONSTANT (0x0101010101010101)
+#define CTRL_MSB G_GUINT64_CONSTANT (0x8080808080808080)
+
+static inline guint64
+ctrl_group_load (const guint8 *group)
+{
+  guint64 word;
+
+  memcpy (&word, group, sizeof (word));
+
+  return GUINT64_FROM_LE (word);
+}
+
+static inline guint64
+ctrl_group_match (const guint8 *group,
+                  guint8        h2)
+{
+  guint64 x = ctrl_group_load (group) ^ (CTRL_LSB * h2);
+
+  /* May report false positives above a real match, which are then
+   * filtered out by the hash comparison.
+   */
+  return (x - CTRL_LSB) & ~x & CTRL_MSB;
+}
+
+static inline guint64
+ctrl_group_match_empty (const guint8 *group)
+{
+  guint64 word = ctrl_group_load (group);
+
+  /* empty is the only value with the top bit set and bit 6 clear */
+  return word & ~(word << 1) & CTRL_MSB;
+}
+
+static inline guint64
+ctrl_group_match_free (const guint8 *group)
+{
+  return ctrl_group_load (group) & CTRL_MSB;
+}
+
+#endif
+
+static inline guint
+ctrl_mask_first (guint64 mask)
+{
+#if defined (__GNUC__) && __GNUC__ >= 4
+  return __builtin_ctzll (mask) >> CTRL_MASK_SHIFT;
+#else
+  guint i = 0;
+
+  while (!(mask & 1))
+    {
+      mask >>= 1;
+      i++;
+    }
+
+  return i >> CTRL_MASK_SHIFT;
+#endif
+}
+
+static inline void
+ctrl_set (guint8 *ctrl,
+          gint    size,
+          guint   i,
+          guint8  value)
+{
+  ctrl[i] = value;
+
+  /* keep the mirrored copy of the first group in sync; tables smaller
+   * than a group are mirrored more than once
+   */
+  for (; i < CTRL_GROUP_WIDTH; i += size)
+    ctrl[size + i] = value;
+}
+
 struct _GHashTable
 {
   gint             size;
@@ -270,6 +433,9 @@ struct _GHashTable
 #endif
   GDestroyNotify   key_destroy_func;
   GDestroyNotify   value_destroy_func;
+
+  guint8          *ctrl;       /* size + CTRL_GROUP_WIDTH control bytes */
+  gboolean         interned;
 };
 
 typedef struct
@@ -392,11 +558,12 @@ g_hash_table_lookup_node (GHashTable    *hash_table,
                           guint         *hash_return)
 {
   guint node_index;
-  guint node_hash;
   guint hash_value;
-  guint first_tombstone = 0;
-  gboolean have_tombstone = FALSE;
+  guint first_free = 0;
+  gboolean have_free = FALSE;
+  guint group_index;
   guint step = 0;
+  guint8 h2;
 
   hash_value = hash_table->hash_func (key);
   if (G_UNLIKELY (!HASH_IS_REAL (hash_value)))
@@ -404,45 +571,61 @@ g_hash_table_lookup_node (GHashTable    *hash_table,
 
   *hash_return = hash_value;
 
-  node_index = hash_value % hash_table->mod;
-  node_hash = hash_table->hashes[node_index];
+  h2 = CTRL_H2 (hash_value);
+  group_index = hash_value % hash_table->mod;
 
-  while (!HASH_IS_UNUSED (node_hash))
+  while (TRUE)
     {
-      /* We first check if our full hash values
-       * are equal so we can avoid calling the full-blown
-       * key equality function in most cases.
-       */
-      if (node_hash == hash_value)
+      const guint8 *group = hash_table->ctrl + group_index;
+      guint64 match = ctrl_group_match (group, h2);
+
+      while (match)
         {
-          gpointer node_key = hash_table->keys[node_index];
+          node_index = (group_index + ctrl_mask_first (match)) & hash_table->mask;
 
-          if (hash_table->key_equal_func)
+          /* We first check if our full hash values
+           * are equal so we can avoid calling the full-blown
+           * key equality function in most cases.
+           */
+          if (hash_table->hashes[node_index] == hash_value)
             {
-              if (hash_table->key_equal_func (node_key, key))
+              gpointer node_key = hash_table->keys[node_index];
+
+              if (node_key == key &&
+                  (hash_table->interned || !hash_table->key_equal_func))
+                return node_index;
+
+              if (hash_table->key_equal_func &&
+                  hash_table->key_equal_func (node_key, key))
                 return node_index;
             }
-          else if (node_key == key)
-            {
-              return node_index;
-            }
+
+          match &= match - 1;
         }
-      else if (HASH_IS_TOMBSTONE (node_hash) && !have_tombstone)
+
+      if (!have_free)
         {
-          first_tombstone = node_index;
-          have_tombstone = TRUE;
+          guint64 free_mask = ctrl_group_match_free (group);
+
+          if (free_mask)
+            {
+              first_free = (group_index + ctrl_mask_first (free_mask)) & hash_table->mask;
+              have_free = TRUE;
+            }
         }
 
-      step++;
-      node_index += step;
-      node_index &= hash_table->mask;
-      node_hash = hash_table->hashes[node_index];
-    }
+      /* An empty bucket ends the probe sequence: the key would have
+       * been inserted there.
+       */
+      if (ctrl_group_match_empty (group))
+        break;
 
-  if (have_tombstone)
-    return first_tombstone;
+      step += CTRL_GROUP_WIDTH;
+      group_index += step;
+      group_index &= hash_table->mask;
+    }
 
-  return node_index;
+  return first_free;
 }
 
 /*
@@ -470,6 +653,7 @@ g_hash_table_remove_node (GHashTable   *hash_table,
 
   /* Erect tombstone */
   hash_table->hashes[i] = TOMBSTONE_HASH_VALUE;
+  ctrl_set (hash_table->ctrl, hash_table->size, i, CTRL_DELETED);
 
   /* Be GC friendly */
   hash_table->keys[i] = NULL;
@@ -507,6 +691,8 @@ g_hash_table_remove_all_nodes (GHashTable *hash_table,
   hash_table->nnodes = 0;
   hash_table->noccupied = 0;
 
+  memset (hash_table->ctrl, CTRL_EMPTY, hash_table->size + CTRL_GROUP_WIDTH);
+
   if (!notify ||
       (hash_table->key_destroy_func == NULL &&
        hash_table->value_destroy_func == NULL))
@@ -561,6 +747,7 @@ g_hash_table_resize (GHashTable *hash_table)
   gpointer *new_keys;
   gpointer *new_values;
   guint *new_hashes;
+  guint8 *new_ctrl;
   gint old_size;
   gint i;
 
@@ -573,10 +760,13 @@ g_hash_table_resize (GHashTable *hash_table)
   else
     new_values = g_new0 (gpointer, hash_table->size);
   new_hashes = g_new0 (guint, hash_table->size);
+  new_ctrl = g_malloc (hash_table->size + CTRL_GROUP_WIDTH);
+  memset (new_ctrl, CTRL_EMPTY, hash_table->size + CTRL_GROUP_WIDTH);
 
   for (i = 0; i < old_size; i++)
     {
       guint node_hash = hash_table->hashes[i];
+      guint64 empty;
       guint hash_val;
       guint step = 0;
 
@@ -585,13 +775,16 @@ g_hash_table_resize (GHashTable *hash_table)
 
       hash_val = node_hash % hash_table->mod;
 
-      while (!HASH_IS_UNUSED (new_hashes[hash_val]))
+      while (!(empty = ctrl_group_match_empty (new_ctrl + hash_val)))
         {
-          step++;
+          step += CTRL_GROUP_WIDTH;
           hash_val += step;
           hash_val &= hash_table->mask;
         }
 
+      hash_val = (hash_val + ctrl_mask_first (empty)) & hash_table->mask;
+
+      ctrl_set (new_ctrl, hash_table->size, hash_val, CTRL_H2 (node_hash));
       new_hashes[hash_val] = hash_table->hashes[i];
       new_keys[hash_val] = hash_table->keys[i];
       new_values[hash_val] = hash_table->values[i];
@@ -602,10 +795,12 @@ g_hash_table_resize (GHashTable *hash_table)
 
   g_free (hash_table->keys);
   g_free (hash_table->hashes);
+  g_free (hash_table->ctrl);
 
   hash_table->keys = new_keys;
   hash_table->values = new_values;
   hash_table->hashes = new_hashes;
+  hash_table->ctrl = new_ctrl;
 
   hash_table->noccupied = hash_table->nnodes;
 }
@@ -701,6 +896,45 @@ g_hash_table_new_full (GHashFunc      hash_func,
   hash_table->keys               = g_new0 (gpointer, hash_table->size);
   hash_table->values             = hash_table->keys;
   hash_table->hashes             = g_new0 (guint, hash_table->size);
+  hash_table->ctrl               = g_malloc (hash_table->size + CTRL_GROUP_WIDTH);
+  hash_table->interned           = FALSE;
+
+  memset (hash_table->ctrl, CTRL_EMPTY, hash_table->size + CTRL_GROUP_WIDTH);
+
+  return hash_table;
+}
+
+/**
+ * g_hash_table_new_interned:
+ * @value_destroy_func: (allow-none): a function to free the memory allocated
+ *     for the value used when removing the entry from the #GHashTable, or
+ *     %NULL if you don't want to supply such a function.
+ *
+ * Creates a new #GHashTable with string keys, like
+ * g_hash_table_new_full (g_str_hash, g_str_equal, NULL, @value_destroy_func)
+ * would, but which stores its keys as interned strings.
+ *
+ * Keys passed to g_hash_table_insert(), g_hash_table_replace() and
+ * g_hash_table_add() are run through g_intern_string(), so the caller
+ * keeps ownership of them and doesn't need to copy them. Lookups with
+ * a key that was interned as well are resolved by pointer comparison,
+ * without comparing the strings; any other string key still works.
+ *
+ * This suits tables with a limited set of keys which are looked up
+ * very often, such as object paths or interface names.
+ *
+ * Return value: a new #GHashTable
+ *
+ * Since: 2.32
+ */
+GHashTable *
+g_hash_table_new_interned (GDestroyNotify value_destroy_func)
+{
+  GHashTable *hash_table;
+
+  hash_table = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                      NULL, value_destroy_func);
+  hash_table->interned = TRUE;
 
   return hash_table;
 }
@@ -897,6 +1131,7 @@ g_hash_table_insert_node (GHashTable *hash_table,
       hash_table->keys[node_index] = key;
       hash_table->values[node_index] = value;
       hash_table->hashes[node_index] = key_hash;
+      ctrl_set (hash_table->ctrl, hash_table->size, node_index, CTRL_H2 (key_hash));
 
       hash_table->nnodes++;
 
@@ -1026,6 +1261,7 @@ g_hash_table_unref (GHashTable *hash_table)
         g_free (hash_table->values);
       g_free (hash_table->keys);
       g_free (hash_table->hashes);
+      g_free (hash_table->ctrl);
       g_slice_free (GHashTable, hash_table);
     }
 }
@@ -1148,6 +1384,15 @@ g_hash_table_insert_internal (GHashTable *hash_table,
 
   g_return_if_fail (hash_table != NULL);
 
+  if (hash_table->interned)
+    {
+      gpointer interned_key = (gpointer) g_intern_string (key);
+
+      if (value == key)
+        value = interned_key;
+      key = interned_key;
+    }
+
   node_index = g_hash_table_lookup_node (hash_table, key, &key_hash);
 
   g_hash_table_insert_node (hash_table, node_index, key_hash, key, value, keep_new_key, FALSE);
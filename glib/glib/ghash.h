@@ -61,6 +61,7 @@ GHashTable* g_hash_table_new_full          (GHashFunc       hash_func,
                                             GEqualFunc      key_equal_func,
                                             GDestroyNotify  key_destroy_func,
                                             GDestroyNotify  value_destroy_func);
+GHashTable* g_hash_table_new_interned      (GDestroyNotify  value_destroy_func);
 void        g_hash_table_destroy           (GHashTable     *hash_table);
 void        g_hash_table_insert            (GHashTable     *hash_table,
                                             gpointer        key,
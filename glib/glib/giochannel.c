@@ -1991,6 +1991,34 @@ g_io_channel_read_to_end (GIOChannel  *channel,
   return G_IO_STATUS_NORMAL;
 }
 
+static GIOStatus
+g_io_channel_read_direct (GIOChannel  *channel,
+                          gchar       *buf,
+                          gsize        count,
+                          gsize       *bytes_read,
+                          GError     **error)
+{
+  GIOStatus status = G_IO_STATUS_NORMAL;
+  gsize got_bytes = 0;
+
+  /* Keep reading until count is reached, like the buffered path does */
+  while (got_bytes < count && status == G_IO_STATUS_NORMAL)
+    {
+      gsize tmp_bytes;
+
+      status = channel->funcs->io_read (channel, buf + got_bytes,
+                                        count - got_bytes, &tmp_bytes,
+                                        got_bytes > 0 ? NULL : error);
+      got_bytes += tmp_bytes;
+    }
+
+  if (bytes_read)
+    *bytes_read = got_bytes;
+
+  /* Only return an error if we have no data */
+  return got_bytes > 0 ? G_IO_STATUS_NORMAL : status;
+}
+
 /**
  * g_io_channel_read_chars:
  * @channel: a #GIOChannel
@@ -2045,6 +2073,15 @@ g_io_channel_read_chars (GIOChannel  *channel,
       return status;
     }
 
+  /* Reads of at least a buffer's worth of raw data go straight into the
+   * caller's memory instead of being copied through read_buf.
+   */
+  if (!channel->encoding && count >= channel->buf_size &&
+      BUF_LEN (channel->read_buf) == 0 &&
+      BUF_LEN (channel->write_buf) == 0 &&
+      channel->partial_write_buf[0] == '\0')
+    return g_io_channel_read_direct (channel, buf, count, bytes_read, error);
+
   status = G_IO_STATUS_NORMAL;
 
   while (BUF_LEN (USE_BUF (channel)) < count && status == G_IO_STATUS_NORMAL)
@@ -306,6 +306,25 @@ GIOChannelError g_io_channel_error_from_errno (gint en);
 GIOChannel* g_io_channel_unix_new    (int         fd);
 gint        g_io_channel_unix_get_fd (GIOChannel *channel);
 
+#ifdef G_OS_UNIX
+
+typedef struct _GIOChannelPacket GIOChannelPacket;
+
+struct _GIOChannelPacket
+{
+  gchar *buf;
+  gsize  size;
+  gsize  bytes_read;
+};
+
+GIOStatus   g_io_channel_unix_read_packets (GIOChannel        *channel,
+                                            GIOChannelPacket  *packets,
+                                            guint              n_packets,
+                                            guint             *packets_read,
+                                            GError           **error);
+
+#endif /* G_OS_UNIX */
+
 
 /* Hook for GClosure / GSource integration. Don't touch */
 GLIB_VAR GSourceFuncs g_io_watch_funcs;
@@ -42,6 +42,7 @@
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
+#include <sys/socket.h>
 
 #include "giochannel.h"
 
@@ -656,3 +657,136 @@ g_io_channel_unix_get_fd (GIOChannel *channel)
   GIOUnixChannel *unix_channel = (GIOUnixChannel *)channel;
   return unix_channel->fd;
 }
+
+/**
+ * GIOChannelPacket:
+ * @buf: the buffer to read the packet into
+ * @size: the size of @buf
+ * @bytes_read: the length of the packet that was read, set by
+ *     g_io_channel_unix_read_packets()
+ *
+ * Describes one buffer for g_io_channel_unix_read_packets().
+ *
+ * Since: 2.32
+ */
+
+/**
+ * g_io_channel_unix_read_packets:
+ * @channel: an unbuffered #GIOChannel created with g_io_channel_unix_new()
+ * @packets: (array length=n_packets): buffers to read packets into
+ * @n_packets: the number of elements in @packets
+ * @packets_read: (out): location to store the number of packets read
+ * @error: a location to return an error of type #GIOChannelError
+ *
+ * Reads up to @n_packets packets from a datagram or sequential packet
+ * socket at once, each one into its own buffer of @packets. Data is
+ * read from the file descriptor straight into the buffers provided by
+ * the caller, and on Linux a whole batch is read with a single system
+ * call. Packets longer than the buffer are truncated.
+ *
+ * Only the first packet is waited for on a blocking socket; the
+ * function returns as soon as no further packets are queued. For other
+ * kinds of file descriptors one read is made into the first buffer.
+ *
+ * Since the channel's buffer is bypassed, @channel must not be buffered,
+ * see g_io_channel_set_buffered().
+ *
+ * Return value: %G_IO_STATUS_NORMAL if at least one packet was read,
+ *     %G_IO_STATUS_EOF if the peer closed the connection,
+ *     %G_IO_STATUS_AGAIN if no packet was queued on a non-blocking
+ *     socket, or %G_IO_STATUS_ERROR
+ *
+ * Since: 2.32
+ **/
+GIOStatus
+g_io_channel_unix_read_packets (GIOChannel        *channel,
+                                GIOChannelPacket  *packets,
+                                guint              n_packets,
+                                guint             *packets_read,
+                                GError           **error)
+{
+  GIOUnixChannel *unix_channel = (GIOUnixChannel *)channel;
+  GIOStatus status;
+  guint i;
+
+  g_return_val_if_fail (channel != NULL, G_IO_STATUS_ERROR);
+  g_return_val_if_fail (channel->funcs == &unix_channel_funcs, G_IO_STATUS_ERROR);
+  g_return_val_if_fail (channel->is_readable, G_IO_STATUS_ERROR);
+  g_return_val_if_fail (!channel->use_buffer, G_IO_STATUS_ERROR);
+  g_return_val_if_fail (packets != NULL || n_packets == 0, G_IO_STATUS_ERROR);
+  g_return_val_if_fail (error == NULL || *error == NULL, G_IO_STATUS_ERROR);
+
+  if (packets_read)
+    *packets_read = 0;
+
+  if (n_packets == 0)
+    return G_IO_STATUS_NORMAL;
+
+  for (i = 0; i < n_packets; i++)
+    packets[i].bytes_read = 0;
+
+#if defined (HAVE_RECVMMSG) && defined (MSG_WAITFORONE)
+  if (n_packets > 1)
+    {
+      struct mmsghdr msgs[16];
+      struct iovec iov[G_N_ELEMENTS (msgs)];
+      guint n = MIN (n_packets, G_N_ELEMENTS (msgs));
+      int result;
+
+      memset (msgs, 0, sizeof (struct mmsghdr) * n);
+      for (i = 0; i < n; i++)
+        {
+          iov[i].iov_base = packets[i].buf;
+          iov[i].iov_len = packets[i].size;
+          msgs[i].msg_hdr.msg_iov = &iov[i];
+          msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+    retry:
+      result = recvmmsg (unix_channel->fd, msgs, n, MSG_WAITFORONE, NULL);
+      if (result > 0)
+        {
+          for (i = 0; i < (guint) result; i++)
+            packets[i].bytes_read = msgs[i].msg_len;
+
+          if (packets_read)
+            *packets_read = result;
+
+          /* as with read(), an empty first packet means end of file */
+          return packets[0].bytes_read > 0 ? G_IO_STATUS_NORMAL
+                                           : G_IO_STATUS_EOF;
+        }
+
+      if (result < 0)
+        {
+          int errsv = errno;
+
+          switch (errsv)
+            {
+            case EINTR:
+              goto retry;
+            case EAGAIN:
+              return G_IO_STATUS_AGAIN;
+            case ENOTSOCK:
+            case ENOSYS:
+              /* fall back to a plain read */
+              break;
+            default:
+              g_set_error_literal (error, G_IO_CHANNEL_ERROR,
+                                   g_io_channel_error_from_errno (errsv),
+                                   g_strerror (errsv));
+              return G_IO_STATUS_ERROR;
+            }
+        }
+      else
+        return G_IO_STATUS_EOF;
+    }
+#endif
+
+  status = g_io_unix_read (channel, packets[0].buf, packets[0].size,
+                           &packets[0].bytes_read, error);
+  if (status == G_IO_STATUS_NORMAL && packets_read)
+    *packets_read = 1;
+
+  return status;
+}
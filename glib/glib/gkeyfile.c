@@ -59,6 +59,7 @@
 #include "glibintl.h"
 #include "glist.h"
 #include "gslist.h"
+#include "gmappedfile.h"
 #include "gmem.h"
 #include "gmessages.h"
 #include "gstdio.h"
@@ -507,9 +508,12 @@ static void                  g_key_file_add_group              (GKeyFile
 static gboolean              g_key_file_is_group_name          (const gchar *name);
 static gboolean              g_key_file_is_key_name            (const gchar *name);
 static void                  g_key_file_key_value_pair_free    (GKeyFileKeyValuePair   *pair);
-static gboolean              g_key_file_line_is_comment        (const gchar            *line);
-static gboolean              g_key_file_line_is_group          (const gchar            *line);
-static gboolean              g_key_file_line_is_key_value_pair (const gchar            *line);
+static gboolean              g_key_file_line_is_comment        (const gchar            *line,
+								gsize                   length);
+static gboolean              g_key_file_line_is_group          (const gchar            *line,
+								gsize                   length);
+static gboolean              g_key_file_line_is_key_value_pair (const gchar            *line,
+								gsize                   length);
 static gchar                *g_key_file_parse_value_as_string  (GKeyFile               *key_file,
 								const gchar            *value,
 								GSList                **separators,
@@ -741,6 +745,7 @@ g_key_file_load_from_fd (GKeyFile       *key_file,
 			 GError        **error)
 {
   GError *key_file_error = NULL;
+  GMappedFile *mapped;
   gssize bytes_read;
   struct stat stat_buf;
   gchar read_buf[4096];
@@ -768,29 +773,44 @@ g_key_file_load_from_fd (GKeyFile       *key_file,
   key_file->list_separator = list_separator;
   key_file->flags = flags;
 
-  do
+  /* Parse the whole file in one pass straight out of the page cache,
+   * so that lines don't have to be copied together across reads.
+   */
+  mapped = g_mapped_file_new_from_fd (fd, FALSE, NULL);
+  if (mapped != NULL)
+    {
+      g_key_file_parse_data (key_file,
+			     g_mapped_file_get_contents (mapped),
+			     g_mapped_file_get_length (mapped),
+			     &key_file_error);
+      g_mapped_file_unref (mapped);
+    }
+  else
     {
-      bytes_read = read (fd, read_buf, 4096);
+      do
+        {
+          bytes_read = read (fd, read_buf, 4096);
 
-      if (bytes_read == 0)  /* End of File */
-        break;
+          if (bytes_read == 0)  /* End of File */
+            break;
 
-      if (bytes_read < 0)
-        {
-          if (errno == EINTR || errno == EAGAIN)
-            continue;
+          if (bytes_read < 0)
+            {
+              if (errno == EINTR || errno == EAGAIN)
+                continue;
 
-          g_set_error_literal (error, G_FILE_ERROR,
-                               g_file_error_from_errno (errno),
-                               g_strerror (errno));
-          return FALSE;
-        }
+              g_set_error_literal (error, G_FILE_ERROR,
+                                   g_file_error_from_errno (errno),
+                                   g_strerror (errno));
+              return FALSE;
+            }
 
-      g_key_file_parse_data (key_file,
-			     read_buf, bytes_read,
-			     &key_file_error);
+          g_key_file_parse_data (key_file,
+				 read_buf, bytes_read,
+				 &key_file_error);
+        }
+      while (!key_file_error);
     }
-  while (!key_file_error);
 
   if (key_file_error)
     {
@@ -1134,34 +1154,38 @@ g_key_file_parse_line (GKeyFile     *key_file,
 		       GError      **error)
 {
   GError *parse_error = NULL;
-  gchar *line_start;
+  const gchar *line_start, *line_end;
+  gsize remaining;
 
   g_return_if_fail (key_file != NULL);
   g_return_if_fail (line != NULL);
 
-  line_start = (gchar *) line;
-  while (g_ascii_isspace (*line_start))
+  /* The line is not nul-terminated when parsed in place */
+  line_start = line;
+  line_end = line + length;
+  while (line_start < line_end && g_ascii_isspace (*line_start))
     line_start++;
 
-  if (g_key_file_line_is_comment (line_start))
+  remaining = line_end - line_start;
+
+  if (g_key_file_line_is_comment (line_start, remaining))
     g_key_file_parse_comment (key_file, line, length, &parse_error);
-  else if (g_key_file_line_is_group (line_start))
-    g_key_file_parse_group (key_file, line_start,
-			    length - (line_start - line),
-			    &parse_error);
-  else if (g_key_file_line_is_key_value_pair (line_start))
-    g_key_file_parse_key_value_pair (key_file, line_start,
-				     length - (line_start - line),
+  else if (g_key_file_line_is_group (line_start, remaining))
+    g_key_file_parse_group (key_file, line_start, remaining, &parse_error);
+  else if (g_key_file_line_is_key_value_pair (line_start, remaining))
+    g_key_file_parse_key_value_pair (key_file, line_start, remaining,
 				     &parse_error);
   else
     {
-      gchar *line_utf8 = _g_utf8_make_valid (line);
+      gchar *line_copy = g_strndup (line, length);
+      gchar *line_utf8 = _g_utf8_make_valid (line_copy);
       g_set_error (error, G_KEY_FILE_ERROR,
                    G_KEY_FILE_ERROR_PARSE,
                    _("Key file contains line '%s' which is not "
                      "a key-value pair, group, or comment"),
                    line_utf8);
       g_free (line_utf8);
+      g_free (line_copy);
 
       return;
     }
@@ -1230,7 +1254,8 @@ g_key_file_parse_key_value_pair (GKeyFile     *key_file,
 				 gsize         length,
 				 GError      **error)
 {
-  gchar *key, *value, *key_end, *value_start, *locale;
+  gchar *key, *value, *locale;
+  const gchar *key_end, *value_start, *line_end;
   gsize key_len, value_len;
 
   if (key_file->current_group == NULL || key_file->current_group->name == NULL)
@@ -1241,7 +1266,8 @@ g_key_file_parse_key_value_pair (GKeyFile     *key_file,
       return;
     }
 
-  key_end = value_start = strchr (line, '=');
+  line_end = line + length;
+  key_end = value_start = memchr (line, '=', length);
 
   g_warn_if_fail (key_end != NULL);
 
@@ -1270,19 +1296,19 @@ g_key_file_parse_key_value_pair (GKeyFile     *key_file,
 
   /* Pull the value from the line (chugging leading whitespace)
    */
-  while (g_ascii_isspace (*value_start))
+  while (value_start < line_end && g_ascii_isspace (*value_start))
     value_start++;
 
-  value_len = line + length - value_start + 1;
+  value_len = line_end - value_start;
 
   value = g_strndup (value_start, value_len);
 
   g_warn_if_fail (key_file->start_group != NULL);
 
+  /* Group names are unique, so comparing the groups is enough */
   if (key_file->current_group
       && key_file->current_group->name
-      && strcmp (key_file->start_group->name,
-                 key_file->current_group->name) == 0
+      && key_file->start_group == key_file->current_group
       && strcmp (key, "Encoding") == 0)
     {
       if (g_ascii_strcasecmp (value, "UTF-8") != 0)
@@ -1356,47 +1382,53 @@ g_key_file_parse_data (GKeyFile     *key_file,
   i = 0;
   while (i < length)
     {
-      if (data[i] == '\n')
-        {
-	  if (key_file->parse_buffer->len > 0
-	      && (key_file->parse_buffer->str[key_file->parse_buffer->len - 1]
-		  == '\r'))
-	    g_string_erase (key_file->parse_buffer,
-			    key_file->parse_buffer->len - 1,
-			    1);
-	    
-          /* When a newline is encountered flush the parse buffer so that the
-           * line can be parsed.  Note that completely blank lines won't show
-           * up in the parse buffer, so they get parsed directly.
-           */
-          if (key_file->parse_buffer->len > 0)
-            g_key_file_flush_parse_buffer (key_file, &parse_error);
-          else
-            g_key_file_parse_comment (key_file, "", 1, &parse_error);
+      const gchar *start_of_line;
+      const gchar *end_of_line;
+      gsize line_length;
 
-          if (parse_error)
-            {
-              g_propagate_error (error, parse_error);
-              return;
-            }
-          i++;
+      start_of_line = data + i;
+      end_of_line = memchr (start_of_line, '\n', length - i);
+
+      /* Keep an incomplete line until more data completes it or the
+       * parse buffer is flushed at the end of the file.
+       */
+      if (end_of_line == NULL)
+        {
+          g_string_append_len (key_file->parse_buffer, start_of_line,
+                               length - i);
+          break;
         }
-      else
+
+      line_length = end_of_line - start_of_line;
+      i += line_length + 1;
+
+      /* Only lines split across chunks are copied, all others are
+       * parsed in place.
+       */
+      if (key_file->parse_buffer->len > 0)
         {
-          const gchar *start_of_line;
-          const gchar *end_of_line;
-          gsize line_length;
+          g_string_append_len (key_file->parse_buffer, start_of_line,
+                               line_length);
+          start_of_line = key_file->parse_buffer->str;
+          line_length = key_file->parse_buffer->len;
+        }
 
-          start_of_line = data + i;
-          end_of_line = memchr (start_of_line, '\n', length - i);
+      if (line_length > 0 && start_of_line[line_length - 1] == '\r')
+        line_length--;
 
-          if (end_of_line == NULL)
-            end_of_line = data + length;
+      /* Completely blank lines are recorded as comments */
+      if (line_length > 0)
+        g_key_file_parse_line (key_file, start_of_line, line_length,
+                               &parse_error);
+      else
+        g_key_file_parse_comment (key_file, "", 1, &parse_error);
 
-          line_length = end_of_line - start_of_line;
+      g_string_truncate (key_file->parse_buffer, 0);
 
-          g_string_append_len (key_file->parse_buffer, start_of_line, line_length);
-          i += line_length;
+      if (parse_error)
+        {
+          g_propagate_error (error, parse_error);
+          return;
         }
     }
 }
@@ -1448,12 +1480,46 @@ g_key_file_to_data (GKeyFile  *key_file,
 		    gsize     *length,
 		    GError   **error)
 {
-  GString *data_string;
   GList *group_node, *key_file_node;
+  gchar *data, *p;
+  gsize size = 0;
 
   g_return_val_if_fail (key_file != NULL, NULL);
 
-  data_string = g_string_new (NULL);
+  /* Measure everything first so the output is allocated only once */
+  for (group_node = key_file->groups;
+       group_node != NULL;
+       group_node = group_node->next)
+    {
+      GKeyFileGroup *group;
+
+      group = (GKeyFileGroup *) group_node->data;
+
+      /* room for the separating empty line */
+      size++;
+
+      if (group->comment != NULL)
+        size += strlen (group->comment->value) + 1;
+
+      if (group->name != NULL)
+        size += strlen (group->name) + 3;
+
+      for (key_file_node = group->key_value_pairs;
+           key_file_node != NULL;
+           key_file_node = key_file_node->next)
+        {
+          GKeyFileKeyValuePair *pair;
+
+          pair = (GKeyFileKeyValuePair *) key_file_node->data;
+
+          if (pair->key != NULL)
+            size += strlen (pair->key) + 1;
+
+          size += strlen (pair->value) + 1;
+        }
+    }
+
+  p = data = g_malloc (size + 1);
 
   for (group_node = g_list_last (key_file->groups);
        group_node != NULL;
@@ -1464,15 +1530,22 @@ g_key_file_to_data (GKeyFile  *key_file,
       group = (GKeyFileGroup *) group_node->data;
 
       /* separate groups by at least an empty line */
-      if (data_string->len >= 2 &&
-          data_string->str[data_string->len - 2] != '\n')
-        g_string_append_c (data_string, '\n');
+      if (p - data >= 2 && p[-2] != '\n')
+        *p++ = '\n';
 
       if (group->comment != NULL)
-        g_string_append_printf (data_string, "%s\n", group->comment->value);
+        {
+          p = g_stpcpy (p, group->comment->value);
+          *p++ = '\n';
+        }
 
       if (group->name != NULL)
-        g_string_append_printf (data_string, "[%s]\n", group->name);
+        {
+          *p++ = '[';
+          p = g_stpcpy (p, group->name);
+          *p++ = ']';
+          *p++ = '\n';
+        }
 
       for (key_file_node = g_list_last (group->key_value_pairs);
            key_file_node != NULL;
@@ -1483,16 +1556,22 @@ g_key_file_to_data (GKeyFile  *key_file,
           pair = (GKeyFileKeyValuePair *) key_file_node->data;
 
           if (pair->key != NULL)
-            g_string_append_printf (data_string, "%s=%s\n", pair->key, pair->value);
-          else
-            g_string_append_printf (data_string, "%s\n", pair->value);
+            {
+              p = g_stpcpy (p, pair->key);
+              *p++ = '=';
+            }
+
+          p = g_stpcpy (p, pair->value);
+          *p++ = '\n';
         }
     }
 
+  *p = '\0';
+
   if (length)
-    *length = data_string->len;
+    *length = p - data;
 
-  return g_string_free (data_string, FALSE);
+  return data;
 }
 
 /**
@@ -3865,17 +3944,13 @@ g_key_file_lookup_group_node (GKeyFile    *key_file,
 			      const gchar *group_name)
 {
   GKeyFileGroup *group;
-  GList *tmp;
-
-  for (tmp = key_file->groups; tmp != NULL; tmp = tmp->next)
-    {
-      group = (GKeyFileGroup *) tmp->data;
 
-      if (group && group->name && strcmp (group->name, group_name) == 0)
-        break;
-    }
+  /* Only compare pointers once the hash has the group */
+  group = g_key_file_lookup_group (key_file, group_name);
+  if (group == NULL)
+    return NULL;
 
-  return tmp;
+  return g_list_find (key_file->groups, group);
 }
 
 static GKeyFileGroup *
@@ -3890,21 +3965,13 @@ g_key_file_lookup_key_value_pair_node (GKeyFile       *key_file,
 			               GKeyFileGroup  *group,
                                        const gchar    *key)
 {
-  GList *key_node;
-
-  for (key_node = group->key_value_pairs;
-       key_node != NULL;
-       key_node = key_node->next)
-    {
-      GKeyFileKeyValuePair *pair;
-
-      pair = (GKeyFileKeyValuePair *) key_node->data; 
+  GKeyFileKeyValuePair *pair;
 
-      if (pair->key && strcmp (pair->key, key) == 0)
-        break;
-    }
+  pair = g_key_file_lookup_key_value_pair (key_file, group, key);
+  if (pair == NULL)
+    return NULL;
 
-  return key_node;
+  return g_list_find (group->key_value_pairs, pair);
 }
 
 static GKeyFileKeyValuePair *
@@ -3920,9 +3987,10 @@ g_key_file_lookup_key_value_pair (GKeyFile      *key_file,
  * has been stripped.
  */
 static gboolean
-g_key_file_line_is_comment (const gchar *line)
+g_key_file_line_is_comment (const gchar *line,
+			    gsize        length)
 {
-  return (*line == '#' || *line == '\0' || *line == '\n');
+  return (length == 0 || *line == '#' || *line == '\0' || *line == '\n');
 }
 
 static gboolean 
@@ -3992,46 +4060,49 @@ g_key_file_is_key_name (const gchar *name)
  * or more letters making up the group name followed by ']'.
  */
 static gboolean
-g_key_file_line_is_group (const gchar *line)
+g_key_file_line_is_group (const gchar *line,
+			  gsize        length)
 {
-  gchar *p;
+  const gchar *p, *end;
 
-  p = (gchar *) line;
-  if (*p != '[')
+  if (length == 0 || *line != '[')
     return FALSE;
 
-  p++;
-
-  while (*p && *p != ']')
-    p = g_utf8_find_next_char (p, NULL);
+  /* ']' is plain ASCII and can't be part of a multibyte character,
+   * nor can the nul that ends the group name in a string.
+   */
+  end = line + length;
+  for (p = line + 1; p < end && *p && *p != ']'; p++)
+    ;
 
-  if (*p != ']')
+  if (p == end || *p != ']')
     return FALSE;
  
   /* silently accept whitespace after the ] */
-  p = g_utf8_find_next_char (p, NULL);
-  while (*p == ' ' || *p == '\t')
-    p = g_utf8_find_next_char (p, NULL);
+  p++;
+  while (p < end && (*p == ' ' || *p == '\t'))
+    p++;
      
-  if (*p)
+  if (p < end && *p)
     return FALSE;
 
   return TRUE;
 }
 
 static gboolean
-g_key_file_line_is_key_value_pair (const gchar *line)
+g_key_file_line_is_key_value_pair (const gchar *line,
+				   gsize        length)
 {
-  gchar *p;
+  const gchar *p;
 
-  p = (gchar *) g_utf8_strchr (line, -1, '=');
+  p = memchr (line, '=', length);
 
   if (!p)
     return FALSE;
 
   /* Key must be non-empty
    */
-  if (*p == line[0])
+  if (p == line)
     return FALSE;
 
   return TRUE;
@@ -289,6 +289,47 @@ g_list_prepend (GList	 *list,
   return new_list;
 }
 
+/**
+ * g_list_arena_prepend:
+ * @arena: a #GSliceArena
+ * @list: a pointer to a #GList
+ * @data: the data for the new element
+ *
+ * Like g_list_prepend(), but allocates the new element from @arena.
+ *
+ * This is meant for temporary lists that don't outlive a
+ * g_slice_arena_reset() of @arena. Elements allocated from an arena
+ * must not be freed with g_list_free() or g_list_free_1(), nor be
+ * removed with functions that free elements, like g_list_remove().
+ *
+ * Returns: the new start of the #GList
+ *
+ * Since: 2.32
+ */
+GList*
+g_list_arena_prepend (GSliceArena *arena,
+                      GList       *list,
+                      gpointer     data)
+{
+  GList *new_list;
+
+  new_list = g_slice_arena_alloc (arena, sizeof (GList));
+  new_list->data = data;
+  new_list->next = list;
+
+  if (list)
+    {
+      new_list->prev = list->prev;
+      if (list->prev)
+        list->prev->next = new_list;
+      list->prev = new_list;
+    }
+  else
+    new_list->prev = NULL;
+
+  return new_list;
+}
+
 /**
  * g_list_insert:
  * @list: a pointer to a #GList
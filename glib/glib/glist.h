@@ -32,6 +32,7 @@
 #define __G_LIST_H__
 
 #include <glib/gmem.h>
+#include <glib/gslice.h>
 
 G_BEGIN_DECLS
 
@@ -56,6 +57,9 @@ GList*   g_list_append                  (GList            *list,
 					 gpointer          data) G_GNUC_WARN_UNUSED_RESULT;
 GList*   g_list_prepend                 (GList            *list,
 					 gpointer          data) G_GNUC_WARN_UNUSED_RESULT;
+GList*   g_list_arena_prepend           (GSliceArena      *arena,
+					 GList            *list,
+					 gpointer          data) G_GNUC_WARN_UNUSED_RESULT;
 GList*   g_list_insert                  (GList            *list,
 					 gpointer          data,
 					 gint              position) G_GNUC_WARN_UNUSED_RESULT;
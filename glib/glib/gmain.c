@@ -53,6 +53,9 @@
 #ifdef HAVE_EVENTFD
 #include <sys/eventfd.h>
 #endif
+#ifdef HAVE_EPOLL_CREATE1
+#include <sys/epoll.h>
+#endif
 #endif
 
 #include <signal.h>
@@ -186,13 +189,15 @@ typedef struct _GTimeoutSource GTimeoutSource;
 typedef struct _GChildWatchSource GChildWatchSource;
 typedef struct _GUnixSignalWatchSource GUnixSignalWatchSource;
 typedef struct _GPollRec GPollRec;
+typedef struct _GEpollRec GEpollRec;
 typedef struct _GSourceCallback GSourceCallback;
 
 typedef enum
 {
   G_SOURCE_READY = 1 << G_HOOK_FLAG_USER_SHIFT,
   G_SOURCE_CAN_RECURSE = 1 << (G_HOOK_FLAG_USER_SHIFT + 1),
-  G_SOURCE_BLOCKED = 1 << (G_HOOK_FLAG_USER_SHIFT + 2)
+  G_SOURCE_BLOCKED = 1 << (G_HOOK_FLAG_USER_SHIFT + 2),
+  G_SOURCE_TIMED = 1 << (G_HOOK_FLAG_USER_SHIFT + 3)
 } GSourceFlags;
 
 typedef struct _GMainWaiter GMainWaiter;
@@ -215,6 +220,11 @@ struct _GMainDispatch
 gboolean _g_main_poll_debug = FALSE;
 #endif
 
+#ifdef HAVE_EPOLL_CREATE1
+/* Number of ready file descriptors picked up by one epoll_wait() */
+#define G_MAIN_EPOLL_EVENTS 64
+#endif
+
 struct _GMainContext
 {
   /* The following lock is used for both the list of sources
@@ -251,6 +261,20 @@ struct _GMainContext
 
   gint64   time;
   gboolean time_is_fresh;
+
+  GTimeoutSource **timeouts;	/* min-heap on expiration, from 1 */
+  guint n_timeouts;
+  guint timeouts_size;
+
+#ifdef HAVE_EPOLL_CREATE1
+  /* Persistent registration of the poll records, -1 if poll() is used */
+  gint epoll_fd;
+  GHashTable *epoll_records;	/* fd -> GEpollRec */
+  GEpollRec *epoll_dirty;	/* records waiting for epoll_ctl() */
+  GSList *epoll_static;		/* fds epoll refused, always ready */
+  GPtrArray *epoll_ready;	/* GPollRecs with revents set */
+  struct epoll_event *epoll_events;
+#endif
 };
 
 struct _GSourceCallback
@@ -274,6 +298,7 @@ struct _GTimeoutSource
   gint64      expiration;
   guint       interval;
   gboolean    seconds;
+  guint       heap_index;
 };
 
 struct _GChildWatchSource
@@ -301,8 +326,31 @@ struct _GPollRec
   GPollRec *prev;
   GPollRec *next;
   gint priority;
+#ifdef HAVE_EPOLL_CREATE1
+  gushort events;		/* fd->events as last seen */
+  gboolean ready;		/* in context->epoll_ready */
+  GEpollRec *epoll_rec;
+  GPollRec *epoll_next;		/* other records for the same fd */
+#endif
 };
 
+#ifdef HAVE_EPOLL_CREATE1
+/* A file descriptor in the epoll set, shared by all poll records
+ * watching it since epoll only accepts each descriptor once.
+ */
+struct _GEpollRec
+{
+  gint fd;
+  guint32 events;		/* as registered with epoll_ctl() */
+  gushort revents;		/* for fds epoll can't watch */
+  guint registered : 1;
+  guint fallback : 1;		/* in context->epoll_static */
+  guint dirty : 1;
+  GPollRec *poll_records;
+  GEpollRec *dirty_next;
+};
+#endif
+
 struct _GSourcePrivate
 {
   GSList *child_sources;
@@ -346,6 +394,11 @@ static void g_main_context_add_poll_unlocked    (GMainContext *context,
 						 GPollFD      *fd);
 static void g_main_context_remove_poll_unlocked (GMainContext *context,
 						 GPollFD      *fd);
+static gboolean g_main_context_check_internal   (GMainContext *context,
+						 gint          max_priority,
+						 GPollFD      *fds,
+						 gint          n_fds,
+						 gboolean      epoll);
 
 static gboolean g_timeout_prepare  (GSource     *source,
 				    gint        *timeout);
@@ -462,6 +515,543 @@ poll_rec_list_free (GMainContext *context,
   g_slice_free_chain (GPollRec, list, next);
 }
 
+#ifdef HAVE_EPOLL_CREATE1
+
+static void
+g_main_context_epoll_init (GMainContext *context)
+{
+  context->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+  if (context->epoll_fd < 0)
+    {
+      g_warning ("epoll_create1(2) failed due to: %s.", g_strerror (errno));
+      return;
+    }
+
+  context->epoll_records = g_hash_table_new (NULL, NULL);
+  context->epoll_ready = g_ptr_array_new ();
+  context->epoll_events = g_new (struct epoll_event, G_MAIN_EPOLL_EVENTS);
+}
+
+static void
+epoll_rec_free (gpointer key,
+		gpointer value,
+		gpointer user_data)
+{
+  g_slice_free (GEpollRec, value);
+}
+
+static void
+g_main_context_epoll_free (GMainContext *context)
+{
+  g_hash_table_foreach (context->epoll_records, epoll_rec_free, NULL);
+  g_hash_table_destroy (context->epoll_records);
+  g_slist_free (context->epoll_static);
+  g_ptr_array_free (context->epoll_ready, TRUE);
+  g_free (context->epoll_events);
+
+  close (context->epoll_fd);
+}
+
+/* HOLDS: context's lock */
+static void
+epoll_rec_set_dirty (GMainContext *context,
+		     GEpollRec    *erec)
+{
+  if (erec->dirty)
+    return;
+
+  erec->dirty = TRUE;
+  erec->dirty_next = context->epoll_dirty;
+  context->epoll_dirty = erec;
+}
+
+/* HOLDS: context's lock
+ *
+ * The epoll set itself is only updated right before waiting, so that
+ * blocking and unblocking a source around its dispatch, which removes
+ * and re-adds its poll records, costs no system calls.
+ */
+static void
+g_main_context_epoll_add (GMainContext *context,
+			  GPollRec     *pollrec)
+{
+  GEpollRec *erec;
+
+  erec = g_hash_table_lookup (context->epoll_records,
+			      GINT_TO_POINTER (pollrec->fd->fd));
+  if (!erec)
+    {
+      erec = g_slice_new0 (GEpollRec);
+      erec->fd = pollrec->fd->fd;
+      g_hash_table_insert (context->epoll_records,
+			   GINT_TO_POINTER (erec->fd), erec);
+    }
+
+  pollrec->events = pollrec->fd->events;
+  pollrec->ready = FALSE;
+  pollrec->epoll_rec = erec;
+  pollrec->epoll_next = erec->poll_records;
+  erec->poll_records = pollrec;
+
+  epoll_rec_set_dirty (context, erec);
+}
+
+/* HOLDS: context's lock */
+static GPollRec *
+g_main_context_epoll_remove (GMainContext *context,
+			     GPollFD      *fd)
+{
+  GPollRec *pollrec = NULL;
+  GPollRec **link;
+  GEpollRec *erec;
+
+  erec = g_hash_table_lookup (context->epoll_records,
+			      GINT_TO_POINTER (fd->fd));
+  if (erec)
+    for (pollrec = erec->poll_records; pollrec; pollrec = pollrec->epoll_next)
+      if (pollrec->fd == fd)
+	break;
+
+  /* The descriptor number was changed after adding it */
+  if (!pollrec)
+    {
+      for (pollrec = context->poll_records; pollrec; pollrec = pollrec->next)
+	if (pollrec->fd == fd)
+	  break;
+
+      if (!pollrec)
+	return NULL;
+
+      erec = pollrec->epoll_rec;
+    }
+
+  for (link = &erec->poll_records; *link != pollrec; link = &(*link)->epoll_next)
+    ;
+  *link = pollrec->epoll_next;
+
+  if (pollrec->ready)
+    g_ptr_array_remove_fast (context->epoll_ready, pollrec);
+
+  epoll_rec_set_dirty (context, erec);
+
+  return pollrec;
+}
+
+static gboolean
+epoll_rec_register (gint       epoll_fd,
+		    GEpollRec *erec,
+		    guint32    events)
+{
+  struct epoll_event ev;
+  gint op;
+
+  /* Not the record itself: if the descriptor was closed before its
+   * record was removed, the registration can outlive the record when
+   * another copy of the file is still open.
+   */
+  ev.events = events;
+  ev.data.fd = erec->fd;
+
+  op = erec->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  if (epoll_ctl (epoll_fd, op, erec->fd, &ev) == 0)
+    return TRUE;
+
+  /* The descriptor was closed and its number reused without removing
+   * it from the context first, so the kernel already forgot about it.
+   */
+  if (errno == ENOENT)
+    op = EPOLL_CTL_ADD;
+  else if (errno == EEXIST)
+    op = EPOLL_CTL_MOD;
+  else
+    return FALSE;
+
+  return epoll_ctl (epoll_fd, op, erec->fd, &ev) == 0;
+}
+
+/* HOLDS: context's lock */
+static void
+g_main_context_epoll_update (GMainContext *context)
+{
+  GPollRec *pollrec;
+  GEpollRec *erec;
+
+  /* Like g_main_context_query(), catch applications changing
+   * fd->events behind our back.  This is only a walk over the records,
+   * the kernel is told about actual changes only.
+   */
+  for (pollrec = context->poll_records; pollrec; pollrec = pollrec->next)
+    if (pollrec->events != pollrec->fd->events)
+      {
+	pollrec->events = pollrec->fd->events;
+	epoll_rec_set_dirty (context, pollrec->epoll_rec);
+      }
+
+  while ((erec = context->epoll_dirty) != NULL)
+    {
+      guint32 events = 0;
+
+      context->epoll_dirty = erec->dirty_next;
+      erec->dirty = FALSE;
+
+      for (pollrec = erec->poll_records; pollrec; pollrec = pollrec->epoll_next)
+	events |= pollrec->fd->events & (G_IO_IN | G_IO_OUT | G_IO_PRI);
+
+      if (erec->fallback)
+	{
+	  context->epoll_static = g_slist_remove (context->epoll_static, erec);
+	  erec->fallback = FALSE;
+	  erec->revents = 0;
+	}
+
+      if (!erec->poll_records)
+	{
+	  if (erec->registered)
+	    epoll_ctl (context->epoll_fd, EPOLL_CTL_DEL, erec->fd, NULL);
+
+	  g_hash_table_remove (context->epoll_records,
+			       GINT_TO_POINTER (erec->fd));
+	  g_slice_free (GEpollRec, erec);
+	  continue;
+	}
+
+      if (erec->registered && erec->events == events)
+	continue;
+
+      if (epoll_rec_register (context->epoll_fd, erec, events))
+	{
+	  erec->registered = TRUE;
+	  erec->events = events;
+	  continue;
+	}
+
+      /* Report what poll() would: regular files are always ready and
+       * bad descriptors are invalid.
+       */
+      if (errno == EPERM)
+	erec->revents = events;
+      else if (errno == EBADF)
+	erec->revents = G_IO_NVAL;
+      else
+	erec->revents = G_IO_ERR;
+
+      erec->registered = FALSE;
+      erec->fallback = TRUE;
+      context->epoll_static = g_slist_prepend (context->epoll_static, erec);
+    }
+}
+
+/* HOLDS: context's lock */
+static void
+epoll_rec_dispatch (GMainContext *context,
+		    GEpollRec    *erec,
+		    gushort       revents,
+		    gint          max_priority)
+{
+  GPollRec *pollrec;
+
+  for (pollrec = erec->poll_records; pollrec; pollrec = pollrec->epoll_next)
+    {
+      GPollFD *fd = pollrec->fd;
+
+      /* Lower priority records are left for a later iteration, the
+       * level triggered epoll set will report them again.
+       */
+      if (pollrec->priority > max_priority || !fd->events)
+	continue;
+
+      fd->revents = revents & (fd->events | G_IO_ERR | G_IO_HUP | G_IO_NVAL);
+      if (fd->revents && !pollrec->ready)
+	{
+	  pollrec->ready = TRUE;
+	  g_ptr_array_add (context->epoll_ready, pollrec);
+	}
+    }
+}
+
+/* Replaces g_main_context_query() and g_main_context_poll(); instead
+ * of rebuilding the array of all descriptors, only the records of the
+ * ready ones get their revents set.
+ */
+static void
+g_main_context_epoll_wait (GMainContext *context,
+			   gboolean      block,
+			   gint          max_priority)
+{
+  struct epoll_event *events;
+  GSList *tmp_list;
+  gint epoll_fd;
+  gint timeout;
+  gint i, n;
+
+  LOCK_CONTEXT (context);
+
+  g_main_context_epoll_update (context);
+
+  context->poll_changed = FALSE;
+
+  timeout = block && !context->epoll_static ? context->timeout : 0;
+  if (timeout != 0)
+    context->time_is_fresh = FALSE;
+
+  epoll_fd = context->epoll_fd;
+  events = context->epoll_events;
+
+  UNLOCK_CONTEXT (context);
+
+  n = epoll_wait (epoll_fd, events, G_MAIN_EPOLL_EVENTS, timeout);
+  if (n < 0)
+    {
+      if (errno != EINTR)
+	g_warning ("epoll_wait(2) failed due to: %s.", g_strerror (errno));
+      n = 0;
+    }
+
+  LOCK_CONTEXT (context);
+
+  for (i = 0; i < context->epoll_ready->len; i++)
+    {
+      GPollRec *pollrec = context->epoll_ready->pdata[i];
+
+      pollrec->fd->revents = 0;
+      pollrec->ready = FALSE;
+    }
+  g_ptr_array_set_size (context->epoll_ready, 0);
+
+  for (i = 0; i < n; i++)
+    {
+      GEpollRec *erec;
+
+      erec = g_hash_table_lookup (context->epoll_records,
+				  GINT_TO_POINTER (events[i].data.fd));
+
+      /* Leftovers of descriptors closed while still registered */
+      if (!erec || !erec->registered)
+	continue;
+
+      epoll_rec_dispatch (context, erec, events[i].events, max_priority);
+    }
+
+  for (tmp_list = context->epoll_static; tmp_list; tmp_list = tmp_list->next)
+    {
+      GEpollRec *erec = tmp_list->data;
+
+      epoll_rec_dispatch (context, erec, erec->revents, max_priority);
+    }
+
+  UNLOCK_CONTEXT (context);
+}
+
+/* HOLDS: context's lock */
+static gboolean
+source_needs_check (GMainContext *context,
+		    GSource      *source)
+{
+  GSList *tmp_list;
+
+  /* Anything that isn't purely waiting for its descriptors, and
+   * everything after an explicit wakeup, is still checked.
+   */
+  if (!source->poll_fds || (source->flags & G_SOURCE_TIMED) ||
+      context->wake_up_rec.revents)
+    return TRUE;
+
+  for (tmp_list = source->poll_fds; tmp_list; tmp_list = tmp_list->next)
+    if (((GPollFD *) tmp_list->data)->revents)
+      return TRUE;
+
+  return FALSE;
+}
+
+#endif /* HAVE_EPOLL_CREATE1 */
+
+/* Timeout sources of a context are kept in a binary min-heap on their
+ * expiration, 1-based so that a heap_index of 0 means not queued.  The
+ * main loop reads its next deadline from the root and only visits the
+ * timeouts that expired instead of preparing and checking all of them.
+ */
+
+#define SOURCE_IS_TIMEOUT(source) ((source)->source_funcs == &g_timeout_funcs)
+
+/* HOLDS: context's lock */
+static void
+timeout_heap_set (GMainContext   *context,
+		  guint           index,
+		  GTimeoutSource *timeout_source)
+{
+  context->timeouts[index] = timeout_source;
+  timeout_source->heap_index = index;
+}
+
+/* HOLDS: context's lock */
+static void
+timeout_heap_sift_up (GMainContext *context,
+		      guint         index)
+{
+  GTimeoutSource *timeout_source = context->timeouts[index];
+
+  while (index > 1)
+    {
+      GTimeoutSource *parent = context->timeouts[index / 2];
+
+      if (parent->expiration <= timeout_source->expiration)
+	break;
+
+      timeout_heap_set (context, index, parent);
+      index /= 2;
+    }
+
+  timeout_heap_set (context, index, timeout_source);
+}
+
+/* HOLDS: context's lock */
+static void
+timeout_heap_sift_down (GMainContext *context,
+			guint         index)
+{
+  GTimeoutSource *timeout_source = context->timeouts[index];
+
+  while (index * 2 <= context->n_timeouts)
+    {
+      guint child = index * 2;
+
+      if (child < context->n_timeouts &&
+	  context->timeouts[child + 1]->expiration < context->timeouts[child]->expiration)
+	child++;
+
+      if (timeout_source->expiration <= context->timeouts[child]->expiration)
+	break;
+
+      timeout_heap_set (context, index, context->timeouts[child]);
+      index = child;
+    }
+
+  timeout_heap_set (context, index, timeout_source);
+}
+
+/* HOLDS: context's lock */
+static void
+timeout_heap_insert (GMainContext   *context,
+		     GTimeoutSource *timeout_source)
+{
+  if (context->n_timeouts + 1 >= context->timeouts_size)
+    {
+      context->timeouts_size = MAX (16, context->timeouts_size * 2);
+      context->timeouts = g_renew (GTimeoutSource *, context->timeouts,
+				   context->timeouts_size);
+    }
+
+  context->n_timeouts++;
+  timeout_heap_set (context, context->n_timeouts, timeout_source);
+  timeout_heap_sift_up (context, context->n_timeouts);
+}
+
+/* HOLDS: context's lock */
+static void
+timeout_heap_remove (GMainContext   *context,
+		     GTimeoutSource *timeout_source)
+{
+  guint index = timeout_source->heap_index;
+  GTimeoutSource *last;
+
+  if (index == 0)
+    return;
+
+  timeout_source->heap_index = 0;
+
+  last = context->timeouts[context->n_timeouts--];
+  if (last == timeout_source)
+    return;
+
+  timeout_heap_set (context, index, last);
+  timeout_heap_sift_up (context, index);
+  timeout_heap_sift_down (context, last->heap_index);
+}
+
+/* HOLDS: context's lock */
+static void
+timeout_heap_update (GMainContext   *context,
+		     GTimeoutSource *timeout_source)
+{
+  guint index = timeout_source->heap_index;
+
+  if (index == 0)
+    return;
+
+  timeout_heap_sift_up (context, index);
+  timeout_heap_sift_down (context, timeout_source->heap_index);
+}
+
+/* HOLDS: context's lock */
+static void
+timeout_heap_expire (GMainContext *context,
+		     guint         index,
+		     gint64        now,
+		     gint64       *next)
+{
+  GTimeoutSource *timeout_source;
+  GSource *source;
+
+  if (index > context->n_timeouts)
+    return;
+
+  timeout_source = context->timeouts[index];
+  source = (GSource *) timeout_source;
+
+  /* Nothing below a pending timeout can have expired */
+  if (timeout_source->expiration > now)
+    {
+      *next = MIN (*next, timeout_source->expiration);
+      return;
+    }
+
+  if (!SOURCE_BLOCKED (source))
+    {
+      GSource *ready_source = source;
+
+      while (ready_source)
+	{
+	  ready_source->flags |= G_SOURCE_READY;
+	  ready_source = ready_source->priv ? ready_source->priv->parent_source : NULL;
+	}
+    }
+
+  timeout_heap_expire (context, index * 2, now, next);
+  timeout_heap_expire (context, index * 2 + 1, now, next);
+}
+
+/* HOLDS: context's lock
+ *
+ * Does what g_timeout_prepare() and g_timeout_check() do for all the
+ * timeout sources at once: expired ones are marked ready, and the
+ * poll timeout until the next one to expire is returned, or -1.
+ */
+static gint
+g_main_context_expire_timeouts (GMainContext *context)
+{
+  gint64 next = G_MAXINT64;
+  gint64 now;
+
+  if (context->n_timeouts == 0)
+    return -1;
+
+  if (!context->time_is_fresh)
+    {
+      context->time = g_get_monotonic_time ();
+      context->time_is_fresh = TRUE;
+    }
+
+  now = context->time;
+
+  timeout_heap_expire (context, 1, now, &next);
+
+  if (next == G_MAXINT64)
+    return -1;
+
+  /* Round up to ensure that we don't try again too early */
+  return MIN ((next - now + 999) / 1000, G_MAXINT);
+}
+
 /**
  * g_main_context_unref:
  * @context: a #GMainContext
@@ -497,6 +1087,12 @@ g_main_context_unref (GMainContext *context)
   g_free (context->cached_poll_array);
 
   poll_rec_list_free (context, context->poll_records);
+  g_free (context->timeouts);
+
+#ifdef HAVE_EPOLL_CREATE1
+  if (context->epoll_fd >= 0)
+    g_main_context_epoll_free (context);
+#endif
 
   g_wakeup_free (context->wakeup);
   g_cond_clear (&context->cond);
@@ -549,6 +1145,12 @@ g_main_context_new (void)
   context->pending_dispatches = g_ptr_array_new ();
   
   context->time_is_fresh = FALSE;
+
+#ifdef HAVE_EPOLL_CREATE1
+  context->epoll_fd = -1;
+  if (getenv ("G_MAIN_EPOLL") != NULL)
+    g_main_context_epoll_init (context);
+#endif
   
   context->wakeup = g_wakeup_new ();
   g_wakeup_get_pollfd (context->wakeup, &context->wake_up_rec);
@@ -871,6 +1473,9 @@ g_source_attach_unlocked (GSource      *source,
   source->ref_count++;
   g_source_list_add (source, context);
 
+  if (SOURCE_IS_TIMEOUT (source))
+    timeout_heap_insert (context, (GTimeoutSource *) source);
+
   tmp_list = source->poll_fds;
   while (tmp_list)
     {
@@ -951,6 +1556,9 @@ g_source_destroy_internal (GSource      *source,
       source->callback_data = NULL;
       source->callback_funcs = NULL;
 
+      if (SOURCE_IS_TIMEOUT (source))
+	timeout_heap_remove (context, (GTimeoutSource *) source);
+
       if (old_cb_funcs)
 	{
 	  UNLOCK_CONTEXT (context);
@@ -2570,7 +3178,11 @@ g_main_dispatch (GMainContext *context)
   g_ptr_array_set_size (context->pending_dispatches, 0);
 }
 
-/* Holds context's lock */
+/* Holds context's lock
+ *
+ * Timeout sources the heap did not mark ready have nothing to prepare
+ * or check, so they are stepped over without taking a reference.
+ */
 static inline GSource *
 next_valid_source (GMainContext *context,
 		   GSource      *source)
@@ -2579,7 +3191,9 @@ next_valid_source (GMainContext *context,
 
   while (new_source)
     {
-      if (!SOURCE_DESTROYED (new_source))
+      if (!SOURCE_DESTROYED (new_source) &&
+	  (!SOURCE_IS_TIMEOUT (new_source) ||
+	   (new_source->flags & G_SOURCE_READY)))
 	{
 	  new_source->ref_count++;
 	  break;
@@ -2808,7 +3422,7 @@ g_main_context_prepare (GMainContext *context,
   
   /* Prepare all sources */
 
-  context->timeout = -1;
+  context->timeout = g_main_context_expire_timeouts (context);
   
   source = next_valid_source (context, NULL);
   while (source)
@@ -2823,7 +3437,7 @@ g_main_context_prepare (GMainContext *context,
       if (SOURCE_BLOCKED (source))
 	goto next;
 
-      if (!(source->flags & G_SOURCE_READY))
+      if (!(source->flags & G_SOURCE_READY) && !SOURCE_IS_TIMEOUT (source))
 	{
 	  gboolean result;
 	  gboolean (*prepare)  (GSource  *source, 
@@ -2848,6 +3462,12 @@ g_main_context_prepare (GMainContext *context,
 		  ready_source = ready_source->priv ? ready_source->priv->parent_source : NULL;
 		}
 	    }
+
+	  /* Remember sources whose check() depends on more than their fds */
+	  if (source_timeout >= 0)
+	    source->flags |= G_SOURCE_TIMED;
+	  else
+	    source->flags &= ~G_SOURCE_TIMED;
 	}
 
       if (source->flags & G_SOURCE_READY)
@@ -2960,6 +3580,20 @@ g_main_context_check (GMainContext *context,
 		      gint          max_priority,
 		      GPollFD      *fds,
 		      gint          n_fds)
+{
+  return g_main_context_check_internal (context, max_priority, fds, n_fds,
+					FALSE);
+}
+
+/* With @epoll set, the revents are already in place and only the
+ * sources that may have become ready are checked.
+ */
+static gboolean
+g_main_context_check_internal (GMainContext *context,
+			       gint          max_priority,
+			       GPollFD      *fds,
+			       gint          n_fds,
+			       gboolean      epoll)
 {
   GSource *source;
   GPollRec *pollrec;
@@ -2982,7 +3616,7 @@ g_main_context_check (GMainContext *context,
   /* If the set of poll file descriptors changed, bail out
    * and let the main loop rerun
    */
-  if (context->poll_changed)
+  if (!epoll && context->poll_changed)
     {
       UNLOCK_CONTEXT (context);
       return FALSE;
@@ -2999,6 +3633,8 @@ g_main_context_check (GMainContext *context,
       i++;
     }
 
+  g_main_context_expire_timeouts (context);
+
   source = next_valid_source (context, NULL);
   while (source)
     {
@@ -3010,7 +3646,13 @@ g_main_context_check (GMainContext *context,
       if (SOURCE_BLOCKED (source))
 	goto next;
 
-      if (!(source->flags & G_SOURCE_READY))
+#ifdef HAVE_EPOLL_CREATE1
+      if (epoll && !(source->flags & G_SOURCE_READY) &&
+	  !source_needs_check (context, source))
+	goto next;
+#endif
+
+      if (!(source->flags & G_SOURCE_READY) && !SOURCE_IS_TIMEOUT (source))
 	{
 	  gboolean result;
 	  gboolean (*check) (GSource  *source);
@@ -3111,6 +3753,19 @@ g_main_context_iterate (GMainContext *context,
     }
   else
     LOCK_CONTEXT (context);
+
+#ifdef HAVE_EPOLL_CREATE1
+  if (context->epoll_fd >= 0 && context->poll_func == g_poll)
+    {
+      UNLOCK_CONTEXT (context);
+
+      g_main_context_prepare (context, &max_priority);
+      g_main_context_epoll_wait (context, block, max_priority);
+      some_ready = g_main_context_check_internal (context, max_priority,
+						  NULL, 0, TRUE);
+      goto dispatch;
+    }
+#endif
   
   if (!context->cached_poll_array)
     {
@@ -3141,7 +3796,10 @@ g_main_context_iterate (GMainContext *context,
   g_main_context_poll (context, timeout, max_priority, fds, nfds);
   
   some_ready = g_main_context_check (context, max_priority, fds, nfds);
-  
+
+#ifdef HAVE_EPOLL_CREATE1
+ dispatch:
+#endif
   if (dispatch)
     g_main_context_dispatch (context);
   
@@ -3561,10 +4219,18 @@ g_main_context_add_poll_unlocked (GMainContext *context,
 
   context->n_poll_records++;
 
+#ifdef HAVE_EPOLL_CREATE1
+  if (context->epoll_fd >= 0)
+    g_main_context_epoll_add (context, newrec);
+#endif
+
   context->poll_changed = TRUE;
 
-  /* Now wake up the main loop if it is waiting in the poll() */
-  g_wakeup_signal (context->wakeup);
+  /* Like when attaching a source, only another thread that acquired
+   * the context can be blocked in poll() right now.
+   */
+  if (context->owner && context->owner != G_THREAD_SELF)
+    g_wakeup_signal (context->wakeup);
 }
 
 /**
@@ -3596,37 +4262,43 @@ g_main_context_remove_poll_unlocked (GMainContext *context,
 {
   GPollRec *pollrec, *prevrec, *nextrec;
 
-  prevrec = NULL;
-  pollrec = context->poll_records;
+#ifdef HAVE_EPOLL_CREATE1
+  /* The per fd records save walking the whole list */
+  if (context->epoll_fd >= 0)
+    pollrec = g_main_context_epoll_remove (context, fd);
+  else
+#endif
+  for (pollrec = context->poll_records; pollrec; pollrec = pollrec->next)
+    if (pollrec->fd == fd)
+      break;
 
-  while (pollrec)
+  if (pollrec)
     {
+      prevrec = pollrec->prev;
       nextrec = pollrec->next;
-      if (pollrec->fd == fd)
-	{
-	  if (prevrec != NULL)
-	    prevrec->next = nextrec;
-	  else
-	    context->poll_records = nextrec;
 
-	  if (nextrec != NULL)
-	    nextrec->prev = prevrec;
-	  else
-	    context->poll_records_tail = prevrec;
+      if (prevrec != NULL)
+	prevrec->next = nextrec;
+      else
+	context->poll_records = nextrec;
 
-	  g_slice_free (GPollRec, pollrec);
+      if (nextrec != NULL)
+	nextrec->prev = prevrec;
+      else
+	context->poll_records_tail = prevrec;
 
-	  context->n_poll_records--;
-	  break;
-	}
-      prevrec = pollrec;
-      pollrec = nextrec;
+      g_slice_free (GPollRec, pollrec);
+
+      context->n_poll_records--;
     }
 
   context->poll_changed = TRUE;
   
-  /* Now wake up the main loop if it is waiting in the poll() */
-  g_wakeup_signal (context->wakeup);
+  /* Like when attaching a source, only another thread that acquired
+   * the context can be blocked in poll() right now.
+   */
+  if (context->owner && context->owner != G_THREAD_SELF)
+    g_wakeup_signal (context->wakeup);
 }
 
 /**
@@ -3882,7 +4554,15 @@ g_timeout_dispatch (GSource     *source,
   again = callback (user_data);
 
   if (again)
-    g_timeout_set_expiration (timeout_source, g_source_get_time (source));
+    {
+      GMainContext *context = source->context;
+      gint64 now = g_source_get_time (source);
+
+      LOCK_CONTEXT (context);
+      g_timeout_set_expiration (timeout_source, now);
+      timeout_heap_update (context, timeout_source);
+      UNLOCK_CONTEXT (context);
+    }
 
   return again;
 }
@@ -1207,6 +1207,242 @@ g_slice_free_chain_with_offset (gsize    mem_size,
       }
 }
 
+/* --- scoped arenas --- */
+/* an arena hands out memory by bumping a pointer through a chain of blocks
+ * and never frees individual chunks. resetting rewinds to the first block
+ * and keeps the chain around, so an arena that is reset after every main
+ * loop dispatch settles at its peak working set and stops calling malloc()
+ * altogether. requests bigger than a quarter of the block size would waste
+ * too much of a block and get a dedicated allocation that is released on
+ * reset. with G_SLICE=always-malloc, every chunk is allocated that way so
+ * that memory checkers keep seeing individual blocks.
+ */
+typedef struct _ArenaBlock ArenaBlock;
+struct _ArenaBlock {
+  ArenaBlock *next;
+  gsize       size;             /* usable bytes following the header */
+};
+#define ARENA_HEADER_SIZE       P2ALIGN (sizeof (ArenaBlock))
+#define ARENA_BLOCK_DATA(b)     (((guint8*) (b)) + ARENA_HEADER_SIZE)
+#define ARENA_MIN_BLOCK_SIZE    (256)
+
+struct _GSliceArena {
+  guint8     *pos;              /* next free byte in current */
+  guint8     *end;
+  ArenaBlock *current;
+  ArenaBlock *blocks;           /* reused across resets */
+  ArenaBlock *large;            /* dedicated chunks, released on reset */
+  gsize       block_size;
+  gsize       large_size;
+  gboolean    always_malloc;
+};
+
+static inline void
+arena_use_block (GSliceArena *arena,
+                 ArenaBlock  *block)
+{
+  arena->current = block;
+  arena->pos = ARENA_BLOCK_DATA (block);
+  /* an empty window sends every request down the slow path */
+  arena->end = arena->always_malloc ? arena->pos : arena->pos + block->size;
+}
+
+static ArenaBlock*
+arena_block_new (gsize size)
+{
+  ArenaBlock *block = g_malloc (ARENA_HEADER_SIZE + size);
+  block->next = NULL;
+  block->size = size;
+  return block;
+}
+
+static void
+arena_blocks_free (ArenaBlock *block)
+{
+  while (block)
+    {
+      ArenaBlock *next = block->next;
+      g_free (block);
+      block = next;
+    }
+}
+
+static gpointer
+arena_alloc_slow (GSliceArena *arena,
+                  gsize        chunk_size)
+{
+  ArenaBlock *block;
+
+  if (chunk_size > arena->large_size || arena->always_malloc)
+    {
+      block = arena_block_new (chunk_size);
+      block->next = arena->large;
+      arena->large = block;
+      return ARENA_BLOCK_DATA (block);
+    }
+
+  /* move on to the next block of the chain, growing it if needed */
+  block = arena->current->next;
+  if (!block)
+    {
+      block = arena_block_new (arena->block_size);
+      arena->current->next = block;
+    }
+  arena_use_block (arena, block);
+
+  arena->pos += chunk_size;
+  return ARENA_BLOCK_DATA (block);
+}
+
+/**
+ * g_slice_arena_new:
+ * @block_size: the size of the blocks the arena carves chunks from,
+ *     or 0 for a default size
+ *
+ * Creates a new arena for short-lived allocations. Memory is handed out
+ * with g_slice_arena_alloc() and is never released individually; instead,
+ * g_slice_arena_reset() releases everything allocated from the arena at
+ * once, in constant time for all chunks smaller than a quarter of
+ * @block_size.
+ *
+ * A typical use is to reset an arena at the end of each main loop
+ * dispatch, so that temporary lists and structures built while handling
+ * an event cost no more than a pointer increment each.
+ *
+ * Arenas are not thread safe; each thread should use its own arena.
+ *
+ * Returns: a new #GSliceArena
+ *
+ * Since: 2.32
+ */
+GSliceArena*
+g_slice_arena_new (gsize block_size)
+{
+  GSliceArena *arena;
+
+  /* make sure the slice configuration is initialized */
+  thread_memory_from_self ();
+
+  if (block_size == 0)
+    block_size = sys_page_size - ARENA_HEADER_SIZE - NATIVE_MALLOC_PADDING;
+  block_size = P2ALIGN (MAX (block_size, ARENA_MIN_BLOCK_SIZE));
+
+  arena = g_slice_new (GSliceArena);
+  arena->blocks = arena_block_new (block_size);
+  arena->large = NULL;
+  arena->block_size = block_size;
+  arena->large_size = block_size / 4;
+  arena->always_malloc = allocator->config.always_malloc;
+  arena_use_block (arena, arena->blocks);
+
+  return arena;
+}
+
+/**
+ * g_slice_arena_alloc:
+ * @arena: a #GSliceArena
+ * @mem_size: the number of bytes to allocate
+ *
+ * Allocates a block of memory from @arena. The block is aligned like
+ * blocks returned by g_slice_alloc() and stays valid until @arena is
+ * reset or freed. It must not be passed to g_slice_free1() or g_free().
+ *
+ * Returns: a pointer to the allocated memory block
+ *
+ * Since: 2.32
+ */
+gpointer
+g_slice_arena_alloc (GSliceArena *arena,
+                     gsize        mem_size)
+{
+  gsize chunk_size = P2ALIGN (mem_size);
+  gpointer mem;
+
+  if (G_LIKELY (chunk_size <= (gsize) (arena->end - arena->pos)))
+    {
+      mem = arena->pos;
+      arena->pos += chunk_size;
+    }
+  else
+    mem = arena_alloc_slow (arena, chunk_size);
+
+  TRACE (GLIB_SLICE_ALLOC((void*)mem, mem_size));
+
+  return mem;
+}
+
+/**
+ * g_slice_arena_alloc0:
+ * @arena: a #GSliceArena
+ * @mem_size: the number of bytes to allocate
+ *
+ * Allocates a block of memory via g_slice_arena_alloc() and
+ * initializes the returned memory to 0.
+ *
+ * Returns: a pointer to the allocated memory block
+ *
+ * Since: 2.32
+ */
+gpointer
+g_slice_arena_alloc0 (GSliceArena *arena,
+                      gsize        mem_size)
+{
+  gpointer mem = g_slice_arena_alloc (arena, mem_size);
+  memset (mem, 0, mem_size);
+  return mem;
+}
+
+/**
+ * g_slice_arena_reset:
+ * @arena: a #GSliceArena
+ *
+ * Releases all memory allocated from @arena at once. The blocks backing
+ * the arena are kept for the allocations that follow, so an arena that
+ * is reset regularly stops allocating from the system once it has grown
+ * to its working set.
+ *
+ * Since: 2.32
+ */
+void
+g_slice_arena_reset (GSliceArena *arena)
+{
+  if (G_UNLIKELY (arena->large))
+    {
+      arena_blocks_free (arena->large);
+      arena->large = NULL;
+    }
+
+  if (G_UNLIKELY (g_mem_gc_friendly))
+    {
+      ArenaBlock *block;
+
+      for (block = arena->blocks; block != arena->current->next;
+           block = block->next)
+        memset (ARENA_BLOCK_DATA (block), 0, block->size);
+    }
+
+  arena_use_block (arena, arena->blocks);
+}
+
+/**
+ * g_slice_arena_free:
+ * @arena: a #GSliceArena
+ *
+ * Releases all memory allocated from @arena and @arena itself.
+ *
+ * Since: 2.32
+ */
+void
+g_slice_arena_free (GSliceArena *arena)
+{
+  if (!arena)
+    return;
+
+  arena_blocks_free (arena->large);
+  arena_blocks_free (arena->blocks);
+  g_slice_free (GSliceArena, arena);
+}
+
 /* --- single page allocator --- */
 static void
 allocator_slab_stack_push (Allocator *allocator,
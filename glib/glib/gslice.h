@@ -67,6 +67,18 @@ void     g_slice_free_chain_with_offset (gsize         block_size,
   else   (void) ((type*) 0 == (mem_chain));			\
 } while (0)
 
+/* arenas - scoped allocation, released all at once
+ */
+typedef struct _GSliceArena GSliceArena;
+
+GSliceArena* g_slice_arena_new    (gsize        block_size);
+gpointer     g_slice_arena_alloc  (GSliceArena *arena,
+                                   gsize        block_size) G_GNUC_MALLOC G_GNUC_ALLOC_SIZE(2);
+gpointer     g_slice_arena_alloc0 (GSliceArena *arena,
+                                   gsize        block_size) G_GNUC_MALLOC G_GNUC_ALLOC_SIZE(2);
+void         g_slice_arena_reset  (GSliceArena *arena);
+void         g_slice_arena_free   (GSliceArena *arena);
+
 
 /* --- internal debugging API --- */
 typedef enum {
@@ -269,6 +269,37 @@ g_slist_prepend (GSList   *list,
   return new_list;
 }
 
+/**
+ * g_slist_arena_prepend:
+ * @arena: a #GSliceArena
+ * @list: a #GSList
+ * @data: the data for the new element
+ *
+ * Like g_slist_prepend(), but allocates the new element from @arena.
+ *
+ * This is meant for temporary lists that don't outlive a
+ * g_slice_arena_reset() of @arena. Elements allocated from an arena
+ * must not be freed with g_slist_free() or g_slist_free_1(), nor be
+ * removed with functions that free elements, like g_slist_remove().
+ *
+ * Returns: the new start of the #GSList
+ *
+ * Since: 2.32
+ */
+GSList*
+g_slist_arena_prepend (GSliceArena *arena,
+                       GSList      *list,
+                       gpointer     data)
+{
+  GSList *new_list;
+
+  new_list = g_slice_arena_alloc (arena, sizeof (GSList));
+  new_list->data = data;
+  new_list->next = list;
+
+  return new_list;
+}
+
 /**
  * g_slist_insert:
  * @list: a #GSList
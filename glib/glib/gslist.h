@@ -32,6 +32,7 @@
 #define __G_SLIST_H__
 
 #include <glib/gmem.h>
+#include <glib/gslice.h>
 
 G_BEGIN_DECLS
 
@@ -55,6 +56,9 @@ GSList*  g_slist_append                  (GSList           *list,
 					  gpointer          data) G_GNUC_WARN_UNUSED_RESULT;
 GSList*  g_slist_prepend                 (GSList           *list,
 					  gpointer          data) G_GNUC_WARN_UNUSED_RESULT;
+GSList*  g_slist_arena_prepend           (GSliceArena      *arena,
+					  GSList           *list,
+					  gpointer          data) G_GNUC_WARN_UNUSED_RESULT;
 GSList*  g_slist_insert                  (GSList           *list,
 					  gpointer          data,
 					  gint              position) G_GNUC_WARN_UNUSED_RESULT;
@@ -633,6 +633,148 @@ g_string_append_unichar (GString  *string,
   return g_string_insert_unichar (string, -1, wc);
 }
 
+/**
+ * g_string_reserve:
+ * @string: a #GString
+ * @len: number of bytes about to be appended
+ *
+ * Makes sure that @len more bytes can be appended to @string
+ * without reallocating it. The contents of @string are not changed.
+ *
+ * Like any other growth of a #GString, the buffer is rounded up to the
+ * next power of two, so that repeated calls with small amounts don't
+ * reallocate each time. Calling this before building a large piece of
+ * text whose size can be estimated saves the intermediate reallocations.
+ *
+ * Returns: @string
+ *
+ * Since: 2.32
+ */
+GString *
+g_string_reserve (GString *string,
+                  gsize    len)
+{
+  g_return_val_if_fail (string != NULL, NULL);
+
+  g_string_maybe_expand (string, len);
+
+  return string;
+}
+
+/**
+ * g_string_append_uint:
+ * @string: a #GString
+ * @value: the number to append
+ *
+ * Appends the decimal representation of @value to @string, like
+ * g_string_append_printf (@string, "%" G_GUINT64_FORMAT, @value)
+ * but without parsing a format string.
+ *
+ * Returns: @string
+ *
+ * Since: 2.32
+ */
+GString *
+g_string_append_uint (GString *string,
+                      guint64  value)
+{
+  gchar buf[20];
+  gchar *p = buf + sizeof (buf);
+
+  g_return_val_if_fail (string != NULL, NULL);
+
+  do
+    {
+      *--p = '0' + value % 10;
+      value /= 10;
+    }
+  while (value);
+
+  return g_string_append_len (string, p, buf + sizeof (buf) - p);
+}
+
+/**
+ * g_string_append_int:
+ * @string: a #GString
+ * @value: the number to append
+ *
+ * Appends the decimal representation of @value to @string, like
+ * g_string_append_printf (@string, "%" G_GINT64_FORMAT, @value)
+ * but without parsing a format string.
+ *
+ * Returns: @string
+ *
+ * Since: 2.32
+ */
+GString *
+g_string_append_int (GString *string,
+                     gint64   value)
+{
+  g_return_val_if_fail (string != NULL, NULL);
+
+  if (value < 0)
+    {
+      g_string_append_c (string, '-');
+      /* negate as unsigned, G_MININT64 has no positive counterpart */
+      return g_string_append_uint (string, -(guint64) value);
+    }
+
+  return g_string_append_uint (string, value);
+}
+
+/**
+ * g_string_append_hex:
+ * @string: a #GString
+ * @value: the number to append
+ * @width: minimum number of digits, padded with zeroes
+ * @upper: whether to use upper case digits
+ *
+ * Appends the hexadecimal representation of @value to @string, like
+ * g_string_append_printf (@string, "%0*" G_GINT64_MODIFIER "x",
+ * @width, @value) would (or with "X" if @upper is %TRUE), but without
+ * parsing a format string. No "0x" prefix is added.
+ *
+ * Returns: @string
+ *
+ * Since: 2.32
+ */
+GString *
+g_string_append_hex (GString  *string,
+                     guint64   value,
+                     guint     width,
+                     gboolean  upper)
+{
+  const gchar *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  gchar buf[16];
+  gchar *p = buf + sizeof (buf);
+  gsize len;
+
+  g_return_val_if_fail (string != NULL, NULL);
+
+  do
+    {
+      *--p = digits[value & 0xf];
+      value >>= 4;
+    }
+  while (value);
+
+  len = buf + sizeof (buf) - p;
+
+  g_string_maybe_expand (string, MAX (width, len));
+
+  while (width > len)
+    {
+      string->str[string->len++] = '0';
+      width--;
+    }
+
+  memcpy (string->str + string->len, p, len);
+  string->len += len;
+  string->str[string->len] = 0;
+
+  return string;
+}
+
 /**
  * g_string_prepend:
  * @string: a #GString
@@ -1119,12 +1261,31 @@ g_string_append_vprintf (GString     *string,
                          const gchar *format,
                          va_list      args)
 {
+  gchar stack_buf[256];
+  va_list args_copy;
   gchar *buf;
   gint len;
 
   g_return_if_fail (string != NULL);
   g_return_if_fail (format != NULL);
 
+  /* Most callers append short pieces of text, so format into the stack
+   * first and only go through the heap for long output. Formatting into
+   * a separate buffer keeps arguments that point into @string valid.
+   */
+  G_VA_COPY (args_copy, args);
+  len = g_vsnprintf (stack_buf, sizeof (stack_buf), format, args_copy);
+  va_end (args_copy);
+
+  if (len < 0)
+    return;
+
+  if ((gsize) len < sizeof (stack_buf))
+    {
+      g_string_append_len (string, stack_buf, len);
+      return;
+    }
+
   len = g_vasprintf (&buf, format, args);
 
   if (len >= 0)
@@ -74,6 +74,16 @@ GString*     g_string_append_c          (GString         *string,
                                          gchar            c);
 GString*     g_string_append_unichar    (GString         *string,
                                          gunichar         wc);
+GString*     g_string_reserve           (GString         *string,
+                                         gsize            len);
+GString*     g_string_append_int        (GString         *string,
+                                         gint64           value);
+GString*     g_string_append_uint       (GString         *string,
+                                         guint64          value);
+GString*     g_string_append_hex        (GString         *string,
+                                         guint64          value,
+                                         guint            width,
+                                         gboolean         upper);
 GString*     g_string_prepend           (GString         *string,
                                          const gchar     *val);
 GString*     g_string_prepend_c         (GString         *string,
@@ -31,6 +31,7 @@
 #include "gasyncqueue.h"
 #include "gasyncqueueprivate.h"
 #include "gmain.h"
+#include "gqueue.h"
 #include "gtestutils.h"
 #include "gtimer.h"
 
@@ -75,6 +76,8 @@
 /* #define DEBUG_MSG(args) g_printerr args ; g_printerr ("\n");    */
 
 typedef struct _GRealThreadPool GRealThreadPool;
+typedef struct _GThreadPoolWorker GThreadPoolWorker;
+typedef struct _GThreadPoolStealing GThreadPoolStealing;
 
 /**
  * GThreadPool:
@@ -98,6 +101,36 @@ struct _GRealThreadPool
   gboolean waiting;
   GCompareDataFunc sort_func;
   gpointer sort_user_data;
+  GThreadPoolStealing *stealing;
+};
+
+/* Work stealing pools give every thread its own deque of tasks instead
+ * of sharing one queue. Tasks pushed from outside the pool are spread
+ * over the deques round robin, tasks pushed by a worker go to its own
+ * deque. A worker takes tasks from the head of its deque and, once that
+ * is empty, steals from the tail of the others, so the locks are only
+ * contended when a thread runs out of work.
+ */
+struct _GThreadPoolWorker
+{
+  GMutex mutex;
+  GQueue tasks;
+  GThread *thread;
+  GRealThreadPool *pool;
+};
+
+struct _GThreadPoolStealing
+{
+  GThreadPoolWorker *workers;
+  guint n_workers;
+  guint next_worker;            /* atomic */
+  gint pending;                 /* atomic, tasks in all deques */
+  gint sleeping;                /* atomic */
+  gint ref_count;               /* one per worker plus the owner */
+  GMutex sleep_mutex;
+  GCond sleep_cond;
+  gint stopping;                /* atomic */
+  gint immediate;               /* atomic */
 };
 
 /* The following is just an address to mark the wakeup order for a
@@ -114,6 +147,9 @@ static gint max_unused_threads = 0;
 static gint kill_unused_threads = 0;
 static guint max_idle_time = 0;
 
+/* The worker of a work stealing pool that runs in this thread */
+static GPrivate current_worker;
+
 static void             g_thread_pool_queue_push_unlocked (GRealThreadPool  *pool,
                                                            gpointer          data);
 static void             g_thread_pool_free_internal       (GRealThreadPool  *pool);
@@ -422,6 +458,184 @@ g_thread_pool_start_thread (GRealThreadPool  *pool,
   return TRUE;
 }
 
+static void
+g_thread_pool_stealing_unref (GRealThreadPool *pool)
+{
+  GThreadPoolStealing *stealing = pool->stealing;
+  guint i;
+
+  if (!g_atomic_int_dec_and_test (&stealing->ref_count))
+    return;
+
+  for (i = 0; i < stealing->n_workers; i++)
+    {
+      g_mutex_clear (&stealing->workers[i].mutex);
+      g_queue_clear (&stealing->workers[i].tasks);
+    }
+
+  g_mutex_clear (&stealing->sleep_mutex);
+  g_cond_clear (&stealing->sleep_cond);
+  g_free (stealing->workers);
+  g_free (stealing);
+  g_free (pool);
+}
+
+static gpointer
+g_thread_pool_worker_pop (GThreadPoolWorker *worker,
+                          gboolean           steal)
+{
+  gpointer task;
+
+  g_mutex_lock (&worker->mutex);
+  task = steal ? g_queue_pop_tail (&worker->tasks)
+               : g_queue_pop_head (&worker->tasks);
+  g_mutex_unlock (&worker->mutex);
+
+  return task;
+}
+
+static gpointer
+g_thread_pool_worker_next_task (GThreadPoolWorker *worker)
+{
+  GThreadPoolStealing *stealing = worker->pool->stealing;
+  guint self, i;
+  gpointer task;
+
+  task = g_thread_pool_worker_pop (worker, FALSE);
+  if (task)
+    return task;
+
+  /* Start with the next worker so that thieves spread out */
+  self = worker - stealing->workers;
+  for (i = 1; i < stealing->n_workers; i++)
+    {
+      GThreadPoolWorker *victim;
+
+      victim = &stealing->workers[(self + i) % stealing->n_workers];
+      task = g_thread_pool_worker_pop (victim, TRUE);
+      if (task)
+        return task;
+    }
+
+  return NULL;
+}
+
+static gpointer
+g_thread_pool_worker_proxy (gpointer data)
+{
+  GThreadPoolWorker *worker = data;
+  GRealThreadPool *pool = worker->pool;
+  GThreadPoolStealing *stealing = pool->stealing;
+
+  g_private_set (&current_worker, worker);
+
+  while (!g_atomic_int_get (&stealing->immediate))
+    {
+      gpointer task;
+      gboolean stop;
+
+      task = g_thread_pool_worker_next_task (worker);
+      if (task)
+        {
+          g_atomic_int_add (&stealing->pending, -1);
+          pool->pool.func (task, pool->pool.user_data);
+          continue;
+        }
+
+      /* Pushers only take sleep_mutex if they see sleeping threads, so
+       * sleeping has to be raised before pending is checked again.
+       */
+      g_mutex_lock (&stealing->sleep_mutex);
+      g_atomic_int_inc (&stealing->sleeping);
+      while (g_atomic_int_get (&stealing->pending) == 0 &&
+             !g_atomic_int_get (&stealing->stopping))
+        g_cond_wait (&stealing->sleep_cond, &stealing->sleep_mutex);
+      g_atomic_int_add (&stealing->sleeping, -1);
+      stop = g_atomic_int_get (&stealing->stopping) &&
+             g_atomic_int_get (&stealing->pending) == 0;
+      g_mutex_unlock (&stealing->sleep_mutex);
+
+      if (stop)
+        break;
+    }
+
+  g_private_set (&current_worker, NULL);
+  g_thread_pool_stealing_unref (pool);
+
+  return NULL;
+}
+
+static gboolean
+g_thread_pool_stealing_push (GRealThreadPool *pool,
+                             gpointer         data)
+{
+  GThreadPoolStealing *stealing = pool->stealing;
+  GThreadPoolWorker *worker = g_private_get (&current_worker);
+  gboolean own = worker && worker->pool == pool;
+
+  /* While the pool is being drained, its tasks may still queue more */
+  g_return_val_if_fail (own || pool->running, FALSE);
+
+  if (own)
+    {
+      /* Work spawned by a task stays with its thread while it's hot */
+      g_mutex_lock (&worker->mutex);
+      g_queue_push_head (&worker->tasks, data);
+      g_mutex_unlock (&worker->mutex);
+    }
+  else
+    {
+      guint n = (guint) g_atomic_int_add (&stealing->next_worker, 1);
+
+      worker = &stealing->workers[n % stealing->n_workers];
+      g_mutex_lock (&worker->mutex);
+      g_queue_push_tail (&worker->tasks, data);
+      g_mutex_unlock (&worker->mutex);
+    }
+
+  g_atomic_int_inc (&stealing->pending);
+
+  if (g_atomic_int_get (&stealing->sleeping) > 0)
+    {
+      g_mutex_lock (&stealing->sleep_mutex);
+      g_cond_signal (&stealing->sleep_cond);
+      g_mutex_unlock (&stealing->sleep_mutex);
+    }
+
+  return TRUE;
+}
+
+static void
+g_thread_pool_stealing_free (GRealThreadPool *pool,
+                             gboolean         immediate,
+                             gboolean         wait_)
+{
+  GThreadPoolStealing *stealing = pool->stealing;
+  guint i;
+
+  g_mutex_lock (&stealing->sleep_mutex);
+  g_atomic_int_set (&stealing->immediate, immediate);
+  g_atomic_int_set (&stealing->stopping, TRUE);
+  g_cond_broadcast (&stealing->sleep_cond);
+  g_mutex_unlock (&stealing->sleep_mutex);
+
+  for (i = 0; i < stealing->n_workers; i++)
+    {
+      GThread *thread = stealing->workers[i].thread;
+
+      if (!thread)
+        continue;
+
+      if (wait_)
+        g_thread_join (thread);
+      else
+        g_thread_unref (thread);
+    }
+
+  /* The last worker to finish frees the pool */
+  g_thread_pool_stealing_unref (pool);
+}
+
 /**
  * g_thread_pool_new:
  * @func: a function to execute in the threads of the new thread pool
@@ -485,6 +699,7 @@ g_thread_pool_new (GFunc      func,
   retval->waiting = FALSE;
   retval->sort_func = NULL;
   retval->sort_user_data = NULL;
+  retval->stealing = NULL;
 
   G_LOCK (init);
   if (!unused_thread_queue)
@@ -512,6 +727,89 @@ g_thread_pool_new (GFunc      func,
   return (GThreadPool*) retval;
 }
 
+/**
+ * g_thread_pool_new_work_stealing:
+ * @func: a function to execute in the threads of the new thread pool
+ * @user_data: user data that is handed over to @func every time it
+ *     is called
+ * @num_threads: the number of threads of the new thread pool
+ * @error: return location for error, or %NULL
+ *
+ * This function creates a new exclusive thread pool with @num_threads
+ * threads that don't share a single task queue. Instead, every thread
+ * has its own deque of tasks: tasks pushed with g_thread_pool_push()
+ * from outside the pool are distributed among the threads, tasks that
+ * @func pushes to its own pool are queued for the calling thread, and
+ * a thread that has run out of tasks steals them from the others.
+ *
+ * This avoids contention on the queue lock when many small tasks are
+ * pushed or when tasks spawn more tasks, at the expense of ordering:
+ * tasks are not processed in the order they were pushed, and the pool
+ * can't be sorted with g_thread_pool_set_sort_function(). The number
+ * of threads is fixed for the lifetime of the pool.
+ *
+ * When the pool is freed with g_thread_pool_free() without @immediate,
+ * its tasks may still push new tasks to it until all work is done.
+ *
+ * Return value: the new #GThreadPool, or %NULL if not all threads
+ *     could be created
+ *
+ * Since: 2.32
+ */
+GThreadPool *
+g_thread_pool_new_work_stealing (GFunc      func,
+                                 gpointer   user_data,
+                                 gint       num_threads,
+                                 GError   **error)
+{
+  GRealThreadPool *retval;
+  GThreadPoolStealing *stealing;
+  gint i;
+
+  g_return_val_if_fail (func, NULL);
+  g_return_val_if_fail (num_threads > 0, NULL);
+
+  retval = g_new0 (GRealThreadPool, 1);
+  retval->pool.func = func;
+  retval->pool.user_data = user_data;
+  retval->pool.exclusive = TRUE;
+  retval->max_threads = num_threads;
+  retval->num_threads = num_threads;
+  retval->running = TRUE;
+
+  stealing = g_new0 (GThreadPoolStealing, 1);
+  stealing->workers = g_new0 (GThreadPoolWorker, num_threads);
+  stealing->n_workers = num_threads;
+  stealing->ref_count = 1;
+  g_mutex_init (&stealing->sleep_mutex);
+  g_cond_init (&stealing->sleep_cond);
+  retval->stealing = stealing;
+
+  for (i = 0; i < num_threads; i++)
+    {
+      g_mutex_init (&stealing->workers[i].mutex);
+      g_queue_init (&stealing->workers[i].tasks);
+      stealing->workers[i].pool = retval;
+    }
+
+  for (i = 0; i < num_threads; i++)
+    {
+      GThreadPoolWorker *worker = &stealing->workers[i];
+
+      g_atomic_int_inc (&stealing->ref_count);
+      worker->thread = g_thread_try_new ("pool", g_thread_pool_worker_proxy,
+                                         worker, error);
+      if (worker->thread == NULL)
+        {
+          g_atomic_int_add (&stealing->ref_count, -1);
+          g_thread_pool_stealing_free (retval, TRUE, TRUE);
+          return NULL;
+        }
+    }
+
+  return (GThreadPool*) retval;
+}
+
 /**
  * g_thread_pool_push:
  * @pool: a #GThreadPool
@@ -546,6 +844,10 @@ g_thread_pool_push (GThreadPool  *pool,
   real = (GRealThreadPool*) pool;
 
   g_return_val_if_fail (real, FALSE);
+
+  if (real->stealing)
+    return g_thread_pool_stealing_push (real, data);
+
   g_return_val_if_fail (real->running, FALSE);
 
   result = TRUE;
@@ -615,6 +917,7 @@ g_thread_pool_set_max_threads (GThreadPool  *pool,
   g_return_val_if_fail (real->running, FALSE);
   g_return_val_if_fail (!real->pool.exclusive || max_threads != -1, FALSE);
   g_return_val_if_fail (max_threads >= -1, FALSE);
+  g_return_val_if_fail (real->stealing == NULL, FALSE);
 
   result = TRUE;
 
@@ -663,6 +966,9 @@ g_thread_pool_get_max_threads (GThreadPool *pool)
   g_return_val_if_fail (real, 0);
   g_return_val_if_fail (real->running, 0);
 
+  if (real->stealing)
+    return real->max_threads;
+
   g_async_queue_lock (real->queue);
   retval = real->max_threads;
   g_async_queue_unlock (real->queue);
@@ -689,6 +995,9 @@ g_thread_pool_get_num_threads (GThreadPool *pool)
   g_return_val_if_fail (real, 0);
   g_return_val_if_fail (real->running, 0);
 
+  if (real->stealing)
+    return real->num_threads;
+
   g_async_queue_lock (real->queue);
   retval = real->num_threads;
   g_async_queue_unlock (real->queue);
@@ -715,7 +1024,10 @@ g_thread_pool_unprocessed (GThreadPool *pool)
   g_return_val_if_fail (real, 0);
   g_return_val_if_fail (real->running, 0);
 
-  unprocessed = g_async_queue_length (real->queue);
+  if (real->stealing)
+    unprocessed = g_atomic_int_get (&real->stealing->pending);
+  else
+    unprocessed = g_async_queue_length (real->queue);
 
   return MAX (unprocessed, 0);
 }
@@ -753,6 +1065,13 @@ g_thread_pool_free (GThreadPool *pool,
   g_return_if_fail (real);
   g_return_if_fail (real->running);
 
+  if (real->stealing)
+    {
+      real->running = FALSE;
+      g_thread_pool_stealing_free (real, immediate, wait_);
+      return;
+    }
+
   /* If there's no thread allowed here, there is not much sense in
    * not stopping this pool immediately, when it's not empty
    */
@@ -937,6 +1256,7 @@ g_thread_pool_set_sort_function (GThreadPool      *pool,
 
   g_return_if_fail (real);
   g_return_if_fail (real->running);
+  g_return_if_fail (real->stealing == NULL);
 
   g_async_queue_lock (real->queue);
 
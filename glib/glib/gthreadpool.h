@@ -52,6 +52,10 @@ GThreadPool *   g_thread_pool_new               (GFunc            func,
                                                  gint             max_threads,
                                                  gboolean         exclusive,
                                                  GError         **error);
+GThreadPool *   g_thread_pool_new_work_stealing (GFunc            func,
+                                                 gpointer         user_data,
+                                                 gint             num_threads,
+                                                 GError         **error);
 void            g_thread_pool_free              (GThreadPool     *pool,
                                                  gboolean         immediate,
                                                  gboolean         wait_);
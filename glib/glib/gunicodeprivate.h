@@ -30,6 +30,20 @@ G_GNUC_INTERNAL gunichar *_g_utf8_normalize_wc
 				gssize          max_len,
 				GNormalizeMode  mode);
 
+G_GNUC_INTERNAL gsize     _g_utf8_ascii_prefix
+				(const gchar    *str,
+				gssize          max_len);
+G_GNUC_INTERNAL gsize     _g_utf16_ascii_to_utf8
+				(gchar          *out,
+				const guchar   *in,
+				gsize           n_units,
+				gboolean        big_endian);
+G_GNUC_INTERNAL void      _g_ascii_to_utf16
+				(guchar         *out,
+				const gchar    *in,
+				gsize           len,
+				gboolean        big_endian);
+
 G_END_DECLS
 
 #endif /* __G_UNICODE_PRIVATE_H__ */
@@ -40,8 +40,13 @@
 #include "gtestutils.h"
 #include "gtypes.h"
 #include "gthread.h"
+#include "gunicodeprivate.h"
 #include "glibintl.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define UTF8_COMPUTE(Char, Mask, Len)					      \
   if (Char < 128)							      \
     {									      \
@@ -133,6 +138,227 @@ static const gchar utf8_skip_data[256] = {
 
 const gchar * const g_utf8_skip = utf8_skip_data;
 
+/* Most strings handled by GLib users are ASCII, or mostly so: device
+ * names, object paths, file names. The helpers below find and convert
+ * runs of ASCII characters a block at a time, 16 bytes with SSE2 and a
+ * machine word otherwise, leaving everything else to the
+ * character-by-character code.
+ *
+ * NUL is not counted as ASCII here, since it ends strings.
+ */
+#define IS_ASCII_NON_NUL(c) ((guchar) ((c) - 1) < 0x7f)
+
+#ifdef __SSE2__
+
+#define ASCII_BLOCK 16
+
+static inline gboolean
+ascii_block (const guchar *p)
+{
+  __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+
+  /* 0x01 to 0x7f are the positive bytes */
+  return _mm_movemask_epi8 (_mm_cmpgt_epi8 (v, _mm_setzero_si128 ())) == 0xffff;
+}
+
+#else
+
+#define ASCII_BLOCK GLIB_SIZEOF_SIZE_T
+
+#define ASCII_ONES ((gsize) -1 / 0xff)
+#define ASCII_HIGH (ASCII_ONES * 0x80)
+
+static inline gboolean
+ascii_block (const guchar *p)
+{
+  gsize word;
+
+  memcpy (&word, p, sizeof (word));
+
+  /* no byte with the top bit set, and no zero byte */
+  return (word & ASCII_HIGH) == 0 &&
+    ((word - ASCII_ONES) & ~word & ASCII_HIGH) == 0;
+}
+
+#endif
+
+/* Skips whole blocks of ASCII. Blocks are only loaded when they are
+ * entirely before @end, so nul-terminated strings have to be measured
+ * first; strlen() is vectorized by the C library anyway.
+ */
+static inline const gchar *
+ascii_skip_len (const gchar *p,
+                const gchar *end)
+{
+  while (end - p >= ASCII_BLOCK && ascii_block ((const guchar *) p))
+    p += ASCII_BLOCK;
+
+  return p;
+}
+
+/*
+ * _g_utf8_ascii_prefix:
+ * @str: UTF-8 text
+ * @max_len: bytes to look at, or -1 if @str is nul-terminated
+ *
+ * Returns: the number of ASCII bytes at the start of @str
+ */
+gsize
+_g_utf8_ascii_prefix (const gchar *str,
+                      gssize       max_len)
+{
+  const guchar *p = (const guchar *) str;
+  const guchar *end;
+
+  if (max_len < 0)
+    max_len = strlen (str);
+
+  end = p + max_len;
+
+  p = (const guchar *) ascii_skip_len ((const gchar *) p, (const gchar *) end);
+
+  while (p < end && IS_ASCII_NON_NUL (*p))
+    p++;
+
+  return p - (const guchar *) str;
+}
+
+/* Counts ASCII code units at the start of native endian UTF-16 text.
+ * Without a length, there is no cheap way to find the end of the text
+ * first, so only the unit-by-unit loop is used.
+ */
+static gsize
+utf16_ascii_prefix (const gunichar2 *str,
+                    gssize           max_len)
+{
+  const gunichar2 *p = str;
+  const gunichar2 *end = max_len < 0 ? NULL : str + max_len;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i limit = _mm_set1_epi16 (0x80);
+
+  while (end && end - p >= 8)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+      __m128i ok = _mm_and_si128 (_mm_cmpgt_epi16 (v, zero),
+                                  _mm_cmplt_epi16 (v, limit));
+
+      if (_mm_movemask_epi8 (ok) != 0xffff)
+        break;
+
+      p += 8;
+    }
+#endif
+
+  while ((!end || p < end) && *p > 0 && *p < 0x80)
+    p++;
+
+  return p - str;
+}
+
+/*
+ * _g_utf16_ascii_to_utf8:
+ * @out: buffer for at least @n_units bytes
+ * @in: UTF-16 text, not necessarily aligned
+ * @n_units: number of code units in @in
+ * @big_endian: whether @in is big endian
+ *
+ * Converts the ASCII code units at the start of @in.
+ *
+ * Returns: the number of code units converted
+ */
+gsize
+_g_utf16_ascii_to_utf8 (gchar        *out,
+                        const guchar *in,
+                        gsize         n_units,
+                        gboolean      big_endian)
+{
+  gsize i = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i limit = _mm_set1_epi16 (0x80);
+
+  for (; n_units - i >= 8; i += 8)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (in + 2 * i));
+      __m128i ok;
+
+      if (big_endian)
+        v = _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8));
+
+      ok = _mm_and_si128 (_mm_cmpgt_epi16 (v, zero),
+                          _mm_cmplt_epi16 (v, limit));
+      if (_mm_movemask_epi8 (ok) != 0xffff)
+        break;
+
+      _mm_storel_epi64 ((__m128i *) (out + i), _mm_packus_epi16 (v, v));
+    }
+#endif
+
+  for (; i < n_units; i++)
+    {
+      guint c = big_endian ? (in[2 * i] << 8) | in[2 * i + 1]
+                           : in[2 * i] | (in[2 * i + 1] << 8);
+
+      if (c == 0 || c >= 0x80)
+        break;
+
+      out[i] = c;
+    }
+
+  return i;
+}
+
+/*
+ * _g_ascii_to_utf16:
+ * @out: buffer for 2 * @len bytes, not necessarily aligned
+ * @in: ASCII text
+ * @len: length of @in
+ * @big_endian: whether to write big endian UTF-16
+ *
+ * Widens ASCII text to UTF-16.
+ */
+void
+_g_ascii_to_utf16 (guchar      *out,
+                   const gchar *in,
+                   gsize        len,
+                   gboolean     big_endian)
+{
+  gsize i = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128 ();
+
+  for (; len - i >= 16; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (in + i));
+      __m128i lo, hi;
+
+      if (big_endian)
+        {
+          lo = _mm_unpacklo_epi8 (zero, v);
+          hi = _mm_unpackhi_epi8 (zero, v);
+        }
+      else
+        {
+          lo = _mm_unpacklo_epi8 (v, zero);
+          hi = _mm_unpackhi_epi8 (v, zero);
+        }
+
+      _mm_storeu_si128 ((__m128i *) (out + 2 * i), lo);
+      _mm_storeu_si128 ((__m128i *) (out + 2 * i + 16), hi);
+    }
+#endif
+
+  for (; i < len; i++)
+    {
+      out[2 * i + !big_endian] = 0;
+      out[2 * i + big_endian] = in[i];
+    }
+}
+
 /**
  * g_utf8_find_prev_char:
  * @str: pointer to the beginning of a UTF-8 encoded string
@@ -986,7 +1212,7 @@ g_utf16_to_utf8 (const gunichar2  *str,
   /* This function and g_utf16_to_ucs4 are almost exactly identical - The lines that differ
    * are marked.
    */
-  const gunichar2 *in;
+  const gunichar2 *in, *in_end;
   gchar *out;
   gchar *result = NULL;
   gint n_bytes;
@@ -1002,6 +1228,17 @@ g_utf16_to_utf8 (const gunichar2  *str,
       gunichar2 c = *in;
       gunichar wc;
 
+      /********** DIFFERENT for UTF8/UCS4 **********/
+      if (c < 0x80 && !high_surrogate &&
+	  (len < 0 || len - (in - str) > 1) && in[1] > 0 && in[1] < 0x80)
+	{
+	  gsize n_ascii = utf16_ascii_prefix (in, len < 0 ? -1 : len - (in - str));
+
+	  n_bytes += n_ascii;
+	  in += n_ascii;
+	  continue;
+	}
+
       if (c >= 0xdc00 && c < 0xe000) /* low surrogate */
 	{
 	  if (high_surrogate)
@@ -1047,6 +1284,8 @@ g_utf16_to_utf8 (const gunichar2  *str,
                            _("Partial character sequence at end of input"));
       goto err_out;
     }
+
+  in_end = in;
   
   /* At this point, everything is valid, and we just need to convert
    */
@@ -1061,6 +1300,19 @@ g_utf16_to_utf8 (const gunichar2  *str,
       gunichar2 c = *in;
       gunichar wc;
 
+      /********** DIFFERENT for UTF8/UCS4 **********/
+      if (c < 0x80 && out + 1 < result + n_bytes && in[1] < 0x80)
+	{
+	  gsize n_ascii = _g_utf16_ascii_to_utf8 (out, (const guchar *) in,
+	                                          MIN (result + n_bytes - out,
+	                                               in_end - in),
+	                                          G_BYTE_ORDER == G_BIG_ENDIAN);
+
+	  out += n_ascii;
+	  in += n_ascii;
+	  continue;
+	}
+
       if (c >= 0xdc00 && c < 0xe000) /* low surrogate */
 	{
 	  wc = SURROGATE_VALUE (high_surrogate, c);
@@ -1276,7 +1528,19 @@ g_utf8_to_utf16 (const gchar *str,
   n16 = 0;
   while ((len < 0 || str + len - in > 0) && *in)
     {
-      gunichar wc = g_utf8_get_char_extended (in, len < 0 ? 6 : str + len - in);
+      gunichar wc;
+
+      if (*(guchar *)in < 0x80 &&
+	  (len < 0 || str + len - in > 1) && IS_ASCII_NON_NUL (in[1]))
+	{
+	  gsize n_ascii = _g_utf8_ascii_prefix (in, len < 0 ? -1 : str + len - in);
+
+	  n16 += n_ascii;
+	  in += n_ascii;
+	  continue;
+	}
+
+      wc = g_utf8_get_char_extended (in, len < 0 ? 6 : str + len - in);
       if (wc & 0x80000000)
 	{
 	  if (wc == (gunichar)-2)
@@ -1323,7 +1587,20 @@ g_utf8_to_utf16 (const gchar *str,
   in = str;
   for (i = 0; i < n16;)
     {
-      gunichar wc = g_utf8_get_char (in);
+      gunichar wc;
+
+      if (*(guchar *)in < 0x80 && i + 1 < n16 && IS_ASCII_NON_NUL (in[1]))
+	{
+	  gsize n_ascii = _g_utf8_ascii_prefix (in, n16 - i);
+
+	  _g_ascii_to_utf16 ((guchar *) (result + i), in, n_ascii,
+	                     G_BYTE_ORDER == G_BIG_ENDIAN);
+	  i += n_ascii;
+	  in += n_ascii;
+	  continue;
+	}
+
+      wc = g_utf8_get_char (in);
 
       if (wc < 0x10000)
 	{
@@ -1450,72 +1727,6 @@ g_ucs4_to_utf16 (const gunichar  *str,
   val |= (*(guchar *)p) & 0x3f;                     \
  } G_STMT_END
 
-static const gchar *
-fast_validate (const char *str)
-
-{
-  gunichar val = 0;
-  gunichar min = 0;
-  const gchar *p;
-
-  for (p = str; *p; p++)
-    {
-      if (*(guchar *)p < 128)
-	/* done */;
-      else 
-	{
-	  const gchar *last;
-	  
-	  last = p;
-	  if ((*(guchar *)p & 0xe0) == 0xc0) /* 110xxxxx */
-	    {
-	      if (G_UNLIKELY ((*(guchar *)p & 0x1e) == 0))
-		goto error;
-	      p++;
-	      if (G_UNLIKELY ((*(guchar *)p & 0xc0) != 0x80)) /* 10xxxxxx */
-		goto error;
-	    }
-	  else
-	    {
-	      if ((*(guchar *)p & 0xf0) == 0xe0) /* 1110xxxx */
-		{
-		  min = (1 << 11);
-		  val = *(guchar *)p & 0x0f;
-		  goto TWO_REMAINING;
-		}
-	      else if ((*(guchar *)p & 0xf8) == 0xf0) /* 11110xxx */
-		{
-		  min = (1 << 16);
-		  val = *(guchar *)p & 0x07;
-		}
-	      else
-		goto error;
-	      
-	      p++;
-	      CONTINUATION_CHAR;
-	    TWO_REMAINING:
-	      p++;
-	      CONTINUATION_CHAR;
-	      p++;
-	      CONTINUATION_CHAR;
-	      
-	      if (G_UNLIKELY (val < min))
-		goto error;
-
-	      if (G_UNLIKELY (!UNICODE_VALID(val)))
-		goto error;
-	    } 
-	  
-	  continue;
-	  
-	error:
-	  return last;
-	}
-    }
-
-  return p;
-}
-
 static const gchar *
 fast_validate_len (const char *str,
 		   gssize      max_len)
@@ -1530,7 +1741,15 @@ fast_validate_len (const char *str,
   for (p = str; ((p - str) < max_len) && *p; p++)
     {
       if (*(guchar *)p < 128)
-	/* done */;
+	{
+	  if (((gsize) p & (ASCII_BLOCK - 1)) == 0)
+	    {
+	      const gchar *next = ascii_skip_len (p, str + max_len);
+
+	      if (next != p)
+		p = next - 1;
+	    }
+	}
       else 
 	{
 	  const gchar *last;
@@ -1593,6 +1812,15 @@ fast_validate_len (const char *str,
   return p;
 }
 
+/* Finding the end first lets ASCII be skipped a block at a time
+ * without ever reading past the string.
+ */
+static const gchar *
+fast_validate (const char *str)
+{
+  return fast_validate_len (str, strlen (str));
+}
+
 /**
  * g_utf8_validate:
  * @str: (array length=max_len) (element-type guint8): a pointer to character data
@@ -24,6 +24,7 @@
 #define GLIB_DISABLE_DEPRECATION_WARNINGS
 
 #include <glib.h>
+#include <string.h>
 
 static gint
 compare_func (gconstpointer d1, gconstpointer d2, gpointer data)
@@ -203,6 +204,108 @@ test_async_queue_timed (void)
   g_assert_cmpint (diff, <, G_USEC_PER_SEC);
 }
 
+static void
+test_async_queue_bounded (void)
+{
+  GAsyncQueue *q;
+  gint i;
+
+  q = g_async_queue_new_bounded (5, destroy_notify);
+
+  g_assert (g_async_queue_try_pop (q) == NULL);
+  g_assert (g_async_queue_timeout_pop (q, G_USEC_PER_SEC / 100) == NULL);
+  g_assert_cmpint (g_async_queue_length (q), ==, 0);
+
+  /* the capacity is rounded up to 8 */
+  for (i = 1; i <= 8; i++)
+    g_async_queue_push (q, GINT_TO_POINTER (i));
+  g_assert_cmpint (g_async_queue_length (q), ==, 8);
+
+  for (i = 1; i <= 6; i++)
+    g_assert_cmpint (GPOINTER_TO_INT (g_async_queue_pop (q)), ==, i);
+
+  /* wrap around the ring */
+  for (i = 9; i <= 12; i++)
+    g_async_queue_push (q, GINT_TO_POINTER (i));
+
+  g_assert_cmpint (GPOINTER_TO_INT (g_async_queue_try_pop (q)), ==, 7);
+  g_assert_cmpint (GPOINTER_TO_INT (g_async_queue_timeout_pop (q, 0)), ==, 8);
+
+  g_async_queue_lock (q);
+  g_assert_cmpint (g_async_queue_length_unlocked (q), ==, 4);
+  g_assert_cmpint (GPOINTER_TO_INT (g_async_queue_pop_unlocked (q)), ==, 9);
+  g_async_queue_unlock (q);
+
+  destroy_count = 0;
+  g_async_queue_unref (q);
+  g_assert_cmpint (destroy_count, ==, 3);
+}
+
+#define BOUNDED_THREADS 4
+#define BOUNDED_ITEMS   20000
+
+static gint bounded_sums[BOUNDED_THREADS];
+
+static gpointer
+bounded_producer (gpointer data)
+{
+  gint i;
+
+  for (i = 1; i <= BOUNDED_ITEMS; i++)
+    g_async_queue_push (q, GINT_TO_POINTER (i));
+
+  return NULL;
+}
+
+static gpointer
+bounded_consumer (gpointer data)
+{
+  gint pos = GPOINTER_TO_INT (data);
+  gint value;
+
+  while ((value = GPOINTER_TO_INT (g_async_queue_pop (q))) != -1)
+    bounded_sums[pos] += value;
+
+  return NULL;
+}
+
+static void
+test_async_queue_bounded_threads (void)
+{
+  GThread *producers[BOUNDED_THREADS];
+  GThread *consumers[BOUNDED_THREADS];
+  gint i, sum = 0;
+
+  /* a small ring makes producers block on a full queue */
+  q = g_async_queue_new_bounded (16, NULL);
+  memset (bounded_sums, 0, sizeof (bounded_sums));
+
+  for (i = 0; i < BOUNDED_THREADS; i++)
+    {
+      consumers[i] = g_thread_new ("consumer", bounded_consumer,
+                                   GINT_TO_POINTER (i));
+      producers[i] = g_thread_new ("producer", bounded_producer, NULL);
+    }
+
+  for (i = 0; i < BOUNDED_THREADS; i++)
+    g_thread_join (producers[i]);
+
+  for (i = 0; i < BOUNDED_THREADS; i++)
+    g_async_queue_push (q, GINT_TO_POINTER (-1));
+
+  for (i = 0; i < BOUNDED_THREADS; i++)
+    {
+      g_thread_join (consumers[i]);
+      sum += bounded_sums[i];
+    }
+
+  g_assert_cmpint (sum, ==,
+                   BOUNDED_THREADS * (BOUNDED_ITEMS * (BOUNDED_ITEMS + 1) / 2));
+  g_assert_cmpint (g_async_queue_length (q), ==, 0);
+
+  g_async_queue_unref (q);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -212,6 +315,8 @@ main (int argc, char *argv[])
   g_test_add_func ("/asyncqueue/destroy", test_async_queue_destroy);
   g_test_add_func ("/asyncqueue/threads", test_async_queue_threads);
   g_test_add_func ("/asyncqueue/timed", test_async_queue_timed);
+  g_test_add_func ("/asyncqueue/bounded", test_async_queue_bounded);
+  g_test_add_func ("/asyncqueue/bounded/threads", test_async_queue_bounded_threads);
 
   return g_test_run ();
 }
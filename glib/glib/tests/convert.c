@@ -701,6 +701,194 @@ test_no_conv (void)
   g_assert (error && error->domain == G_CONVERT_ERROR);
 }
 
+static void
+check_utf16_bytes (const gchar     *bytes,
+                   gsize            n_bytes,
+                   const gunichar2 *utf16,
+                   glong            n_units,
+                   gboolean         big_endian)
+{
+  glong i;
+
+  g_assert_cmpint (n_bytes, ==, n_units * 2);
+
+  for (i = 0; i < n_units; i++)
+    {
+      guint16 unit;
+
+      if (big_endian)
+        unit = ((guchar) bytes[2 * i] << 8) | (guchar) bytes[2 * i + 1];
+      else
+        unit = (guchar) bytes[2 * i] | ((guchar) bytes[2 * i + 1] << 8);
+
+      g_assert_cmpint (unit, ==, utf16[i]);
+    }
+}
+
+/* ASCII runs of every length and alignment, possibly interrupted by
+ * other characters, compared with conversions through UCS-4
+ */
+static void
+test_ascii_conversions (void)
+{
+  const gchar *inserts[] = { "", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9d\x84\x9e" };
+  union { gunichar2 u[160]; guint64 align; } buf16;
+  gchar text[160];
+  gint insert, offset, len, i;
+
+  for (insert = 0; insert < G_N_ELEMENTS (inserts); insert++)
+    for (len = 0; len < 80; len++)
+      {
+        gunichar *ucs4;
+        gunichar2 *expected, *utf16;
+        gchar *utf8, *converted;
+        glong n_ucs4, n_units, n_written;
+        gsize bytes_read, bytes_written;
+
+        for (i = 0; i < len; i++)
+          text[i] = 'A' + i % 26;
+        text[len] = '\0';
+        /* put the other character in the middle of the ASCII */
+        if (len > 0)
+          {
+            gchar *rest = g_strdup (text + len / 2);
+
+            strcpy (text + len / 2, inserts[insert]);
+            strcat (text, rest);
+            g_free (rest);
+          }
+
+        ucs4 = g_utf8_to_ucs4_fast (text, -1, &n_ucs4);
+        expected = g_ucs4_to_utf16 (ucs4, n_ucs4, NULL, &n_units, NULL);
+        g_free (ucs4);
+
+        utf16 = g_utf8_to_utf16 (text, -1, NULL, &n_written, NULL);
+        g_assert_cmpint (n_written, ==, n_units);
+        g_assert (memcmp (utf16, expected, (n_units + 1) * 2) == 0);
+        g_free (utf16);
+
+        utf16 = g_utf8_to_utf16 (text, strlen (text), NULL, &n_written, NULL);
+        g_assert_cmpint (n_written, ==, n_units);
+        g_assert (memcmp (utf16, expected, (n_units + 1) * 2) == 0);
+        g_free (utf16);
+
+        for (offset = 0; offset < 8; offset++)
+          {
+            gunichar2 *in = buf16.u + offset;
+
+            memcpy (in, expected, (n_units + 1) * 2);
+
+            utf8 = g_utf16_to_utf8 (in, -1, NULL, NULL, NULL);
+            g_assert_cmpstr (utf8, ==, text);
+            g_free (utf8);
+
+            utf8 = g_utf16_to_utf8 (in, n_units, NULL, NULL, NULL);
+            g_assert_cmpstr (utf8, ==, text);
+            g_free (utf8);
+          }
+
+        converted = g_convert (text, -1, "UTF-16BE", "UTF-8",
+                               &bytes_read, &bytes_written, NULL);
+        g_assert_cmpint (bytes_read, ==, strlen (text));
+        check_utf16_bytes (converted, bytes_written, expected, n_units, TRUE);
+
+        utf8 = g_convert (converted, bytes_written, "UTF-8", "UTF-16BE",
+                          &bytes_read, NULL, NULL);
+        g_assert_cmpint (bytes_read, ==, n_units * 2);
+        g_assert_cmpstr (utf8, ==, text);
+        g_free (utf8);
+        g_free (converted);
+
+        converted = g_convert (text, strlen (text), "UTF-16LE", "UTF-8",
+                               NULL, &bytes_written, NULL);
+        check_utf16_bytes (converted, bytes_written, expected, n_units, FALSE);
+
+        utf8 = g_convert (converted, bytes_written, "UTF-8", "UTF-16LE",
+                          NULL, NULL, NULL);
+        g_assert_cmpstr (utf8, ==, text);
+        g_free (utf8);
+        g_free (converted);
+
+        g_free (expected);
+      }
+}
+
+static void
+test_ascii_convert_partial (void)
+{
+  gchar *out;
+  gsize bytes_read, bytes_written;
+  GError *error = NULL;
+
+  /* trailing partial character */
+  out = g_convert ("\0a\0b\0", 5, "UTF-8", "UTF-16BE",
+                   &bytes_read, &bytes_written, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (out, ==, "ab");
+  g_assert_cmpint (bytes_read, ==, 4);
+  g_assert_cmpint (bytes_written, ==, 2);
+  g_free (out);
+
+  out = g_convert ("\0a\0b\0", 5, "UTF-8", "UTF-16BE",
+                   NULL, NULL, &error);
+  g_assert_error (error, G_CONVERT_ERROR, G_CONVERT_ERROR_PARTIAL_INPUT);
+  g_assert (out == NULL);
+  g_clear_error (&error);
+
+  /* embedded nul */
+  out = g_convert ("a\0\0\0b\0", 6, "UTF-8", "UTF-16LE",
+                   NULL, &bytes_written, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (bytes_written, ==, 3);
+  g_assert (memcmp (out, "a\0b", 4) == 0);
+  g_free (out);
+
+  out = g_convert ("a\0b", 3, "UTF-16BE", "UTF-8",
+                   NULL, &bytes_written, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (bytes_written, ==, 6);
+  g_assert (memcmp (out, "\0a\0\0\0b", 6) == 0);
+  g_free (out);
+}
+
+/* The input is allocated with its exact length, so that reading past
+ * it shows up under a memory checker; the non-ASCII tail makes the
+ * output longer than the input.
+ */
+static void
+test_ascii_short_tail (void)
+{
+  const gunichar2 tail[] = { 0x20ac, 0x20ac };
+  gint len, i;
+
+  for (len = 2; len < 20; len++)
+    {
+      gunichar2 *in = g_new (gunichar2, len + G_N_ELEMENTS (tail));
+      GString *expected = g_string_new (NULL);
+      gchar *utf8;
+      glong items_read, items_written;
+
+      for (i = 0; i < len; i++)
+        {
+          in[i] = 'a' + i;
+          g_string_append_c (expected, 'a' + i);
+        }
+
+      memcpy (in + len, tail, sizeof (tail));
+      g_string_append (expected, "\xe2\x82\xac\xe2\x82\xac");
+
+      utf8 = g_utf16_to_utf8 (in, len + G_N_ELEMENTS (tail),
+                              &items_read, &items_written, NULL);
+      g_assert_cmpstr (utf8, ==, expected->str);
+      g_assert_cmpint (items_read, ==, len + G_N_ELEMENTS (tail));
+      g_assert_cmpint (items_written, ==, expected->len);
+      g_free (utf8);
+
+      g_string_free (expected, TRUE);
+      g_free (in);
+    }
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -711,6 +899,9 @@ main (int argc, char *argv[])
   g_test_add_func ("/conversion/illegal-sequence", test_one_half);
   g_test_add_func ("/conversion/byte-order", test_byte_order);
   g_test_add_func ("/conversion/unicode", test_unicode_conversions);
+  g_test_add_func ("/conversion/ascii", test_ascii_conversions);
+  g_test_add_func ("/conversion/ascii-partial", test_ascii_convert_partial);
+  g_test_add_func ("/conversion/ascii-short-tail", test_ascii_short_tail);
   g_test_add_func ("/conversion/filename-utf8", test_filename_utf8);
   g_test_add_func ("/conversion/filename-display", test_filename_display);
 
@@ -1058,6 +1058,9 @@ struct _GHashTable
 #endif
   GDestroyNotify   key_destroy_func;
   GDestroyNotify   value_destroy_func;
+
+  guint8          *ctrl;
+  gboolean         interned;
 };
 
 static void
@@ -1090,12 +1093,18 @@ check_data (GHashTable *h)
         {
           g_assert (h->keys[i] == NULL);
           g_assert (h->values[i] == NULL);
+          g_assert_cmpint (h->ctrl[i], ==, h->hashes[i] == 0 ? 0x80 : 0xfe);
         }
       else
         {
           g_assert_cmpint (h->hashes[i], ==, h->hash_func (h->keys[i]));
+          g_assert_cmpint (h->ctrl[i], ==, (h->hashes[i] * 0x9e3779b1U) >> 25);
         }
     }
+
+  /* at least the first 8 control bytes are mirrored behind the table */
+  for (i = 0; i < 8; i++)
+    g_assert_cmpint (h->ctrl[h->size + i], ==, h->ctrl[i % h->size]);
 }
 
 static void
@@ -1169,6 +1178,146 @@ test_internal_consistency (void)
   g_hash_table_unref (h);
 }
 
+static guint
+constant_hash (gconstpointer v)
+{
+  return 42;
+}
+
+static guint
+low_bits_hash (gconstpointer v)
+{
+  /* only distinguishes keys by multiples of 256 */
+  return (GPOINTER_TO_UINT (v) & ~0xffU) + 0x100;
+}
+
+/* keep clear of the hash values reserved for unused and deleted buckets */
+#define HASH_TEST_KEY(i) GUINT_TO_POINTER ((i) + 16)
+
+static void
+test_bad_hash (void)
+{
+  GHashFunc funcs[] = { constant_hash, low_bits_hash, g_direct_hash };
+  guint f, i;
+
+  for (f = 0; f < G_N_ELEMENTS (funcs); f++)
+    {
+      GHashTable *h = g_hash_table_new (funcs[f], g_direct_equal);
+      guint n = funcs[f] == constant_hash ? 200 : 5000;
+
+      for (i = 1; i <= n; i++)
+        g_hash_table_insert (h, HASH_TEST_KEY (i), GUINT_TO_POINTER (i * 2));
+      check_consistency (h);
+      g_assert_cmpint (g_hash_table_size (h), ==, n);
+
+      for (i = 1; i <= n; i++)
+        g_assert_cmpuint (GPOINTER_TO_UINT (g_hash_table_lookup (h, HASH_TEST_KEY (i))), ==, i * 2);
+      g_assert (!g_hash_table_contains (h, HASH_TEST_KEY (n + 1)));
+
+      /* leave tombstones behind, then fill them again */
+      for (i = 1; i <= n; i += 2)
+        g_assert (g_hash_table_remove (h, HASH_TEST_KEY (i)));
+      check_consistency (h);
+
+      for (i = 1; i <= n; i++)
+        g_assert (g_hash_table_contains (h, HASH_TEST_KEY (i)) == (i % 2 == 0));
+
+      for (i = 1; i <= n; i += 2)
+        g_hash_table_insert (h, HASH_TEST_KEY (i), GUINT_TO_POINTER (i * 2));
+      check_consistency (h);
+      g_assert_cmpint (g_hash_table_size (h), ==, n);
+
+      g_hash_table_unref (h);
+    }
+}
+
+static void
+test_churn (void)
+{
+  GHashTable *h;
+  gboolean present[1024] = { FALSE, };
+  guint n = 0;
+  gint i;
+
+  h = g_hash_table_new (NULL, NULL);
+
+  for (i = 0; i < 100000; i++)
+    {
+      guint key = g_test_rand_int_range (0, G_N_ELEMENTS (present));
+
+      if (g_test_rand_bit ())
+        {
+          if (!present[key])
+            n++;
+          present[key] = TRUE;
+          g_hash_table_insert (h, HASH_TEST_KEY (key), GUINT_TO_POINTER (key));
+        }
+      else
+        {
+          g_assert (g_hash_table_remove (h, HASH_TEST_KEY (key)) == present[key]);
+          if (present[key])
+            n--;
+          present[key] = FALSE;
+        }
+
+      g_assert_cmpint (g_hash_table_size (h), ==, n);
+
+      if (i % 1000 == 0)
+        {
+          guint j;
+
+          check_consistency (h);
+          for (j = 0; j < G_N_ELEMENTS (present); j++)
+            g_assert (g_hash_table_contains (h, HASH_TEST_KEY (j)) == present[j]);
+        }
+    }
+
+  g_hash_table_unref (h);
+}
+
+static void
+test_interned (void)
+{
+  GHashTable *h;
+  gchar *key;
+  const gchar *orig_key;
+  gpointer value;
+
+  h = g_hash_table_new_interned (g_free);
+
+  key = g_strdup ("/org/bluez/hci0");
+  g_hash_table_insert (h, key, g_strdup ("adapter"));
+  g_hash_table_add (h, "/org/bluez/hci0/dev_00_11_22_33_44_55");
+  g_free (key);
+
+  check_consistency (h);
+
+  /* interned and plain keys both find the entry */
+  g_assert_cmpstr (g_hash_table_lookup (h, g_intern_string ("/org/bluez/hci0")), ==, "adapter");
+  g_assert_cmpstr (g_hash_table_lookup (h, "/org/bluez/hci0"), ==, "adapter");
+  g_assert (g_hash_table_lookup (h, "/org/bluez/hci1") == NULL);
+
+  /* the table kept the interned copy of the key */
+  g_assert (g_hash_table_lookup_extended (h, "/org/bluez/hci0", (gpointer *) &orig_key, &value));
+  g_assert (orig_key == g_intern_string ("/org/bluez/hci0"));
+
+  g_assert (g_hash_table_lookup_extended (h, "/org/bluez/hci0/dev_00_11_22_33_44_55",
+                                          (gpointer *) &orig_key, &value));
+  g_assert (orig_key == value);
+  g_assert (orig_key == g_intern_string ("/org/bluez/hci0/dev_00_11_22_33_44_55"));
+  g_hash_table_steal (h, orig_key);
+
+  g_hash_table_replace (h, "/org/bluez/hci0", g_strdup ("replaced"));
+  g_assert_cmpint (g_hash_table_size (h), ==, 1);
+  g_assert_cmpstr (g_hash_table_lookup (h, "/org/bluez/hci0"), ==, "replaced");
+
+  g_assert (g_hash_table_remove (h, "/org/bluez/hci0"));
+  g_assert_cmpint (g_hash_table_size (h), ==, 0);
+  check_consistency (h);
+
+  g_hash_table_unref (h);
+}
+
 static void
 my_key_free (gpointer v)
 {
@@ -1241,6 +1390,9 @@ main (int argc, char *argv[])
   g_test_add_func ("/hash/destroy-modify", test_destroy_modify);
   g_test_add_func ("/hash/consistency", test_internal_consistency);
   g_test_add_func ("/hash/iter-replace", test_iter_replace);
+  g_test_add_func ("/hash/bad-hash", test_bad_hash);
+  g_test_add_func ("/hash/churn", test_churn);
+  g_test_add_func ("/hash/interned", test_interned);
 
   return g_test_run ();
 
@@ -1,7 +1,9 @@
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <locale.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 static GKeyFile *
 load_data (const gchar   *data,
@@ -1563,6 +1565,61 @@ test_roundtrip (void)
   g_key_file_free (kf);
 }
 
+static void
+test_parse_in_place (void)
+{
+  GKeyFile *kf;
+  GError *error = NULL;
+  const gchar data[] =
+    "# comment\r\n"
+    "[Group]\r\n"
+    "empty=   \n"
+    "key = value\r\n"
+    "\n"
+    "[Other]  \n"
+    "last=truncated";
+  gchar *path, *str;
+  gint fd;
+
+  /* Parsing must stop at the given length, not at a nul */
+  kf = g_key_file_new ();
+  g_key_file_load_from_data (kf, data, sizeof data - 6, G_KEY_FILE_KEEP_COMMENTS, &error);
+  g_assert_no_error (error);
+
+  check_string_value (kf, "Group", "empty", "");
+  check_string_value (kf, "Group", "key", "value");
+  check_string_value (kf, "Other", "last", "trun");
+
+  str = g_key_file_to_data (kf, NULL, NULL);
+  g_assert_cmpstr (str, ==,
+                   "# comment\n"
+                   "\n"
+                   "[Group]\n"
+                   "empty=\n"
+                   "key=value\n"
+                   "\n"
+                   "[Other]\n"
+                   "last=trun\n");
+  g_free (str);
+  g_key_file_free (kf);
+
+  /* Files are parsed in one go from a mapping */
+  fd = g_file_open_tmp ("keyfile-XXXXXX", &path, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (write (fd, data, sizeof data - 1), ==, sizeof data - 1);
+  close (fd);
+
+  kf = g_key_file_new ();
+  g_key_file_load_from_file (kf, path, G_KEY_FILE_NONE, &error);
+  g_assert_no_error (error);
+  check_string_value (kf, "Group", "key", "value");
+  check_string_value (kf, "Other", "last", "truncated");
+  g_key_file_free (kf);
+
+  g_unlink (path);
+  g_free (path);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -1602,6 +1659,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/keyfile/limbo", test_limbo);
   g_test_add_func ("/keyfile/utf8", test_utf8);
   g_test_add_func ("/keyfile/roundtrip", test_roundtrip);
+  g_test_add_func ("/keyfile/parse-in-place", test_parse_in_place);
 
   return g_test_run ();
 }
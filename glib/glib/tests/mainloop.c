@@ -22,6 +22,11 @@
 
 #include <glib.h>
 
+#ifdef G_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 static gboolean cb (gpointer data)
 {
   return FALSE;
@@ -468,6 +473,183 @@ test_recursive_child_sources (void)
   g_main_context_unref (ctx);
 }
 
+#ifdef G_OS_UNIX
+
+static gboolean
+count_cb (GIOChannel   *channel,
+          GIOCondition  cond,
+          gpointer      data)
+{
+  gint *count = data;
+
+  (*count)++;
+
+  return TRUE;
+}
+
+static gboolean
+drain_cb (GIOChannel   *channel,
+          GIOCondition  cond,
+          gpointer      data)
+{
+  gint *count = data;
+  gchar buf[16];
+
+  g_assert_cmpint (read (g_io_channel_unix_get_fd (channel), buf, sizeof buf), >, 0);
+  (*count)++;
+
+  return TRUE;
+}
+
+static GSource *
+add_fd_watch (GMainContext *ctx,
+              gint          fd,
+              GIOCondition  cond,
+              GIOFunc       func,
+              gpointer      data)
+{
+  GIOChannel *channel;
+  GSource *source;
+
+  channel = g_io_channel_unix_new (fd);
+  source = g_io_create_watch (channel, cond);
+  g_source_set_callback (source, (GSourceFunc) func, data, NULL);
+  g_source_attach (source, ctx);
+  g_io_channel_unref (channel);
+
+  return source;
+}
+
+static void
+remove_fd_watch (GSource *source)
+{
+  g_source_destroy (source);
+  g_source_unref (source);
+}
+
+static void
+run_fd_sources (gboolean epoll)
+{
+  GMainContext *ctx;
+  GSource *in_a, *out_a, *in_b, *hup_b, *in_null;
+  gint a[2], b[2], null_fd;
+  gint n_in_a = 0, n_out_a = 0, n_in_b = 0, n_hup_b = 0, n_null = 0;
+
+  /* Only contexts created while it is set use the epoll backend */
+  if (epoll)
+    g_setenv ("G_MAIN_EPOLL", "1", TRUE);
+  ctx = g_main_context_new ();
+  g_unsetenv ("G_MAIN_EPOLL");
+
+  g_assert_cmpint (pipe (a), ==, 0);
+  g_assert_cmpint (pipe (b), ==, 0);
+
+  in_a = add_fd_watch (ctx, a[0], G_IO_IN, drain_cb, &n_in_a);
+  out_a = add_fd_watch (ctx, a[1], G_IO_OUT, count_cb, &n_out_a);
+  /* Two watches on the same descriptor */
+  in_b = add_fd_watch (ctx, b[0], G_IO_IN, drain_cb, &n_in_b);
+  hup_b = add_fd_watch (ctx, b[0], G_IO_HUP, count_cb, &n_hup_b);
+
+  g_assert (g_main_context_iteration (ctx, FALSE));
+  g_assert_cmpint (n_out_a, ==, 1);
+  g_assert_cmpint (n_in_a + n_in_b + n_hup_b, ==, 0);
+
+  remove_fd_watch (out_a);
+  g_assert (!g_main_context_iteration (ctx, FALSE));
+
+  g_assert_cmpint (write (a[1], "x", 1), ==, 1);
+  g_assert (g_main_context_iteration (ctx, FALSE));
+  g_assert_cmpint (n_in_a, ==, 1);
+  g_assert_cmpint (n_in_b + n_hup_b, ==, 0);
+  g_assert (!g_main_context_iteration (ctx, FALSE));
+
+  g_assert_cmpint (write (b[1], "x", 1), ==, 1);
+  g_assert (g_main_context_iteration (ctx, FALSE));
+  g_assert_cmpint (n_in_b, ==, 1);
+  g_assert_cmpint (n_hup_b, ==, 0);
+
+  close (b[1]);
+  g_assert (g_main_context_iteration (ctx, FALSE));
+  g_assert_cmpint (n_hup_b, ==, 1);
+  g_assert_cmpint (n_in_a, ==, 1);
+  g_assert_cmpint (n_in_b, ==, 1);
+
+  remove_fd_watch (hup_b);
+  remove_fd_watch (in_b);
+  g_assert (!g_main_context_iteration (ctx, FALSE));
+
+  /* Descriptors epoll refuses are always ready, as with poll() */
+  null_fd = open ("/dev/null", O_RDONLY);
+  g_assert_cmpint (null_fd, >=, 0);
+  in_null = add_fd_watch (ctx, null_fd, G_IO_IN, count_cb, &n_null);
+  g_assert (g_main_context_iteration (ctx, FALSE));
+  g_assert (g_main_context_iteration (ctx, FALSE));
+  g_assert_cmpint (n_null, ==, 2);
+  remove_fd_watch (in_null);
+
+  remove_fd_watch (in_a);
+  g_assert (!g_main_context_iteration (ctx, FALSE));
+
+  close (null_fd);
+  close (a[0]);
+  close (a[1]);
+  close (b[0]);
+
+  g_main_context_unref (ctx);
+}
+
+static void
+test_fd_sources (void)
+{
+  run_fd_sources (FALSE);
+}
+
+static void
+test_fd_sources_epoll (void)
+{
+  run_fd_sources (TRUE);
+}
+
+/* A descriptor closed before its watch is removed stays in the epoll
+ * set as long as another copy of it is open, and keeps reporting
+ * events that must be ignored.
+ */
+static void
+test_fd_closed_epoll (void)
+{
+  GMainContext *ctx;
+  GSource *in;
+  gint p[2], copy;
+  gint n_in = 0;
+
+  g_setenv ("G_MAIN_EPOLL", "1", TRUE);
+  ctx = g_main_context_new ();
+  g_unsetenv ("G_MAIN_EPOLL");
+
+  g_assert_cmpint (pipe (p), ==, 0);
+  copy = dup (p[0]);
+  g_assert_cmpint (copy, >=, 0);
+
+  in = add_fd_watch (ctx, p[0], G_IO_IN, drain_cb, &n_in);
+  g_assert (!g_main_context_iteration (ctx, FALSE));
+
+  close (p[0]);
+  remove_fd_watch (in);
+  g_assert (!g_main_context_iteration (ctx, FALSE));
+
+  g_assert_cmpint (write (p[1], "x", 1), ==, 1);
+  g_assert (!g_main_context_iteration (ctx, FALSE));
+  g_assert (!g_main_context_iteration (ctx, FALSE));
+  g_assert_cmpint (n_in, ==, 0);
+
+  close (copy);
+  close (p[1]);
+
+  g_main_context_unref (ctx);
+}
+
+#endif
+
 int
 main (int argc, char *argv[])
 {
@@ -480,6 +662,11 @@ main (int argc, char *argv[])
   g_test_add_func ("/mainloop/invoke", test_invoke);
   g_test_add_func ("/mainloop/child_sources", test_child_sources);
   g_test_add_func ("/mainloop/recursive_child_sources", test_recursive_child_sources);
+#ifdef G_OS_UNIX
+  g_test_add_func ("/mainloop/fd_sources", test_fd_sources);
+  g_test_add_func ("/mainloop/fd_sources/epoll", test_fd_sources_epoll);
+  g_test_add_func ("/mainloop/fd_closed/epoll", test_fd_closed_epoll);
+#endif
 
   return g_test_run ();
 }
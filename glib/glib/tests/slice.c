@@ -1,3 +1,4 @@
+#include <string.h>
 #include <glib.h>
 
 static void
@@ -12,6 +13,91 @@ test_slice_config (void)
   g_test_trap_assert_failed ();
 }
 
+static void
+test_slice_arena (void)
+{
+  GSliceArena *arena;
+  guint8 *first, *start = NULL, *prev = NULL;
+  gint i, round;
+
+  arena = g_slice_arena_new (512);
+
+  for (round = 0; round < 3; round++)
+    {
+      first = NULL;
+
+      for (i = 0; i < 1000; i++)
+        {
+          gsize size = 1 + i % 100;
+          guint8 *mem = g_slice_arena_alloc (arena, size);
+
+          g_assert ((gsize) mem % (2 * sizeof (gsize)) == 0);
+          memset (mem, i, size);
+          if (!first)
+            first = mem;
+          if (prev && prev != mem)
+            g_assert_cmpint (prev[0], ==, (guint8) (i - 1));
+          prev = mem;
+        }
+
+      /* memory is reused from the start after a reset */
+      if (start && g_strcmp0 (g_getenv ("G_SLICE"), "always-malloc") != 0)
+        g_assert (first == start);
+      start = first;
+
+      g_slice_arena_reset (arena);
+      prev = NULL;
+    }
+
+  /* big chunks don't use up the blocks */
+  for (i = 0; i < 10; i++)
+    {
+      guint8 *mem = g_slice_arena_alloc0 (arena, 4096);
+      g_assert_cmpint (mem[0], ==, 0);
+      g_assert_cmpint (mem[4095], ==, 0);
+      memset (mem, 0xff, 4096);
+    }
+
+  g_slice_arena_reset (arena);
+  g_slice_arena_free (arena);
+  g_slice_arena_free (NULL);
+}
+
+static void
+test_slice_arena_lists (void)
+{
+  GSliceArena *arena;
+  GSList *slist = NULL;
+  GList *list = NULL, *l;
+  gint i;
+
+  arena = g_slice_arena_new (0);
+
+  for (i = 0; i < 100; i++)
+    {
+      slist = g_slist_arena_prepend (arena, slist, GINT_TO_POINTER (i));
+      list = g_list_arena_prepend (arena, list, GINT_TO_POINTER (i));
+    }
+
+  g_assert_cmpint (g_slist_length (slist), ==, 100);
+  g_assert_cmpint (g_list_length (list), ==, 100);
+  g_assert_cmpint (GPOINTER_TO_INT (slist->data), ==, 99);
+
+  /* walk backwards to check the prev links */
+  l = g_list_last (list);
+  for (i = 0; l; l = l->prev, i++)
+    g_assert_cmpint (GPOINTER_TO_INT (l->data), ==, i);
+  g_assert_cmpint (i, ==, 100);
+
+  /* arena nodes work with the functions that don't free */
+  slist = g_slist_reverse (slist);
+  g_assert_cmpint (GPOINTER_TO_INT (slist->data), ==, 0);
+  list = g_list_reverse (list);
+  g_assert_cmpint (GPOINTER_TO_INT (list->data), ==, 0);
+
+  g_slice_arena_free (arena);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -26,6 +112,8 @@ main (int argc, char **argv)
   g_test_init (&argc, &argv, NULL);
 
   g_test_add_func ("/slice/config", test_slice_config);
+  g_test_add_func ("/slice/arena", test_slice_arena);
+  g_test_add_func ("/slice/arena/lists", test_slice_arena_lists);
 
   return g_test_run ();
 }
@@ -472,6 +472,105 @@ test_string_set_size (void)
   g_string_free (s, TRUE);
 }
 
+static void
+test_string_append_printf_growth (void)
+{
+  GString *s;
+  gchar *expected;
+  gint i;
+
+  /* lengths around the size of the stack buffer, so that both the
+   * short and the long path are taken
+   */
+  for (i = 0; i < 300; i++)
+    {
+      s = g_string_new ("start:");
+      g_string_append_printf (s, "%0*d|%s", i, 7, "end");
+
+      expected = g_strdup_printf ("start:%0*d|%s", i, 7, "end");
+      g_assert_cmpstr (s->str, ==, expected);
+      g_assert_cmpint (s->len, ==, strlen (expected));
+      g_assert_cmpint (s->len, <, s->allocated_len);
+      g_free (expected);
+
+      g_string_free (s, TRUE);
+    }
+
+  s = g_string_sized_new (1);
+  for (i = 0; i < 1000; i++)
+    g_string_append_printf (s, "<%d>", i);
+  g_assert (g_str_has_prefix (s->str, "<0><1><2>"));
+  g_assert (g_str_has_suffix (s->str, "<998><999>"));
+  g_assert_cmpint (strlen (s->str), ==, s->len);
+  g_string_free (s, TRUE);
+
+  /* the arguments may point into the string itself */
+  s = g_string_new ("abc");
+  g_string_append_printf (s, "%s-%s", s->str, s->str);
+  g_assert_cmpstr (s->str, ==, "abcabc-abc");
+  g_string_free (s, TRUE);
+}
+
+static void
+test_string_reserve (void)
+{
+  GString *s;
+  gchar *str;
+
+  s = g_string_new ("foo");
+  g_string_reserve (s, 1000);
+  g_assert_cmpstr (s->str, ==, "foo");
+  g_assert_cmpint (s->allocated_len, >, 1003);
+
+  str = s->str;
+  while (s->len < 1000)
+    g_string_append (s, "bar");
+  g_assert (s->str == str);
+
+  g_string_free (s, TRUE);
+}
+
+static void
+test_string_append_numbers (void)
+{
+  GString *s;
+
+  s = g_string_new (NULL);
+
+  g_string_append_uint (s, 0);
+  g_string_append_c (s, ' ');
+  g_string_append_uint (s, 1234567890);
+  g_string_append_c (s, ' ');
+  g_string_append_uint (s, G_MAXUINT64);
+  g_assert_cmpstr (s->str, ==, "0 1234567890 18446744073709551615");
+
+  g_string_truncate (s, 0);
+  g_string_append_int (s, -1);
+  g_string_append_c (s, ' ');
+  g_string_append_int (s, 42);
+  g_string_append_c (s, ' ');
+  g_string_append_int (s, G_MININT64);
+  g_string_append_c (s, ' ');
+  g_string_append_int (s, G_MAXINT64);
+  g_assert_cmpstr (s->str, ==,
+                   "-1 42 -9223372036854775808 9223372036854775807");
+
+  g_string_truncate (s, 0);
+  g_string_append_hex (s, 0, 0, FALSE);
+  g_string_append_c (s, ' ');
+  g_string_append_hex (s, 0xab, 4, FALSE);
+  g_string_append_c (s, ' ');
+  g_string_append_hex (s, 0xab, 4, TRUE);
+  g_string_append_c (s, ' ');
+  g_string_append_hex (s, 0x12345, 2, TRUE);
+  g_string_append_c (s, ' ');
+  g_string_append_hex (s, G_MAXUINT64, 0, FALSE);
+  g_assert_cmpstr (s->str, ==, "0 00ab 00AB 12345 ffffffffffffffff");
+  g_assert_cmpint (strlen (s->str), ==, s->len);
+
+  g_string_free (s, TRUE);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -495,6 +594,9 @@ main (int   argc,
   g_test_add_func ("/string/test-string-nul-handling", test_string_nul_handling);
   g_test_add_func ("/string/test-string-up-down", test_string_up_down);
   g_test_add_func ("/string/test-string-set-size", test_string_set_size);
+  g_test_add_func ("/string/test-string-append-printf-growth", test_string_append_printf_growth);
+  g_test_add_func ("/string/test-string-reserve", test_string_reserve);
+  g_test_add_func ("/string/test-string-append-numbers", test_string_append_numbers);
 
   return g_test_run();
 }
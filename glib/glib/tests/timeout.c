@@ -92,6 +92,89 @@ test_rounding (void)
   g_main_loop_unref (loop);
 }
 
+#define N_TIMEOUTS 500
+
+static gint n_fired;
+static gint n_repeats;
+
+static gboolean
+check_expired (gpointer data)
+{
+  gint64 *expiration = data;
+
+  g_assert_cmpint (*expiration, <=, g_get_monotonic_time ());
+  n_fired++;
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+repeat_func (gpointer data)
+{
+  GMainLoop *loop = data;
+
+  if (++n_repeats < 5)
+    return G_SOURCE_CONTINUE;
+
+  g_main_loop_quit (loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+test_many (void)
+{
+  GMainContext *ctx;
+  GMainLoop *loop;
+  GSource *sources[N_TIMEOUTS];
+  gint64 expirations[N_TIMEOUTS];
+  GSource *source;
+  gint64 start;
+  gint i, n_removed = 0;
+
+  ctx = g_main_context_new ();
+  loop = g_main_loop_new (ctx, FALSE);
+
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < N_TIMEOUTS; i++)
+    {
+      guint interval = g_test_rand_int_range (0, 100);
+
+      sources[i] = g_timeout_source_new (interval);
+      expirations[i] = start + interval * 1000;
+      g_source_set_callback (sources[i], check_expired, &expirations[i], NULL);
+      g_source_attach (sources[i], ctx);
+    }
+
+  /* Removing sources must keep the others scheduled */
+  for (i = 0; i < N_TIMEOUTS; i += 7)
+    {
+      g_source_destroy (sources[i]);
+      n_removed++;
+    }
+
+  source = g_timeout_source_new (30);
+  g_source_set_callback (source, repeat_func, loop, NULL);
+  g_source_attach (source, ctx);
+  g_source_unref (source);
+
+  g_main_loop_run (loop);
+
+  /* Drain whatever is left after the repeating timeout stopped */
+  while (n_fired + n_removed < N_TIMEOUTS)
+    g_main_context_iteration (ctx, TRUE);
+
+  g_assert_cmpint (n_repeats, ==, 5);
+  g_assert (!g_main_context_pending (ctx));
+
+  for (i = 0; i < N_TIMEOUTS; i++)
+    g_source_unref (sources[i]);
+
+  g_main_loop_unref (loop);
+  g_main_context_unref (ctx);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -99,6 +182,7 @@ main (int argc, char *argv[])
 
   g_test_add_func ("/timeout/seconds", test_seconds);
   g_test_add_func ("/timeout/rounding", test_rounding);
+  g_test_add_func ("/timeout/many", test_many);
 
   return g_test_run ();
 }
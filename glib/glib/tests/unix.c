@@ -25,6 +25,8 @@
 
 #include "glib-unix.h"
 #include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
 
 static void
 test_pipe (void)
@@ -145,6 +147,140 @@ test_sighup_add_remove (void)
 
 }
 
+static void
+test_read_packets (void)
+{
+  GError *error = NULL;
+  GIOChannel *channel;
+  GIOChannelPacket packets[4];
+  gchar bufs[4][16];
+  const gchar *msgs[] = { "one", "two", "three", "truncated message" };
+  GIOStatus status;
+  guint i, n;
+  int sv[2];
+
+  g_assert_cmpint (socketpair (AF_UNIX, SOCK_SEQPACKET, 0, sv), ==, 0);
+
+  channel = g_io_channel_unix_new (sv[0]);
+  g_io_channel_set_encoding (channel, NULL, NULL);
+  g_io_channel_set_buffered (channel, FALSE);
+  g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (packets); i++)
+    {
+      packets[i].buf = bufs[i];
+      packets[i].size = i < 3 ? sizeof (bufs[i]) : 9;
+    }
+
+  status = g_io_channel_unix_read_packets (channel, packets, 4, &n, &error);
+  g_assert_cmpint (status, ==, G_IO_STATUS_AGAIN);
+  g_assert_no_error (error);
+  g_assert_cmpuint (n, ==, 0);
+
+  for (i = 0; i < G_N_ELEMENTS (msgs); i++)
+    g_assert_cmpint (write (sv[1], msgs[i], strlen (msgs[i])), ==, strlen (msgs[i]));
+
+  /* a short batch only takes what it asks for */
+  status = g_io_channel_unix_read_packets (channel, packets, 1, &n, &error);
+  g_assert_cmpint (status, ==, G_IO_STATUS_NORMAL);
+  g_assert_cmpuint (n, ==, 1);
+  g_assert_cmpuint (packets[0].bytes_read, ==, 3);
+  g_assert (memcmp (bufs[0], "one", 3) == 0);
+
+  status = g_io_channel_unix_read_packets (channel, packets, 4, &n, &error);
+  g_assert_cmpint (status, ==, G_IO_STATUS_NORMAL);
+  g_assert_no_error (error);
+  g_assert_cmpuint (n, ==, 3);
+  g_assert_cmpuint (packets[0].bytes_read, ==, 3);
+  g_assert (memcmp (bufs[0], "two", 3) == 0);
+  g_assert_cmpuint (packets[1].bytes_read, ==, 5);
+  g_assert (memcmp (bufs[1], "three", 5) == 0);
+  g_assert_cmpuint (packets[2].bytes_read, ==, 16);
+  g_assert (memcmp (bufs[2], "truncated messag", 16) == 0);
+  g_assert_cmpuint (packets[3].bytes_read, ==, 0);
+
+  close (sv[1]);
+
+  status = g_io_channel_unix_read_packets (channel, packets, 4, &n, &error);
+  g_assert_cmpint (status, ==, G_IO_STATUS_EOF);
+  g_assert_no_error (error);
+
+  g_io_channel_unref (channel);
+  close (sv[0]);
+
+  /* pipes are read one chunk at a time */
+  g_assert_cmpint (pipe (sv), ==, 0);
+  channel = g_io_channel_unix_new (sv[0]);
+  g_io_channel_set_encoding (channel, NULL, NULL);
+  g_io_channel_set_buffered (channel, FALSE);
+
+  g_assert_cmpint (write (sv[1], "abcdef", 6), ==, 6);
+  status = g_io_channel_unix_read_packets (channel, packets, 4, &n, &error);
+  g_assert_cmpint (status, ==, G_IO_STATUS_NORMAL);
+  g_assert_no_error (error);
+  g_assert_cmpuint (n, ==, 1);
+  g_assert_cmpuint (packets[0].bytes_read, ==, 6);
+  g_assert (memcmp (bufs[0], "abcdef", 6) == 0);
+
+  g_io_channel_unref (channel);
+  close (sv[0]);
+  close (sv[1]);
+}
+
+static void
+test_read_chars_direct (void)
+{
+  GError *error = NULL;
+  GIOChannel *channel;
+  gchar in[4096], out[4096];
+  gsize n;
+  GIOStatus status;
+  guint i;
+  int fds[2];
+
+  for (i = 0; i < sizeof (in); i++)
+    in[i] = i % 251;
+
+  g_assert_cmpint (pipe (fds), ==, 0);
+  channel = g_io_channel_unix_new (fds[0]);
+  g_io_channel_set_encoding (channel, NULL, NULL);
+  g_io_channel_set_flags (channel, G_IO_FLAG_NONBLOCK, NULL);
+  g_io_channel_set_buffer_size (channel, 1024);
+
+  g_assert_cmpint (write (fds[1], in, sizeof (in)), ==, sizeof (in));
+
+  /* small reads go through the buffer, which then holds the rest */
+  status = g_io_channel_read_chars (channel, out, 10, &n, &error);
+  g_assert_cmpint (status, ==, G_IO_STATUS_NORMAL);
+  g_assert_cmpuint (n, ==, 10);
+
+  /* big reads are still served in order, from buffer and descriptor */
+  status = g_io_channel_read_chars (channel, out + 10, 2048, &n, &error);
+  g_assert_cmpint (status, ==, G_IO_STATUS_NORMAL);
+  g_assert_no_error (error);
+  g_assert_cmpuint (n, ==, 2048);
+
+  status = g_io_channel_read_chars (channel, out + 2058, sizeof (out), &n,
+                                    &error);
+  g_assert_cmpint (status, ==, G_IO_STATUS_NORMAL);
+  g_assert_no_error (error);
+  g_assert_cmpuint (n, ==, sizeof (out) - 2058);
+  g_assert (memcmp (in, out, sizeof (in)) == 0);
+
+  status = g_io_channel_read_chars (channel, out, sizeof (out), &n, &error);
+  g_assert_cmpint (status, ==, G_IO_STATUS_AGAIN);
+  g_assert_no_error (error);
+  g_assert_cmpuint (n, ==, 0);
+
+  close (fds[1]);
+  status = g_io_channel_read_chars (channel, out, sizeof (out), &n, &error);
+  g_assert_cmpint (status, ==, G_IO_STATUS_EOF);
+  g_assert_no_error (error);
+
+  g_io_channel_unref (channel);
+  close (fds[0]);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -157,6 +293,8 @@ main (int   argc,
   g_test_add_func ("/glib-unix/sigterm", test_sigterm);
   g_test_add_func ("/glib-unix/sighup_again", test_sighup);
   g_test_add_func ("/glib-unix/sighup_add_remove", test_sighup_add_remove);
+  g_test_add_func ("/glib-unix/read-packets", test_read_packets);
+  g_test_add_func ("/glib-unix/read-chars-direct", test_read_chars_direct);
 
   return g_test_run();
 }
@@ -144,6 +144,74 @@ grind_utf8_to_ucs4_fast_sized (const char *str, gsize len)
   return 0;
 }
 
+static int
+grind_validate (const char *str, gsize len)
+{
+  int acc = 0;
+  int i;
+  for (i = 0; i < NUM_ITERATIONS; i++)
+    acc += g_utf8_validate (str, -1, NULL);
+  return acc;
+}
+
+static int
+grind_validate_sized (const char *str, gsize len)
+{
+  int acc = 0;
+  int i;
+  for (i = 0; i < NUM_ITERATIONS; i++)
+    acc += g_utf8_validate (str, len, NULL);
+  return acc;
+}
+
+static int
+grind_utf8_to_utf16 (const char *str, gsize len)
+{
+  int i;
+  for (i = 0; i < NUM_ITERATIONS; i++)
+    {
+      gunichar2 *ustr;
+      ustr = g_utf8_to_utf16 (str, -1, NULL, NULL, NULL);
+      g_free (ustr);
+    }
+  return 0;
+}
+
+static int
+grind_utf16_to_utf8 (const char *str, gsize len)
+{
+  gunichar2 *ustr;
+  int i;
+
+  ustr = g_utf8_to_utf16 (str, -1, NULL, NULL, NULL);
+  for (i = 0; i < NUM_ITERATIONS; i++)
+    {
+      gchar *result;
+      result = g_utf16_to_utf8 (ustr, -1, NULL, NULL, NULL);
+      g_free (result);
+    }
+  g_free (ustr);
+  return 0;
+}
+
+static int
+grind_convert_utf16be (const char *str, gsize len)
+{
+  gchar *utf16;
+  gsize utf16_len;
+  int i;
+
+  utf16 = g_convert (str, len, "UTF-16BE", "UTF-8", NULL, &utf16_len, NULL);
+  for (i = 0; i < NUM_ITERATIONS; i++)
+    {
+      gchar *result;
+      result = g_convert (utf16, utf16_len, "UTF-8", "UTF-16BE", NULL, NULL, NULL);
+      g_free (result);
+    }
+  g_free (utf16);
+  return 0;
+}
+
 static void
 perform_for (GrindFunc grind_func, const char *str, const char *label)
 {
@@ -198,5 +266,15 @@ main (int argc, char **argv)
       grind_utf8_to_ucs4_fast, perform);
   g_test_add_data_func ("/utf8/perf/utf8_to_ucs4_fast-sized",
       grind_utf8_to_ucs4_fast_sized, perform);
+  g_test_add_data_func ("/utf8/perf/validate",
+      grind_validate, perform);
+  g_test_add_data_func ("/utf8/perf/validate-sized",
+      grind_validate_sized, perform);
+  g_test_add_data_func ("/utf8/perf/utf8_to_utf16",
+      grind_utf8_to_utf16, perform);
+  g_test_add_data_func ("/utf8/perf/utf16_to_utf8",
+      grind_utf16_to_utf8, perform);
+  g_test_add_data_func ("/utf8/perf/convert-utf16be",
+      grind_convert_utf16be, perform);
   return g_test_run ();
 }
@@ -17,6 +17,8 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#include <string.h>
+
 #include "glib.h"
 
 #define UNICODE_VALID(Char)                   \
@@ -286,6 +288,59 @@ do_test (gconstpointer d)
   g_assert (end - test->text == test->offset);
 }
 
+/* ASCII runs of every length and alignment around the block size of
+ * the vectorized code, followed by different kinds of non-ASCII input
+ */
+static void
+test_ascii_runs (void)
+{
+  union { gchar c[160]; guint64 align; } buf;
+  const gchar *end;
+  gint offset, len, i;
+
+  for (offset = 0; offset < 16; offset++)
+    for (len = 0; len < 100; len++)
+      {
+        gchar *text = buf.c + offset;
+
+        for (i = 0; i < len; i++)
+          text[i] = 'a' + i % 26;
+
+        /* end of string */
+        text[len] = '\0';
+        g_assert (g_utf8_validate (text, -1, &end));
+        g_assert (end == text + len);
+        g_assert (g_utf8_validate (text, len, &end));
+        g_assert (end == text + len);
+        g_assert (!g_utf8_validate (text, len + 1, &end));
+        g_assert (end == text + len);
+
+        /* invalid byte */
+        text[len] = '\xff';
+        text[len + 1] = 'b';
+        text[len + 2] = '\0';
+        g_assert (!g_utf8_validate (text, -1, &end));
+        g_assert (end == text + len);
+        g_assert (!g_utf8_validate (text, len + 2, &end));
+        g_assert (end == text + len);
+
+        /* two byte character, then ASCII again */
+        memcpy (text + len, "\xc3\xa9xyz", 6);
+        g_assert (g_utf8_validate (text, -1, &end));
+        g_assert (end == text + len + 5);
+        g_assert (g_utf8_validate (text, len + 5, &end));
+        g_assert (end == text + len + 5);
+
+        /* truncated three byte character */
+        g_assert (!g_utf8_validate ("\xe2\x82", 2, &end));
+        memcpy (text + len, "\xe2\x82", 3);
+        g_assert (!g_utf8_validate (text, -1, &end));
+        g_assert (end == text + len);
+        g_assert (!g_utf8_validate (text, len + 2, &end));
+        g_assert (end == text + len);
+      }
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -294,6 +349,8 @@ main (int argc, char *argv[])
 
   g_test_init (&argc, &argv, NULL);
 
+  g_test_add_func ("/utf8/validate/ascii-runs", test_ascii_runs);
+
   for (i = 0; test[i].text; i++)
     {
       path = g_strdup_printf ("/utf8/validate/%d", i);
@@ -0,0 +1,196 @@
+/* asyncqueue-bench.c - compare the bounded GAsyncQueue and the
+ * work-stealing GThreadPool with their mutex based counterparts
+ * Copyright (C) 2015 PDi Communication Systems, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <glib.h>
+
+#define N_ITEMS         (1000000)
+#define N_THREADS       (4)
+#define QUEUE_CAPACITY  (1024)
+
+/* items are counted from 1 so that a NULL never ends up in the queue */
+#define ITEM_STOP       GUINT_TO_POINTER (G_MAXUINT)
+
+static GAsyncQueue *queue;
+static guint n_items;
+static guint n_threads;
+
+static gpointer
+producer (gpointer data)
+{
+  guint i, n = n_items / n_threads;
+
+  for (i = 1; i <= n; i++)
+    g_async_queue_push (queue, GUINT_TO_POINTER (i));
+
+  return NULL;
+}
+
+static gpointer
+consumer (gpointer data)
+{
+  guint64 sum = 0;
+  gpointer item;
+
+  while ((item = g_async_queue_pop (queue)) != ITEM_STOP)
+    sum += GPOINTER_TO_UINT (item);
+
+  return g_memdup (&sum, sizeof (sum));
+}
+
+static gdouble
+run_queue (gboolean  bounded,
+           guint64  *sum)
+{
+  GThread *producers[N_THREADS * 4], *consumers[N_THREADS * 4];
+  GTimer *timer;
+  gdouble elapsed;
+  guint i;
+
+  if (bounded)
+    queue = g_async_queue_new_bounded (QUEUE_CAPACITY, NULL);
+  else
+    queue = g_async_queue_new ();
+
+  *sum = 0;
+  timer = g_timer_new ();
+
+  for (i = 0; i < n_threads; i++)
+    consumers[i] = g_thread_new ("consumer", consumer, NULL);
+  for (i = 0; i < n_threads; i++)
+    producers[i] = g_thread_new ("producer", producer, NULL);
+
+  for (i = 0; i < n_threads; i++)
+    g_thread_join (producers[i]);
+  for (i = 0; i < n_threads; i++)
+    g_async_queue_push (queue, ITEM_STOP);
+  for (i = 0; i < n_threads; i++)
+    {
+      guint64 *result = g_thread_join (consumers[i]);
+
+      *sum += *result;
+      g_free (result);
+    }
+
+  g_timer_stop (timer);
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_async_queue_unref (queue);
+
+  return elapsed;
+}
+
+/* Each task is a node of a binary tree; non-leaf tasks push their two
+ * children back into the pool, like a divide and conquer workload would.
+ */
+#define TREE_DEPTH      (10)
+
+static GThreadPool *pool;
+static gint n_tasks;
+
+static void
+tree_task (gpointer data,
+           gpointer user_data)
+{
+  guint depth = GPOINTER_TO_UINT (data);
+
+  g_atomic_int_inc (&n_tasks);
+
+  if (depth > 1)
+    {
+      g_thread_pool_push (pool, GUINT_TO_POINTER (depth - 1), NULL);
+      g_thread_pool_push (pool, GUINT_TO_POINTER (depth - 1), NULL);
+    }
+}
+
+static gdouble
+run_pool (gboolean stealing,
+          guint    n_trees)
+{
+  GTimer *timer;
+  gdouble elapsed;
+  guint i;
+
+  n_tasks = 0;
+
+  if (stealing)
+    pool = g_thread_pool_new_work_stealing (tree_task, NULL, n_threads, NULL);
+  else
+    pool = g_thread_pool_new (tree_task, NULL, n_threads, TRUE, NULL);
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < n_trees; i++)
+    g_thread_pool_push (pool, GUINT_TO_POINTER (TREE_DEPTH), NULL);
+
+  /* wait until every tree was expanded, then drain the pool */
+  while (g_atomic_int_get (&n_tasks) < (gint) (n_trees * ((1 << TREE_DEPTH) - 1)))
+    g_usleep (100);
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  g_timer_stop (timer);
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  return elapsed;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  guint64 sum, expected;
+  guint n_trees;
+
+  n_items = N_ITEMS;
+  n_threads = N_THREADS;
+
+  if (argc > 1)
+    n_items = g_ascii_strtoull (argv[1], NULL, 10);
+  if (argc > 2)
+    n_threads = CLAMP (g_ascii_strtoull (argv[2], NULL, 10), 1, N_THREADS * 4);
+
+  n_items -= n_items % n_threads;
+  expected = (guint64) n_threads * (n_items / n_threads) * (n_items / n_threads + 1) / 2;
+
+  g_print ("%u items, %u producers and %u consumers\n",
+           n_items, n_threads, n_threads);
+
+  g_print ("  %-10s %8.3f ms\n", "mutex",
+           run_queue (FALSE, &sum) * 1000.0);
+  if (sum != expected)
+    g_error ("mutex queue: checksum mismatch");
+
+  g_print ("  %-10s %8.3f ms\n", "bounded",
+           run_queue (TRUE, &sum) * 1000.0);
+  if (sum != expected)
+    g_error ("bounded queue: checksum mismatch");
+
+  n_trees = MAX (n_items / (1 << TREE_DEPTH), 1);
+
+  g_print ("%u task trees of depth %u, %u threads\n",
+           n_trees, TREE_DEPTH, n_threads);
+
+  g_print ("  %-10s %8.3f ms\n", "exclusive",
+           run_pool (FALSE, n_trees) * 1000.0);
+  g_print ("  %-10s %8.3f ms\n", "stealing",
+           run_pool (TRUE, n_trees) * 1000.0);
+
+  return 0;
+}
@@ -0,0 +1,164 @@
+/* slice-arena.c - compare GSliceArena with GSlice and malloc
+ * Copyright (C) 2015 PDi Communication Systems, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Every "dispatch" mimics what a Bluetooth daemon does when handling one
+ * event: collect a few matching objects into a temporary list, and build
+ * a handful of small request/PDU structures that are gone once the
+ * callback returns.
+ */
+#define N_DISPATCHES    (100000)
+#define LIST_LENGTH     (24)
+#define N_STRUCTS       (8)
+
+typedef enum {
+  MODE_MALLOC,
+  MODE_SLICE,
+  MODE_ARENA
+} Mode;
+
+static const gchar *mode_names[] = { "malloc", "slice", "arena" };
+
+/* sizes of typical short lived structures: ATT PDU headers, pending
+ * request records, D-Bus message helpers
+ */
+static const gsize struct_sizes[] = { 24, 40, 56, 72, 104, 136 };
+
+static guint
+run (Mode        mode,
+     guint       n_dispatches,
+     GSliceArena *arena)
+{
+  gpointer structs[N_STRUCTS];
+  guint checksum = 0;
+  guint i, j;
+
+  for (i = 0; i < n_dispatches; i++)
+    {
+      GSList *list = NULL, *l;
+
+      for (j = 0; j < LIST_LENGTH; j++)
+        {
+          gpointer data = GUINT_TO_POINTER (i + j);
+
+          if (mode == MODE_ARENA)
+            list = g_slist_arena_prepend (arena, list, data);
+          else if (mode == MODE_SLICE)
+            list = g_slist_prepend (list, data);
+          else
+            {
+              GSList *node = malloc (sizeof (GSList));
+              node->data = data;
+              node->next = list;
+              list = node;
+            }
+        }
+
+      for (j = 0; j < N_STRUCTS; j++)
+        {
+          gsize size = struct_sizes[(i + j) % G_N_ELEMENTS (struct_sizes)];
+
+          if (mode == MODE_ARENA)
+            structs[j] = g_slice_arena_alloc (arena, size);
+          else if (mode == MODE_SLICE)
+            structs[j] = g_slice_alloc (size);
+          else
+            structs[j] = malloc (size);
+          memset (structs[j], j, size);
+        }
+
+      for (l = list; l; l = l->next)
+        checksum += GPOINTER_TO_UINT (l->data);
+      for (j = 0; j < N_STRUCTS; j++)
+        checksum += ((guint8*) structs[j])[0];
+
+      if (mode == MODE_ARENA)
+        {
+          g_slice_arena_reset (arena);
+          continue;
+        }
+
+      for (j = 0; j < N_STRUCTS; j++)
+        {
+          gsize size = struct_sizes[(i + j) % G_N_ELEMENTS (struct_sizes)];
+
+          if (mode == MODE_SLICE)
+            g_slice_free1 (size, structs[j]);
+          else
+            free (structs[j]);
+        }
+
+      if (mode == MODE_SLICE)
+        g_slist_free (list);
+      else
+        while (list)
+          {
+            l = list->next;
+            free (list);
+            list = l;
+          }
+    }
+
+  return checksum;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  guint n_dispatches = N_DISPATCHES;
+  GSliceArena *arena;
+  guint checksum = 0;
+  Mode mode;
+
+  if (argc > 1)
+    n_dispatches = g_ascii_strtoull (argv[1], NULL, 10);
+
+  arena = g_slice_arena_new (0);
+
+  g_print ("%u dispatches, %u list nodes and %u structures each\n",
+           n_dispatches, LIST_LENGTH, N_STRUCTS);
+
+  for (mode = MODE_MALLOC; mode <= MODE_ARENA; mode++)
+    {
+      GTimer *timer = g_timer_new ();
+      guint result;
+
+      /* warm up the allocator caches */
+      run (mode, n_dispatches / 10 + 1, arena);
+
+      g_timer_start (timer);
+      result = run (mode, n_dispatches, arena);
+      g_timer_stop (timer);
+
+      if (mode != MODE_MALLOC && result != checksum)
+        g_error ("%s: checksum mismatch", mode_names[mode]);
+      checksum = result;
+
+      g_print ("  %-8s %8.3f ms\n", mode_names[mode],
+               g_timer_elapsed (timer, NULL) * 1000.0);
+      g_timer_destroy (timer);
+    }
+
+  g_slice_arena_free (arena);
+
+  return 0;
+}
@@ -358,6 +358,57 @@ test_thread_idle_time ()
 		 GUINT_TO_POINTER (interval));
 }
 
+static GThreadPool *stealing_pool = NULL;
+static gint stealing_counter = 0;
+
+static void
+test_thread_stealing_entry_func (gpointer data, gpointer user_data)
+{
+  guint depth = GPOINTER_TO_UINT (data);
+
+  g_atomic_int_inc (&stealing_counter);
+
+  /* tasks spawn more tasks, which stay on the worker's own deque */
+  if (depth > 1)
+    {
+      g_thread_pool_push (stealing_pool, GUINT_TO_POINTER (depth - 1), NULL);
+      g_thread_pool_push (stealing_pool, GUINT_TO_POINTER (depth - 1), NULL);
+    }
+}
+
+static void
+test_thread_stealing (void)
+{
+  GError *error = NULL;
+  guint i;
+
+  stealing_pool = g_thread_pool_new_work_stealing (test_thread_stealing_entry_func,
+                                                   NULL, 4, &error);
+  g_assert_no_error (error);
+  g_assert (stealing_pool != NULL);
+  g_assert (g_thread_pool_get_num_threads (stealing_pool) == 4);
+  g_assert (g_thread_pool_get_max_threads (stealing_pool) == 4);
+
+  /* 100 trees of depth 6 make 100 * 63 tasks */
+  for (i = 0; i < 100; i++)
+    g_thread_pool_push (stealing_pool, GUINT_TO_POINTER (6), NULL);
+
+  g_thread_pool_free (stealing_pool, FALSE, TRUE);
+
+  g_assert_cmpint (stealing_counter, ==, 100 * 63);
+
+  /* an immediate stop drops what is still queued */
+  stealing_counter = 0;
+  stealing_pool = g_thread_pool_new_work_stealing (test_thread_stealing_entry_func,
+                                                   NULL, 2, NULL);
+  for (i = 0; i < 1000; i++)
+    g_thread_pool_push (stealing_pool, GUINT_TO_POINTER (1), NULL);
+
+  g_thread_pool_free (stealing_pool, TRUE, TRUE);
+  g_assert_cmpint (stealing_counter, <=, 1000);
+  stealing_pool = NULL;
+}
+
 static gboolean
 test_check_start_and_stop (gpointer user_data)
 {
@@ -396,6 +447,9 @@ test_check_start_and_stop (gpointer user_data)
     case 7:
       test_thread_idle_time ();
       break;
+    case 8:
+      test_thread_stealing ();
+      break;
     default:
       DEBUG_MSG (("***** END OF TESTS *****"));
       g_main_loop_quit (main_loop);